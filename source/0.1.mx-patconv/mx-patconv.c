@@ -17,6 +17,7 @@
 
 #include "ext.h"
 #include "ext_obex.h"
+#include "../common/mx_stats.h"
 
 typedef struct _mx_patconv {
     t_object p_ob;
@@ -26,6 +27,7 @@ typedef struct _mx_patconv {
     t_atom_long *patbin;
     t_atom_long *pat;
     int last_called;
+    t_mx_stats stats;
 } t_mx_patconv;
 
 void *mx_patconv_new(t_symbol *s,  long argc, t_atom *argv);
@@ -34,6 +36,7 @@ void mx_patconv_pat(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv);
 void mx_patconv_patbin(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv);
 void mx_patconv_assist(t_mx_patconv *x, void *b, long m, long a, char *s);
 void mx_patconv_bang(t_mx_patconv *x);
+void mx_patconv_stats_info(t_mx_patconv *x, long *bytes, long *length);
 
 t_class *mx_patconv_class;
 
@@ -46,9 +49,11 @@ void ext_main(void *r){
     class_addmethod(c, (method)mx_patconv_pat, "pat", A_GIMME, 0);
     class_addmethod(c, (method)mx_patconv_patbin, "patbin", A_GIMME, 0);
     
+    MX_STATS_CLASS(c, t_mx_patconv, stats, mx_patconv_stats_info);
+    
     class_register(CLASS_BOX, c);
     mx_patconv_class = c;
-
+    
 }
 
 void *mx_patconv_new(t_symbol *s, long argc, t_atom *argv){
@@ -59,16 +64,22 @@ void *mx_patconv_new(t_symbol *s, long argc, t_atom *argv){
     
     x->patbin = NULL;
     x->pat = NULL;
+    x->patbin_length = 0;
+    x->pat_length = 0;
+    x->last_called = 0;
+    mx_stats_init(&x->stats, (t_object *)x);
     
+    attr_args_process(x, argc, argv);
     return (x);
 }
 
 void mx_patconv_free(t_mx_patconv *x){
+    mx_stats_free(&x->stats);
     if(x->patbin)
         sysmem_freeptr(x->patbin);
     
     if(x->pat)
-        sysmem_freeptr(x->patbin);
+        sysmem_freeptr(x->pat);
 }
 
 void mx_patconv_assist(t_mx_patconv *x, void *b, long m, long a, char *s){
@@ -93,6 +104,7 @@ void mx_patconv_patbin(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv){
         return;
     }
     
+    t_uint64 start = mx_stats_start(&x->stats);
     x->last_called = 0;
     t_atom_long patbin[argc];
     x->patbin_length = argc;
@@ -107,7 +119,7 @@ void mx_patconv_patbin(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv){
     }
     
     int beatcount = 0;
-
+    
     for(int i=0;i<argc;i++){
         beatcount += patbin[i];
     }
@@ -144,9 +156,9 @@ void mx_patconv_patbin(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv){
         //rest functionality is disabled for now, because no other objects supports it, and there is no time
         //to implement proper functionality. maybe for later release..
         /*
-        char buffer[4];
+        char buffer[16];
         t_atom pat[beatcount+1];
-        snprintf(buffer, 4, "r%d", rest);
+        snprintf(buffer, sizeof(buffer), "r%d", rest);
         atom_setsym(pat, gensym(buffer));
         for(int i=1;i<beatcount+1;i++){
             atom_setlong(pat+i, result[i-1]);
@@ -160,7 +172,9 @@ void mx_patconv_patbin(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv){
             x->pat[i] = result[i];
         }
         outlet_anything(x->msg_out, gensym("pat"), beatcount, pat);
+        mx_stats_sent(&x->stats, 1);
     }
+    mx_stats_gen(&x->stats, start);
 }
 
 void mx_patconv_pat(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv){
@@ -169,6 +183,7 @@ void mx_patconv_pat(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv){
         return;
     }
     
+    t_uint64 start = mx_stats_start(&x->stats);
     x->last_called = 1;
     t_atom_long pat[argc];
     x->pat_length = argc;
@@ -176,9 +191,9 @@ void mx_patconv_pat(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv){
     if(x->pat)
         sysmem_freeptr(x->pat);
     x->pat = (t_atom_long *)sysmem_newptrclear(x->pat_length * sizeof(t_atom_long));
-
+    
     long pat_sum = 0;
-
+    
     for(int i=0;i<argc;i++){
         pat[i] = atom_getlong(argv+i);
         x->pat[i] = pat[i];
@@ -191,7 +206,7 @@ void mx_patconv_pat(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv){
     if(x->patbin)
         sysmem_freeptr(x->patbin);
     x->patbin = (t_atom_long *)sysmem_newptrclear(x->patbin_length * sizeof(t_atom_long));
-
+    
     for(int i=0;i<pat_sum;i++){
         patbin[i] = 0;
     }
@@ -210,6 +225,8 @@ void mx_patconv_pat(t_mx_patconv *x, t_symbol *s, long argc, t_atom *argv){
     }
     
     outlet_anything(x->msg_out, gensym("patbin"), pat_sum, patbin_atom);
+    mx_stats_sent(&x->stats, 1);
+    mx_stats_gen(&x->stats, start);
 }
 
 void mx_patconv_bang(t_mx_patconv *x){
@@ -222,20 +239,26 @@ void mx_patconv_bang(t_mx_patconv *x){
     
     if(x->last_called == 0){
         t_atom arg[x->pat_length];
-        
+    
         for(int i=0;i<x->pat_length;i++){
             atom_setlong(arg+i, x->pat[i]);
         }
-        
+    
         outlet_anything(x->msg_out, gensym("pat"), x->pat_length, arg);
     }else{
         t_atom arg[x->patbin_length];
-        
+    
         for(int i=0;i<x->patbin_length;i++){
             atom_setlong(arg+i, x->patbin[i]);
         }
-        
+    
         outlet_anything(x->msg_out, gensym("patbin"), x->patbin_length, arg);
     }
-    
+    mx_stats_sent(&x->stats, 1);
+}
+
+void mx_patconv_stats_info(t_mx_patconv *x, long *bytes, long *length){
+    *bytes = sysmem_ptrsize(x->pat) + sysmem_ptrsize(x->patbin);
+    //the converted pattern, the one bang repeats
+    *length = x->last_called ? x->patbin_length : x->pat_length;
 }
@@ -1,7 +1,17 @@
 #include "ext.h"
 #include "z_dsp.h"
 #include "ext_obex.h"
+#include "ext_critical.h"
+#include "ext_buffer.h"
+#include "ext_dictobj.h"
 #include <stdarg.h>
+#include "../common/mx_arena.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+#include "../common/mx_events.h"
+#include "../common/mx_swap.h"
+#include "../common/mx_clock.h"
+#include "../common/mx_timing.h"
 
 //signal outlets (pat, cd, cp, stepnr)
 #define PAT_OUT 0
@@ -9,20 +19,87 @@
 #define CP_OUT 2
 #define STP_OUT 3
 
+//layout of the blob saved with @embed, bump when it changes
+#define MX_STATE_VERSION 1
+//onsets are packed 32 to a word
+#define STATE_WORDS(n) (((n)+31)/32)
+//longest arrangement in steps, the counter and arr_seek are 32 bit
+#define MX_ARRANGE_STEPS (1L<<24)
+
 typedef struct _schillinger{
     t_atom_long *pattern;
     t_atom_long *binpat;
     long steps;
     long bin_steps;
+    long pattern_cap;   //bytes allocated for pattern and binpat, they only ever grow
+    long binpat_cap;
 } t_schillinger;
 
+//the slots of @banks, perform plays from one version while the next is built
+typedef struct _bank{
+    long banks;
+    long size;          //steps per slot (@banksize)
+    long *steps;        //length of each slot, 0 for an empty slot
+    char *slots;        //banks * size steps, one slot after another
+    t_mx_arena mem;     //holds steps and slots, only ever grows
+} t_bank;
+
+//a whole form compiled from an arrange message
+typedef struct _arrangement{
+    t_uint64 *bits;     //one bit per step, all sections back to back
+    long steps;
+    long sections;
+    long bars;          //one bar is one pass through a section's pattern
+    long *start;        //first step of each section
+    long *first_bar;    //first bar of each section, ascending, for seek
+    long *bar_len;      //steps per bar of each section
+    t_mx_arena mem;     //holds the arrays above, only ever grows
+} t_arrangement;
+
+//the steps playing in a vector, one of the four, for the countdown of @timing
+typedef struct _source{
+    t_atom_long *binpat;    //the pattern
+    float *tab;             //the buffer~ channel, chans samples apart
+    long chans;
+    t_uint64 *bits;         //the arrangement
+    char *slot;             //the bank slot
+    long steps;             //0 when nothing plays
+} t_source;
+
 typedef struct _mx_player {
     t_pxobject p_ob;
     int counter;
     int step_prev;
     t_schillinger t;
     void *msg_out;
+    void *onset_out;
     char *out_names[2];
+    t_buffer_ref *buf_ref;  //onset table from buffer~ (@buffer)
+    t_symbol *buf_name;
+    long buf_chan;
+    char coalesce;
+    t_qelem *pending_q;
+    t_critical pending_lock;
+    t_symbol *pending_s;        //latest pat/patbin message, waiting for pending_q
+    long pending_argc;
+    long pending_size;
+    t_atom *pending_argv;
+    t_bank bank[3];         //versions of the bank, handed to perform by bank_swap
+    t_mx_swap bank_swap;
+    long banks;             //of the version published last
+    long bank_size;
+    long bank_active;       //slot currently playing, 0-based, perform only
+    t_arrangement arr[3];   //versions of the arrangement, handed to perform by arr_swap
+    t_mx_swap arr_swap;
+    t_int32_atomic arr_seek;    //step to continue from on the next click, -1 for none
+    t_mx_clock_reader clock;
+    long clock_shift;       //with @clock, steps the arrangement is ahead of the count after a seek
+    t_mx_timing timing;
+    void *timing_table;     //the steps the countdown was looked up in, perform only
+    long timing_steps;
+    char embed;
+    t_mx_stats stats;
+    t_mx_events events;
 } t_mx_player;
 
 void *mx_player_new(t_symbol *s,  long argc, t_atom *argv);
@@ -34,12 +111,39 @@ void mx_player_perform64(t_mx_player *x, t_object *dsp64, double **ins, long num
 void mx_player_dsp64(t_mx_player *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
 void mx_player_free(t_mx_player *x);
 void mx_player_pat(t_mx_player *x, t_symbol *s, long argc, t_atom *argv);
+void mx_player_coalesce(t_mx_player *x, t_symbol *s, long argc, t_atom *argv);
+void mx_player_coalesced(t_mx_player *x);
+void mx_player_dispatch(t_mx_player *x, t_symbol *s, long argc, t_atom *argv);
 void mx_player_npat(t_mx_player *x, t_symbol *s, long argc, t_atom *argv);
+t_max_err mx_player_buffer_set(t_mx_player *x, void *attr, long argc, t_atom *argv);
+t_max_err mx_player_notify(t_mx_player *x, t_symbol *s, t_symbol *msg, void *sender, void *data);
+void mx_player_perform_buffer(t_mx_player *x, t_buffer_obj *b, double **ins, double **outs, long sampleframes);
+void mx_player_perform_bank(t_mx_player *x, t_bank *bank, double **ins, double **outs, long sampleframes);
+void mx_player_perform_clock(t_mx_player *x, t_bank *bank, t_arrangement *arr, t_mx_clock_event *clicks, long events, double **ins, double **outs, long sampleframes);
+void mx_player_bank(t_mx_player *x, t_symbol *s, long argc, t_atom *argv);
+t_max_err mx_player_banks_set(t_mx_player *x, void *attr, long argc, t_atom *argv);
+t_max_err mx_player_banksize_set(t_mx_player *x, void *attr, long argc, t_atom *argv);
+void mx_player_bank_alloc(t_mx_player *x, long banks, long bank_size);
+t_bank *mx_player_bank_build(t_mx_player *x, long banks, long bank_size);
+void mx_player_bank_publish(t_mx_player *x, long banks, long bank_size);
+void mx_player_arrange(t_mx_player *x, t_symbol *s, long argc, t_atom *argv);
+void mx_player_seek(t_mx_player *x, long bar);
+void mx_player_perform_arrangement(t_mx_player *x, t_arrangement *arr, double **ins, double **outs, long sampleframes);
+void mx_player_print_arrangement(t_mx_player *x);
+t_arrangement *mx_player_arrangement_build(t_mx_player *x, long sections, long steps, long bars);
+void mx_player_appendtodictionary(t_mx_player *x, t_dictionary *d);
+void mx_player_restore(t_mx_player *x, t_dictionary *d);
+void state_setbit(t_atom *words, long i);
+char state_getbit(t_atom *words, long i);
+void mx_player_stats_info(t_mx_player *x, long *bytes, long *length);
+long mx_player_multichanneloutputs(t_mx_player *x, long index);
+char mx_player_source_onset(t_source *src, long step);
+void mx_player_timing(t_mx_player *x, t_source *src, double **outs, long from, long to);
 
 void outlet_s(t_mx_player *x, char *selector, int argc, char *msg, ...);
 void mx_outlet(t_mx_player *x, char *pre, int a, int b, int c);
-long pattobin(long argc, t_atom_long **bin, t_atom_long **pat);
-long bintopat(long argc, t_atom_long **pat, t_atom_long **bin);
+long pattobin(long argc, t_atom_long **bin, long *bin_cap, t_atom_long *pat);
+long bintopat(long argc, t_atom_long **pat, long *pat_cap, t_atom_long *bin);
 
 t_class *mx_player_class;        // global pointer to the object class - so max can reference the object
 
@@ -50,10 +154,46 @@ void ext_main(void *r){
     class_addmethod(c, (method)mx_player_dsp64, "dsp64", A_CANT, 0);
     class_addmethod(c, (method)mx_player_assist, "assist", A_CANT, 0);
     class_addmethod(c, (method)mx_player_bang, "bang", 0);
-    class_addmethod(c, (method)mx_player_pat, "pat", A_GIMME, 0);
-    class_addmethod(c, (method)mx_player_patbin, "patbin", A_GIMME, 0);
-
+    class_addmethod(c, (method)mx_player_coalesce, "pat", A_GIMME, 0);
+    class_addmethod(c, (method)mx_player_coalesce, "patbin", A_GIMME, 0);
+    class_addmethod(c, (method)mx_player_notify, "notify", A_CANT, 0);
+    class_addmethod(c, (method)mx_player_bank, "bank", A_GIMME, 0);
+    class_addmethod(c, (method)mx_player_arrange, "arrange", A_GIMME, 0);
+    class_addmethod(c, (method)mx_player_seek, "seek", A_LONG, 0);
+    class_addmethod(c, (method)mx_player_appendtodictionary, "appendtodictionary", A_CANT, 0);
+    class_addmethod(c, (method)mx_player_multichanneloutputs, "multichanneloutputs", A_CANT, 0);
+    
+    CLASS_ATTR_SYM(c, "buffer", 0, t_mx_player, buf_name);
+    CLASS_ATTR_ACCESSORS(c, "buffer", NULL, mx_player_buffer_set);
+    CLASS_ATTR_LABEL(c, "buffer", 0, "Pattern buffer~");
+    
+    CLASS_ATTR_LONG(c, "bufchan", 0, t_mx_player, buf_chan);
+    CLASS_ATTR_FILTER_MIN(c, "bufchan", 1);
+    CLASS_ATTR_LABEL(c, "bufchan", 0, "Pattern buffer~ channel");
+    
+    CLASS_ATTR_LONG(c, "banks", 0, t_mx_player, banks);
+    CLASS_ATTR_ACCESSORS(c, "banks", NULL, mx_player_banks_set);
+    CLASS_ATTR_FILTER_MIN(c, "banks", 0);
+    CLASS_ATTR_LABEL(c, "banks", 0, "Number of bank slots");
+    
+    CLASS_ATTR_LONG(c, "banksize", 0, t_mx_player, bank_size);
+    CLASS_ATTR_ACCESSORS(c, "banksize", NULL, mx_player_banksize_set);
+    CLASS_ATTR_FILTER_MIN(c, "banksize", 1);
+    CLASS_ATTR_LABEL(c, "banksize", 0, "Maximum steps per bank slot");
+    
     class_dspinit(c);
+    
+    CLASS_ATTR_CHAR(c, "coalesce", 0, t_mx_player, coalesce);
+    CLASS_ATTR_STYLE_LABEL(c, "coalesce", 0, "onoff", "Coalesce pat messages");
+    
+    CLASS_ATTR_CHAR(c, "embed", 0, t_mx_player, embed);
+    CLASS_ATTR_STYLE_LABEL(c, "embed", 0, "onoff", "Save patterns with patcher");
+    CLASS_ATTR_SAVE(c, "embed", 0);
+    
+    MX_CLOCK_CLASS(c, t_mx_player, clock);
+    MX_TIMING_CLASS(c, t_mx_player, timing);
+    MX_STATS_CLASS(c, t_mx_player, stats, mx_player_stats_info);
+    
     class_register(CLASS_BOX, c);
     mx_player_class = c;
 }
@@ -62,11 +202,17 @@ void *mx_player_new(t_symbol *s, long argc, t_atom *argv){
     //allocate class
     t_mx_player *x = (t_mx_player *)object_alloc(mx_player_class);
     
+    //onset outlet, the rightmost
+    x->onset_out = outlet_new((t_object *)x, NULL);
+    
     //create one message outlet
     x->msg_out = outlet_new((t_object *)x, NULL);
     
-    //set up DSP, create signal inlets (3)
-    dsp_setup((t_pxobject *)x, 3);
+    //set up DSP, create signal inlets (click, reset, jump, bank slot)
+    dsp_setup((t_pxobject *)x, 4);
+    //with @timing 1, phase and onset countdown right of the step number
+    mx_timing_init(&x->timing, 1, 4, argc, argv);
+    mx_timing_outlets(&x->timing, (t_object *)x);
     //signal outlets (pat, cd, cp, stepnr)
     for(int i=0;i<4;i++){
         outlet_new((t_object *)x, "signal");
@@ -74,16 +220,68 @@ void *mx_player_new(t_symbol *s, long argc, t_atom *argv){
     
     x->counter = 0;
     x->step_prev = 0;
-
+    
     x->out_names[0] = "r";
     x->out_names[1] = "stp";
     
     t_schillinger *p_s = &x->t;
     p_s->steps = 1; //init to one, lest we get divide by zero error later on
     p_s->bin_steps = 1; //init to one, lest we get divide by zero error later on
-
+    
     p_s->pattern = NULL;
     p_s->binpat = NULL;
+    p_s->pattern_cap = 0;
+    p_s->binpat_cap = 0;
+    
+    x->buf_ref = NULL;
+    x->buf_name = gensym("");
+    x->buf_chan = 1;
+    
+    x->coalesce = 0;
+    x->pending_q = qelem_new(x, (method)mx_player_coalesced);
+    critical_new(&x->pending_lock);
+    x->pending_s = NULL;
+    x->pending_argc = 0;
+    x->pending_size = 16;
+    x->pending_argv = (t_atom *)sysmem_newptrclear(x->pending_size * sizeof(t_atom));
+    
+    for(int i=0;i<3;i++){
+        x->bank[i].banks = 0;
+        x->bank[i].size = 0;
+        x->bank[i].steps = NULL;
+        x->bank[i].slots = NULL;
+        mx_arena_init(&x->bank[i].mem);
+    }
+    mx_swap_init(&x->bank_swap, x->bank, x->bank+1, x->bank+2);
+    x->banks = 0;
+    x->bank_size = 64;
+    x->bank_active = 0;
+    
+    for(int i=0;i<3;i++){
+        t_arrangement *arr = x->arr+i;
+        arr->bits = NULL;
+        arr->steps = 0;
+        arr->sections = 0;
+        arr->bars = 0;
+        arr->start = NULL;
+        arr->first_bar = NULL;
+        arr->bar_len = NULL;
+        mx_arena_init(&arr->mem);
+    }
+    mx_swap_init(&x->arr_swap, x->arr, x->arr+1, x->arr+2);
+    x->arr_seek = -1;
+    mx_clock_init(&x->clock);
+    x->clock_shift = 0;
+    x->timing_table = NULL;
+    x->timing_steps = 0;
+    
+    x->embed = 0;
+    mx_stats_init(&x->stats, (t_object *)x);
+    mx_events_init(&x->events, x->msg_out, x->onset_out);
+    
+    attr_args_process(x, argc, argv);
+    //state saved with @embed, restored silently
+    mx_player_restore(x, (t_dictionary *)gensym("#D")->s_thing);
     return (x);
 }
 
@@ -91,6 +289,12 @@ void mx_player_free(t_mx_player *x){
     t_schillinger *p_s = &x->t;
     dsp_free((t_pxobject *)x);
     
+    qelem_free(x->pending_q);
+    critical_free(x->pending_lock);
+    mx_stats_free(&x->stats);
+    mx_events_free(&x->events);
+    sysmem_freeptr(x->pending_argv);
+    
     if(p_s->pattern){
         sysmem_freeptr(p_s->pattern);
     }
@@ -98,13 +302,504 @@ void mx_player_free(t_mx_player *x){
     if(p_s->binpat){
         sysmem_freeptr(p_s->binpat);
     }
+    
+    if(x->buf_ref){
+        object_free(x->buf_ref);
+    }
+    
+    for(int i=0;i<3;i++){
+        mx_arena_free(&x->bank[i].mem);
+    }
+    
+    for(int i=0;i<3;i++){
+        mx_arena_free(&x->arr[i].mem);
+    }
+}
+
+t_max_err mx_player_buffer_set(t_mx_player *x, void *attr, long argc, t_atom *argv){
+    t_symbol *name = (argc && argv)?atom_getsym(argv):gensym("");
+    x->buf_name = name;
+    
+    //an empty name switches back to the pattern received via pat/patbin
+    if(name == gensym("")){
+        if(x->buf_ref){
+            object_free(x->buf_ref);
+            x->buf_ref = NULL;
+        }
+        return MAX_ERR_NONE;
+    }
+    
+    if(!x->buf_ref){
+        x->buf_ref = buffer_ref_new((t_object *)x, name);
+    }else{
+        buffer_ref_set(x->buf_ref, name);
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err mx_player_banks_set(t_mx_player *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv){
+        mx_player_bank_alloc(x, MAX(atom_getlong(argv), 0), x->bank_size);
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err mx_player_banksize_set(t_mx_player *x, void *attr, long argc, t_atom *argv){
+    if(argc && argv){
+        mx_player_bank_alloc(x, x->banks, MAX(atom_getlong(argv), 1));
+    }
+    return MAX_ERR_NONE;
+}
+
+void mx_player_bank_alloc(t_mx_player *x, long banks, long bank_size){
+    mx_player_bank_build(x, banks, bank_size);
+    mx_player_bank_publish(x, banks, bank_size);
+}
+
+t_bank *mx_player_bank_build(t_mx_player *x, long banks, long bank_size){
+    //main thread: the next version of the bank, with the slots of the current one that
+    //still fit. the whole bank lives in one block, so switching slots never allocates.
+    t_bank *from = (t_bank *)mx_swap_latest(&x->bank_swap);
+    t_bank *bank = (t_bank *)mx_swap_back(&x->bank_swap);
+    
+    mx_arena_reset(&bank->mem, MX_ARENA_ALIGN(banks * sizeof(long)) + MX_ARENA_ALIGN(banks * bank_size));
+    bank->steps = (long *)mx_arena_take(&bank->mem, banks * sizeof(long));
+    bank->slots = (char *)mx_arena_take(&bank->mem, banks * bank_size);
+    bank->banks = banks;
+    bank->size = bank_size;
+    
+    for(int i=0;i<MIN(banks, from->banks);i++){
+        if(from->steps[i] <= bank_size){
+            sysmem_copyptr(from->slots + i*from->size, bank->slots + i*bank_size, from->steps[i]);
+            bank->steps[i] = from->steps[i];
+        }
+    }
+    return bank;
+}
+
+void mx_player_bank_publish(t_mx_player *x, long banks, long bank_size){
+    //perform plays the new version from its next vector on
+    mx_swap_publish(&x->bank_swap);
+    mx_timing_refresh(&x->timing);
+    x->banks = banks;
+    x->bank_size = bank_size;
+}
+
+void mx_player_bank(t_mx_player *x, t_symbol *s, long argc, t_atom *argv){
+    //bank <slot> [pat|patbin] <pattern>, slots are counted from 1
+    if(argc<2 || atom_gettype(argv) != A_LONG){
+        post("bank: expected slot number and pattern.");
+        return;
+    }
+    
+    long slot = atom_getlong(argv) - 1;
+    if(slot<0 || slot>=x->banks){
+        post("bank: slot %ld out of range (@banks %ld).", slot+1, x->banks);
+        return;
+    }
+    
+    char bin = 0;
+    argc--;
+    argv++;
+    if(atom_gettype(argv) == A_SYM){
+        bin = atom_getsym(argv) == gensym("patbin");
+        argc--;
+        argv++;
+    }
+    
+    long steps = 0;
+    if(bin){
+        steps = argc;
+    }else{
+        for(int i=0;i<argc;i++){
+            t_atom_long temp = atom_getlong(argv+i);
+            steps += (temp<1)?1:temp;
+        }
+    }
+    
+    if(!steps){
+        post("bank: empty pattern.");
+        return;
+    }
+    if(steps > x->bank_size){
+        post("bank: pattern has %ld steps, @banksize is %ld.", steps, x->bank_size);
+        return;
+    }
+    
+    //a copy of the bank with the slot replaced, perform keeps playing the old one until it's done
+    t_uint64 start = mx_stats_start(&x->stats);
+    t_bank *bank = mx_player_bank_build(x, x->banks, x->bank_size);
+    char *dst = bank->slots + slot*bank->size;
+    if(bin){
+        for(int i=0;i<argc;i++){
+            dst[i] = atom_getlong(argv+i) != 0;
+        }
+    }else{
+        memset(dst, 0, steps);
+        long other = 0;
+        for(int i=0;i<argc;i++){
+            t_atom_long temp = atom_getlong(argv+i);
+            dst[other] = 1;
+            other += (temp<1)?1:temp;
+        }
+    }
+    bank->steps[slot] = steps;
+    mx_player_bank_publish(x, x->banks, x->bank_size);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mx_player_arrange(t_mx_player *x, t_symbol *s, long argc, t_atom *argv){
+    //arrange x2 3 2 4 x4 1 1 2: every xN starts a section playing the
+    //following pattern N times. no argument drops the arrangement.
+    t_uint64 start = mx_stats_start(&x->stats);
+    long max_sections = 1;
+    for(int i=0;i<argc;i++){
+        max_sections += atom_gettype(argv+i) == A_SYM;
+    }
+    long repeats[max_sections];
+    long pat_first[max_sections];   //first atom of each section's pattern
+    long pat_len[max_sections];
+    long bar_len[max_sections];
+    
+    //first pass: sections and their lengths
+    long sec = -1;
+    for(int i=0;i<argc;i++){
+        if(atom_gettype(argv+i) == A_SYM || sec<0){
+            sec++;
+            repeats[sec] = 1;
+            pat_first[sec] = i;
+            pat_len[sec] = 0;
+            bar_len[sec] = 0;
+    
+            if(atom_gettype(argv+i) == A_SYM){
+                char *name = atom_getsym(argv+i)->s_name;
+                char *end = name;
+                long count = (name[0] == 'x')?strtol(name+1, &end, 10):0;
+                if(end == name+1 || *end || count<1 || count>MX_ARRANGE_STEPS){
+                    post("arrange: expected a repeat count like x2, got %s.", name);
+                    return;
+                }
+                repeats[sec] = count;
+                pat_first[sec] = i+1;
+                continue;
+            }
+        }
+        t_atom_long temp = atom_getlong(argv+i);
+        if(temp > MX_ARRANGE_STEPS - bar_len[sec]){
+            object_error((t_object *)x, "arrange: longer than %ld steps, not loaded.", MX_ARRANGE_STEPS);
+            return;
+        }
+        bar_len[sec] += (temp<1)?1:temp;
+        pat_len[sec]++;
+    }
+    
+    long sections = sec+1;
+    long steps = 0;
+    long bars = 0;
+    for(int i=0;i<sections;i++){
+        if(!pat_len[i]){
+            post("arrange: section %d has no pattern.", i+1);
+            return;
+        }
+        if(repeats[i] > (MX_ARRANGE_STEPS - steps) / bar_len[i]){
+            object_error((t_object *)x, "arrange: longer than %ld steps, not loaded.", MX_ARRANGE_STEPS);
+            return;
+        }
+        steps += repeats[i] * bar_len[i];
+        bars += repeats[i];
+    }
+    
+    //second pass, into the next version: offsets and onset bits
+    t_arrangement *arr = mx_player_arrangement_build(x, sections, steps, bars);
+    long step = 0;
+    long bar = 0;
+    for(int i=0;i<sections;i++){
+        arr->start[i] = step;
+        arr->first_bar[i] = bar;
+        arr->bar_len[i] = bar_len[i];
+        bar += repeats[i];
+        for(int r=0;r<repeats[i];r++){
+            for(int j=0;j<pat_len[i];j++){
+                t_atom_long temp = atom_getlong(argv+pat_first[i]+j);
+                arr->bits[step>>6] |= (t_uint64)1 << (step&63);
+                step += (temp<1)?1:temp;
+            }
+        }
+    }
+    
+    //a seek into the previous arrangement is dropped, perform plays this one from its next vector on
+    x->arr_seek = -1;
+    mx_swap_publish(&x->arr_swap);
+    mx_timing_refresh(&x->timing);
+    
+    if(arr->steps){
+        mx_player_print_arrangement(x);
+    }
+    mx_stats_gen(&x->stats, start);
+}
+
+t_arrangement *mx_player_arrangement_build(t_mx_player *x, long sections, long steps, long bars){
+    //main thread: the next version, cleared, with room for sections and steps
+    t_arrangement *arr = (t_arrangement *)mx_swap_back(&x->arr_swap);
+    long words = (steps+63)/64;
+    
+    mx_arena_reset(&arr->mem, MX_ARENA_ALIGN(words * sizeof(t_uint64)) + 3*MX_ARENA_ALIGN(sections * sizeof(long)));
+    arr->bits = (t_uint64 *)mx_arena_take(&arr->mem, words * sizeof(t_uint64));
+    arr->start = (long *)mx_arena_take(&arr->mem, sections * sizeof(long));
+    arr->first_bar = (long *)mx_arena_take(&arr->mem, sections * sizeof(long));
+    arr->bar_len = (long *)mx_arena_take(&arr->mem, sections * sizeof(long));
+    arr->sections = sections;
+    arr->steps = steps;
+    arr->bars = bars;
+    return arr;
+}
+
+void mx_player_seek(t_mx_player *x, long bar){
+    //bars are counted from 1, the jump happens on the next click
+    t_arrangement *arr = (t_arrangement *)mx_swap_latest(&x->arr_swap);
+    if(!arr->steps){
+        post("seek: no arrangement.");
+        return;
+    }
+    
+    bar = CLAMP(bar, 1, arr->bars) - 1;
+    
+    //binary search for the last section starting at or before the bar
+    long lo = 0;
+    long hi = arr->sections-1;
+    while(lo<hi){
+        long mid = (lo+hi+1)/2;
+        if(arr->first_bar[mid] <= bar){
+            lo = mid;
+        }else{
+            hi = mid-1;
+        }
+    }
+    
+    x->arr_seek = (int32_t)(arr->start[lo] + (bar - arr->first_bar[lo]) * arr->bar_len[lo]);
+}
+
+void mx_player_print_arrangement(t_mx_player *x){
+    t_arrangement *arr = (t_arrangement *)mx_swap_latest(&x->arr_swap);
+    for(int i=0;i<2;i++){
+        outlet_s(x, x->out_names[i], 1, "clear");
+        outlet_s(x, x->out_names[i], 2, "rows", 1);
+        outlet_s(x, x->out_names[i], 2, "columns", (int)arr->steps);
+    }
+    mx_events_refresh(&x->events);
+    
+    outlet_int(x->msg_out, 1);
+    outlet_int(x->msg_out, arr->steps);
+    mx_stats_sent(&x->stats, 2);
+    
+    for(int i=0;i<arr->steps;i++){
+        if((arr->bits[i>>6] >> (i&63)) & 1){
+            mx_outlet(x, "r", i, 0, 1);
+        }
+    }
+}
+
+void mx_player_appendtodictionary(t_mx_player *x, t_dictionary *d){
+    //@embed: position, pattern, bank slots and arrangement are stored with the patcher.
+    //layout: version counter | bin_steps onsets | banks bank_size bank_active (steps onsets)*banks
+    //        | sections steps bars (start first_bar bar_len)*sections onsets
+    if(!x->embed){
+        return;
+    }
+    
+    t_schillinger *p_s = &x->t;
+    t_arrangement *arr = (t_arrangement *)mx_swap_latest(&x->arr_swap);
+    t_bank *bank = (t_bank *)mx_swap_latest(&x->bank_swap);
+    long bin_steps = p_s->binpat?p_s->bin_steps:0;
+    
+    long argc = 3 + STATE_WORDS(bin_steps) + 3 + 3 + 3*arr->sections + STATE_WORDS(arr->steps);
+    for(int i=0;i<bank->banks;i++){
+        argc += 1 + STATE_WORDS(bank->steps[i]);
+    }
+    
+    t_atom *argv = (t_atom *)sysmem_newptr(argc * sizeof(t_atom));
+    for(int i=0;i<argc;i++){
+        atom_setlong(argv+i, 0);
+    }
+    
+    long w = 0;
+    atom_setlong(argv+w++, MX_STATE_VERSION);
+    atom_setlong(argv+w++, x->counter);
+    atom_setlong(argv+w++, bin_steps);
+    for(int i=0;i<bin_steps;i++){
+        if(p_s->binpat[i]){
+            state_setbit(argv+w, i);
+        }
+    }
+    w += STATE_WORDS(bin_steps);
+    
+    atom_setlong(argv+w++, bank->banks);
+    atom_setlong(argv+w++, x->bank_size);
+    atom_setlong(argv+w++, x->bank_active);
+    for(int i=0;i<bank->banks;i++){
+        char *src = bank->slots + i*bank->size;
+        atom_setlong(argv+w++, bank->steps[i]);
+        for(int j=0;j<bank->steps[i];j++){
+            if(src[j]){
+                state_setbit(argv+w, j);
+            }
+        }
+        w += STATE_WORDS(bank->steps[i]);
+    }
+    
+    atom_setlong(argv+w++, arr->sections);
+    atom_setlong(argv+w++, arr->steps);
+    atom_setlong(argv+w++, arr->bars);
+    for(int i=0;i<arr->sections;i++){
+        atom_setlong(argv+w++, arr->start[i]);
+        atom_setlong(argv+w++, arr->first_bar[i]);
+        atom_setlong(argv+w++, arr->bar_len[i]);
+    }
+    for(int i=0;i<arr->steps;i++){
+        if((arr->bits[i>>6] >> (i&63)) & 1){
+            state_setbit(argv+w, i);
+        }
+    }
+    
+    dictionary_appendatoms(d, gensym("mx_state"), argc, argv);
+    sysmem_freeptr(argv);
+}
+
+void mx_player_restore(t_mx_player *x, t_dictionary *d){
+    //counterpart of appendtodictionary. nothing is output, bang shows the restored pattern
+    t_schillinger *p_s = &x->t;
+    long argc = 0;
+    t_atom *argv = NULL;
+    
+    if(!d || dictionary_getatoms(d, gensym("mx_state"), &argc, &argv) || argc<3){
+        return;
+    }
+    if(atom_getlong(argv) != MX_STATE_VERSION){
+        return;
+    }
+    
+    long w = 1;
+    long counter = atom_getlong(argv+w++);
+    long bin_steps = atom_getlong(argv+w++);
+    
+    if(bin_steps<0 || w+STATE_WORDS(bin_steps)+3 > argc){
+        post("embed: saved state is corrupt, ignored.");
+        return;
+    }
+    
+    if(bin_steps){
+        p_s->binpat = (t_atom_long *)mx_buffer_reserve(p_s->binpat, &p_s->binpat_cap, bin_steps * sizeof(t_atom_long));
+        p_s->pattern = (t_atom_long *)mx_buffer_reserve(p_s->pattern, &p_s->pattern_cap, bin_steps * sizeof(t_atom_long));
+        p_s->bin_steps = bin_steps;
+        p_s->steps = 0;
+    
+        //intervals between the onsets, as bintopat would give
+        for(int i=0;i<bin_steps;i++){
+            p_s->binpat[i] = state_getbit(argv+w, i);
+            if(p_s->binpat[i]){
+                p_s->pattern[p_s->steps++] = 1;
+            }else if(p_s->steps){
+                p_s->pattern[p_s->steps-1]++;
+            }
+        }
+        if(!p_s->steps){
+            p_s->steps = 1;
+        }
+        x->counter = (int)counter;
+    }
+    w += STATE_WORDS(bin_steps);
+    
+    long banks = atom_getlong(argv+w++);
+    long bank_size = atom_getlong(argv+w++);
+    long bank_active = atom_getlong(argv+w++);
+    
+    if(banks<0 || bank_size<1){
+        post("embed: saved bank is corrupt, ignored.");
+        return;
+    }
+    
+    if(banks){
+        //slots saved before a corrupt one are kept
+        t_bank *bank = mx_player_bank_build(x, banks, bank_size);
+        long corrupt = 0;
+        for(int i=0;i<banks && !corrupt;i++){
+            long steps = (w<argc)?atom_getlong(argv+w):-1;
+            w++;
+            if(steps<0 || steps>bank_size || w+STATE_WORDS(steps) > argc){
+                corrupt = 1;
+                break;
+            }
+    
+            char *dst = bank->slots + i*bank_size;
+            for(int j=0;j<steps;j++){
+                dst[j] = state_getbit(argv+w, j);
+            }
+            bank->steps[i] = steps;
+            w += STATE_WORDS(steps);
+        }
+        mx_player_bank_publish(x, banks, bank_size);
+        x->bank_active = CLAMP(bank_active, 0, banks-1);
+        if(corrupt){
+            post("embed: saved bank is corrupt, ignored.");
+            return;
+        }
+    }
+    
+    if(w+3 > argc){
+        post("embed: saved arrangement is corrupt, ignored.");
+        return;
+    }
+    
+    long sections = atom_getlong(argv+w++);
+    long steps = atom_getlong(argv+w++);
+    long bars = atom_getlong(argv+w++);
+    
+    if(sections<0 || steps<0 || steps>MX_ARRANGE_STEPS || w + 3*sections + STATE_WORDS(steps) != argc){
+        post("embed: saved arrangement is corrupt, ignored.");
+        return;
+    }
+    if(!sections || !steps){
+        return;
+    }
+    
+    t_arrangement *arr = mx_player_arrangement_build(x, sections, steps, bars);
+    for(int i=0;i<sections;i++){
+        arr->start[i] = atom_getlong(argv+w++);
+        arr->first_bar[i] = atom_getlong(argv+w++);
+        arr->bar_len[i] = atom_getlong(argv+w++);
+    }
+    
+    for(int i=0;i<steps;i++){
+        if(state_getbit(argv+w, i)){
+            arr->bits[i>>6] |= (t_uint64)1 << (i&63);
+        }
+    }
+    mx_swap_publish(&x->arr_swap);
+    x->counter = (int)counter;
+}
+
+void state_setbit(t_atom *words, long i){
+    atom_setlong(words+(i>>5), atom_getlong(words+(i>>5)) | ((t_atom_long)1 << (i&31)));
+}
+
+char state_getbit(t_atom *words, long i){
+    return (atom_getlong(words+(i>>5)) >> (i&31)) & 1;
+}
+
+t_max_err mx_player_notify(t_mx_player *x, t_symbol *s, t_symbol *msg, void *sender, void *data){
+    if(x->buf_ref){
+        //the buffer~ may have been changed or replaced
+        mx_timing_refresh(&x->timing);
+        return buffer_ref_notify(x->buf_ref, s, msg, sender, data);
+    }
+    return MAX_ERR_NONE;
 }
 
 void mx_player_assist(t_mx_player *x, void *b, long m, long a, char *s){
     if(m == ASSIST_INLET){
         switch(a){
             case 0:
-                sprintf(s, "(signal) Click to advance one step | (pat) Pattern");
+                sprintf(s, "(signal) Click to advance one step | (pat) Pattern | (buffer) Pattern buffer~");
                 break;
             case 1:
                 sprintf(s, "(signal) Click to reset sequencer");
@@ -112,8 +807,14 @@ void mx_player_assist(t_mx_player *x, void *b, long m, long a, char *s){
             case 2:
                 sprintf(s, "(signal) Step number to jump to");
                 break;
+            case 3:
+                sprintf(s, "(signal) Bank slot to play from the next step on");
+                break;
         }
     }else{
+            if(mx_timing_assist(&x->timing, 4, &a, s)){
+                return;
+            }
             switch(a){
                 case 0:
                     sprintf(s, "Pattern");
@@ -130,14 +831,20 @@ void mx_player_assist(t_mx_player *x, void *b, long m, long a, char *s){
                 case 4:
                     sprintf(s, "To sequencer");
                     break;
+                case 5:
+                    sprintf(s, "Onsets (onset <lane> <step>), on the scheduler");
+                    break;
             }
     }
 }
 
 void mx_player_bang(t_mx_player *x){
     t_schillinger *p_s = &(x->t);
+    t_arrangement *arr = (t_arrangement *)mx_swap_latest(&x->arr_swap);
     
-    if(p_s->pattern || p_s->binpat){
+    if(arr->steps){
+        mx_player_print_arrangement(x);
+    }else if(p_s->pattern || p_s->binpat){
         mx_player_print(x);
     }else{
         post("No pattern received yet!");
@@ -151,113 +858,172 @@ void mx_player_print(t_mx_player *x){
         outlet_s(x, x->out_names[i], 2, "rows", 1);
         outlet_s(x, x->out_names[i], 2, "columns", (int)p_s->bin_steps);
     }
+    mx_events_refresh(&x->events);
     
     outlet_int(x->msg_out, 1);
     outlet_int(x->msg_out, p_s->bin_steps);
+    mx_stats_sent(&x->stats, 2);
     
     for(int i=0;i<p_s->bin_steps;i++){
         mx_outlet(x, "r", i, 0, (int)p_s->binpat[i]);
     }
 }
 
+void mx_player_coalesce(t_mx_player *x, t_symbol *s, long argc, t_atom *argv){
+    if(!x->coalesce){
+        mx_player_dispatch(x, s, argc, argv);
+        return;
+    }
+    //overwrite the pending message, only the latest one of a burst gets computed
+    critical_enter(x->pending_lock);
+    if(argc > x->pending_size){
+        x->pending_argv = (t_atom *)sysmem_resizeptr(x->pending_argv, argc * sizeof(t_atom));
+        x->pending_size = argc;
+    }
+    sysmem_copyptr(argv, x->pending_argv, argc * sizeof(t_atom));
+    x->pending_s = s;
+    x->pending_argc = argc;
+    critical_exit(x->pending_lock);
+    
+    qelem_set(x->pending_q);
+}
+
+void mx_player_coalesced(t_mx_player *x){
+    //copy the message out, so a new one may arrive while this one is computed
+    critical_enter(x->pending_lock);
+    t_symbol *s = x->pending_s;
+    long argc = x->pending_argc;
+    t_atom argv[argc?argc:1];
+    sysmem_copyptr(x->pending_argv, argv, argc * sizeof(t_atom));
+    x->pending_s = NULL;
+    critical_exit(x->pending_lock);
+    
+    if(s){
+        mx_player_dispatch(x, s, argc, argv);
+    }
+}
+
+void mx_player_dispatch(t_mx_player *x, t_symbol *s, long argc, t_atom *argv){
+    if(s == gensym("patbin")){
+        mx_player_patbin(x, s, argc, argv);
+    }else{
+        mx_player_pat(x, s, argc, argv);
+    }
+}
+
 void mx_player_pat(t_mx_player *x, t_symbol *s, long argc, t_atom *argv){
     if(!argc)
         return;
     
+    t_uint64 start = mx_stats_start(&x->stats);
     t_schillinger *p_s = &(x->t);
     p_s->steps = argc;
-    
-    if(p_s->pattern){
-        sysmem_freeptr(p_s->pattern);
-    }
-    
-    p_s->pattern = (t_atom_long *)sysmem_newptrclear(p_s->steps * sizeof(t_atom_long));
+    p_s->pattern = (t_atom_long *)mx_buffer_reserve(p_s->pattern, &p_s->pattern_cap, p_s->steps * sizeof(t_atom_long));
     
     for(int i=0;i<argc;i++){
         t_atom_long temp = atom_getlong(argv+i);
-        p_s->pattern[i] = (temp==0)?1:temp;
+        p_s->pattern[i] = (temp<1)?1:temp;
     }
     
-    p_s->bin_steps = pattobin(p_s->steps, &(p_s->binpat), &(p_s->pattern));
+    p_s->bin_steps = pattobin(p_s->steps, &(p_s->binpat), &(p_s->binpat_cap), p_s->pattern);
+    mx_timing_refresh(&x->timing);
     mx_player_print(x);
+    mx_stats_gen(&x->stats, start);
 }
 
 void mx_player_patbin(t_mx_player *x, t_symbol *s, long argc, t_atom *argv){
+    t_uint64 start = mx_stats_start(&x->stats);
     t_schillinger *p_s = &(x->t);
     p_s->bin_steps = argc;
-    
-    if(p_s->binpat){
-        sysmem_freeptr(p_s->binpat);
-    }
-    
-    p_s->binpat = (t_atom_long *)sysmem_newptrclear(p_s->bin_steps * sizeof(t_atom_long));
+    p_s->binpat = (t_atom_long *)mx_buffer_reserve(p_s->binpat, &p_s->binpat_cap, p_s->bin_steps * sizeof(t_atom_long));
     
     for(int i=0;i<argc;i++){
         p_s->binpat[i] = atom_getlong(argv+i);
     }
     
-    p_s->steps = bintopat(p_s->steps, &(p_s->pattern), &(p_s->binpat));
+    p_s->steps = bintopat(p_s->bin_steps, &(p_s->pattern), &(p_s->pattern_cap), p_s->binpat);
+    mx_timing_refresh(&x->timing);
     mx_player_print(x);
+    mx_stats_gen(&x->stats, start);
 }
 
-void mx_player_npat(t_mx_player *x, t_symbol *s, long argc, t_atom *argv){
-    if(argc<3){
-        post("no");
-        return;
+void mx_player_stats_info(t_mx_player *x, long *bytes, long *length){
+    t_arrangement *arr = (t_arrangement *)mx_swap_latest(&x->arr_swap);
+    *bytes = x->t.pattern_cap + x->t.binpat_cap + x->pending_size*sizeof(t_atom);
+    for(int i=0;i<3;i++){
+        *bytes += x->bank[i].mem.capacity + x->arr[i].mem.capacity;
     }
-    post("argc: %d", argc);
+    //the arrangement plays instead of the pattern
+    *length = arr->steps ? arr->steps : x->t.bin_steps;
 }
 
-long pattobin(long argc, t_atom_long **bin, t_atom_long **pat){
-    //oh god pls no pointers to pointers
-    //treating them as 2d-arrays works, so i dont need to know the exact pointer arithmetic
-    long pat_sum = 0;
-    
-    for(int i=0;i<argc;i++){
-        pat_sum += pat[0][i];
+long mx_player_multichanneloutputs(t_mx_player *x, long index){
+    return index == x->timing.index ? x->timing.lanes : 1;
+}
+
+char mx_player_source_onset(t_source *src, long step){
+    if(src->tab){
+        return src->tab[step*src->chans] != 0;
     }
-    
-    if(bin){
-        sysmem_freeptr(bin);
+    if(src->bits){
+        return (src->bits[step>>6] >> (step&63)) & 1;
     }
-    
-    *bin = (t_atom_long*)sysmem_newptrclear(pat_sum*sizeof(t_atom_long));
-    int other = 0;
-    for(int i=0;i<argc;i++){
-        bin[0][other] = 1;
-        other+=pat[0][i];
+    if(src->slot){
+        return src->slot[step] != 0;
     }
-    
-    return pat_sum;
+    return src->binpat[step] != 0;
 }
 
-long bintopat(long argc, t_atom_long **pat, t_atom_long **bin){
-    long beatcount = 0;
-    
-    for(int i=0;i<argc;i++){
-        beatcount += bin[0][i];
+void mx_player_timing(t_mx_player *x, t_source *src, double **outs, long from, long to){
+    //mx_timing_run with the single lane looked up in what plays. other steps, e.g. a bank
+    //slot taken over or a new version handed over, are looked up again
+    t_mx_timing *t = &x->timing;
+    if(!t->on){
+        return;
     }
-    
-    if(pat){
-        sysmem_freeptr(pat);
+    void *table = src->tab ? (void *)src->tab : src->bits ? (void *)src->bits : src->slot ? (void *)src->slot : (void *)src->binpat;
+    if(table != x->timing_table || src->steps != x->timing_steps){
+        x->timing_table = table;
+        x->timing_steps = src->steps;
+        t->step = -1;
     }
-    
-    *pat = (t_atom_long*)sysmem_newptrclear(beatcount*sizeof(t_atom_long));
-
-    t_atom_long lpat[beatcount+1];
-    int counter=0;
-    
-    for(int i=0;i<argc;i++){
-        if(bin[0][i]==1){
-            lpat[counter++] = i;
+    if(x->counter != t->step){
+        long gap = 0;
+        for(long k=1;k<=src->steps;k++){
+            if(mx_player_source_onset(src, (x->counter+k) % src->steps)){
+                gap = k;
+                break;
+            }
         }
+        t->gap[0] = gap;
+        t->step = x->counter;
+    }
+    mx_timing_output(t, outs + STP_OUT + 1, from, to);
+}
+
+void mx_player_npat(t_mx_player *x, t_symbol *s, long argc, t_atom *argv){
+    if(argc<3){
+        post("no");
+        return;
     }
+    post("argc: %d", argc);
+}
+
+long pattobin(long argc, t_atom_long **bin, long *bin_cap, t_atom_long *pat){
+    //bin keeps its memory between calls and is only reallocated when it has to grow
+    long pat_sum = mx_core_pat_length(pat, argc);
     
-    lpat[beatcount] = argc;
+    *bin = (t_atom_long *)mx_buffer_reserve(*bin, bin_cap, pat_sum*sizeof(t_atom_long));
+    mx_core_pattobin(pat, argc, *bin);
     
-    for(int i=0;i<beatcount;i++){
-        pat[0][i] = lpat[i+1]-lpat[i];
-    }
+    return pat_sum;
+}
+
+long bintopat(long argc, t_atom_long **pat, long *pat_cap, t_atom_long *bin){
+    long beatcount = mx_core_onsets(bin, argc);
+    
+    *pat = (t_atom_long *)mx_buffer_reserve(*pat, pat_cap, beatcount*sizeof(t_atom_long));
+    mx_core_bintopat(bin, argc, *pat);
     
     return beatcount;
 }
@@ -272,53 +1038,440 @@ void mx_player_perform64(t_mx_player *x, t_object *dsp64, double **ins, long num
     t_double        *stp_out = outs[STP_OUT];
     long            n = sampleframes;
     t_double        in1, in2, in3;
+    t_uint64        start = mx_stats_start(&x->stats);
     
     t_schillinger *p_s = &x->t;
+    t_bank *bank = (t_bank *)mx_swap_front(&x->bank_swap);
+    t_arrangement *arr = (t_arrangement *)mx_swap_front(&x->arr_swap);
+    
+    //clicks and resets from mx-clock~ instead of the inlets
+    t_mx_clock_event *clicks = NULL;
+    long events = mx_clock_read(&x->clock, sampleframes, &clicks);
+    if(events >= 0){
+        mx_player_perform_clock(x, bank, arr, clicks, events, ins, outs, sampleframes);
+        mx_events_block(&x->events, sampleframes);
+        mx_stats_perform(&x->stats, start, sampleframes);
+        return;
+    }
+    
+    if(x->buf_ref){
+        t_buffer_obj *b = buffer_ref_getobject(x->buf_ref);
+        if(b){
+            mx_player_perform_buffer(x, b, ins, outs, sampleframes);
+            mx_events_block(&x->events, sampleframes);
+            mx_stats_perform(&x->stats, start, sampleframes);
+            return;
+        }
+    }
+    
+    if(arr->steps){
+        mx_player_perform_arrangement(x, arr, ins, outs, sampleframes);
+        mx_events_block(&x->events, sampleframes);
+        mx_stats_perform(&x->stats, start, sampleframes);
+        return;
+    }
+    
+    if(bank->banks){
+        mx_player_perform_bank(x, bank, ins, outs, sampleframes);
+        mx_events_block(&x->events, sampleframes);
+        mx_stats_perform(&x->stats, start, sampleframes);
+        return;
+    }
     
     if(!p_s->binpat){
+        t_source none = {NULL, NULL, 0, NULL, NULL, 0};
         set_zero64(r_out, sampleframes);
         set_zero64(cd_out, sampleframes);
         set_zero64(cp_out, sampleframes);
         set_zero64(stp_out, sampleframes);
+        mx_player_timing(x, &none, outs, 0, sampleframes);
+        mx_events_block(&x->events, sampleframes);
+        mx_stats_perform(&x->stats, start, sampleframes);
         return;
     }
     
+    t_source src = {p_s->binpat, NULL, 0, NULL, NULL, p_s->bin_steps};
     while(n--){
         in1 = *in1_p++;
         in2 = *in2_p++;
         in3 = *in3_p++;
-        
+    
         //detect click, increase on click
         if(in1>0.){
             x->counter++;
         }
         x->counter %= p_s->bin_steps;
-        
+    
         //detect click, reset counter on click
         if(in2>0.){
             x->counter = 0;
         }
-        
+    
         //if new in3 is different than previous step, reset the counter to in3 (only on ONE frame!)
         if(x->step_prev != in3 && in3 != 0){
             x->counter = ((int)(in3-1)) % p_s->bin_steps;
         }
-        
+    
         x->step_prev = in3;
         if(p_s->binpat){
             t_double temp = in1*(int)p_s->binpat[x->counter];
             *r_out++ = CLAMP(temp, -1, 1);
+            if(in1>0. && temp){
+                mx_events_onset(&x->events, 0, x->counter, sampleframes-n-1);
+            }
+        }
+        if(in1>0.){
+            mx_timing_click(&x->timing);
         }
         *cd_out++ = in1;
-        
+    
         //cp_out is 1 on one click, when x->counter is 0 and v is one
         *cp_out++ = (!x->counter) && in1;
+        mx_events_step(&x->events, x->counter, sampleframes-n-1);
         *stp_out++ = x->counter;
+        mx_player_timing(x, &src, outs, sampleframes-n-1, sampleframes-n);
     }
+    mx_events_block(&x->events, sampleframes);
+    mx_stats_perform(&x->stats, start, sampleframes);
     return;
 }
 
+void mx_player_perform_buffer(t_mx_player *x, t_buffer_obj *b, double **ins, double **outs, long sampleframes){
+    //every frame of the buffer is one step, any non-zero sample is an onset
+    //(the sample value is used as the amplitude of the click)
+    t_double        *in1_p = ins[0];
+    t_double        *in2_p = ins[1];
+    t_double        *in3_p = ins[2];
+    t_double        *r_out = outs[PAT_OUT];
+    t_double        *cd_out = outs[CD_OUT];
+    t_double        *cp_out = outs[CP_OUT];
+    t_double        *stp_out = outs[STP_OUT];
+    long            n = sampleframes;
+    t_double        in1, in2, in3;
+    t_source        none = {NULL, NULL, 0, NULL, NULL, 0};
+    
+    float *tab = buffer_locksamples(b);
+    if(!tab){
+        set_zero64(r_out, sampleframes);
+        set_zero64(cd_out, sampleframes);
+        set_zero64(cp_out, sampleframes);
+        set_zero64(stp_out, sampleframes);
+        mx_player_timing(x, &none, outs, 0, sampleframes);
+        return;
+    }
+    
+    long frames = (long)buffer_getframecount(b);
+    long chans = (long)buffer_getchannelcount(b);
+    long chan = MIN(x->buf_chan, chans) - 1;
+    t_source src = {NULL, tab+chan, chans, NULL, NULL, frames};
+    
+    if(frames<1){
+        buffer_unlocksamples(b);
+        set_zero64(r_out, sampleframes);
+        set_zero64(cd_out, sampleframes);
+        set_zero64(cp_out, sampleframes);
+        set_zero64(stp_out, sampleframes);
+        mx_player_timing(x, &none, outs, 0, sampleframes);
+        return;
+    }
+    
+    while(n--){
+        in1 = *in1_p++;
+        in2 = *in2_p++;
+        in3 = *in3_p++;
+    
+        if(in1>0.){
+            x->counter++;
+        }
+        x->counter %= frames;
+    
+        if(in2>0.){
+            x->counter = 0;
+        }
+    
+        if(x->step_prev != in3 && in3 != 0){
+            x->counter = ((int)(in3-1)) % frames;
+        }
+    
+        x->step_prev = in3;
+        t_double temp = in1*tab[x->counter*chans + chan];
+        *r_out++ = CLAMP(temp, -1, 1);
+        if(in1>0. && temp){
+            mx_events_onset(&x->events, 0, x->counter, sampleframes-n-1);
+        }
+        if(in1>0.){
+            mx_timing_click(&x->timing);
+        }
+        *cd_out++ = in1;
+        *cp_out++ = (!x->counter) && in1;
+        mx_events_step(&x->events, x->counter, sampleframes-n-1);
+        *stp_out++ = x->counter;
+        mx_player_timing(x, &src, outs, sampleframes-n-1, sampleframes-n);
+    }
+    
+    buffer_unlocksamples(b);
+}
+
+void mx_player_perform_arrangement(t_mx_player *x, t_arrangement *arr, double **ins, double **outs, long sampleframes){
+    //the whole form is one step table, a single counter runs through all sections
+    t_double        *in1_p = ins[0];
+    t_double        *in2_p = ins[1];
+    t_double        *in3_p = ins[2];
+    t_double        *r_out = outs[PAT_OUT];
+    t_double        *cd_out = outs[CD_OUT];
+    t_double        *cp_out = outs[CP_OUT];
+    t_double        *stp_out = outs[STP_OUT];
+    long            n = sampleframes;
+    t_double        in1, in2, in3;
+    
+    t_uint64 *bits = arr->bits;
+    long steps = arr->steps;
+    t_source src = {NULL, NULL, 0, bits, NULL, steps};
+    
+    while(n--){
+        in1 = *in1_p++;
+        in2 = *in2_p++;
+        in3 = *in3_p++;
+    
+        if(in1>0.){
+            //taken with a swap, so a seek arriving meanwhile waits for the next click
+            int32_t seek = x->arr_seek;
+            if(seek>=0 && ATOMIC_COMPARE_SWAP32(seek, -1, &x->arr_seek)){
+                x->counter = seek;
+            }else{
+                x->counter++;
+            }
+        }
+        x->counter %= steps;
+    
+        if(in2>0.){
+            x->counter = 0;
+        }
+    
+        if(x->step_prev != in3 && in3 != 0){
+            x->counter = ((int)(in3-1)) % steps;
+        }
+    
+        x->step_prev = in3;
+        t_double temp = in1*(t_double)((bits[x->counter>>6] >> (x->counter&63)) & 1);
+        *r_out++ = CLAMP(temp, -1, 1);
+        if(in1>0. && temp){
+            mx_events_onset(&x->events, 0, x->counter, sampleframes-n-1);
+        }
+        if(in1>0.){
+            mx_timing_click(&x->timing);
+        }
+        *cd_out++ = in1;
+        *cp_out++ = (!x->counter) && in1;
+        mx_events_step(&x->events, x->counter, sampleframes-n-1);
+        *stp_out++ = x->counter;
+        mx_player_timing(x, &src, outs, sampleframes-n-1, sampleframes-n);
+    }
+}
+
+void mx_player_perform_bank(t_mx_player *x, t_bank *bank, double **ins, double **outs, long sampleframes){
+    //the 4th inlet selects the slot (1-based, 0 keeps the current one).
+    //a new slot is taken over on the next click, so the switch lands exactly on a step.
+    t_double        *in1_p = ins[0];
+    t_double        *in2_p = ins[1];
+    t_double        *in3_p = ins[2];
+    t_double        *in4_p = ins[3];
+    t_double        *r_out = outs[PAT_OUT];
+    t_double        *cd_out = outs[CD_OUT];
+    t_double        *cp_out = outs[CP_OUT];
+    t_double        *stp_out = outs[STP_OUT];
+    long            n = sampleframes;
+    t_double        in1, in2, in3, in4;
+    
+    //a new version of the bank may have fewer slots
+    if(x->bank_active >= bank->banks){
+        x->bank_active = 0;
+    }
+    char *slot = bank->slots + x->bank_active*bank->size;
+    long steps = bank->steps[x->bank_active];
+    t_source src = {NULL, NULL, 0, NULL, slot, steps};
+    
+    while(n--){
+        in1 = *in1_p++;
+        in2 = *in2_p++;
+        in3 = *in3_p++;
+        in4 = *in4_p++;
+    
+        if(in1>0.){
+            long next = (long)in4 - 1;
+            if(next>=0 && next<bank->banks && next != x->bank_active && bank->steps[next]){
+                x->bank_active = next;
+                slot = bank->slots + next*bank->size;
+                steps = bank->steps[next];
+                src.slot = slot;
+                src.steps = steps;
+            }
+            x->counter++;
+            mx_timing_click(&x->timing);
+        }
+    
+        if(!steps){
+            *r_out++ = 0.;
+            *cd_out++ = in1;
+            *cp_out++ = 0.;
+            *stp_out++ = 0.;
+            mx_player_timing(x, &src, outs, sampleframes-n-1, sampleframes-n);
+            continue;
+        }
+        x->counter %= steps;
+    
+        if(in2>0.){
+            x->counter = 0;
+        }
+    
+        if(x->step_prev != in3 && in3 != 0){
+            x->counter = ((int)(in3-1)) % steps;
+        }
+    
+        x->step_prev = in3;
+        t_double temp = in1*slot[x->counter];
+        *r_out++ = CLAMP(temp, -1, 1);
+        if(in1>0. && temp){
+            mx_events_onset(&x->events, 0, x->counter, sampleframes-n-1);
+        }
+        *cd_out++ = in1;
+        *cp_out++ = (!x->counter) && in1;
+        mx_events_step(&x->events, x->counter, sampleframes-n-1);
+        *stp_out++ = x->counter;
+        mx_player_timing(x, &src, outs, sampleframes-n-1, sampleframes-n);
+    }
+}
+
+void mx_player_perform_clock(t_mx_player *x, t_bank *bank, t_arrangement *arr, t_mx_clock_event *clicks, long events, double **ins, double **outs, long sampleframes){
+    //clicks and resets from mx-clock~: the step is the count modulo the steps of what plays,
+    //the buffer~, the arrangement, the bank slot or the pattern, in that order like in the
+    //perform routine. a seek shifts the arrangement against the count until the next reset.
+    //the bank slot inlet is still read on the clicks. the outputs are 0 but on the clicks
+    //and the step number holds in between
+    t_double *in4_p = ins[3];
+    t_double *r_out = outs[PAT_OUT];
+    t_double *cd_out = outs[CD_OUT];
+    t_double *cp_out = outs[CP_OUT];
+    t_double *stp_out = outs[STP_OUT];
+    t_schillinger *p_s = &x->t;
+    t_source src = {NULL, NULL, 0, NULL, NULL, 0};
+    long from = 0;
+    
+    t_buffer_obj *b = x->buf_ref ? buffer_ref_getobject(x->buf_ref) : NULL;
+    float *tab = b ? buffer_locksamples(b) : NULL;
+    long frames = tab ? (long)buffer_getframecount(b) : 0;
+    long chans = tab ? (long)buffer_getchannelcount(b) : 1;
+    long chan = MIN(x->buf_chan, chans) - 1;
+    
+    set_zero64(r_out, sampleframes);
+    set_zero64(cd_out, sampleframes);
+    set_zero64(cp_out, sampleframes);
+    if((b && frames<1) || (!b && !arr->steps && !bank->banks && !p_s->binpat)){
+        //nothing to play
+        if(tab){
+            buffer_unlocksamples(b);
+        }
+        set_zero64(stp_out, sampleframes);
+        mx_player_timing(x, &src, outs, 0, sampleframes);
+        return;
+    }
+    if(bank->banks && x->bank_active >= bank->banks){
+        x->bank_active = 0;
+    }
+    if(b){
+        src.tab = tab+chan;
+        src.chans = chans;
+        src.steps = frames;
+    }else if(arr->steps){
+        src.bits = arr->bits;
+        src.steps = arr->steps;
+    }else if(bank->banks){
+        src.slot = bank->slots + x->bank_active*bank->size;
+        src.steps = bank->steps[x->bank_active];
+    }else{
+        src.binpat = p_s->binpat;
+        src.steps = p_s->bin_steps;
+    }
+    
+    for(long i=0;i<events;i++){
+        t_mx_clock_event *e = clicks+i;
+        long o = e->offset;
+        for(long j=from;j<o;j++){
+            stp_out[j] = x->counter;
+        }
+        mx_player_timing(x, &src, outs, from, o);
+        from = o;
+    
+        long steps;
+        long shift = 0;
+        if(b){
+            steps = frames;
+        }else if(arr->steps){
+            int32_t seek = x->arr_seek;
+            if(e->click > 0. && seek>=0 && ATOMIC_COMPARE_SWAP32(seek, -1, &x->arr_seek)){
+                x->clock_shift = seek - (long)e->count;
+            }
+            if(!e->count){
+                x->clock_shift = 0;
+            }
+            steps = arr->steps;
+            shift = x->clock_shift;
+        }else if(bank->banks){
+            long next = (long)in4_p[o] - 1;
+            if(e->click > 0. && next>=0 && next<bank->banks && bank->steps[next]){
+                x->bank_active = next;
+            }
+            steps = bank->steps[x->bank_active];
+            src.slot = bank->slots + x->bank_active*bank->size;
+            src.steps = steps;
+        }else{
+            steps = p_s->bin_steps;
+        }
+        if(e->click > 0.){
+            mx_timing_click(&x->timing);
+        }
+    
+        if(!steps){
+            //an empty bank slot
+            cd_out[o] = e->click;
+            continue;
+        }
+        x->counter = (int)((((long)e->count + shift) % steps + steps) % steps);
+        mx_events_step(&x->events, x->counter, o);
+        if(e->click <= 0.){
+            continue;
+        }
+    
+        t_double onset;
+        if(b){
+            onset = tab[x->counter*chans + chan];
+        }else if(arr->steps){
+            onset = (t_double)((arr->bits[x->counter>>6] >> (x->counter&63)) & 1);
+        }else if(bank->banks){
+            onset = bank->slots[x->bank_active*bank->size + x->counter];
+        }else{
+            onset = (t_double)p_s->binpat[x->counter];
+        }
+        t_double temp = e->click*onset;
+        r_out[o] = CLAMP(temp, -1, 1);
+        if(temp){
+            mx_events_onset(&x->events, 0, x->counter, o);
+        }
+        cd_out[o] = e->click;
+        cp_out[o] = !x->counter;
+    }
+    for(long j=from;j<sampleframes;j++){
+        stp_out[j] = x->counter;
+    }
+    mx_player_timing(x, &src, outs, from, sampleframes);
+    if(tab){
+        buffer_unlocksamples(b);
+    }
+}
+
 void mx_player_dsp64(t_mx_player *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags){
+    mx_stats_dsp(&x->stats, samplerate);
+    mx_events_dsp(&x->events, samplerate);
     object_method(dsp64, gensym("dsp_add64"), x, mx_player_perform64, 0, NULL);
 }
 
@@ -328,6 +1481,7 @@ void mx_outlet(t_mx_player *x, char *pre, int a, int b, int c){
     atom_setlong(argv, a);
     atom_setlong(argv+1, b);
     atom_setlong(argv+2, c);
+    mx_stats_sent(&x->stats, 1);
     outlet_anything(x->msg_out, gensym(pre), 3, argv);
 }
 
@@ -345,5 +1499,6 @@ void outlet_s(t_mx_player *x, char *selector, int argc, char *msg, ...){
     }
     
     outlet_anything(x->msg_out, gensym(selector), argc, argv);
+    mx_stats_sent(&x->stats, 1);
     va_end(ap);
 }
@@ -0,0 +1,193 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ext.h"
+#include "z_dsp.h"
+#include "ext_obex.h"
+#include "../common/mx_stats.h"
+#include "../common/mx_clock.h"
+
+//signal outlets (clicks, count)
+#define CLICK_OUT 0
+#define COUNT_OUT 1
+
+typedef struct _mx_clock_tilde {
+    t_pxobject p_ob;
+    t_symbol *name;
+    t_mx_clock *clock;  //the timeline published to, NULL while there's none
+    t_uint32 count;     //clicks since the last reset
+    t_mx_stats stats;
+} t_mx_clock_tilde;
+
+void *mx_clock_tilde_new(t_symbol *s,  long argc, t_atom *argv);
+void mx_clock_tilde_free(t_mx_clock_tilde *x);
+void mx_clock_tilde_assist(t_mx_clock_tilde *x, void *b, long m, long a, char *s);
+t_max_err mx_clock_tilde_name_set(t_mx_clock_tilde *x, void *attr, long argc, t_atom *argv);
+void mx_clock_tilde_perform64(t_mx_clock_tilde *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam);
+void mx_clock_tilde_dsp64(t_mx_clock_tilde *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
+void mx_clock_tilde_stats_info(t_mx_clock_tilde *x, long *bytes, long *length);
+
+t_class *mx_clock_tilde_class;
+
+void ext_main(void *r){
+    t_class *c;
+    
+    c = class_new("mx-clock~", (method)mx_clock_tilde_new, (method)mx_clock_tilde_free, sizeof(t_mx_clock_tilde), NULL, A_GIMME, 0);
+    class_addmethod(c, (method)mx_clock_tilde_dsp64, "dsp64", A_CANT, 0);
+    class_addmethod(c, (method)mx_clock_tilde_assist, "assist", A_CANT, 0);
+    
+    class_dspinit(c);
+    
+    CLASS_ATTR_SYM(c, "name", 0, t_mx_clock_tilde, name);
+    CLASS_ATTR_ACCESSORS(c, "name", NULL, mx_clock_tilde_name_set);
+    CLASS_ATTR_LABEL(c, "name", 0, "Name the sequencers' @clock refers to");
+    
+    MX_STATS_CLASS(c, t_mx_clock_tilde, stats, mx_clock_tilde_stats_info);
+    
+    class_register(CLASS_BOX, c);
+    mx_clock_tilde_class = c;
+}
+
+void *mx_clock_tilde_new(t_symbol *s, long argc, t_atom *argv){
+    //allocate class
+    t_mx_clock_tilde *x = (t_mx_clock_tilde *)object_alloc(mx_clock_tilde_class);
+    
+    //set up DSP, create signal inlets (click, reset)
+    dsp_setup((t_pxobject *)x, 2);
+    //signal outlets (clicks, count)
+    for(int i=0;i<2;i++){
+        outlet_new((t_object *)x, "signal");
+    }
+    
+    x->name = gensym("");
+    x->clock = NULL;
+    x->count = 0;
+    mx_stats_init(&x->stats, (t_object *)x);
+    
+    long ac = attr_args_offset(argc, argv);
+    attr_args_process(x, argc, argv);
+    
+    //mx-clock~ main is mx-clock~ @name main
+    if(ac && atom_gettype(argv) == A_SYM){
+        mx_clock_tilde_name_set(x, NULL, 1, argv);
+    }
+    
+    return (x);
+}
+
+void mx_clock_tilde_free(t_mx_clock_tilde *x){
+    mx_stats_free(&x->stats);
+    dsp_free((t_pxobject *)x);
+    //the sequencers go by their inlets again
+    mx_clock_release(x->clock, (t_object *)x);
+}
+
+void mx_clock_tilde_assist(t_mx_clock_tilde *x, void *b, long m, long a, char *s){
+    if(m == ASSIST_INLET){
+        switch(a){
+            case 0:
+                sprintf(s, "(signal) Click to advance all sequencers following this clock");
+                break;
+            case 1:
+                sprintf(s, "(signal) Click to reset all sequencers following this clock");
+                break;
+        }
+    }else{
+        switch(a){
+            case 0:
+                sprintf(s, "Clicks, to the click inlets of the sequencers following this clock");
+                break;
+            case 1:
+                sprintf(s, "Clicks since the last reset");
+                break;
+        }
+    }
+}
+
+t_max_err mx_clock_tilde_name_set(t_mx_clock_tilde *x, void *attr, long argc, t_atom *argv){
+    t_symbol *name = argc && atom_gettype(argv) == A_SYM ? atom_getsym(argv) : gensym("");
+    t_mx_clock *c = NULL;
+    
+    if(name != gensym("")){
+        c = mx_clock_find(name);
+        if(!c){
+            object_error((t_object *)x, "clock: not available, the package's externals are of different versions");
+        }else if(!mx_clock_claim(c, (t_object *)x)){
+            object_error((t_object *)x, "there already is an mx-clock~ named %s", name->s_name);
+            c = NULL;
+        }
+    }
+    if(x->clock != c){
+        mx_clock_release(x->clock, (t_object *)x);
+    }
+    x->clock = c;
+    x->name = c ? name : gensym("");
+    return MAX_ERR_NONE;
+}
+
+void mx_clock_tilde_stats_info(t_mx_clock_tilde *x, long *bytes, long *length){
+    //the timeline, shared with the sequencers following it
+    *bytes = x->clock ? sizeof(t_mx_clock) : 0;
+    *length = 0;
+}
+
+void mx_clock_tilde_perform64(t_mx_clock_tilde *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam){
+    t_double        *click_p = ins[0];
+    t_double        *reset_p = ins[1];
+    t_double        *click_out = outs[CLICK_OUT];
+    t_double        *count_out = outs[COUNT_OUT];
+    t_mx_clock      *c = x->clock;
+    t_mx_clock_block *b = c ? mx_clock_block(c) : NULL;
+    long            events = 0;
+    t_uint64        start = mx_stats_start(&x->stats);
+    
+    for(long i=0;i<sampleframes;i++){
+        t_double click = click_p[i];
+        t_double reset = reset_p[i];
+    
+        //what every sequencer does with its click and reset inlets, done once for all of them
+        if(click>0. || reset>0.){
+            if(click>0.){
+                x->count++;
+            }
+            if(reset>0.){
+                x->count = 0;
+            }
+            if(b && events<MX_CLOCK_EVENTS){
+                t_mx_clock_event *e = b->event + events++;
+                e->offset = (t_uint32)i;
+                e->count = x->count;
+                e->click = click>0. ? click : 0.;
+            }
+        }
+    
+        *click_out++ = click;
+        *count_out++ = x->count;
+    }
+    
+    if(b){
+        b->frames = sampleframes;
+        b->events = events;
+        mx_clock_publish(c);
+    }
+    mx_stats_perform(&x->stats, start, sampleframes);
+}
+
+void mx_clock_tilde_dsp64(t_mx_clock_tilde *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags){
+    mx_stats_dsp(&x->stats, samplerate);
+    object_method(dsp64, gensym("dsp_add64"), x, mx_clock_tilde_perform64, 0, NULL);
+}
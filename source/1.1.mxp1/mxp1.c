@@ -17,7 +17,27 @@
 
 #include "ext.h"
 #include "ext_obex.h"
+#include "ext_critical.h"
+#include "ext_dictobj.h"
+#include "ext_systhread.h"
 #include <stdarg.h>
+#include "../common/mx_arena.h"
+#include "../common/mx_links.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+#include "../common/mx_worker.h"
+
+//batches of at least MX_BATCH_PARALLEL pairs are computed on MX_BATCH_THREADS threads
+#define MX_BATCH_THREADS 4
+#define MX_BATCH_PARALLEL 64
+//most pairs a genrange computes at once
+#define MX_BATCH_RANGE 65536
+
+//outlets, left to right
+#define R_OUT 0
+#define A_OUT 1
+#define B_OUT 2
+#define STP_OUT 3
 
 typedef struct _schillinger{
     long a;
@@ -26,8 +46,24 @@ typedef struct _schillinger{
     t_ptr b_pat;
     t_ptr r_pat;
     long steps;
+    t_mx_arena arena;   //the three lanes, kept across gens
 } t_schillinger;
 
+//one gen with @async: the generators and the lanes computed from them
+typedef struct _mxp1_nsg_job {
+    t_mx_worker *worker;        //the job is cancelled when its id isn't the newest
+    int32_t id;
+    t_schillinger t;
+    t_uint64 start;             //when the gen message arrived, for @measure
+} t_mxp1_nsg_job;
+
+//pairs first to last-1 of a batch, computed by one thread
+typedef struct _mxp1_nsg_slice {
+    t_schillinger *results;
+    long first;
+    long last;
+} t_mxp1_nsg_slice;
+
 typedef struct _mxp1_nsg {
     t_object p_ob;
     t_schillinger t;
@@ -36,15 +72,50 @@ typedef struct _mxp1_nsg {
     void *a_out;
     void *b_out;
     char* out_names[4];
+    char coalesce;
+    t_qelem *gen_q;
+    long gen_args[2];   //latest generators, waiting for gen_q
+    t_critical gen_lock;    //gen_args are written by the scheduler and read by gen_q
+    char async;
+    t_mx_worker *worker;        //@async jobs, see mx_worker.h
+    t_mxp1_nsg_job *spare;      //lanes of the result replaced last, reused by the next gen
+    t_symbol *format;           //list or dict (@format)
+    t_dictionary *out_dict;     //named dictionary reused by every gen in dict format
+    t_symbol *out_dict_name;
+    t_dictionary *batch_dict;   //result of the last genlist/genrange
+    long links[4];              //patch cords leaving each outlet
+    t_mx_stats stats;
+    t_atom *out_atoms;          //patbin lists, kept across gens and only ever grown
+    long out_atoms_cap;
 } t_mxp1_nsg;
 
 void *mxp1_nsg_new(t_symbol *s,  long argc, t_atom *argv);
 void mxp1_nsg_free(t_mxp1_nsg *x);
 void mxp1_nsg_gen(t_mxp1_nsg *x, long a, long b);
+void mxp1_nsg_gen_msg(t_mxp1_nsg *x, long a, long b);
+void mxp1_nsg_gen_pending(t_mxp1_nsg *x);
+void mxp1_nsg_compute(t_schillinger *p_s, long a, long b);
+void mxp1_nsg_async(t_mxp1_nsg *x, long a, long b, t_uint64 start);
+void mxp1_nsg_job_free(t_mxp1_nsg_job *job);
+void *mxp1_nsg_worker(t_mxp1_nsg_job *job);
+void mxp1_nsg_publish(t_mxp1_nsg *x);
+void mxp1_nsg_output(t_mxp1_nsg *x);
+void mxp1_nsg_genlist(t_mxp1_nsg *x, t_symbol *s, long argc, t_atom *argv);
+void mxp1_nsg_genrange(t_mxp1_nsg *x, long amin, long amax, long bmin, long bmax);
+t_bool mxp1_nsg_pair_ok(long a, long b);
+void mxp1_nsg_batch(t_mxp1_nsg *x, long *pairs, long count);
+void mxp1_nsg_batch_slice(t_mxp1_nsg_slice *slice);
+void *mxp1_nsg_batch_thread(t_mxp1_nsg_slice *slice);
+void mxp1_nsg_todict(t_dictionary *entry, t_schillinger *p_s);
+void mxp1_nsg_lanes_free(t_schillinger *p_s);
+void mxp1_nsg_lanes_take(t_schillinger *p_s);
+void mxp1_nsg_output_dict(t_mxp1_nsg *x);
+t_max_err mxp1_nsg_patchlineupdate(t_mxp1_nsg *x, t_object *patchline, long updatetype, t_object *src, long srcout, t_object *dst, long dstin);
 void mxp1_nsg_assist(t_mxp1_nsg *x, void *b, long m, long a, char *s);
 void mxp1_nsg_bang(t_mxp1_nsg *x);
 void outlet_s(t_mxp1_nsg *x, char *selector, int argc, char *msg, ...);
 void mx_outlet(t_mxp1_nsg *x, char *pre, int a, int b, int c);
+void mxp1_nsg_stats_info(t_mxp1_nsg *x, long *bytes, long *length);
 
 t_class *mxp1_nsg_class;
 
@@ -53,12 +124,27 @@ void ext_main(void *r){
     
     c = class_new("mxp1", (method)mxp1_nsg_new, (method)mxp1_nsg_free, sizeof(t_mxp1_nsg), NULL, A_GIMME, 0);
     class_addmethod(c, (method)mxp1_nsg_assist, "assist", A_CANT, 0);
+    class_addmethod(c, (method)mxp1_nsg_patchlineupdate, "patchlineupdate", A_CANT, 0);
     class_addmethod(c, (method)mxp1_nsg_bang, "bang", 0);
-    class_addmethod(c, (method)mxp1_nsg_gen, "gen", A_LONG, A_LONG, 0);
+    class_addmethod(c, (method)mxp1_nsg_gen_msg, "gen", A_LONG, A_LONG, 0);
+    class_addmethod(c, (method)mxp1_nsg_genlist, "genlist", A_GIMME, 0);
+    class_addmethod(c, (method)mxp1_nsg_genrange, "genrange", A_LONG, A_LONG, A_LONG, A_LONG, 0);
+    
+    CLASS_ATTR_CHAR(c, "coalesce", 0, t_mxp1_nsg, coalesce);
+    CLASS_ATTR_STYLE_LABEL(c, "coalesce", 0, "onoff", "Coalesce gen messages");
+    
+    CLASS_ATTR_CHAR(c, "async", 0, t_mxp1_nsg, async);
+    CLASS_ATTR_STYLE_LABEL(c, "async", 0, "onoff", "Compute patterns in the background");
+    
+    CLASS_ATTR_SYM(c, "format", 0, t_mxp1_nsg, format);
+    CLASS_ATTR_ENUM(c, "format", 0, "list dict");
+    CLASS_ATTR_LABEL(c, "format", 0, "Output format");
+    
+    MX_STATS_CLASS(c, t_mxp1_nsg, stats, mxp1_nsg_stats_info);
     
     class_register(CLASS_BOX, c);
     mxp1_nsg_class = c;
-
+    
 }
 
 void *mxp1_nsg_new(t_symbol *s, long argc, t_atom *argv){
@@ -69,23 +155,42 @@ void *mxp1_nsg_new(t_symbol *s, long argc, t_atom *argv){
     x->b_out    = outlet_new((t_object *)x, NULL);
     x->a_out    = outlet_new((t_object *)x, NULL);
     x->r_out    = outlet_new((t_object *)x, NULL);
-
+    
     x->out_names[0] = "r";
     x->out_names[1] = "a";
     x->out_names[2] = "b";
     x->out_names[3] = "stp";
     
     t_schillinger *p_s = &x->t;
-
+    
     
     p_s->steps = 1; //init to one, lest we get divide by zero error later on
     p_s->a = 0;
     p_s->b = 0;
-    p_s->a_pat = sysmem_newptrclear(p_s->steps * sizeof(int));
-    p_s->b_pat = sysmem_newptrclear(p_s->steps * sizeof(int));
-    p_s->r_pat = sysmem_newptrclear(p_s->steps * sizeof(int));
+    mx_arena_init(&p_s->arena);
+    mxp1_nsg_lanes_take(p_s);
     
-    if(argc == 2){
+    x->coalesce = 0;
+    x->gen_q = qelem_new(x, (method)mxp1_nsg_gen_pending);
+    critical_new(&x->gen_lock);
+    x->async = 0;
+    x->worker = mx_worker_new((t_object *)x, (method)mxp1_nsg_publish, (mx_worker_free_fn)mxp1_nsg_job_free);
+    x->spare = NULL;
+    x->format = gensym("list");
+    x->out_dict = NULL;
+    x->out_dict_name = NULL;
+    x->batch_dict = NULL;
+    for(int i=0;i<4;i++){
+        x->links[i] = 0;
+    }
+    mx_stats_init(&x->stats, (t_object *)x);
+    x->out_atoms = NULL;
+    x->out_atoms_cap = 0;
+    
+    long ac = attr_args_offset(argc, argv);
+    attr_args_process(x, argc, argv);
+    
+    if(ac == 2){
         p_s->a = atom_getlong(argv);
         p_s->b = atom_getlong(argv+1);
     }
@@ -95,10 +200,23 @@ void *mxp1_nsg_new(t_symbol *s, long argc, t_atom *argv){
 
 void mxp1_nsg_free(t_mxp1_nsg *x){
     t_schillinger *p_s = &x->t;
-    
-    sysmem_freeptr(p_s->r_pat);
-    sysmem_freeptr(p_s->a_pat);
-    sysmem_freeptr(p_s->b_pat);
+    qelem_free(x->gen_q);
+    critical_free(x->gen_lock);
+    mx_worker_close(x->worker);
+    if(x->spare){
+        mxp1_nsg_job_free(x->spare);
+    }
+    mx_stats_free(&x->stats);
+    if(x->out_atoms){
+        sysmem_freeptr(x->out_atoms);
+    }
+    if(x->out_dict){
+        object_free(x->out_dict);
+    }
+    if(x->batch_dict){
+        object_free(x->batch_dict);
+    }
+    mx_arena_free(&p_s->arena);
 }
 
 void mxp1_nsg_assist(t_mxp1_nsg *x, void *b, long m, long a, char *s){
@@ -126,6 +244,11 @@ void mxp1_nsg_assist(t_mxp1_nsg *x, void *b, long m, long a, char *s){
     }
 }
 
+t_max_err mxp1_nsg_patchlineupdate(t_mxp1_nsg *x, t_object *patchline, long updatetype, t_object *src, long srcout, t_object *dst, long dstin){
+    mx_links_update(x->links, 4, x, updatetype, src, srcout);
+    return MAX_ERR_NONE;
+}
+
 void mxp1_nsg_bang(t_mxp1_nsg *x){
     t_schillinger *p_s = &(x->t);
     
@@ -136,70 +259,343 @@ void mxp1_nsg_bang(t_mxp1_nsg *x){
     }
 }
 
+void mxp1_nsg_gen_msg(t_mxp1_nsg *x, long a, long b){
+    if(!x->coalesce){
+        mxp1_nsg_gen(x, a, b);
+        return;
+    }
+    //keep only the latest generators, a burst of gen messages costs one generation
+    critical_enter(x->gen_lock);
+    x->gen_args[0] = a;
+    x->gen_args[1] = b;
+    critical_exit(x->gen_lock);
+    
+    qelem_set(x->gen_q);
+}
+
+void mxp1_nsg_gen_pending(t_mxp1_nsg *x){
+    critical_enter(x->gen_lock);
+    long a = x->gen_args[0];
+    long b = x->gen_args[1];
+    critical_exit(x->gen_lock);
+    mxp1_nsg_gen(x, a, b);
+}
+
 void mxp1_nsg_gen(t_mxp1_nsg *x, long a, long b){
-    t_schillinger *p_s = &(x->t);
-    p_s->steps = a*b;
+    t_uint64 start = mx_stats_start(&x->stats);
+    //generators below 1 have no pattern, like in genlist
+    a = MAX(a, 1);
+    b = MAX(b, 1);
+    if(x->async){
+        mxp1_nsg_async(x, a, b, start);
+        return;
+    }
+    mxp1_nsg_compute(&x->t, a, b);
+    mxp1_nsg_output(x);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mxp1_nsg_async(t_mxp1_nsg *x, long a, long b, t_uint64 start){
+    //a new gen supersedes the one in flight, whose result is dropped
+    t_mxp1_nsg_job *job = x->spare;
+    x->spare = NULL;
+    if(!job){
+        job = (t_mxp1_nsg_job *)sysmem_newptrclear(sizeof(t_mxp1_nsg_job));
+        mx_arena_init(&job->t.arena);
+    }
+    job->t.a = a;
+    job->t.b = b;
+    job->start = start;
+    job->worker = x->worker;
+    job->id = mx_worker_request(x->worker);
+    mx_worker_start(x->worker, (method)mxp1_nsg_worker, job);
+}
+
+void mxp1_nsg_job_free(t_mxp1_nsg_job *job){
+    mx_arena_free(&job->t.arena);
+    sysmem_freeptr(job);
+}
+
+void *mxp1_nsg_worker(t_mxp1_nsg_job *job){
+    t_uint64 start = mx_trace_start();
+    mxp1_nsg_compute(&job->t, job->t.a, job->t.b);
+    mx_worker_done(job->worker, job, mx_worker_cancelled(job->worker, job->id), start);
+    systhread_exit(0);
+    return NULL;
+}
+
+void mxp1_nsg_publish(t_mxp1_nsg *x){
+    //runs on the main thread: swap the finished lanes in, the replaced ones become the spare
+    t_mxp1_nsg_job *job = (t_mxp1_nsg_job *)mx_worker_take(x->worker);
+    
+    if(!job){
+        return;
+    }
+    
+    if(mx_worker_cancelled(job->worker, job->id)){
+        mxp1_nsg_job_free(job);
+        return;
+    }
+    t_schillinger old = x->t;
+    x->t = job->t;
+    job->t = old;
+    if(x->spare){
+        mxp1_nsg_job_free(x->spare);
+    }
+    x->spare = job;
+    
+    mxp1_nsg_output(x);
+    //with @async the generation takes from the gen message to here
+    mx_stats_gen(&x->stats, job->start);
+}
+
+void mxp1_nsg_stats_info(t_mxp1_nsg *x, long *bytes, long *length){
+    *bytes = x->t.arena.capacity + (x->spare ? x->spare->t.arena.capacity : 0);
+    *length = x->t.steps;
+}
+
+void mxp1_nsg_compute(t_schillinger *p_s, long a, long b){
+    //fills the lanes of p_s, touches nothing else so it may run on any thread
+    a = MAX(a, 1);
+    b = MAX(b, 1);
+    p_s->steps = mx_core_p1_steps(a, b);
     
     p_s->a = a;
     p_s->b = b;
-    long newsize = (long)p_s->steps * sizeof(int);
-    t_ptr temp1, temp2, temp3;
-    temp1 = sysmem_resizeptrclear(p_s->r_pat, newsize);
-    temp2 = sysmem_resizeptrclear(p_s->a_pat, newsize);
-    temp3 = sysmem_resizeptrclear(p_s->b_pat, newsize);
-    p_s->r_pat = temp1;
-    p_s->a_pat = temp2;
-    p_s->b_pat = temp3;
-    
-
-    for(int i=0;i<newsize;i++){
-        p_s->r_pat[i]=0;
-        p_s->a_pat[i]=0;
-        p_s->b_pat[i]=0;
-    }
-        
-    for(int i=0;i<4;i++){
-        outlet_s(x, x->out_names[i], 1, "clear");
-        outlet_s(x, x->out_names[i], 2, "rows", 1);
-        outlet_s(x, x->out_names[i], 2, "columns", (int)p_s->steps);
-    }
+    mxp1_nsg_lanes_take(p_s);
+    
+    mx_core_p1(a, b, p_s->r_pat, p_s->a_pat, p_s->b_pat);
+}
+
+void mxp1_nsg_output(t_mxp1_nsg *x){
+    t_schillinger *p_s = &(x->t);
+    
+    //outlets without a patch cord get nothing, not even the formatting
+    t_uint64 start = mx_trace_start();
+    if(x->links[STP_OUT]){
+        for(int i=0;i<4;i++){
+            outlet_s(x, x->out_names[i], 1, "clear");
+            outlet_s(x, x->out_names[i], 2, "rows", 1);
+            outlet_s(x, x->out_names[i], 2, "columns", (int)p_s->steps);
+        }
     
-    outlet_int(x->step_out, 1);
-    outlet_int(x->step_out, p_s->steps);
+        outlet_int(x->step_out, 1);
+        outlet_int(x->step_out, p_s->steps);
+        mx_stats_sent(&x->stats, 2);
     
-    for(int i=0;i<p_s->steps;i+=a){
-        //a
-        p_s->a_pat[i] = 1;
-        mx_outlet(x, "a", i, 0, 1);
-        
-        //r
-        p_s->r_pat[i] = 1;
-        mx_outlet(x, "r", i, 0, 1);
+        for(int i=0;i<p_s->steps;i++){
+            if(p_s->a_pat[i])
+                mx_outlet(x, "a", i, 0, 1);
+            if(p_s->b_pat[i])
+                mx_outlet(x, "b", i, 0, 1);
+            if(p_s->r_pat[i])
+                mx_outlet(x, "r", i, 0, 1);
+        }
     }
+    mx_trace_span_as(x, "visualiser", start);
     
-    for(int i=0;i<p_s->steps;i+=b){
-        p_s->b_pat[i] = 1;
-        mx_outlet(x, "b", i, 0, 1);
-        
-        p_s->r_pat[i] = 1;
-        mx_outlet(x, "r", i, 0, 1);
+    if(x->format == gensym("dict")){
+        if(x->links[R_OUT]){
+            mxp1_nsg_output_dict(x);
+        }
+        return;
     }
     
     //print out the patterns
     
-    t_atom atom_r_pat[p_s->steps];
-    t_atom atom_a_pat[p_s->steps];
-    t_atom atom_b_pat[p_s->steps];
+    x->out_atoms = (t_atom *)mx_buffer_reserve(x->out_atoms, &x->out_atoms_cap, p_s->steps * sizeof(t_atom));
+    t_atom *atom_pat = x->out_atoms;
+    t_ptr lanes[3] = {p_s->r_pat, p_s->a_pat, p_s->b_pat};
+    void *outs[3] = {x->r_out, x->a_out, x->b_out};
+    
+    for(int i=0;i<3;i++){
+        if(!x->links[R_OUT+i]){
+            continue;
+        }
+        for(int j=0;j<p_s->steps;j++){
+            atom_setlong(atom_pat+j, lanes[i][j]);
+        }
+        outlet_anything(outs[i], gensym("patbin"), p_s->steps, atom_pat);
+        mx_stats_sent(&x->stats, 1);
+    }
+}
+
+void mxp1_nsg_genlist(t_mxp1_nsg *x, t_symbol *s, long argc, t_atom *argv){
+    //genlist a1 b1 a2 b2 ...
+    long count = 0;
+    long *pairs = (long *)sysmem_newptrclear((argc/2+1) * 2 * sizeof(long));
+    
+    for(int i=0;i+1<argc;i+=2){
+        long a = atom_getlong(argv+i);
+        long b = atom_getlong(argv+i+1);
+        if(!mxp1_nsg_pair_ok(a, b)){
+            post("genlist: skipping invalid generator pair %ld %ld.", a, b);
+            continue;
+        }
+        pairs[count*2] = a;
+        pairs[count*2+1] = b;
+        count++;
+    }
+    
+    if(count){
+        mxp1_nsg_batch(x, pairs, count);
+    }else{
+        post("genlist: no generator pairs.");
+    }
+    sysmem_freeptr(pairs);
+}
+
+void mxp1_nsg_genrange(t_mxp1_nsg *x, long amin, long amax, long bmin, long bmax){
+    //every valid pair with amin <= a <= amax and bmin <= b <= bmax. any a and b from 1 up
+    //are valid, so the range is counted instead of walked, and bounded
+    amin = MAX(amin, 1);
+    bmin = MAX(bmin, 1);
+    if(amin>amax || bmin>bmax){
+        post("genrange: no valid generator pairs in range.");
+        return;
+    }
+    if(amax-amin+1 > MX_BATCH_RANGE / (bmax-bmin+1)){
+        object_error((t_object *)x, "genrange: more than %d generator pairs, split the range.", MX_BATCH_RANGE);
+        return;
+    }
+    long count = (amax-amin+1) * (bmax-bmin+1);
+    
+    long *pairs = (long *)sysmem_newptrclear(count * 2 * sizeof(long));
+    long k = 0;
+    for(long a=amin;a<=amax;a++){
+        for(long b=bmin;b<=bmax;b++){
+            if(mxp1_nsg_pair_ok(a, b)){
+                pairs[k++] = a;
+                pairs[k++] = b;
+            }
+        }
+    }
+    
+    mxp1_nsg_batch(x, pairs, count);
+    sysmem_freeptr(pairs);
+}
+
+t_bool mxp1_nsg_pair_ok(long a, long b){
+    return a>=1 && b>=1;
+}
+
+void mxp1_nsg_batch(t_mxp1_nsg *x, long *pairs, long count){
+    //computes all pairs in one go, large batches are spread over worker threads
+    t_uint64 start = mx_stats_start(&x->stats);
+    t_schillinger *results = (t_schillinger *)sysmem_newptrclear(count * sizeof(t_schillinger));
+    for(int i=0;i<count;i++){
+        results[i].a = pairs[i*2];
+        results[i].b = pairs[i*2+1];
+    }
+    
+    if(count < MX_BATCH_PARALLEL){
+        t_mxp1_nsg_slice slice = {results, 0, count};
+        mxp1_nsg_batch_slice(&slice);
+    }else{
+        t_systhread threads[MX_BATCH_THREADS];
+        t_mxp1_nsg_slice slices[MX_BATCH_THREADS];
+        unsigned int ret;
+    
+        for(int i=0;i<MX_BATCH_THREADS;i++){
+            slices[i].results = results;
+            slices[i].first = count*i/MX_BATCH_THREADS;
+            slices[i].last = count*(i+1)/MX_BATCH_THREADS;
+            systhread_create((method)mxp1_nsg_batch_thread, slices+i, 0, 0, 0, threads+i);
+        }
+        for(int i=0;i<MX_BATCH_THREADS;i++){
+            systhread_join(threads[i], &ret);
+        }
+    }
+    
+    t_dictionary *d = dictionary_new();
+    char key[32];
+    for(int i=0;i<count;i++){
+        t_dictionary *entry = dictionary_new();
+        mxp1_nsg_todict(entry, results+i);
+        snprintf(key, 32, "%ld %ld", results[i].a, results[i].b);
+        dictionary_appenddictionary(d, gensym(key), (t_object *)entry);
+        mxp1_nsg_lanes_free(results+i);
+    }
+    sysmem_freeptr(results);
+    
+    t_symbol *name = NULL;
+    d = dictobj_register(d, &name);
+    if(x->batch_dict){
+        object_free(x->batch_dict);
+    }
+    x->batch_dict = d;
+    
+    t_atom a;
+    atom_setsym(&a, name);
+    outlet_anything(x->r_out, gensym("dictionary"), 1, &a);
+    mx_stats_sent(&x->stats, 1);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mxp1_nsg_batch_slice(t_mxp1_nsg_slice *slice){
+    for(long i=slice->first;i<slice->last;i++){
+        t_schillinger *p_s = slice->results+i;
+        mxp1_nsg_compute(p_s, p_s->a, p_s->b);
+    }
+}
+
+void *mxp1_nsg_batch_thread(t_mxp1_nsg_slice *slice){
+    mxp1_nsg_batch_slice(slice);
+    systhread_exit(0);
+    return NULL;
+}
+
+void mxp1_nsg_todict(t_dictionary *entry, t_schillinger *p_s){
+    //lanes live on the heap, patterns of any length fit
+    dictionary_appendlong(entry, gensym("a"), p_s->a);
+    dictionary_appendlong(entry, gensym("b"), p_s->b);
+    dictionary_appendlong(entry, gensym("steps"), p_s->steps);
+    
+    t_atom *lane = (t_atom *)sysmem_newptr(MAX(p_s->steps, 1) * sizeof(t_atom));
     
     for(int i=0;i<p_s->steps;i++){
-        atom_setlong(atom_r_pat+i, p_s->r_pat[i]);
-        atom_setlong(atom_a_pat+i, p_s->a_pat[i]);
-        atom_setlong(atom_b_pat+i, p_s->b_pat[i]);
+        atom_setlong(lane+i, p_s->r_pat[i]);
+    }
+    dictionary_appendatoms(entry, gensym("r"), p_s->steps, lane);
+    
+    for(int i=0;i<p_s->steps;i++){
+        atom_setlong(lane+i, p_s->a_pat[i]);
+    }
+    dictionary_appendatoms(entry, gensym("a"), p_s->steps, lane);
+    
+    for(int i=0;i<p_s->steps;i++){
+        atom_setlong(lane+i, p_s->b_pat[i]);
+    }
+    dictionary_appendatoms(entry, gensym("b"), p_s->steps, lane);
+    
+    sysmem_freeptr(lane);
+}
+
+void mxp1_nsg_lanes_free(t_schillinger *p_s){
+    mx_arena_free(&p_s->arena);
+}
+
+void mxp1_nsg_lanes_take(t_schillinger *p_s){
+    //r, a and b as one cleared block, reused by every later gen that fits into it
+    mx_arena_reset(&p_s->arena, 3*MX_ARENA_ALIGN(p_s->steps));
+    p_s->r_pat = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+    p_s->a_pat = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+    p_s->b_pat = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+}
+
+void mxp1_nsg_output_dict(t_mxp1_nsg *x){
+    //every lane, the step count and the generators in one dictionary
+    if(!x->out_dict){
+        x->out_dict = dictobj_register(dictionary_new(), &x->out_dict_name);
+    }else{
+        dictionary_clear(x->out_dict);
     }
+    mxp1_nsg_todict(x->out_dict, &x->t);
     
-    outlet_anything(x->r_out, gensym("patbin"), p_s->steps, atom_r_pat);
-    outlet_anything(x->a_out, gensym("patbin"), p_s->steps, atom_a_pat);
-    outlet_anything(x->b_out, gensym("patbin"), p_s->steps, atom_b_pat);
+    t_atom a;
+    atom_setsym(&a, x->out_dict_name);
+    outlet_anything(x->r_out, gensym("dictionary"), 1, &a);
+    mx_stats_sent(&x->stats, 1);
 }
 
 void mx_outlet(t_mxp1_nsg *x, char *pre, int a, int b, int c){
@@ -208,6 +604,7 @@ void mx_outlet(t_mxp1_nsg *x, char *pre, int a, int b, int c){
     atom_setlong(argv+1, b);
     atom_setlong(argv+2, c);
     outlet_anything(x->step_out, gensym(pre), 3, argv);
+    mx_stats_sent(&x->stats, 1);
 }
 
 void outlet_s(t_mxp1_nsg *x, char *selector, int argc, char *msg, ...){
@@ -224,5 +621,6 @@ void outlet_s(t_mxp1_nsg *x, char *selector, int argc, char *msg, ...){
     }
     
     outlet_anything(x->step_out, gensym(selector), argc, argv);
+    mx_stats_sent(&x->stats, 1);
     va_end(ap);
 }
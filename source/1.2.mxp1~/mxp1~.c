@@ -18,7 +18,15 @@
 #include "ext.h"
 #include "z_dsp.h"
 #include "ext_obex.h"
+#include "ext_critical.h"
+#include "ext_buffer.h"
 #include <stdarg.h>
+#include "../common/mx_arena.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+#include "../common/mx_events.h"
+#include "../common/mx_clock.h"
+#include "../common/mx_timing.h"
 
 //signal outlets (r pat, a pat, b pat, cd, cp, stepnr)
 #define R_OUT 0
@@ -35,6 +43,7 @@ typedef struct _schillinger{
     t_ptr b_pat;
     t_ptr r_pat;
     long steps;
+    t_mx_arena arena;   //r, a and b, kept across gens
 } t_schillinger;
 
 typedef struct _mxp1 {
@@ -43,18 +52,38 @@ typedef struct _mxp1 {
     int step_prev;
     t_schillinger t;
     void *msg_out;
+    void *onset_out;
     char* out_names[4];
+    char coalesce;
+    t_qelem *gen_q;
+    long gen_args[2];   //latest generators, waiting for gen_q
+    t_critical gen_lock;    //gen_args are written by the scheduler and read by gen_q
+    t_qelem *init_q;
+    char init_pending;  //generators from the arguments, generated on the first dsp or by init_q
+    char quiet;         //gen fills the lanes without any visualiser output
+    t_mx_stats stats;
+    t_mx_events events;
+    t_mx_clock_reader clock;
+    t_mx_timing timing;
 } t_mxp1;
 
 void *mxp1_new(t_symbol *s,  long argc, t_atom *argv);
 void mxp1_free(t_mxp1 *x);
 void mxp1_gen(t_mxp1 *x, long a, long b);
+void mxp1_gen_msg(t_mxp1 *x, long a, long b);
+void mxp1_gen_pending(t_mxp1 *x);
+void mxp1_lanes_take(t_schillinger *p_s);
 void mxp1_assist(t_mxp1 *x, void *b, long m, long a, char *s);
 void mxp1_bang(t_mxp1 *x);
+void mxp1_init(t_mxp1 *x);
+long mxp1_multichanneloutputs(t_mxp1 *x, long index);
+void mxp1_writebuffer(t_mxp1 *x, t_symbol *s, long argc, t_atom *argv);
 void mxp1_perform64(t_mxp1 *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam);
+void mxp1_perform_clock(t_mxp1 *x, t_mx_clock_event *clicks, long events, double **outs, long sampleframes);
 void mxp1_dsp64(t_mxp1 *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
 void outlet_s(t_mxp1 *x, char *selector, int argc, char *msg, ...);
 void mx_outlet(t_mxp1 *x, char *pre, int a, int b, int c);
+void mxp1_stats_info(t_mxp1 *x, long *bytes, long *length);
 
 t_class *mxp1_class;        // global pointer to the object class - so max can reference the object
 
@@ -65,9 +94,19 @@ void ext_main(void *r){
     class_addmethod(c, (method)mxp1_dsp64, "dsp64", A_CANT, 0);
     class_addmethod(c, (method)mxp1_assist, "assist", A_CANT, 0);
     class_addmethod(c, (method)mxp1_bang, "bang", 0);
-    class_addmethod(c, (method)mxp1_gen, "gen", A_LONG, A_LONG, 0);
-
+    class_addmethod(c, (method)mxp1_gen_msg, "gen", A_LONG, A_LONG, 0);
+    class_addmethod(c, (method)mxp1_writebuffer, "writebuffer", A_GIMME, 0);
+    class_addmethod(c, (method)mxp1_multichanneloutputs, "multichanneloutputs", A_CANT, 0);
+    
     class_dspinit(c);
+    
+    CLASS_ATTR_CHAR(c, "coalesce", 0, t_mxp1, coalesce);
+    CLASS_ATTR_STYLE_LABEL(c, "coalesce", 0, "onoff", "Coalesce gen messages");
+    
+    MX_STATS_CLASS(c, t_mxp1, stats, mxp1_stats_info);
+    MX_CLOCK_CLASS(c, t_mxp1, clock);
+    MX_TIMING_CLASS(c, t_mxp1, timing);
+    
     class_register(CLASS_BOX, c);
     mxp1_class = c;
 }
@@ -76,11 +115,17 @@ void *mxp1_new(t_symbol *s, long argc, t_atom *argv){
     //allocate class
     t_mxp1 *x = (t_mxp1 *)object_alloc(mxp1_class);
     
+    //onset outlet, the rightmost
+    x->onset_out = outlet_new((t_object *)x, NULL);
+    
     //create one message outlet
     x->msg_out = outlet_new((t_object *)x, NULL);
     
     //set up DSP, create signal inlets (3)
     dsp_setup((t_pxobject *)x, 3);
+    //with @timing 1, phase and mc onset countdown right of the step number
+    mx_timing_init(&x->timing, 3, 6, argc, argv);
+    mx_timing_outlets(&x->timing, (t_object *)x);
     //signal outlets (r pat, a pat, b pat, cd, cp, stepnr
     int i;
     for(i=0;i<6;i++){
@@ -89,7 +134,7 @@ void *mxp1_new(t_symbol *s, long argc, t_atom *argv){
     
     x->counter = 0;
     x->step_prev = 0;
-
+    
     x->out_names[0] = "r";
     x->out_names[1] = "a";
     x->out_names[2] = "b";
@@ -100,14 +145,28 @@ void *mxp1_new(t_symbol *s, long argc, t_atom *argv){
     p_s->b = 0;
     p_s->steps = 1; //init to one, lest we get divide by zero error later on
     
-    p_s->a_pat = sysmem_newptrclear(p_s->steps * sizeof(int));
-    p_s->b_pat = sysmem_newptrclear(p_s->steps * sizeof(int));
-    p_s->r_pat = sysmem_newptrclear(p_s->steps * sizeof(int));
+    mx_arena_init(&p_s->arena);
+    mxp1_lanes_take(p_s);
+    
+    x->coalesce = 0;
+    x->gen_q = qelem_new(x, (method)mxp1_gen_pending);
+    critical_new(&x->gen_lock);
+    x->init_q = qelem_new(x, (method)mxp1_init);
+    x->init_pending = 0;
+    x->quiet = 0;
+    mx_stats_init(&x->stats, (t_object *)x);
+    mx_events_init(&x->events, x->msg_out, x->onset_out);
+    mx_clock_init(&x->clock);
+    
+    long ac = attr_args_offset(argc, argv);
+    attr_args_process(x, argc, argv);
     
-    if(argc==2){
+    if(ac == 2){
         p_s->a = atom_getlong(argv);
         p_s->b = atom_getlong(argv+1);
-        mxp1_bang(x);
+        //only record them, the patch may still be loading and the outlets unconnected
+        x->init_pending = 1;
+        qelem_set(x->init_q);
     }
     
     return (x);
@@ -115,18 +174,21 @@ void *mxp1_new(t_symbol *s, long argc, t_atom *argv){
 
 void mxp1_free(t_mxp1 *x){
     t_schillinger *p_s = &x->t;
+    qelem_free(x->gen_q);
+    critical_free(x->gen_lock);
+    qelem_free(x->init_q);
+    mx_stats_free(&x->stats);
+    mx_events_free(&x->events);
     dsp_free((t_pxobject *)x);
     
-    sysmem_freeptr(p_s->r_pat);
-    sysmem_freeptr(p_s->a_pat);
-    sysmem_freeptr(p_s->b_pat);
+    mx_arena_free(&p_s->arena);
 }
 
 void mxp1_assist(t_mxp1 *x, void *b, long m, long a, char *s){
     if(m == ASSIST_INLET){
         switch(a){
             case 0:
-                sprintf(s, "(signal) Click to advance one step\n(gen) Generator pair\n(bang) Output to step visualiser");
+                sprintf(s, "(signal) Click to advance one step\n(gen) Generator pair\n(bang) Output to step visualiser\n(writebuffer) Write patterns to buffer~");
                 break;
             case 1:
                 sprintf(s, "(signal) Click to reset sequencer");
@@ -136,6 +198,9 @@ void mxp1_assist(t_mxp1 *x, void *b, long m, long a, char *s){
                 break;
         }
     }else{
+        if(mx_timing_assist(&x->timing, 6, &a, s)){
+            return;
+        }
         switch(a){
             case 0:
                 sprintf(s, "Resultant");
@@ -158,6 +223,9 @@ void mxp1_assist(t_mxp1 *x, void *b, long m, long a, char *s){
             case 6:
                 sprintf(s, "To step visualiser");
                 break;
+            case 7:
+                sprintf(s, "Onsets (onset <lane> <step>), on the scheduler");
+                break;
         }
     }
 }
@@ -172,57 +240,163 @@ void mxp1_bang(t_mxp1 *x){
     }
 }
 
+void mxp1_init(t_mxp1 *x){
+    //low priority, once: the generators given as arguments, without output
+    if(!x->init_pending){
+        return;
+    }
+    t_schillinger *p_s = &(x->t);
+    x->quiet = 1;
+    mxp1_gen(x, p_s->a, p_s->b);
+    x->quiet = 0;
+}
+
+long mxp1_multichanneloutputs(t_mxp1 *x, long index){
+    return index == x->timing.index ? x->timing.lanes : 1;
+}
+
+void mxp1_gen_msg(t_mxp1 *x, long a, long b){
+    if(!x->coalesce){
+        mxp1_gen(x, a, b);
+        return;
+    }
+    //keep only the latest generators, a burst of gen messages costs one generation
+    critical_enter(x->gen_lock);
+    x->gen_args[0] = a;
+    x->gen_args[1] = b;
+    critical_exit(x->gen_lock);
+    
+    qelem_set(x->gen_q);
+}
+
+void mxp1_gen_pending(t_mxp1 *x){
+    critical_enter(x->gen_lock);
+    long a = x->gen_args[0];
+    long b = x->gen_args[1];
+    critical_exit(x->gen_lock);
+    mxp1_gen(x, a, b);
+}
+
 void mxp1_gen(t_mxp1 *x, long a, long b){
+    x->init_pending = 0;
+    t_uint64 start = mx_stats_start(&x->stats);
     t_schillinger *p_s = &(x->t);
-    a = (a==0)?1:a;
-    b = (b==0)?1:b;
-    p_s->steps = a*b;
+    a = MAX(a, 1);
+    b = MAX(b, 1);
+    p_s->steps = mx_core_p1_steps(a, b);
     
     int i;
     
     p_s->a = a;
     p_s->b = b;
-    long newsize = (long)p_s->steps * sizeof(int);
-    t_ptr temp1, temp2, temp3;
-    temp1 = sysmem_resizeptrclear(p_s->r_pat, newsize);
-    temp2 = sysmem_resizeptrclear(p_s->a_pat, newsize);
-    temp3 = sysmem_resizeptrclear(p_s->b_pat, newsize);
-    p_s->r_pat = temp1;
-    p_s->a_pat = temp2;
-    p_s->b_pat = temp3;
-    
-    for(i=0;i<newsize;i++){
-        p_s->r_pat[i]=0;
-        p_s->a_pat[i]=0;
-        p_s->b_pat[i]=0;
-    }
+    mxp1_lanes_take(p_s);
     
     for(i=0;i<4;i++){
         outlet_s(x, x->out_names[i], 1, "clear");
         outlet_s(x, x->out_names[i], 2, "rows", 1);
         outlet_s(x, x->out_names[i], 2, "columns", (int)p_s->steps);
     }
+    mx_events_refresh(&x->events);
+    
+    if(!x->quiet){
+        outlet_int(x->msg_out, 1);
+        outlet_int(x->msg_out, p_s->steps);
+        mx_stats_sent(&x->stats, 2);
+    }
+    
+    mx_core_p1(a, b, p_s->r_pat, p_s->a_pat, p_s->b_pat);
+    mx_timing_refresh(&x->timing);
+    
+    t_uint64 out = mx_trace_start();
+    for(i=0;i<p_s->steps;i++){
+        if(p_s->a_pat[i])
+            mx_outlet(x, "a", i, 0, 1);
+        if(p_s->b_pat[i])
+            mx_outlet(x, "b", i, 0, 1);
+        if(p_s->r_pat[i])
+            mx_outlet(x, "r", i, 0, 1);
+    }
+    mx_trace_span_as(x, "visualiser", out);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mxp1_writebuffer(t_mxp1 *x, t_symbol *s, long argc, t_atom *argv){
+    //writebuffer name [r a b]: one channel per lane, one frame per step
+    if(!argc || atom_gettype(argv) != A_SYM){
+        post("Usage: writebuffer <buffer~ name> [r a b]");
+        return;
+    }
+    mxp1_init(x);
+    
+    t_schillinger *p_s = &(x->t);
+    t_symbol *name = atom_getsym(argv);
+    t_ptr pats[3] = {p_s->r_pat, p_s->a_pat, p_s->b_pat};
+    t_ptr lanes[3];
+    long lane_amt = 0;
+    
+    if(argc == 1){
+        for(int i=0;i<3;i++){
+            lanes[lane_amt++] = pats[i];
+        }
+    }
+    
+    for(int i=1;i<argc && lane_amt<3;i++){
+        t_symbol *lane = atom_getsym(argv+i);
+        for(int j=0;j<3;j++){
+            if(lane == gensym(x->out_names[j])){
+                lanes[lane_amt++] = pats[j];
+            }
+        }
+    }
     
-    outlet_int(x->msg_out, 1);
-    outlet_int(x->msg_out, p_s->steps);
-    
-    for(i=0;i<p_s->steps;i+=a){
-        //a
-        p_s->a_pat[i] = 1;
-        mx_outlet(x, "a", i, 0, 1);
-        
-        //r
-        p_s->r_pat[i] = 1;
-        mx_outlet(x, "r", i, 0, 1);
+    if(!lane_amt){
+        post("writebuffer: unknown lane, use r, a or b");
+        return;
     }
     
-    for(i=0;i<p_s->steps;i+=b){
-        p_s->b_pat[i] = 1;
-        mx_outlet(x, "b", i, 0, 1);
-        
-        p_s->r_pat[i] = 1;
-        mx_outlet(x, "r", i, 0, 1);
+    t_buffer_ref *ref = buffer_ref_new((t_object *)x, name);
+    t_buffer_obj *b = buffer_ref_getobject(ref);
+    
+    if(!b){
+        post("writebuffer: no buffer~ named %s", name->s_name);
+        object_free(ref);
+        return;
+    }
+    
+    t_atom size[2];
+    atom_setlong(size, p_s->steps);
+    atom_setlong(size+1, lane_amt);
+    object_method_typed(b, gensym("sizeinsamps"), 2, size, NULL);
+    
+    float *tab = buffer_locksamples(b);
+    if(tab){
+        long chans = (long)buffer_getchannelcount(b);
+        long frames = MIN((long)buffer_getframecount(b), p_s->steps);
+    
+        for(int i=0;i<frames;i++){
+            for(int j=0;j<lane_amt && j<chans;j++){
+                tab[i*chans + j] = lanes[j][i];
+            }
+        }
+        buffer_setdirty(b);
+        buffer_unlocksamples(b);
     }
+    
+    object_free(ref);
+}
+
+void mxp1_lanes_take(t_schillinger *p_s){
+    //r, a and b as one cleared block, reused by every later gen that fits into it
+    mx_arena_reset(&p_s->arena, 3*MX_ARENA_ALIGN(p_s->steps));
+    p_s->r_pat = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+    p_s->a_pat = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+    p_s->b_pat = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+}
+
+void mxp1_stats_info(t_mxp1 *x, long *bytes, long *length){
+    t_schillinger *p_s = &x->t;
+    *bytes = p_s->arena.capacity;
+    *length = p_s->steps;
 }
 
 void mxp1_perform64(t_mxp1 *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam){
@@ -235,52 +409,131 @@ void mxp1_perform64(t_mxp1 *x, t_object *dsp64, double **ins, long numins, doubl
     t_double        *cd_out = outs[CD_OUT];
     t_double        *cp_out = outs[CP_OUT];
     t_double        *stp_out = outs[STP_OUT];
+    t_double        **timing_outs = outs + STP_OUT + 1;
     long            n = sampleframes;
     t_double        in1, in2, in3;
+    t_uint64        start = mx_stats_start(&x->stats);
+    
+    //clicks and resets from mx-clock~ instead of the inlets
+    t_mx_clock_event *clicks = NULL;
+    long events = mx_clock_read(&x->clock, sampleframes, &clicks);
+    if(events >= 0){
+        mxp1_perform_clock(x, clicks, events, outs, sampleframes);
+        mx_events_block(&x->events, sampleframes);
+        mx_stats_perform(&x->stats, start, sampleframes);
+        return;
+    }
     
     t_schillinger *p_s = &x->t;
+    t_ptr pats[3] = {p_s->r_pat, p_s->a_pat, p_s->b_pat};
     
     while(n--){
         in1 = *in1_p++;
         in2 = *in2_p++;
         in3 = *in3_p++;
-        
+    
         //detect click, increase on click
         if(in1>0.){
             x->counter++;
         }
         x->counter %=p_s->steps;
-        
+    
         //detect click, reset counter on click
         if(in2>0.){
             x->counter = 0;
         }
-        
+    
         //if new in3 is different than previous step, reset the counter to in3 (only on ONE frame!)
         if(x->step_prev != in3 && in3 != 0){
             x->counter = ((int)(in3-1)) % p_s->steps;
         }
-        
+    
         x->step_prev = in3;
-        
+    
         *r_out++ = in1*(int)p_s->r_pat[x->counter];
         *a_out++ = in1*(int)p_s->a_pat[x->counter];
         *b_out++ = in1*(int)p_s->b_pat[x->counter];
-
+    
+        //an onset for every lane playing on the click, lanes counted like the pattern outlets
+        if(in1>0.){
+            mx_timing_click(&x->timing);
+            for(int i=0;i<3;i++){
+                if(pats[i][x->counter]){
+                    mx_events_onset(&x->events, i, x->counter, sampleframes-n-1);
+                }
+            }
+        }
+    
         *cd_out++ = in1;
-        
+    
         //cp_out is 1 on one click, when x->counter is 0 and v is one
         *cp_out++ = (!x->counter) && in1;
+        mx_events_step(&x->events, x->counter, sampleframes-n-1);
         *stp_out++ = x->counter;
+        mx_timing_run(&x->timing, timing_outs, sampleframes-n-1, sampleframes-n, x->counter, pats, 3, p_s->steps);
     }
+    mx_events_block(&x->events, sampleframes);
+    mx_stats_perform(&x->stats, start, sampleframes);
     return;
 }
 
+void mxp1_perform_clock(t_mxp1 *x, t_mx_clock_event *clicks, long events, double **outs, long sampleframes){
+    //clicks and resets from mx-clock~: the step is the clicks it counted modulo the steps, the
+    //outputs are 0 but on the clicks and the step number holds in between
+    t_schillinger *p_s = &x->t;
+    t_ptr pats[3] = {p_s->r_pat, p_s->a_pat, p_s->b_pat};
+    t_double *cd_out = outs[CD_OUT];
+    t_double *cp_out = outs[CP_OUT];
+    t_double *stp_out = outs[STP_OUT];
+    t_double **timing_outs = outs + STP_OUT + 1;
+    long from = 0;
+    
+    for(int i=0;i<STP_OUT;i++){
+        set_zero64(outs[i], sampleframes);
+    }
+    
+    for(long i=0;i<events;i++){
+        t_mx_clock_event *e = clicks+i;
+        long o = e->offset;
+        for(long j=from;j<o;j++){
+            stp_out[j] = x->counter;
+        }
+        mx_timing_run(&x->timing, timing_outs, from, o, x->counter, pats, 3, p_s->steps);
+        from = o;
+        x->counter = e->count % p_s->steps;
+        mx_events_step(&x->events, x->counter, o);
+        if(e->click <= 0.){
+            continue;
+        }
+    
+        mx_timing_click(&x->timing);
+        for(int i=0;i<3;i++){
+            outs[i][o] = e->click*(int)pats[i][x->counter];
+            if(pats[i][x->counter]){
+                mx_events_onset(&x->events, i, x->counter, o);
+            }
+        }
+        cd_out[o] = e->click;
+        cp_out[o] = !x->counter;
+    }
+    for(long j=from;j<sampleframes;j++){
+        stp_out[j] = x->counter;
+    }
+    mx_timing_run(&x->timing, timing_outs, from, sampleframes, x->counter, pats, 3, p_s->steps);
+}
+
 void mxp1_dsp64(t_mxp1 *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags){
+    mxp1_init(x);
+    mx_stats_dsp(&x->stats, samplerate);
+    mx_events_dsp(&x->events, samplerate);
     object_method(dsp64, gensym("dsp_add64"), x, mxp1_perform64, 0, NULL);
 }
 
 void mx_outlet(t_mxp1 *x, char *pre, int a, int b, int c){
+    if(x->quiet){
+        return;
+    }
+    mx_stats_sent(&x->stats, 1);
     t_atom argv[3];
     atom_setlong(argv, a);
     atom_setlong(argv+1, b);
@@ -289,6 +542,10 @@ void mx_outlet(t_mxp1 *x, char *pre, int a, int b, int c){
 }
 
 void outlet_s(t_mxp1 *x, char *selector, int argc, char *msg, ...){
+    if(x->quiet){
+        return;
+    }
+    mx_stats_sent(&x->stats, 1);
     //the first symbol message counts as argc as well
     t_atom argv[argc];
     int i, temp;
@@ -18,7 +18,14 @@
 #include "ext.h"
 #include "z_dsp.h"
 #include "ext_obex.h"
+#include "ext_critical.h"
 #include <stdarg.h>
+#include "../common/mx_arena.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+#include "../common/mx_events.h"
+#include "../common/mx_clock.h"
+#include "../common/mx_timing.h"
 
 /* periodicities 2
  * for this we need MC outputs
@@ -42,6 +49,7 @@ typedef struct _schillinger{
     t_ptr r_pat;
     long steps;
     long steps_b;
+    t_mx_arena arena;   //lanes and b lane table, kept across gens
 } t_schillinger;
 
 typedef struct _mxp2 {
@@ -50,20 +58,39 @@ typedef struct _mxp2 {
     int step_prev;
     t_schillinger t;
     void *msg_out;
+    void *onset_out;
     char* out_names[4];
     long b_offset;
+    char coalesce;
+    t_qelem *gen_q;
+    long gen_args[2];   //latest generators, waiting for gen_q
+    t_critical gen_lock;    //gen_args are written by the scheduler and read by gen_q
+    t_qelem *init_q;
+    char init_pending;  //generators from the arguments, generated on the first dsp or by init_q
+    char quiet;         //gen fills the lanes without any visualiser output
+    t_mx_stats stats;
+    t_mx_events events;
+    t_mx_clock_reader clock;
+    t_mx_timing timing;
 } t_mxp2;
 
 void *mxp2_new(t_symbol *s,  long argc, t_atom *argv);
 void mxp2_free(t_mxp2 *x);
 void mxp2_gen(t_mxp2 *x, long a, long b);
+void mxp2_gen_msg(t_mxp2 *x, long a, long b);
+void mxp2_gen_pending(t_mxp2 *x);
+void mxp2_lanes_take(t_schillinger *p_s);
 void mxp2_assist(t_mxp2 *x, void *b, long m, long a, char *s);
 void mxp2_bang(t_mxp2 *x);
+void mxp2_init(t_mxp2 *x);
 long mxp2_multichanneloutputs(t_mxp2 *x, long index);
+long mxp2_timing_lanes(t_mxp2 *x, t_ptr *lanes);
 void mxp2_perform64(t_mxp2 *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam);
+void mxp2_perform_clock(t_mxp2 *x, t_mx_clock_event *clicks, long events, double **outs, long sampleframes);
 void mxp2_dsp64(t_mxp2 *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
 void outlet_s(t_mxp2 *x, char *selector, int argc, char *msg, ...);
 void mx_outlet(t_mxp2 *x, char *pre, int a, int b, int c);
+void mxp2_stats_info(t_mxp2 *x, long *bytes, long *length);
 
 t_class *mxp2_class;
 
@@ -74,10 +101,18 @@ void ext_main(void *r){
     class_addmethod(c, (method)mxp2_dsp64, "dsp64", A_CANT, 0);
     class_addmethod(c, (method)mxp2_assist, "assist", A_CANT, 0);
     class_addmethod(c, (method)mxp2_bang, "bang", 0);
-    class_addmethod(c, (method)mxp2_gen, "gen", A_LONG, A_LONG, 0);
+    class_addmethod(c, (method)mxp2_gen_msg, "gen", A_LONG, A_LONG, 0);
     class_addmethod(c, (method)mxp2_multichanneloutputs, "multichanneloutputs", A_CANT, 0);
-
+    
     class_dspinit(c);
+    
+    CLASS_ATTR_CHAR(c, "coalesce", 0, t_mxp2, coalesce);
+    CLASS_ATTR_STYLE_LABEL(c, "coalesce", 0, "onoff", "Coalesce gen messages");
+    
+    MX_STATS_CLASS(c, t_mxp2, stats, mxp2_stats_info);
+    MX_CLOCK_CLASS(c, t_mxp2, clock);
+    MX_TIMING_CLASS(c, t_mxp2, timing);
+    
     class_register(CLASS_BOX, c);
     mxp2_class = c;
 }
@@ -86,13 +121,20 @@ void *mxp2_new(t_symbol *s, long argc, t_atom *argv){
     //allocate class
     t_mxp2 *x = (t_mxp2 *)object_alloc(mxp2_class);
     
+    //onset outlet, the rightmost
+    x->onset_out = outlet_new((t_object *)x, NULL);
+    
     //create one message outlet
     x->msg_out = outlet_new((t_object *)x, NULL);
     
     //set up DSP, create signal inlets (3)
     dsp_setup((t_pxobject *)x, 3);
     //x->p_ob.z_misc |= Z_NO_INPLACE;
-
+    
+    
+    //with @timing 1, phase and mc onset countdown right of the step number, r, a and 10 b lanes
+    mx_timing_init(&x->timing, 12, 6, argc, argv);
+    mx_timing_outlets(&x->timing, (t_object *)x);
     
     //signal outlets cd, cp, stepnr
     for(int i=0;i<3;i++){
@@ -109,7 +151,7 @@ void *mxp2_new(t_symbol *s, long argc, t_atom *argv){
     x->counter = 0;
     x->step_prev = 0;
     x->b_offset = 10;
-
+    
     x->out_names[0] = "r";
     x->out_names[1] = "a";
     x->out_names[2] = "b";
@@ -121,20 +163,29 @@ void *mxp2_new(t_symbol *s, long argc, t_atom *argv){
     p_s->steps = 1; //init to one, lest we get divide by zero error later on
     p_s->b_amt = 2;
     
-    p_s->r_pat = sysmem_newptrclear(p_s->steps * sizeof(t_ptr));
-    p_s->a_pat = sysmem_newptrclear(p_s->steps * sizeof(t_ptr));
-    p_s->b_pat = (t_ptr *)sysmem_newptrclear(p_s->b_amt * sizeof(t_ptr));
     p_s->b_outs = (t_double **)sysmem_newptrclear(x->b_offset * sizeof(t_double *));
-
-    for(int i = 0;i<p_s->b_amt;i++){
-        p_s->b_pat[i] = sysmem_newptrclear(p_s->steps * sizeof(t_ptr));
-        p_s->b_outs[i] = NULL;
-    }
+    mx_arena_init(&p_s->arena);
+    mxp2_lanes_take(p_s);
+    
+    x->coalesce = 0;
+    x->gen_q = qelem_new(x, (method)mxp2_gen_pending);
+    critical_new(&x->gen_lock);
+    x->init_q = qelem_new(x, (method)mxp2_init);
+    x->init_pending = 0;
+    x->quiet = 0;
+    mx_stats_init(&x->stats, (t_object *)x);
+    mx_events_init(&x->events, x->msg_out, x->onset_out);
+    mx_clock_init(&x->clock);
+    
+    long ac = attr_args_offset(argc, argv);
+    attr_args_process(x, argc, argv);
     
-    if(argc==2){
+    if(ac == 2){
         p_s->a = atom_getlong(argv);
         p_s->b = atom_getlong(argv+1);
-        mxp2_bang(x);
+        //only record them, the patch may still be loading and the outlets unconnected
+        x->init_pending = 1;
+        qelem_set(x->init_q);
     }
     
     return (x);
@@ -142,16 +193,15 @@ void *mxp2_new(t_symbol *s, long argc, t_atom *argv){
 
 void mxp2_free(t_mxp2 *x){
     t_schillinger *p_s = &x->t;
+    qelem_free(x->gen_q);
+    critical_free(x->gen_lock);
+    qelem_free(x->init_q);
+    mx_stats_free(&x->stats);
+    mx_events_free(&x->events);
     dsp_free((t_pxobject *)x);
     
-    sysmem_freeptr(p_s->r_pat);
-    sysmem_freeptr(p_s->a_pat);
+    mx_arena_free(&p_s->arena);
     
-    for(int i=0;i<p_s->b_amt;i++){
-        sysmem_freeptr(p_s->b_pat[i]);
-    }
-    sysmem_freeptr(p_s->b_pat);
-
     sysmem_freeptr(p_s->b_outs);
 }
 
@@ -169,6 +219,9 @@ void mxp2_assist(t_mxp2 *x, void *b, long m, long a, char *s){
                 break;
         }
     }else{
+        if(mx_timing_assist(&x->timing, 6, &a, s)){
+            return;
+        }
         switch(a){
             case 0:
                 sprintf(s, "Resultant");
@@ -191,6 +244,9 @@ void mxp2_assist(t_mxp2 *x, void *b, long m, long a, char *s){
             case 6:
                 sprintf(s, "To sequencer");
                 break;
+            case 7:
+                sprintf(s, "Onsets (onset <lane> <step>), on the scheduler");
+                break;
         }
     }
 }
@@ -205,112 +261,155 @@ void mxp2_bang(t_mxp2 *x){
     }
 }
 
+void mxp2_init(t_mxp2 *x){
+    //low priority, once: the generators given as arguments, without output
+    if(!x->init_pending){
+        return;
+    }
+    t_schillinger *p_s = &(x->t);
+    x->quiet = 1;
+    mxp2_gen(x, p_s->a, p_s->b);
+    x->quiet = 0;
+}
+
 long mxp2_multichanneloutputs(t_mxp2 *x, long index){
     if(2 == index){  //index where we want our mc sig
         //return x->t.b_amt;
         return x->b_offset;
+    }else if(index == x->timing.index){
+        return x->timing.lanes;
     }else{
         return 1;
     }
 }
 
+long mxp2_timing_lanes(t_mxp2 *x, t_ptr *lanes){
+    //r, a and the b lanes, counted like the onsets
+    t_schillinger *p_s = &x->t;
+    long b = MIN(p_s->b_amt, x->b_offset);
+    lanes[0] = p_s->r_pat;
+    lanes[1] = p_s->a_pat;
+    for(long i=0;i<b;i++){
+        lanes[2+i] = p_s->b_pat[i];
+    }
+    return 2 + b;
+}
+
+void mxp2_gen_msg(t_mxp2 *x, long a, long b){
+    if(!x->coalesce){
+        mxp2_gen(x, a, b);
+        return;
+    }
+    //keep only the latest generators, a burst of gen messages costs one generation
+    critical_enter(x->gen_lock);
+    x->gen_args[0] = a;
+    x->gen_args[1] = b;
+    critical_exit(x->gen_lock);
+    
+    qelem_set(x->gen_q);
+}
+
+void mxp2_gen_pending(t_mxp2 *x){
+    critical_enter(x->gen_lock);
+    long a = x->gen_args[0];
+    long b = x->gen_args[1];
+    critical_exit(x->gen_lock);
+    mxp2_gen(x, a, b);
+}
+
 void mxp2_gen(t_mxp2 *x, long a, long b){
+    x->init_pending = 0;
+    t_uint64 start = mx_stats_start(&x->stats);
     //b may not be larger than a
     a = CLAMP(a, 1, 9);
     b = CLAMP(b, 1, a);
-
+    
     t_schillinger *p_s = &(x->t);
-
+    
     p_s->a = a;
     p_s->b = b;
     
-    p_s->steps = a*a;
+    p_s->steps = mx_core_p2_steps(a, b);
     p_s->steps_b = a*b;
     
-    long old_b_amt = p_s->b_amt;
-    p_s->b_amt = a - b + 1;
-    long newsize = (long)p_s->steps * sizeof(t_ptr);
-    
-    /******************************************************************/
-    sysmem_freeptr(p_s->r_pat);
-    p_s->r_pat = sysmem_newptrclear(newsize);
-
-    sysmem_freeptr(p_s->a_pat);
-    p_s->a_pat = sysmem_newptrclear(newsize);
-    
-    if(p_s->b_outs == NULL){
-        post("b_outs is NULL. abort\n", p_s->b_outs);
-        return;
-    }
-
-    sysmem_freeptr(p_s->b_outs);
-    p_s->b_outs = (t_double **)sysmem_newptrclear(x->b_offset * sizeof(t_double *));
-
-    if(p_s->b_outs == NULL){
-        post("allocation failed!\n");
-        return;
-    }
-
-    //free the old array, which has the size of old_b_amt
-    for(int i=0;i<old_b_amt;i++){
-        sysmem_freeptr(p_s->b_pat[i]);
-    }
-    //free the pointer itself
-    sysmem_freeptr(p_s->b_pat);
-    
-    p_s->b_pat = (t_ptr *)sysmem_newptrclear(p_s->b_amt * sizeof(t_ptr *));
-    for(int i=0;i<p_s->b_amt;i++){
-        p_s->b_pat[i] = sysmem_newptrclear(p_s->steps * sizeof(t_ptr));
-    }
-    
-    // *****************************************************************
+    p_s->b_amt = mx_core_b_amt(a, b);
+    mxp2_lanes_take(p_s);
     
     for(int i=0;i<4;i++){
         outlet_s(x, x->out_names[i], 1, "clear");
         outlet_s(x, x->out_names[i], 2, "rows", 1);
         outlet_s(x, x->out_names[i], 2, "columns", (int)p_s->steps);
     }
+    mx_events_refresh(&x->events);
     outlet_s(x, "b", 2, "rows", p_s->b_amt);
     
-    outlet_int(x->msg_out, p_s->b_amt);
-    outlet_int(x->msg_out, p_s->steps);
-    
-    // ****************************************************************
-    
-    for(int i=0;i<p_s->steps;i+=a){
-        //a
-        p_s->a_pat[i] = 1;
-        mx_outlet(x, "a", i, 0, 1);
-        
-        //r
-        p_s->r_pat[i] = 1;
-        mx_outlet(x, "r", i, 0, 1);
+    if(!x->quiet){
+        outlet_int(x->msg_out, p_s->b_amt);
+        outlet_int(x->msg_out, p_s->steps);
+        mx_stats_sent(&x->stats, 2);
     }
     
-    for(int i=0;i<p_s->steps_b;i+=b){
+    mx_core_p2(a, b, p_s->r_pat, p_s->a_pat, p_s->b_pat);
+    mx_timing_refresh(&x->timing);
+    
+    t_uint64 out = mx_trace_start();
+    for(int i=0;i<p_s->steps;i++){
+        if(p_s->a_pat[i])
+            mx_outlet(x, "a", i, 0, 1);
         for(int j=0;j<p_s->b_amt;j++){
-            //b
-            p_s->b_pat[j][i+(j*(int)a)] = 1;
-            mx_outlet(x, "b", i+(j*(int)a), j, 1);
-            //r
-            p_s->r_pat[i+(j*(int)a)] = 1;
-            mx_outlet(x, "r", i+(j*(int)a), 0, 1);
+            if(p_s->b_pat[j][i])
+                mx_outlet(x, "b", i, j, 1);
         }
+        if(p_s->r_pat[i])
+            mx_outlet(x, "r", i, 0, 1);
+    }
+    mx_trace_span_as(x, "visualiser", out);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mxp2_lanes_take(t_schillinger *p_s){
+    //one cleared block for r, a, the b lane table and the b lanes, the same block
+    //is reused by every later gen that fits into it
+    long lane = MX_ARENA_ALIGN(p_s->steps);
+    mx_arena_reset(&p_s->arena, (2+p_s->b_amt)*lane + MX_ARENA_ALIGN(p_s->b_amt * (long)sizeof(t_ptr)));
+    
+    p_s->r_pat = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+    p_s->a_pat = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+    p_s->b_pat = (t_ptr *)mx_arena_take(&p_s->arena, p_s->b_amt * sizeof(t_ptr));
+    for(int i=0;i<p_s->b_amt;i++){
+        p_s->b_pat[i] = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
     }
 }
 
+void mxp2_stats_info(t_mxp2 *x, long *bytes, long *length){
+    t_schillinger *p_s = &x->t;
+    *bytes = p_s->arena.capacity + sysmem_ptrsize(p_s->b_outs);
+    *length = p_s->steps;
+}
+
 void mxp2_perform64(t_mxp2 *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam){
     long            n = sampleframes;
     t_double        in1, in2, in3;
     t_schillinger   *p_s = &x->t;
-
+    t_uint64        start = mx_stats_start(&x->stats);
+    
+    //clicks and resets from mx-clock~ instead of the inlets
+    t_mx_clock_event *clicks = NULL;
+    long events = mx_clock_read(&x->clock, sampleframes, &clicks);
+    if(events >= 0){
+        mxp2_perform_clock(x, clicks, events, outs, sampleframes);
+        mx_events_block(&x->events, sampleframes);
+        mx_stats_perform(&x->stats, start, sampleframes);
+        return;
+    }
+    
     t_double        *in1_p = ins[0];
     t_double        *in2_p = ins[1];
     t_double        *in3_p = ins[2];
     
     t_double        *r_out = outs[0];
     t_double        *a_out = outs[1];
-
+    
     long            ra_off  = 2;
     long            b_off   = x->b_offset;
     long            rab_off = b_off + ra_off;
@@ -330,55 +429,144 @@ void mxp2_perform64(t_mxp2 *x, t_object *dsp64, double **ins, long numins, doubl
     t_double        *cd_out     = outs[rab_off];
     t_double        *cp_out     = outs[rab_off + 1];
     t_double        *stp_out    = outs[rab_off + 2];
-
+    t_double        **timing_outs = outs + rab_off + 3;
+    t_ptr           lanes[MX_TIMING_LANES];
+    long            lane_amt = mxp2_timing_lanes(x, lanes);
+    
     while(n--){
         in1 = *in1_p++;
         in2 = *in2_p++;
         in3 = *in3_p++;
-        
+    
         //detect click, increase on click
         if(in1>0.){
             (*p_counter)++;
         }
-
+    
         //x->counter %=p_s->steps;
         *p_counter %= (*p_steps);
-
+    
         //detect click, reset counter on click
         if(in2>0.){
             //x->counter = 0;
             *p_counter = 0;
         }
-        
+    
         //if new in3 is different than previous step, reset the counter to in3 (only on ONE frame!)
         if(x->step_prev != in3 && in3 != 0){
             x->counter = ((int)(in3-1)) % p_s->steps;
         }
-        
+    
         x->step_prev = in3;
-        
+    
         *r_out++ = in1*(int)p_s->r_pat[x->counter];
         *a_out++ = in1*(int)p_s->a_pat[x->counter];
-        
+    
         for(int i=0;i<b;i++){
             t_double temp = in1*(int)p_s->b_pat[i][x->counter];
             *b_o[i]++ = CLAMP(temp, -1, 1);
         }
-
+    
+        //an onset for every lane playing on the click, lanes counted like the pattern outlets
+        if(in1>0.){
+            mx_timing_click(&x->timing);
+            if(p_s->r_pat[x->counter]){
+                mx_events_onset(&x->events, 0, x->counter, sampleframes-n-1);
+            }
+            if(p_s->a_pat[x->counter]){
+                mx_events_onset(&x->events, 1, x->counter, sampleframes-n-1);
+            }
+            for(int i=0;i<b;i++){
+                if(p_s->b_pat[i][x->counter]){
+                    mx_events_onset(&x->events, 2+i, x->counter, sampleframes-n-1);
+                }
+            }
+        }
+    
         *cd_out++ = in1;
-        
+    
         //cp_out is 1 on one click, when x->counter is 0 and v is one
         *cp_out++ = (!x->counter) && in1;
+        mx_events_step(&x->events, x->counter, sampleframes-n-1);
         *stp_out++ = x->counter;
+        mx_timing_run(&x->timing, timing_outs, sampleframes-n-1, sampleframes-n, x->counter, lanes, lane_amt, p_s->steps);
     }
+    mx_events_block(&x->events, sampleframes);
+    mx_stats_perform(&x->stats, start, sampleframes);
     return;
 }
 
+void mxp2_perform_clock(t_mxp2 *x, t_mx_clock_event *clicks, long events, double **outs, long sampleframes){
+    //clicks and resets from mx-clock~: the step is the clicks it counted modulo the steps, the
+    //outputs are 0 but on the clicks and the step number holds in between
+    t_schillinger *p_s = &x->t;
+    long rab_off = x->b_offset + 2;
+    int b = (int)p_s->b_amt;
+    t_double *cd_out = outs[rab_off];
+    t_double *cp_out = outs[rab_off + 1];
+    t_double *stp_out = outs[rab_off + 2];
+    t_double **timing_outs = outs + rab_off + 3;
+    t_ptr lanes[MX_TIMING_LANES];
+    long lane_amt = mxp2_timing_lanes(x, lanes);
+    long from = 0;
+    
+    for(long i=0;i<rab_off+2;i++){
+        set_zero64(outs[i], sampleframes);
+    }
+    
+    for(long i=0;i<events;i++){
+        t_mx_clock_event *e = clicks+i;
+        long o = e->offset;
+        for(long j=from;j<o;j++){
+            stp_out[j] = x->counter;
+        }
+        mx_timing_run(&x->timing, timing_outs, from, o, x->counter, lanes, lane_amt, p_s->steps);
+        from = o;
+        x->counter = e->count % p_s->steps;
+        mx_events_step(&x->events, x->counter, o);
+        if(e->click <= 0.){
+            continue;
+        }
+    
+        mx_timing_click(&x->timing);
+        outs[0][o] = e->click*(int)p_s->r_pat[x->counter];
+        outs[1][o] = e->click*(int)p_s->a_pat[x->counter];
+        for(int i=0;i<b;i++){
+            t_double temp = e->click*(int)p_s->b_pat[i][x->counter];
+            outs[2+i][o] = CLAMP(temp, -1, 1);
+        }
+        if(p_s->r_pat[x->counter]){
+            mx_events_onset(&x->events, 0, x->counter, o);
+        }
+        if(p_s->a_pat[x->counter]){
+            mx_events_onset(&x->events, 1, x->counter, o);
+        }
+        for(int i=0;i<b;i++){
+            if(p_s->b_pat[i][x->counter]){
+                mx_events_onset(&x->events, 2+i, x->counter, o);
+            }
+        }
+        cd_out[o] = e->click;
+        cp_out[o] = !x->counter;
+    }
+    for(long j=from;j<sampleframes;j++){
+        stp_out[j] = x->counter;
+    }
+    mx_timing_run(&x->timing, timing_outs, from, sampleframes, x->counter, lanes, lane_amt, p_s->steps);
+}
+
 void mxp2_dsp64(t_mxp2 *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags){
+    mxp2_init(x);
+    mx_stats_dsp(&x->stats, samplerate);
+    mx_events_dsp(&x->events, samplerate);
     object_method(dsp64, gensym("dsp_add64"), x, mxp2_perform64, 0, NULL);
 }
 
 void mx_outlet(t_mxp2 *x, char *pre, int a, int b, int c){
+    if(x->quiet){
+        return;
+    }
+    mx_stats_sent(&x->stats, 1);
     t_atom argv[3];
     atom_setlong(argv, a);
     atom_setlong(argv+1, b);
@@ -387,6 +575,10 @@ void mx_outlet(t_mxp2 *x, char *pre, int a, int b, int c){
 }
 
 void outlet_s(t_mxp2 *x, char *selector, int argc, char *msg, ...){
+    if(x->quiet){
+        return;
+    }
+    mx_stats_sent(&x->stats, 1);
     //the first symbol message counts as argc as well
     t_atom argv[argc];
     int i, temp;
@@ -17,7 +17,20 @@
 
 #include "ext.h"
 #include "ext_obex.h"
+#include "ext_critical.h"
+#include "ext_dictobj.h"
 #include <stdarg.h>
+#include "../common/mxpl_max.h"
+#include "../common/mx_arena.h"
+#include "../common/mx_links.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+
+//outlets, left to right
+#define R_OUT 0
+#define A_OUT 1
+#define B_OUT 2
+#define STP_OUT 3
 
 typedef struct _schillinger{
     long a;
@@ -27,6 +40,9 @@ typedef struct _schillinger{
     t_ptr a_pat;
     t_ptr *b_pat;
     long steps;
+    char mapped;        //lanes point into the @library map, they are read only and never freed
+    t_ptr lib_b[9];     //b lanes of a mapped result
+    t_mx_arena arena;   //lanes and b lane table of a computed result, kept across gens
 } t_schillinger;
 
 typedef struct _mx_c_nsg {
@@ -37,15 +53,46 @@ typedef struct _mx_c_nsg {
     void *a_out;
     void *b_out;
     char* out_names[4];
+    char coalesce;
+    t_qelem *gen_q;
+    long gen_args[2];   //latest generators, waiting for gen_q
+    t_critical gen_lock;    //gen_args are written by the scheduler and read by gen_q
+    t_symbol *format;           //list or dict (@format)
+    t_dictionary *out_dict;     //named dictionary reused by every gen in dict format
+    t_symbol *out_dict_name;
+    t_symbol *library;
+    t_mxpl *lib;
+    t_dictionary *batch_dict;   //result of the last genlist/genrange
+    long links[4];              //patch cords leaving each outlet
+    t_mx_stats stats;
+    t_atom *out_atoms;          //patbin lists, kept across gens and only ever grown
+    long out_atoms_cap;
 } t_mx_c_nsg;
 
 void *mx_c_nsg_new(t_symbol *s,  long argc, t_atom *argv);
 void mx_c_nsg_free(t_mx_c_nsg *x);
 void mx_c_nsg_gen(t_mx_c_nsg *x, long a, long b);
+void mx_c_nsg_gen_msg(t_mx_c_nsg *x, long a, long b);
+void mx_c_nsg_gen_pending(t_mx_c_nsg *x);
+void mx_c_nsg_compute(t_schillinger *p_s, long a, long b);
+void mx_c_nsg_output(t_mx_c_nsg *x);
+void mx_c_nsg_genlist(t_mx_c_nsg *x, t_symbol *s, long argc, t_atom *argv);
+void mx_c_nsg_genrange(t_mx_c_nsg *x, long amin, long amax, long bmin, long bmax);
+t_bool mx_c_nsg_pair_ok(long a, long b);
+void mx_c_nsg_batch(t_mx_c_nsg *x, long *pairs, long count);
+void mx_c_nsg_todict(t_dictionary *entry, t_schillinger *p_s);
+void mx_c_nsg_lanes_free(t_schillinger *p_s);
+void mx_c_nsg_lanes_take(t_schillinger *p_s);
+t_max_err mx_c_nsg_library_set(t_mx_c_nsg *x, void *attr, long argc, t_atom *argv);
+t_bool mx_c_nsg_lookup(t_mx_c_nsg *x, long a, long b);
+void mx_c_nsg_unmap_lanes(t_schillinger *p_s);
+void mx_c_nsg_output_dict(t_mx_c_nsg *x);
+t_max_err mx_c_nsg_patchlineupdate(t_mx_c_nsg *x, t_object *patchline, long updatetype, t_object *src, long srcout, t_object *dst, long dstin);
 void mx_c_nsg_assist(t_mx_c_nsg *x, void *b, long m, long a, char *s);
 void mx_c_nsg_bang(t_mx_c_nsg *x);
 void outlet_s(t_mx_c_nsg *x, char *selector, int argc, char *msg, ...);
 void mx_outlet(t_mx_c_nsg *x, char *pre, int a, int b, int c);
+void mx_c_nsg_stats_info(t_mx_c_nsg *x, long *bytes, long *length);
 
 t_class *mx_c_nsg_class;
 
@@ -54,12 +101,28 @@ void ext_main(void *r){
     
     c = class_new("mx-c", (method)mx_c_nsg_new, (method)mx_c_nsg_free, sizeof(t_mx_c_nsg), NULL, A_GIMME, 0);
     class_addmethod(c, (method)mx_c_nsg_assist, "assist", A_CANT, 0);
+    class_addmethod(c, (method)mx_c_nsg_patchlineupdate, "patchlineupdate", A_CANT, 0);
     class_addmethod(c, (method)mx_c_nsg_bang, "bang", 0);
-    class_addmethod(c, (method)mx_c_nsg_gen, "gen", A_LONG, A_LONG, 0);
+    class_addmethod(c, (method)mx_c_nsg_gen_msg, "gen", A_LONG, A_LONG, 0);
+    class_addmethod(c, (method)mx_c_nsg_genlist, "genlist", A_GIMME, 0);
+    class_addmethod(c, (method)mx_c_nsg_genrange, "genrange", A_LONG, A_LONG, A_LONG, A_LONG, 0);
+    
+    CLASS_ATTR_CHAR(c, "coalesce", 0, t_mx_c_nsg, coalesce);
+    CLASS_ATTR_STYLE_LABEL(c, "coalesce", 0, "onoff", "Coalesce gen messages");
+    
+    CLASS_ATTR_SYM(c, "format", 0, t_mx_c_nsg, format);
+    CLASS_ATTR_ENUM(c, "format", 0, "list dict");
+    CLASS_ATTR_LABEL(c, "format", 0, "Output format");
+    
+    CLASS_ATTR_SYM(c, "library", 0, t_mx_c_nsg, library);
+    CLASS_ATTR_ACCESSORS(c, "library", NULL, mx_c_nsg_library_set);
+    CLASS_ATTR_LABEL(c, "library", 0, "Pattern library");
+    
+    MX_STATS_CLASS(c, t_mx_c_nsg, stats, mx_c_nsg_stats_info);
     
     class_register(CLASS_BOX, c);
     mx_c_nsg_class = c;
-
+    
 }
 
 void *mx_c_nsg_new(t_symbol *s, long argc, t_atom *argv){
@@ -70,7 +133,7 @@ void *mx_c_nsg_new(t_symbol *s, long argc, t_atom *argv){
     x->b_out    = outlet_new((t_object *)x, NULL);
     x->a_out    = outlet_new((t_object *)x, NULL);
     x->r_out    = outlet_new((t_object *)x, NULL);
-
+    
     x->out_names[0] = "r";
     x->out_names[1] = "a";
     x->out_names[2] = "b";
@@ -82,15 +145,30 @@ void *mx_c_nsg_new(t_symbol *s, long argc, t_atom *argv){
     p_s->steps = 1; //init to one, lest we get divide by zero error later on
     p_s->b_amt = 2;
     
-    p_s->r_pat = sysmem_newptrclear(p_s->steps * sizeof(t_ptr));
-    p_s->a_pat = sysmem_newptrclear(p_s->steps * sizeof(t_ptr));
-    p_s->b_pat = (t_ptr*)sysmem_newptrclear(p_s->b_amt * sizeof(t_ptr*));
+    mx_arena_init(&p_s->arena);
+    mx_c_nsg_lanes_take(p_s);
     
-    for(int i=0;i<p_s->b_amt;i++){
-        p_s->b_pat[i] = sysmem_newptrclear(p_s->steps *sizeof(t_ptr));
+    x->coalesce = 0;
+    x->gen_q = qelem_new(x, (method)mx_c_nsg_gen_pending);
+    critical_new(&x->gen_lock);
+    x->format = gensym("list");
+    x->out_dict = NULL;
+    x->out_dict_name = NULL;
+    x->batch_dict = NULL;
+    for(int i=0;i<4;i++){
+        x->links[i] = 0;
     }
+    x->library = gensym("");
+    x->lib = NULL;
+    p_s->mapped = 0;
+    mx_stats_init(&x->stats, (t_object *)x);
+    x->out_atoms = NULL;
+    x->out_atoms_cap = 0;
     
-    if(argc == 2){
+    long ac = attr_args_offset(argc, argv);
+    attr_args_process(x, argc, argv);
+    
+    if(ac == 2){
         p_s->a = atom_getlong(argv);
         p_s->b = atom_getlong(argv+1);
     }
@@ -100,14 +178,20 @@ void *mx_c_nsg_new(t_symbol *s, long argc, t_atom *argv){
 
 void mx_c_nsg_free(t_mx_c_nsg *x){
     t_schillinger *p_s = &x->t;
-    
-    sysmem_freeptr(p_s->r_pat);
-    sysmem_freeptr(p_s->a_pat);
-    
-    for(int i=0;i<p_s->b_amt;i++){
-        sysmem_freeptr(p_s->b_pat[i]);
+    qelem_free(x->gen_q);
+    critical_free(x->gen_lock);
+    mx_stats_free(&x->stats);
+    if(x->out_atoms){
+        sysmem_freeptr(x->out_atoms);
+    }
+    if(x->out_dict){
+        object_free(x->out_dict);
     }
-    sysmem_freeptr(p_s->b_pat);
+    if(x->batch_dict){
+        object_free(x->batch_dict);
+    }
+    mxpl_close(x->lib);
+    mx_arena_free(&p_s->arena);
 }
 
 void mx_c_nsg_assist(t_mx_c_nsg *x, void *b, long m, long a, char *s){
@@ -135,6 +219,11 @@ void mx_c_nsg_assist(t_mx_c_nsg *x, void *b, long m, long a, char *s){
     }
 }
 
+t_max_err mx_c_nsg_patchlineupdate(t_mx_c_nsg *x, t_object *patchline, long updatetype, t_object *src, long srcout, t_object *dst, long dstin){
+    mx_links_update(x->links, 4, x, updatetype, src, srcout);
+    return MAX_ERR_NONE;
+}
+
 void mx_c_nsg_bang(t_mx_c_nsg *x){
     t_schillinger *p_s = &(x->t);
     
@@ -145,123 +234,351 @@ void mx_c_nsg_bang(t_mx_c_nsg *x){
     }
 }
 
+void mx_c_nsg_gen_msg(t_mx_c_nsg *x, long a, long b){
+    if(!x->coalesce){
+        mx_c_nsg_gen(x, a, b);
+        return;
+    }
+    //keep only the latest generators, a burst of gen messages costs one generation
+    critical_enter(x->gen_lock);
+    x->gen_args[0] = a;
+    x->gen_args[1] = b;
+    critical_exit(x->gen_lock);
+    
+    qelem_set(x->gen_q);
+}
+
+void mx_c_nsg_gen_pending(t_mx_c_nsg *x){
+    critical_enter(x->gen_lock);
+    long a = x->gen_args[0];
+    long b = x->gen_args[1];
+    critical_exit(x->gen_lock);
+    mx_c_nsg_gen(x, a, b);
+}
+
 void mx_c_nsg_gen(t_mx_c_nsg *x, long a, long b){
-    //b may not be larger than a
+    t_uint64 start = mx_stats_start(&x->stats);
+    if(!mx_c_nsg_lookup(x, a, b)){
+        mx_c_nsg_compute(&x->t, a, b);
+    }
+    mx_c_nsg_output(x);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mx_c_nsg_stats_info(t_mx_c_nsg *x, long *bytes, long *length){
+    //mapped lanes belong to the library
+    *bytes = x->t.mapped ? 0 : x->t.arena.capacity;
+    *length = x->t.steps;
+}
+
+t_bool mx_c_nsg_lookup(t_mx_c_nsg *x, long a, long b){
+    //answers gen straight from the @library map: no allocation, no copying
+    if(!x->lib){
+        return 0;
+    }
     a = CLAMP(a, 1, 9);
     b = CLAMP(b, 1, a);
     
+    int32_t key[2] = {(int32_t)a, (int32_t)b};
+    const t_mxpl_slot *e = mxpl_find(x->lib, MXPL_MX_C, key, 2);
+    if(!e || e->lanes<3 || e->lanes>11){
+        return 0;
+    }
+    
     t_schillinger *p_s = &(x->t);
     
     p_s->a = a;
     p_s->b = b;
+    p_s->steps = e->steps;
+    p_s->b_amt = e->lanes - 2;
+    p_s->r_pat = (t_ptr)mxpl_lane(x->lib, e, 0);
+    p_s->a_pat = (t_ptr)mxpl_lane(x->lib, e, 1);
+    for(int i=0;i<p_s->b_amt;i++){
+        p_s->lib_b[i] = (t_ptr)mxpl_lane(x->lib, e, 2+i);
+    }
+    p_s->b_pat = p_s->lib_b;
+    p_s->mapped = 1;
+    return 1;
+}
 
-    long steps_aa   = a*a;
-    long steps_ab   = a*b;
-    p_s->steps      = steps_aa + steps_ab;
-    
-    long old_b_amt = p_s->b_amt;
-    p_s->b_amt = a - b + 1;
-    long newsize = (long)p_s->steps * sizeof(t_ptr);
-    
-    sysmem_freeptr(p_s->r_pat);
-    p_s->r_pat = sysmem_newptrclear(newsize);
-    
-    sysmem_freeptr(p_s->a_pat);
-    p_s->a_pat = sysmem_newptrclear(newsize);
+void mx_c_nsg_unmap_lanes(t_schillinger *p_s){
+    //mapped lanes belong to the library, forget them instead of freeing them
+    p_s->r_pat = NULL;
+    p_s->a_pat = NULL;
+    p_s->b_pat = NULL;
+    p_s->b_amt = 0;
+    p_s->mapped = 0;
+}
+
+t_max_err mx_c_nsg_library_set(t_mx_c_nsg *x, void *attr, long argc, t_atom *argv){
+    t_symbol *name = (argc && argv)?atom_getsym(argv):gensym("");
+    t_mxpl *lib = NULL;
     
-    for(int i=0;i<old_b_amt;i++){
-        sysmem_freeptr(p_s->b_pat[i]);
+    if(name != gensym("")){
+        lib = mxpl_open_sym(name);
     }
-    sysmem_freeptr(p_s->b_pat);
-    p_s->b_pat = (t_ptr *)sysmem_newptrclear(p_s->b_amt * sizeof(t_ptr *));
-    for(int i=0;i<p_s->b_amt;i++){
-        p_s->b_pat[i] = sysmem_newptrclear(newsize);
+    
+    //lanes still pointing into the old map get computed before it goes away
+    t_schillinger *p_s = &(x->t);
+    if(p_s->mapped){
+        mx_c_nsg_compute(p_s, p_s->a, p_s->b);
     }
     
-    for(int i=0;i<4;i++){
-        outlet_s(x, x->out_names[i], 1, "clear");
-        outlet_s(x, x->out_names[i], 2, "rows", 1);
-        outlet_s(x, x->out_names[i], 2, "columns", (int)p_s->steps);
+    mxpl_close(x->lib);
+    x->lib = lib;
+    x->library = lib?name:gensym("");
+    return MAX_ERR_NONE;
+}
+
+void mx_c_nsg_compute(t_schillinger *p_s, long a, long b){
+    //fills the lanes of p_s, touches nothing else so it may run on any thread
+    if(p_s->mapped){
+        mx_c_nsg_unmap_lanes(p_s);
     }
-    outlet_s(x, "b", 2, "rows", p_s->b_amt);
+    //b may not be larger than a
+    a = CLAMP(a, 1, 9);
+    b = CLAMP(b, 1, a);
     
-    outlet_int(x->step_out, p_s->b_amt);
-    outlet_int(x->step_out, p_s->steps);
+    p_s->a = a;
+    p_s->b = b;
     
-    // ****************************************************************
+    p_s->steps = mx_core_c_steps(a, b);
     
-    //SQUARED GROUP:
-    //calculate a pattern
+    p_s->b_amt = mx_core_b_amt(a, b);
+    mx_c_nsg_lanes_take(p_s);
     
-    for(int i=0;i<p_s->steps;i+=a){
-        //a
-        p_s->a_pat[i] = 1;
-        mx_outlet(x, "a", i, 0, 1);
-        
-        //r
-        p_s->r_pat[i] = 1;
-        mx_outlet(x, "r", i, 0, 1);
+    mx_core_c(a, b, p_s->r_pat, p_s->a_pat, p_s->b_pat);
+}
+
+void mx_c_nsg_output(t_mx_c_nsg *x){
+    t_schillinger *p_s = &(x->t);
+    
+    //outlets without a patch cord get nothing, not even the formatting
+    t_uint64 start = mx_trace_start();
+    if(x->links[STP_OUT]){
+        for(int i=0;i<4;i++){
+            outlet_s(x, x->out_names[i], 1, "clear");
+            outlet_s(x, x->out_names[i], 2, "rows", 1);
+            outlet_s(x, x->out_names[i], 2, "columns", (int)p_s->steps);
+        }
+        outlet_s(x, "b", 2, "rows", p_s->b_amt);
+    
+        outlet_int(x->step_out, p_s->b_amt);
+        outlet_int(x->step_out, p_s->steps);
+        mx_stats_sent(&x->stats, 2);
+    
+        for(int i=0;i<p_s->steps;i++){
+            if(p_s->a_pat[i])
+                mx_outlet(x, "a", i, 0, 1);
+            if(p_s->r_pat[i])
+                mx_outlet(x, "r", i, 0, 1);
+            for(int j=0;j<p_s->b_amt;j++){
+                if(p_s->b_pat[j][i])
+                    mx_outlet(x, "b", i, j, 1);
+            }
+        }
     }
+    mx_trace_span_as(x, "visualiser", start);
     
-    //calculate b patterns
+    if(x->format == gensym("dict")){
+        if(x->links[R_OUT]){
+            mx_c_nsg_output_dict(x);
+        }
+        return;
+    }
+    
+    //print out the patterns
+    x->out_atoms = (t_atom *)mx_buffer_reserve(x->out_atoms, &x->out_atoms_cap, (p_s->steps+1) * sizeof(t_atom));
+    t_atom *atom_pat = x->out_atoms;
     
-    for(int i=0;i<steps_ab;i+=b){
-        for(int j=0;j<p_s->b_amt;j++){
-            //b
-            p_s->b_pat[j][i+(j*(int)a)] = 1;
-            mx_outlet(x, "b", i+(j*(int)a), j, 1);
-            //r
-            p_s->r_pat[i+(j*(int)a)] = 1;
-            mx_outlet(x, "r", i+(j*(int)a), 0, 1);
+    if(x->links[R_OUT]){
+        for(int i=0;i<p_s->steps;i++){
+            atom_setlong(atom_pat+i, p_s->r_pat[i]);
         }
+        outlet_anything(x->r_out, gensym("patbin"), p_s->steps, atom_pat);
+        mx_stats_sent(&x->stats, 1);
+    }
+    if(x->links[A_OUT]){
+        for(int i=0;i<p_s->steps;i++){
+            atom_setlong(atom_pat+i, p_s->a_pat[i]);
+        }
+        outlet_anything(x->a_out, gensym("patbin"), p_s->steps, atom_pat);
+        mx_stats_sent(&x->stats, 1);
+    }
+    if(!x->links[B_OUT]){
+        return;
     }
     
-    //NORMAL GROUPS:
-    //calculate a pattern
+    char buffer[16];
+    atom_setsym(atom_pat, gensym("patbin"));
+    for(int i=0;i<p_s->b_amt;i++){
+        snprintf(buffer, sizeof(buffer), "b%d", i);
+        for(int j=1;j<p_s->steps+1;j++){
+            atom_setlong(atom_pat+j, p_s->b_pat[i][j-1]);
+        }
+        outlet_anything(x->b_out, gensym(buffer), p_s->steps+1, atom_pat);
+        mx_stats_sent(&x->stats, 1);
+    }
+}
+
+void mx_c_nsg_genlist(t_mx_c_nsg *x, t_symbol *s, long argc, t_atom *argv){
+    //genlist a1 b1 a2 b2 ...
+    long count = 0;
+    long *pairs = (long *)sysmem_newptrclear((argc/2+1) * 2 * sizeof(long));
+    
+    for(int i=0;i+1<argc;i+=2){
+        long a = atom_getlong(argv+i);
+        long b = atom_getlong(argv+i+1);
+        if(!mx_c_nsg_pair_ok(a, b)){
+            post("genlist: skipping invalid generator pair %ld %ld.", a, b);
+            continue;
+        }
+        pairs[count*2] = a;
+        pairs[count*2+1] = b;
+        count++;
+    }
     
-    for(int i=(int)steps_ab;i<p_s->steps;i+=a){
-        //a
-        p_s->a_pat[i] = 1;
-        mx_outlet(x, "a", i, 0, 1);
-        //r
-        p_s->r_pat[i] = 1;
-        mx_outlet(x, "r", i, 0, 1);
+    if(count){
+        mx_c_nsg_batch(x, pairs, count);
+    }else{
+        post("genlist: no generator pairs.");
+    }
+    sysmem_freeptr(pairs);
+}
+
+void mx_c_nsg_genrange(t_mx_c_nsg *x, long amin, long amax, long bmin, long bmax){
+    //every valid pair with amin <= a <= amax and bmin <= b <= bmax. only 1 <= b <= a <= 9
+    //are valid, so both passes stay within that instead of the whole range
+    long count = 0;
+    amin = MAX(amin, 1);
+    amax = MIN(amax, 9);
+    bmin = MAX(bmin, 1);
+    for(long a=amin;a<=amax;a++){
+        for(long b=bmin;b<=MIN(bmax, a);b++){
+            count += mx_c_nsg_pair_ok(a, b);
+        }
     }
     
-    //calculate b pattern
+    if(!count){
+        post("genrange: no valid generator pairs in range.");
+        return;
+    }
     
-    for(int i=(int)steps_aa;i<p_s->steps;i+=b){
-        //b
-        for(int j=0;j<p_s->b_amt;j++){
-            p_s->b_pat[j][i] = 1;
-            mx_outlet(x, "b", i, j, 1);
+    long *pairs = (long *)sysmem_newptrclear(count * 2 * sizeof(long));
+    long k = 0;
+    for(long a=amin;a<=amax;a++){
+        for(long b=bmin;b<=MIN(bmax, a);b++){
+            if(mx_c_nsg_pair_ok(a, b)){
+                pairs[k++] = a;
+                pairs[k++] = b;
+            }
         }
-        //r
-        p_s->r_pat[i] = 1;
-        mx_outlet(x, "r", i, 0, 1);
     }
     
-    //print out the patterns
-    t_atom atom_r_pat[p_s->steps];
-    t_atom atom_a_pat[p_s->steps];
-    t_atom atom_b_pat[p_s->b_amt][p_s->steps];
+    mx_c_nsg_batch(x, pairs, count);
+    sysmem_freeptr(pairs);
+}
+
+t_bool mx_c_nsg_pair_ok(long a, long b){
+    return a>=1 && a<=9 && b>=1 && b<=a;
+}
+
+void mx_c_nsg_batch(t_mx_c_nsg *x, long *pairs, long count){
+    //computes all pairs in one go
+    t_uint64 start = mx_stats_start(&x->stats);
+    t_schillinger *results = (t_schillinger *)sysmem_newptrclear(count * sizeof(t_schillinger));
+    for(int i=0;i<count;i++){
+        results[i].a = pairs[i*2];
+        results[i].b = pairs[i*2+1];
+        mx_c_nsg_compute(results+i, results[i].a, results[i].b);
+    }
+    
+    t_dictionary *d = dictionary_new();
+    char key[32];
+    for(int i=0;i<count;i++){
+        t_dictionary *entry = dictionary_new();
+        mx_c_nsg_todict(entry, results+i);
+        snprintf(key, 32, "%ld %ld", results[i].a, results[i].b);
+        dictionary_appenddictionary(d, gensym(key), (t_object *)entry);
+        mx_c_nsg_lanes_free(results+i);
+    }
+    sysmem_freeptr(results);
+    
+    t_symbol *name = NULL;
+    d = dictobj_register(d, &name);
+    if(x->batch_dict){
+        object_free(x->batch_dict);
+    }
+    x->batch_dict = d;
+    
+    t_atom a;
+    atom_setsym(&a, name);
+    outlet_anything(x->r_out, gensym("dictionary"), 1, &a);
+    mx_stats_sent(&x->stats, 1);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mx_c_nsg_todict(t_dictionary *entry, t_schillinger *p_s){
+    //lanes live on the heap, patterns of any length fit
+    dictionary_appendlong(entry, gensym("a"), p_s->a);
+    dictionary_appendlong(entry, gensym("b"), p_s->b);
+    dictionary_appendlong(entry, gensym("steps"), p_s->steps);
+    
+    t_atom *lane = (t_atom *)sysmem_newptr(MAX(p_s->steps, 1) * sizeof(t_atom));
+    char key[16];
     
     for(int i=0;i<p_s->steps;i++){
-        atom_setlong(atom_r_pat+i, p_s->r_pat[i]);
-        atom_setlong(atom_a_pat+i, p_s->a_pat[i]);
+        atom_setlong(lane+i, p_s->r_pat[i]);
     }
-    outlet_anything(x->r_out, gensym("patbin"), p_s->steps, atom_r_pat);
-    outlet_anything(x->a_out, gensym("patbin"), p_s->steps, atom_a_pat);
+    dictionary_appendatoms(entry, gensym("r"), p_s->steps, lane);
+    
+    for(int i=0;i<p_s->steps;i++){
+        atom_setlong(lane+i, p_s->a_pat[i]);
+    }
+    dictionary_appendatoms(entry, gensym("a"), p_s->steps, lane);
+    
+    for(int j=0;j<p_s->b_amt;j++){
+        for(int i=0;i<p_s->steps;i++){
+            atom_setlong(lane+i, p_s->b_pat[j][i]);
+        }
+        snprintf(key, sizeof(key), "b%d", j);
+        dictionary_appendatoms(entry, gensym(key), p_s->steps, lane);
+    }
+    
+    sysmem_freeptr(lane);
+}
 
-    char buffer[3];
+void mx_c_nsg_lanes_free(t_schillinger *p_s){
+    mx_arena_free(&p_s->arena);
+}
+
+void mx_c_nsg_lanes_take(t_schillinger *p_s){
+    //one cleared block for r, a, the b lane table and the b lanes, the same block
+    //is reused by every later gen that fits into it
+    long lane = MX_ARENA_ALIGN(p_s->steps);
+    mx_arena_reset(&p_s->arena, (2+p_s->b_amt)*lane + MX_ARENA_ALIGN(p_s->b_amt * (long)sizeof(t_ptr)));
+    
+    p_s->r_pat = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+    p_s->a_pat = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+    p_s->b_pat = (t_ptr *)mx_arena_take(&p_s->arena, p_s->b_amt * sizeof(t_ptr));
     for(int i=0;i<p_s->b_amt;i++){
-        snprintf(buffer, 3, "b%d", i);
-        atom_setsym(atom_b_pat[i], gensym("patbin"));
-        for(int j=1;j<p_s->steps+1;j++){
-            atom_setlong(atom_b_pat[i]+j, p_s->b_pat[i][j-1]);
-        }
-        outlet_anything(x->b_out, gensym(buffer), p_s->steps+1, atom_b_pat[i]);
+        p_s->b_pat[i] = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
+    }
+}
+
+void mx_c_nsg_output_dict(t_mx_c_nsg *x){
+    //every lane, the step count and the generators in one dictionary
+    if(!x->out_dict){
+        x->out_dict = dictobj_register(dictionary_new(), &x->out_dict_name);
+    }else{
+        dictionary_clear(x->out_dict);
     }
+    mx_c_nsg_todict(x->out_dict, &x->t);
+    
+    t_atom a;
+    atom_setsym(&a, x->out_dict_name);
+    outlet_anything(x->r_out, gensym("dictionary"), 1, &a);
+    mx_stats_sent(&x->stats, 1);
 }
 
 void mx_outlet(t_mx_c_nsg *x, char *pre, int a, int b, int c){
@@ -270,6 +587,7 @@ void mx_outlet(t_mx_c_nsg *x, char *pre, int a, int b, int c){
     atom_setlong(argv+1, b);
     atom_setlong(argv+2, c);
     outlet_anything(x->step_out, gensym(pre), 3, argv);
+    mx_stats_sent(&x->stats, 1);
 }
 
 void outlet_s(t_mx_c_nsg *x, char *selector, int argc, char *msg, ...){
@@ -286,5 +604,6 @@ void outlet_s(t_mx_c_nsg *x, char *selector, int argc, char *msg, ...){
     }
     
     outlet_anything(x->step_out, gensym(selector), argc, argv);
+    mx_stats_sent(&x->stats, 1);
     va_end(ap);
 }
@@ -17,7 +17,15 @@
 
 #include "ext.h"
 #include "ext_obex.h"
+#include "ext_critical.h"
+#include "ext_dictobj.h"
 #include <stdarg.h>
+#include "../common/mxpl_max.h"
+#include "../common/mx_arena.h"
+#include "../common/mx_links.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+#include "../common/mx_worker.h"
 
 #define R1  0
 #define A1  1
@@ -31,29 +39,73 @@
 #define CP  9
 #define STP 10
 
+//outlets, left to right: the eight lanes in the order above, then the step visualiser
+#define STP_OUT 8
+
 typedef struct _schillinger{
     long a;
     long b;
     long c;
     t_ptr *pat_list;
     long steps;
+    char mapped;        //lanes point into the @library map, they are read only and never freed
+    t_mx_arena arena;   //the eight lanes of a computed result, kept across gens
 } t_schillinger;
 
+//one gen with @async: the generators and the lanes computed from them
+typedef struct _mx_3g_nsg_job {
+    t_mx_worker *worker;        //the job is cancelled when its id isn't the newest
+    int32_t id;
+    t_schillinger t;
+    t_uint64 start;             //when the gen message arrived, for @measure
+} t_mx_3g_nsg_job;
+
 typedef struct _mx_3g_nsg {
     t_object p_ob;
     t_schillinger t;
     void *step_out;
     void *outlet_list[8];
     char* out_names[9];
+    char coalesce;
+    t_qelem *gen_q;
+    long gen_args[3];   //latest generators, waiting for gen_q
+    t_critical gen_lock;    //gen_args are written by the scheduler and read by gen_q
+    char async;
+    t_mx_worker *worker;        //@async jobs, see mx_worker.h
+    t_mx_3g_nsg_job *spare;     //lanes of the result replaced last, reused by the next gen
+    t_symbol *format;           //list or dict (@format)
+    t_dictionary *out_dict;     //named dictionary reused by every gen in dict format
+    t_symbol *out_dict_name;
+    t_symbol *library;
+    t_mxpl *lib;
+    long links[9];              //patch cords leaving each outlet
+    t_mx_stats stats;
+    t_atom *out_atoms;          //patbin lists, kept across gens and only ever grown
+    long out_atoms_cap;
 } t_mx_3g_nsg;
 
 void *mx_3g_nsg_new(t_symbol *s,  long argc, t_atom *argv);
 void mx_3g_nsg_free(t_mx_3g_nsg *x);
 void mx_3g_nsg_gen(t_mx_3g_nsg *x, long a, long b, long c);
+void mx_3g_nsg_gen_msg(t_mx_3g_nsg *x, long a, long b, long c);
+void mx_3g_nsg_gen_pending(t_mx_3g_nsg *x);
+void mx_3g_nsg_output_dict(t_mx_3g_nsg *x);
+void mx_3g_nsg_compute(t_schillinger *p_s, long a, long b, long c);
+void mx_3g_nsg_async(t_mx_3g_nsg *x, long a, long b, long c, t_uint64 start);
+void mx_3g_nsg_job_free(t_mx_3g_nsg_job *job);
+void *mx_3g_nsg_worker(t_mx_3g_nsg_job *job);
+void mx_3g_nsg_publish(t_mx_3g_nsg *x);
+void mx_3g_nsg_output(t_mx_3g_nsg *x);
+t_bool mx_3g_nsg_lookup(t_mx_3g_nsg *x, long a, long b, long c);
+void mx_3g_nsg_lanes_take(t_schillinger *p_s);
+void mx_3g_nsg_unmap_lanes(t_schillinger *p_s);
+t_max_err mx_3g_nsg_library_set(t_mx_3g_nsg *x, void *attr, long argc, t_atom *argv);
+t_max_err mx_3g_nsg_patchlineupdate(t_mx_3g_nsg *x, t_object *patchline, long updatetype, t_object *src, long srcout, t_object *dst, long dstin);
 void mx_3g_nsg_assist(t_mx_3g_nsg *x, void *b, long m, long a, char *s);
 void mx_3g_nsg_bang(t_mx_3g_nsg *x);
 void outlet_s(t_mx_3g_nsg *x, char *selector, int argc, char *msg, ...);
 void mx_outlet(t_mx_3g_nsg *x, char *pre, int a, int b, int c);
+void mx_3g_nsg_stats_info(t_mx_3g_nsg *x, long *bytes, long *length);
 
 t_class *mx_3g_nsg_class;
 
@@ -62,12 +114,29 @@ void ext_main(void *r){
     
     c = class_new("mx-3g", (method)mx_3g_nsg_new, (method)mx_3g_nsg_free, sizeof(t_mx_3g_nsg), NULL, A_GIMME, 0);
     class_addmethod(c, (method)mx_3g_nsg_assist, "assist", A_CANT, 0);
+    class_addmethod(c, (method)mx_3g_nsg_patchlineupdate, "patchlineupdate", A_CANT, 0);
     class_addmethod(c, (method)mx_3g_nsg_bang, "bang", 0);
-    class_addmethod(c, (method)mx_3g_nsg_gen, "gen", A_LONG, A_LONG, A_LONG, 0);
+    class_addmethod(c, (method)mx_3g_nsg_gen_msg, "gen", A_LONG, A_LONG, A_LONG, 0);
+    
+    CLASS_ATTR_CHAR(c, "coalesce", 0, t_mx_3g_nsg, coalesce);
+    CLASS_ATTR_STYLE_LABEL(c, "coalesce", 0, "onoff", "Coalesce gen messages");
+    
+    CLASS_ATTR_CHAR(c, "async", 0, t_mx_3g_nsg, async);
+    CLASS_ATTR_STYLE_LABEL(c, "async", 0, "onoff", "Compute patterns in the background");
+    
+    CLASS_ATTR_SYM(c, "format", 0, t_mx_3g_nsg, format);
+    CLASS_ATTR_ENUM(c, "format", 0, "list dict");
+    CLASS_ATTR_LABEL(c, "format", 0, "Output format");
+    
+    CLASS_ATTR_SYM(c, "library", 0, t_mx_3g_nsg, library);
+    CLASS_ATTR_ACCESSORS(c, "library", NULL, mx_3g_nsg_library_set);
+    CLASS_ATTR_LABEL(c, "library", 0, "Pattern library");
+    
+    MX_STATS_CLASS(c, t_mx_3g_nsg, stats, mx_3g_nsg_stats_info);
     
     class_register(CLASS_BOX, c);
     mx_3g_nsg_class = c;
-
+    
 }
 
 void *mx_3g_nsg_new(t_symbol *s, long argc, t_atom *argv){
@@ -78,7 +147,7 @@ void *mx_3g_nsg_new(t_symbol *s, long argc, t_atom *argv){
     for(int i=0;i<8;i++){
         x->outlet_list[7-i] = outlet_new((t_object *)x, NULL);
     }
-
+    
     x->out_names[0] = "r1";
     x->out_names[1] = "a1";
     x->out_names[2] = "b1";
@@ -88,7 +157,7 @@ void *mx_3g_nsg_new(t_symbol *s, long argc, t_atom *argv){
     x->out_names[6] = "b2";
     x->out_names[7] = "c2";
     x->out_names[8] = "stp";
-
+    
     t_schillinger *p_s = &x->t;
     p_s->a = 0;
     p_s->b = 0;
@@ -96,11 +165,32 @@ void *mx_3g_nsg_new(t_symbol *s, long argc, t_atom *argv){
     p_s->steps = 1; //init to one, lest we get divide by zero error later on
     
     p_s->pat_list = (t_ptr *)sysmem_newptrclear(8*sizeof(t_ptr));
-    for(int i=0;i<8;i++){
-        p_s->pat_list[i] = sysmem_newptr(p_s->steps * sizeof(t_ptr));
+    mx_arena_init(&p_s->arena);
+    mx_3g_nsg_lanes_take(p_s);
+    
+    x->coalesce = 0;
+    x->gen_q = qelem_new(x, (method)mx_3g_nsg_gen_pending);
+    critical_new(&x->gen_lock);
+    x->async = 0;
+    x->worker = mx_worker_new((t_object *)x, (method)mx_3g_nsg_publish, (mx_worker_free_fn)mx_3g_nsg_job_free);
+    x->spare = NULL;
+    x->format = gensym("list");
+    x->out_dict = NULL;
+    x->out_dict_name = NULL;
+    for(int i=0;i<9;i++){
+        x->links[i] = 0;
     }
-
-    if(argc == 3){
+    x->library = gensym("");
+    x->lib = NULL;
+    p_s->mapped = 0;
+    mx_stats_init(&x->stats, (t_object *)x);
+    x->out_atoms = NULL;
+    x->out_atoms_cap = 0;
+    
+    long ac = attr_args_offset(argc, argv);
+    attr_args_process(x, argc, argv);
+    
+    if(ac == 3){
         p_s->a = atom_getlong(argv);
         p_s->b = atom_getlong(argv+1);
         p_s->c = atom_getlong(argv+2);
@@ -111,13 +201,22 @@ void *mx_3g_nsg_new(t_symbol *s, long argc, t_atom *argv){
 
 void mx_3g_nsg_free(t_mx_3g_nsg *x){
     t_schillinger *p_s = &x->t;
-    
-    if(p_s->pat_list){
-        for(int i=0;i<8;i++){
-            sysmem_freeptr(p_s->pat_list[i]);
-        }
-        sysmem_freeptr(p_s->pat_list);
+    qelem_free(x->gen_q);
+    critical_free(x->gen_lock);
+    mx_worker_close(x->worker);
+    if(x->spare){
+        mx_3g_nsg_job_free(x->spare);
+    }
+    mx_stats_free(&x->stats);
+    if(x->out_atoms){
+        sysmem_freeptr(x->out_atoms);
     }
+    if(x->out_dict){
+        object_free(x->out_dict);
+    }
+    mxpl_close(x->lib);
+    mx_arena_free(&p_s->arena);
+    sysmem_freeptr(p_s->pat_list);
 }
 
 void mx_3g_nsg_assist(t_mx_3g_nsg *x, void *b, long m, long a, char *s){
@@ -160,6 +259,11 @@ void mx_3g_nsg_assist(t_mx_3g_nsg *x, void *b, long m, long a, char *s){
     }
 }
 
+t_max_err mx_3g_nsg_patchlineupdate(t_mx_3g_nsg *x, t_object *patchline, long updatetype, t_object *src, long srcout, t_object *dst, long dstin){
+    mx_links_update(x->links, 9, x, updatetype, src, srcout);
+    return MAX_ERR_NONE;
+}
+
 void mx_3g_nsg_bang(t_mx_3g_nsg *x){
     t_schillinger *p_s = &(x->t);
     
@@ -170,93 +274,269 @@ void mx_3g_nsg_bang(t_mx_3g_nsg *x){
     }
 }
 
+void mx_3g_nsg_gen_msg(t_mx_3g_nsg *x, long a, long b, long c){
+    if(!x->coalesce){
+        mx_3g_nsg_gen(x, a, b, c);
+        return;
+    }
+    //keep only the latest generators, a burst of gen messages costs one generation
+    critical_enter(x->gen_lock);
+    x->gen_args[0] = a;
+    x->gen_args[1] = b;
+    x->gen_args[2] = c;
+    critical_exit(x->gen_lock);
+    
+    qelem_set(x->gen_q);
+}
+
+void mx_3g_nsg_gen_pending(t_mx_3g_nsg *x){
+    critical_enter(x->gen_lock);
+    long a = x->gen_args[0];
+    long b = x->gen_args[1];
+    long c = x->gen_args[2];
+    critical_exit(x->gen_lock);
+    mx_3g_nsg_gen(x, a, b, c);
+}
+
 void mx_3g_nsg_gen(t_mx_3g_nsg *x, long a, long b, long c){
-    t_schillinger *p_s = &(x->t);
-    p_s->steps = a*b*c;
+    t_uint64 start = mx_stats_start(&x->stats);
+    //generators below 1 have no pattern
+    a = MAX(a, 1);
+    b = MAX(b, 1);
+    c = MAX(c, 1);
+    if(mx_3g_nsg_lookup(x, a, b, c)){
+        //a computation still running for older generators must not overwrite this one
+        mx_worker_request(x->worker);
+    }else if(x->async){
+        mx_3g_nsg_async(x, a, b, c, start);
+        return;
+    }else{
+        mx_3g_nsg_compute(&x->t, a, b, c);
+    }
+    mx_3g_nsg_output(x);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mx_3g_nsg_async(t_mx_3g_nsg *x, long a, long b, long c, t_uint64 start){
+    //a new gen supersedes the one in flight, whose result is dropped
+    t_mx_3g_nsg_job *job = x->spare;
+    x->spare = NULL;
+    if(!job){
+        job = (t_mx_3g_nsg_job *)sysmem_newptrclear(sizeof(t_mx_3g_nsg_job));
+        job->t.pat_list = (t_ptr *)sysmem_newptrclear(8*sizeof(t_ptr));
+        mx_arena_init(&job->t.arena);
+    }
+    job->t.a = a;
+    job->t.b = b;
+    job->t.c = c;
+    job->start = start;
+    job->worker = x->worker;
+    job->id = mx_worker_request(x->worker);
+    mx_worker_start(x->worker, (method)mx_3g_nsg_worker, job);
+}
+
+void mx_3g_nsg_job_free(t_mx_3g_nsg_job *job){
+    mx_arena_free(&job->t.arena);
+    sysmem_freeptr(job->t.pat_list);
+    sysmem_freeptr(job);
+}
+
+void *mx_3g_nsg_worker(t_mx_3g_nsg_job *job){
+    t_uint64 start = mx_trace_start();
+    mx_3g_nsg_compute(&job->t, job->t.a, job->t.b, job->t.c);
+    mx_worker_done(job->worker, job, mx_worker_cancelled(job->worker, job->id), start);
+    systhread_exit(0);
+    return NULL;
+}
+
+void mx_3g_nsg_publish(t_mx_3g_nsg *x){
+    //runs on the main thread: swap the finished lanes in, the replaced ones become the spare
+    t_mx_3g_nsg_job *job = (t_mx_3g_nsg_job *)mx_worker_take(x->worker);
+    
+    if(!job){
+        return;
+    }
+    
+    if(mx_worker_cancelled(job->worker, job->id)){
+        mx_3g_nsg_job_free(job);
+        return;
+    }
+    t_schillinger old = x->t;
+    x->t = job->t;
+    job->t = old;
+    if(x->spare){
+        mx_3g_nsg_job_free(x->spare);
+    }
+    x->spare = job;
+    
+    mx_3g_nsg_output(x);
+    //with @async the generation takes from the gen message to here
+    mx_stats_gen(&x->stats, job->start);
+}
+
+void mx_3g_nsg_stats_info(t_mx_3g_nsg *x, long *bytes, long *length){
+    //mapped lanes belong to the library
+    *bytes = 8*sizeof(t_ptr) + (x->t.mapped ? 0 : x->t.arena.capacity) + (x->spare ? x->spare->t.arena.capacity : 0);
+    *length = x->t.steps;
+}
+
+void mx_3g_nsg_compute(t_schillinger *p_s, long a, long b, long c){
+    //fills the lanes of p_s
+    a = MAX(a, 1);
+    b = MAX(b, 1);
+    c = MAX(c, 1);
+    if(p_s->mapped){
+        mx_3g_nsg_unmap_lanes(p_s);
+    }
+    
+    p_s->steps = mx_core_3g_steps(a, b, c);
     
     p_s->a = a;
     p_s->b = b;
     p_s->c = c;
-    long newsize = (long)p_s->steps * sizeof(int);
+    mx_3g_nsg_lanes_take(p_s);
+    
+    mx_core_3g(a, b, c, p_s->pat_list);
+}
 
-    for(int i=0;i<8;i++){
-        sysmem_freeptr(p_s->pat_list[i]);
-        p_s->pat_list[i] = sysmem_newptrclear(newsize);
-    }
-        
-    for(int i=0;i<9;i++){
-        outlet_s(x, x->out_names[i], 1, "clear");
-        outlet_s(x, x->out_names[i], 2, "rows", 1);
-        outlet_s(x, x->out_names[i], 2, "columns", (int)p_s->steps);
+void mx_3g_nsg_output(t_mx_3g_nsg *x){
+    t_schillinger *p_s = &(x->t);
+    
+    //outlets without a patch cord get nothing, not even the formatting
+    t_uint64 start = mx_trace_start();
+    if(x->links[STP_OUT]){
+        for(int i=0;i<9;i++){
+            outlet_s(x, x->out_names[i], 1, "clear");
+            outlet_s(x, x->out_names[i], 2, "rows", 1);
+            outlet_s(x, x->out_names[i], 2, "columns", (int)p_s->steps);
+        }
+    
+        outlet_int(x->step_out, 1);
+        outlet_int(x->step_out, p_s->steps);
+        mx_stats_sent(&x->stats, 2);
+    
+        for(int i=0;i<p_s->steps;i++){
+            for(int j=0;j<8;j++){
+                if(p_s->pat_list[j][i])
+                    mx_outlet(x, x->out_names[j], i, 0, 1);
+            }
+        }
     }
+    mx_trace_span_as(x, "visualiser", start);
     
-    outlet_int(x->step_out, 1);
-    outlet_int(x->step_out, p_s->steps);
-    
-    for(int i=0;i<p_s->steps;i+=a){
-        //a
-        p_s->pat_list[A1][i] = 1;
-        mx_outlet(x, "a1", i, 0, 1);
-        
-        //r
-        p_s->pat_list[R1][i] = 1;
-        mx_outlet(x, "r1", i, 0, 1);
+    if(x->format == gensym("dict")){
+        if(x->links[R1]){
+            mx_3g_nsg_output_dict(x);
+        }
+        return;
     }
     
-    for(int i=0;i<p_s->steps;i+=b){
-        p_s->pat_list[B1][i] = 1;
-        mx_outlet(x, "b1", i, 0, 1);
-        
-        p_s->pat_list[R1][i] = 1;
-        mx_outlet(x, "r1", i, 0, 1);
+    //print out the patterns
+    
+    x->out_atoms = (t_atom *)mx_buffer_reserve(x->out_atoms, &x->out_atoms_cap, p_s->steps * sizeof(t_atom));
+    t_atom *atom_pat = x->out_atoms;
+    
+    for(int i=0;i<8;i++){
+        if(!x->links[i]){
+            continue;
+        }
+        for(int j=0;j<p_s->steps;j++){
+            atom_setlong(atom_pat+j, p_s->pat_list[i][j]);
+        }
+        outlet_anything(x->outlet_list[i], gensym("patbin"), p_s->steps, atom_pat);
+        mx_stats_sent(&x->stats, 1);
+    }
+}
+
+t_bool mx_3g_nsg_lookup(t_mx_3g_nsg *x, long a, long b, long c){
+    //answers gen straight from the @library map: no allocation, no copying
+    if(!x->lib){
+        return 0;
     }
     
-    for(int i=0;i<p_s->steps;i+=c){
-        p_s->pat_list[C1][i] = 1;
-        mx_outlet(x, "c1", i, 0, 1);
-        
-        p_s->pat_list[R1][i] = 1;
-        mx_outlet(x, "r1", i, 0, 1);
+    int32_t key[3] = {(int32_t)a, (int32_t)b, (int32_t)c};
+    const t_mxpl_slot *e = mxpl_find(x->lib, MXPL_MX_3G, key, 3);
+    if(!e || e->lanes != 8){
+        return 0;
     }
     
-    //COUNTERTHEME
+    t_schillinger *p_s = &(x->t);
+    for(int i=0;i<8;i++){
+        p_s->pat_list[i] = (t_ptr)mxpl_lane(x->lib, e, i);
+    }
     
-    for(int i=0;i<p_s->steps;i+=(b*c)){
-        //a
-        p_s->pat_list[A2][i] = 1;
-        mx_outlet(x, "a2", i, 0, 1);
-        
-        //r
-        p_s->pat_list[R2][i] = 1;
-        mx_outlet(x, "r2", i, 0, 1);
+    p_s->a = a;
+    p_s->b = b;
+    p_s->c = c;
+    p_s->steps = e->steps;
+    p_s->mapped = 1;
+    return 1;
+}
+
+void mx_3g_nsg_lanes_take(t_schillinger *p_s){
+    //all eight lanes as one cleared block, reused by every later gen that fits into it
+    mx_arena_reset(&p_s->arena, 8*MX_ARENA_ALIGN(p_s->steps));
+    for(int i=0;i<8;i++){
+        p_s->pat_list[i] = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
     }
+}
+
+void mx_3g_nsg_unmap_lanes(t_schillinger *p_s){
+    //mapped lanes belong to the library, forget them instead of freeing them
+    for(int i=0;i<8;i++){
+        p_s->pat_list[i] = NULL;
+    }
+    p_s->mapped = 0;
+}
+
+t_max_err mx_3g_nsg_library_set(t_mx_3g_nsg *x, void *attr, long argc, t_atom *argv){
+    t_symbol *name = (argc && argv)?atom_getsym(argv):gensym("");
+    t_mxpl *lib = NULL;
     
-    for(int i=0;i<p_s->steps;i+=(a*c)){
-        p_s->pat_list[B2][i] = 1;
-        mx_outlet(x, "b2", i, 0, 1);
-        
-        p_s->pat_list[R2][i] = 1;
-        mx_outlet(x, "r2", i, 0, 1);
+    if(name != gensym("")){
+        lib = mxpl_open_sym(name);
     }
     
-    for(int i=0;i<p_s->steps;i+=(a*b)){
-        p_s->pat_list[C2][i] = 1;
-        mx_outlet(x, "c2", i, 0, 1);
-        
-        p_s->pat_list[R2][i] = 1;
-        mx_outlet(x, "r2", i, 0, 1);
+    //lanes still pointing into the old map get computed before it goes away
+    t_schillinger *p_s = &(x->t);
+    if(p_s->mapped){
+        mx_3g_nsg_compute(p_s, p_s->a, p_s->b, p_s->c);
     }
     
-    //print out the patterns
+    mxpl_close(x->lib);
+    x->lib = lib;
+    x->library = lib?name:gensym("");
+    return MAX_ERR_NONE;
+}
+
+void mx_3g_nsg_output_dict(t_mx_3g_nsg *x){
+    //every lane, the step count and the generators in one dictionary
+    t_schillinger *p_s = &(x->t);
+    
+    if(!x->out_dict){
+        x->out_dict = dictobj_register(dictionary_new(), &x->out_dict_name);
+    }else{
+        dictionary_clear(x->out_dict);
+    }
     
-    t_atom atom_pats[8][p_s->steps];
+    dictionary_appendlong(x->out_dict, gensym("a"), p_s->a);
+    dictionary_appendlong(x->out_dict, gensym("b"), p_s->b);
+    dictionary_appendlong(x->out_dict, gensym("c"), p_s->c);
+    dictionary_appendlong(x->out_dict, gensym("steps"), p_s->steps);
     
+    t_atom *lane = (t_atom *)sysmem_newptr(MAX(p_s->steps, 1) * sizeof(t_atom));
     for(int i=0;i<8;i++){
         for(int j=0;j<p_s->steps;j++){
-            atom_setlong(atom_pats[i]+j, p_s->pat_list[i][j]);
+            atom_setlong(lane+j, p_s->pat_list[i][j]);
         }
-        outlet_anything(x->outlet_list[i], gensym("patbin"), p_s->steps, atom_pats[i]);
+        dictionary_appendatoms(x->out_dict, gensym(x->out_names[i]), p_s->steps, lane);
     }
+    sysmem_freeptr(lane);
+    
+    t_atom a;
+    atom_setsym(&a, x->out_dict_name);
+    outlet_anything(x->outlet_list[R1], gensym("dictionary"), 1, &a);
+    mx_stats_sent(&x->stats, 1);
 }
 
 void mx_outlet(t_mx_3g_nsg *x, char *pre, int a, int b, int c){
@@ -265,6 +545,7 @@ void mx_outlet(t_mx_3g_nsg *x, char *pre, int a, int b, int c){
     atom_setlong(argv+1, b);
     atom_setlong(argv+2, c);
     outlet_anything(x->step_out, gensym(pre), 3, argv);
+    mx_stats_sent(&x->stats, 1);
 }
 
 void outlet_s(t_mx_3g_nsg *x, char *selector, int argc, char *msg, ...){
@@ -281,5 +562,6 @@ void outlet_s(t_mx_3g_nsg *x, char *selector, int argc, char *msg, ...){
     }
     
     outlet_anything(x->step_out, gensym(selector), argc, argv);
+    mx_stats_sent(&x->stats, 1);
     va_end(ap);
 }
@@ -17,8 +17,16 @@
 
 #include "ext.h"
 #include "ext_obex.h"
+#include "ext_critical.h"
 #include "z_dsp.h"
+#include "ext_buffer.h"
 #include <stdarg.h>
+#include "../common/mx_arena.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+#include "../common/mx_events.h"
+#include "../common/mx_clock.h"
+#include "../common/mx_timing.h"
 
 //signal outlets (r pat, a pat, b pat, r' pat, a' pat, b' patcd, cp, stepnr)
 #define R1  0
@@ -39,6 +47,7 @@ typedef struct _schillinger{
     long c;
     t_ptr *pat_list;
     long steps;
+    t_mx_arena arena;   //the eight lanes, kept across gens
 } t_schillinger;
 
 typedef struct _mx_3g {
@@ -47,18 +56,38 @@ typedef struct _mx_3g {
     int step_prev;
     t_schillinger t;
     void *msg_out;
+    void *onset_out;
     char* out_names[9];
+    char coalesce;
+    t_qelem *gen_q;
+    long gen_args[3];   //latest generators, waiting for gen_q
+    t_critical gen_lock;    //gen_args are written by the scheduler and read by gen_q
+    t_qelem *init_q;
+    char init_pending;  //generators from the arguments, generated on the first dsp or by init_q
+    char quiet;         //gen fills the lanes without any visualiser output
+    t_mx_stats stats;
+    t_mx_events events;
+    t_mx_clock_reader clock;
+    t_mx_timing timing;
 } t_mx_3g;
 
 void *mx_3g_new(t_symbol *s,  long argc, t_atom *argv);
 void mx_3g_free(t_mx_3g *x);
 void mx_3g_gen(t_mx_3g *x, long a, long b, long c);
+void mx_3g_gen_msg(t_mx_3g *x, long a, long b, long c);
+void mx_3g_gen_pending(t_mx_3g *x);
+void mx_3g_lanes_take(t_schillinger *p_s);
 void mx_3g_assist(t_mx_3g *x, void *b, long m, long a, char *s);
 void mx_3g_bang(t_mx_3g *x);
+void mx_3g_init(t_mx_3g *x);
+long mx_3g_multichanneloutputs(t_mx_3g *x, long index);
+void mx_3g_writebuffer(t_mx_3g *x, t_symbol *s, long argc, t_atom *argv);
 void mx_3g_perform64(t_mx_3g *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam);
+void mx_3g_perform_clock(t_mx_3g *x, t_mx_clock_event *clicks, long events, double **outs, long sampleframes);
 void mx_3g_dsp64(t_mx_3g *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
 void outlet_s(t_mx_3g *x, char *selector, int argc, char *msg, ...);
 void mx_outlet(t_mx_3g *x, char *pre, int a, int b, int c);
+void mx_3g_stats_info(t_mx_3g *x, long *bytes, long *length);
 
 t_class *mx_3g_class;        // global pointer to the object class - so max can reference the object
 
@@ -69,9 +98,19 @@ void ext_main(void *r){
     class_addmethod(c, (method)mx_3g_dsp64, "dsp64", A_CANT, 0);
     class_addmethod(c, (method)mx_3g_assist, "assist", A_CANT, 0);
     class_addmethod(c, (method)mx_3g_bang, "bang", 0);
-    class_addmethod(c, (method)mx_3g_gen, "gen", A_LONG, A_LONG, A_LONG, 0);
-
+    class_addmethod(c, (method)mx_3g_gen_msg, "gen", A_LONG, A_LONG, A_LONG, 0);
+    class_addmethod(c, (method)mx_3g_writebuffer, "writebuffer", A_GIMME, 0);
+    class_addmethod(c, (method)mx_3g_multichanneloutputs, "multichanneloutputs", A_CANT, 0);
+    
     class_dspinit(c);
+    
+    CLASS_ATTR_CHAR(c, "coalesce", 0, t_mx_3g, coalesce);
+    CLASS_ATTR_STYLE_LABEL(c, "coalesce", 0, "onoff", "Coalesce gen messages");
+    
+    MX_STATS_CLASS(c, t_mx_3g, stats, mx_3g_stats_info);
+    MX_CLOCK_CLASS(c, t_mx_3g, clock);
+    MX_TIMING_CLASS(c, t_mx_3g, timing);
+    
     class_register(CLASS_BOX, c);
     mx_3g_class = c;
 }
@@ -80,11 +119,17 @@ void *mx_3g_new(t_symbol *s, long argc, t_atom *argv){
     //allocate class
     t_mx_3g *x = (t_mx_3g *)object_alloc(mx_3g_class);
     
+    //onset outlet, the rightmost
+    x->onset_out = outlet_new((t_object *)x, NULL);
+    
     //create one message outlet
     x->msg_out = outlet_new((t_object *)x, NULL);
     
     //set up DSP, create signal inlets (3)
     dsp_setup((t_pxobject *)x, 3);
+    //with @timing 1, phase and mc onset countdown right of the step number
+    mx_timing_init(&x->timing, 8, 11, argc, argv);
+    mx_timing_outlets(&x->timing, (t_object *)x);
     //signal outlets (r pat, a pat, b pat, c pat, r2 pat, a2 pat, b2 pat, c2pat, cd, cp, stepnr)
     int i;
     for(i=0;i<11;i++){
@@ -111,15 +156,29 @@ void *mx_3g_new(t_symbol *s, long argc, t_atom *argv){
     p_s->steps = 1; //init to one, lest we get divide by zero error later on
     
     p_s->pat_list = (t_ptr *)sysmem_newptrclear(8 * sizeof(t_ptr));
-    for(i=0;i<8;i++){
-        p_s->pat_list[i] = sysmem_newptrclear(p_s->steps * sizeof(t_ptr));
-    }
+    mx_arena_init(&p_s->arena);
+    mx_3g_lanes_take(p_s);
+    
+    x->coalesce = 0;
+    x->gen_q = qelem_new(x, (method)mx_3g_gen_pending);
+    critical_new(&x->gen_lock);
+    x->init_q = qelem_new(x, (method)mx_3g_init);
+    x->init_pending = 0;
+    x->quiet = 0;
+    mx_stats_init(&x->stats, (t_object *)x);
+    mx_events_init(&x->events, x->msg_out, x->onset_out);
+    mx_clock_init(&x->clock);
     
-    if(argc==3){
+    long ac = attr_args_offset(argc, argv);
+    attr_args_process(x, argc, argv);
+    
+    if(ac == 3){
         p_s->a = atom_getlong(argv);
         p_s->b = atom_getlong(argv+1);
         p_s->c = atom_getlong(argv+2);
-        mx_3g_bang(x);
+        //only record them, the patch may still be loading and the outlets unconnected
+        x->init_pending = 1;
+        qelem_set(x->init_q);
     }
     
     return (x);
@@ -127,21 +186,22 @@ void *mx_3g_new(t_symbol *s, long argc, t_atom *argv){
 
 void mx_3g_free(t_mx_3g *x){
     t_schillinger *p_s = &x->t;
+    qelem_free(x->gen_q);
+    critical_free(x->gen_lock);
+    qelem_free(x->init_q);
+    mx_stats_free(&x->stats);
+    mx_events_free(&x->events);
     dsp_free((t_pxobject *)x);
-   
-    if(p_s->pat_list){
-        for(int i=0;i<8;i++){
-            sysmem_freeptr(p_s->pat_list[i]);
-        }
+    
+    mx_arena_free(&p_s->arena);
     sysmem_freeptr(p_s->pat_list);
-    }
 }
 
 void mx_3g_assist(t_mx_3g *x, void *b, long m, long a, char *s){
     if(m == ASSIST_INLET){
         switch(a){
             case 0:
-                sprintf(s, "(signal) Click to advance one step\n(gen) Generator trio\n(bang) Output to step visualiser");
+                sprintf(s, "(signal) Click to advance one step\n(gen) Generator trio\n(bang) Output to step visualiser\n(writebuffer) Write patterns to buffer~");
                 break;
             case 1:
                 sprintf(s, "(signal) Click to reset sequencer");
@@ -151,6 +211,9 @@ void mx_3g_assist(t_mx_3g *x, void *b, long m, long a, char *s){
                 break;
         }
     }else{
+        if(mx_timing_assist(&x->timing, 11, &a, s)){
+            return;
+        }
         switch(a){
             case 0:
                 sprintf(s, "Resultant");
@@ -188,6 +251,9 @@ void mx_3g_assist(t_mx_3g *x, void *b, long m, long a, char *s){
             case 11:
                 sprintf(s, "To sequencer");
                 break;
+            case 12:
+                sprintf(s, "Onsets (onset <lane> <step>), on the scheduler");
+                break;
         }
     }
 }
@@ -202,87 +268,168 @@ void mx_3g_bang(t_mx_3g *x){
     }
 }
 
+void mx_3g_init(t_mx_3g *x){
+    //low priority, once: the generators given as arguments, without output
+    if(!x->init_pending){
+        return;
+    }
+    t_schillinger *p_s = &(x->t);
+    x->quiet = 1;
+    mx_3g_gen(x, p_s->a, p_s->b, p_s->c);
+    x->quiet = 0;
+}
+
+long mx_3g_multichanneloutputs(t_mx_3g *x, long index){
+    return index == x->timing.index ? x->timing.lanes : 1;
+}
+
+void mx_3g_gen_msg(t_mx_3g *x, long a, long b, long c){
+    if(!x->coalesce){
+        mx_3g_gen(x, a, b, c);
+        return;
+    }
+    //keep only the latest generators, a burst of gen messages costs one generation
+    critical_enter(x->gen_lock);
+    x->gen_args[0] = a;
+    x->gen_args[1] = b;
+    x->gen_args[2] = c;
+    critical_exit(x->gen_lock);
+    
+    qelem_set(x->gen_q);
+}
+
+void mx_3g_gen_pending(t_mx_3g *x){
+    critical_enter(x->gen_lock);
+    long a = x->gen_args[0];
+    long b = x->gen_args[1];
+    long c = x->gen_args[2];
+    critical_exit(x->gen_lock);
+    mx_3g_gen(x, a, b, c);
+}
+
 void mx_3g_gen(t_mx_3g *x, long a, long b, long c){
+    x->init_pending = 0;
+    t_uint64 start = mx_stats_start(&x->stats);
     t_schillinger *p_s = &(x->t);
-    p_s->steps = a*b*c;
+    //generators below 1 have no pattern
+    a = MAX(a, 1);
+    b = MAX(b, 1);
+    c = MAX(c, 1);
+    p_s->steps = mx_core_3g_steps(a, b, c);
     
     int i;
     
     p_s->a = a;
     p_s->b = b;
     p_s->c = c;
-
-    long newsize = (long)p_s->steps * sizeof(t_ptr);
-     
-    for(i=0;i<8;i++){
-        sysmem_freeptr(p_s->pat_list[i]);
-        p_s->pat_list[i] = sysmem_newptrclear(newsize);
-    }
+    
+    mx_3g_lanes_take(p_s);
     
     for(i=0;i<9;i++){
         outlet_s(x, x->out_names[i], 1, "clear");
         outlet_s(x, x->out_names[i], 2, "rows", 1);
         outlet_s(x, x->out_names[i], 2, "columns", (int)p_s->steps);
     }
+    mx_events_refresh(&x->events);
+    
+    if(!x->quiet){
+        outlet_int(x->msg_out, 1);
+        outlet_int(x->msg_out, p_s->steps);
+        mx_stats_sent(&x->stats, 2);
+    }
+    
+    mx_core_3g(a, b, c, p_s->pat_list);
+    mx_timing_refresh(&x->timing);
+    
+    t_uint64 out = mx_trace_start();
+    for(i=0;i<p_s->steps;i++){
+        for(int j=0;j<8;j++){
+            if(p_s->pat_list[j][i])
+                mx_outlet(x, x->out_names[j], i, 0, 1);
+        }
+    }
+    mx_trace_span_as(x, "visualiser", out);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mx_3g_writebuffer(t_mx_3g *x, t_symbol *s, long argc, t_atom *argv){
+    //writebuffer name [r1 a1 b1 c1 r2 a2 b2 c2]: one channel per lane, one frame per step
+    if(!argc || atom_gettype(argv) != A_SYM){
+        post("Usage: writebuffer <buffer~ name> [r1 a1 b1 c1 r2 a2 b2 c2]");
+        return;
+    }
+    mx_3g_init(x);
     
-    outlet_int(x->msg_out, 1);
-    outlet_int(x->msg_out, p_s->steps);
-    
-    for(i=0;i<p_s->steps;i+=a){
-        //a
-        p_s->pat_list[A1][i] = 1;
-        mx_outlet(x, "a1", i, 0, 1);
-        
-        //r
-        p_s->pat_list[R1][i] = 1;
-        mx_outlet(x, "r1", i, 0, 1);
+    t_schillinger *p_s = &(x->t);
+    t_symbol *name = atom_getsym(argv);
+    t_ptr lanes[8];
+    long lane_amt = 0;
+    
+    if(argc == 1){
+        for(int i=0;i<8;i++){
+            lanes[lane_amt++] = p_s->pat_list[i];
+        }
     }
     
-    for(i=0;i<p_s->steps;i+=b){
-        p_s->pat_list[B1][i] = 1;
-        mx_outlet(x, "b1", i, 0, 1);
-        
-        p_s->pat_list[R1][i] = 1;
-        mx_outlet(x, "r1", i, 0, 1);
+    for(int i=1;i<argc && lane_amt<8;i++){
+        t_symbol *lane = atom_getsym(argv+i);
+        for(int j=0;j<8;j++){
+            if(lane == gensym(x->out_names[j])){
+                lanes[lane_amt++] = p_s->pat_list[j];
+            }
+        }
     }
     
-    for(i=0;i<p_s->steps;i+=c){
-        p_s->pat_list[C1][i] = 1;
-        mx_outlet(x, "c1", i, 0, 1);
-        
-        p_s->pat_list[R1][i] = 1;
-        mx_outlet(x, "r1", i, 0, 1);
+    if(!lane_amt){
+        post("writebuffer: unknown lane, use r1 a1 b1 c1 r2 a2 b2 or c2");
+        return;
     }
     
-    //COUNTERTHEME
+    t_buffer_ref *ref = buffer_ref_new((t_object *)x, name);
+    t_buffer_obj *b = buffer_ref_getobject(ref);
     
-    for(i=0;i<p_s->steps;i+=(b*c)){
-        //a
-        p_s->pat_list[A2][i] = 1;
-        mx_outlet(x, "a2", i, 0, 1);
-        
-        //r
-        p_s->pat_list[R2][i] = 1;
-        mx_outlet(x, "r2", i, 0, 1);
+    if(!b){
+        post("writebuffer: no buffer~ named %s", name->s_name);
+        object_free(ref);
+        return;
     }
     
-    for(i=0;i<p_s->steps;i+=(a*c)){
-        p_s->pat_list[B2][i] = 1;
-        mx_outlet(x, "b2", i, 0, 1);
-        
-        p_s->pat_list[R2][i] = 1;
-        mx_outlet(x, "r2", i, 0, 1);
+    t_atom size[2];
+    atom_setlong(size, p_s->steps);
+    atom_setlong(size+1, lane_amt);
+    object_method_typed(b, gensym("sizeinsamps"), 2, size, NULL);
+    
+    float *tab = buffer_locksamples(b);
+    if(tab){
+        long chans = (long)buffer_getchannelcount(b);
+        long frames = MIN((long)buffer_getframecount(b), p_s->steps);
+    
+        for(int i=0;i<frames;i++){
+            for(int j=0;j<lane_amt && j<chans;j++){
+                tab[i*chans + j] = lanes[j][i];
+            }
+        }
+        buffer_setdirty(b);
+        buffer_unlocksamples(b);
     }
     
-    for(i=0;i<p_s->steps;i+=(a*b)){
-        p_s->pat_list[C2][i] = 1;
-        mx_outlet(x, "c2", i, 0, 1);
-        
-        p_s->pat_list[R2][i] = 1;
-        mx_outlet(x, "r2", i, 0, 1);
+    object_free(ref);
+}
+
+void mx_3g_lanes_take(t_schillinger *p_s){
+    //all eight lanes as one cleared block, reused by every later gen that fits into it
+    mx_arena_reset(&p_s->arena, 8*MX_ARENA_ALIGN(p_s->steps));
+    for(int i=0;i<8;i++){
+        p_s->pat_list[i] = (t_ptr)mx_arena_take(&p_s->arena, p_s->steps);
     }
 }
 
+void mx_3g_stats_info(t_mx_3g *x, long *bytes, long *length){
+    t_schillinger *p_s = &x->t;
+    *bytes = sysmem_ptrsize(p_s->pat_list) + p_s->arena.capacity;
+    *length = p_s->steps;
+}
+
 void mx_3g_perform64(t_mx_3g *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam){
     t_double        *in1_p = ins[0];
     t_double        *in2_p = ins[1];
@@ -298,8 +445,20 @@ void mx_3g_perform64(t_mx_3g *x, t_object *dsp64, double **ins, long numins, dou
     t_double        *cd_out = outs[CD];
     t_double        *cp_out = outs[CP];
     t_double        *stp_out = outs[STP];
+    t_double        **timing_outs = outs + STP + 1;
     long            n = sampleframes;
     t_double        in1, in2, in3;
+    t_uint64        start = mx_stats_start(&x->stats);
+    
+    //clicks and resets from mx-clock~ instead of the inlets
+    t_mx_clock_event *clicks = NULL;
+    long events = mx_clock_read(&x->clock, sampleframes, &clicks);
+    if(events >= 0){
+        mx_3g_perform_clock(x, clicks, events, outs, sampleframes);
+        mx_events_block(&x->events, sampleframes);
+        mx_stats_perform(&x->stats, start, sampleframes);
+        return;
+    }
     
     t_schillinger *p_s = &x->t;
     
@@ -307,25 +466,25 @@ void mx_3g_perform64(t_mx_3g *x, t_object *dsp64, double **ins, long numins, dou
         in1 = *in1_p++;
         in2 = *in2_p++;
         in3 = *in3_p++;
-        
+    
         //detect click, increase on click
         if(in1>0.){
             x->counter++;
         }
         x->counter %=p_s->steps;
-        
+    
         //detect click, reset counter on click
         if(in2>0.){
             x->counter = 0;
         }
-        
+    
         //if new in3 is different than previous step, reset the counter to in3 (only on ONE frame!)
         if(x->step_prev != in3 && in3 != 0){
             x->counter = ((int)(in3-1)) % p_s->steps;
         }
-        
+    
         x->step_prev = in3;
-        
+    
         *r1_out++ = in1*(int)p_s->pat_list[R1][x->counter];
         *a1_out++ = in1*(int)p_s->pat_list[A1][x->counter];
         *b1_out++ = in1*(int)p_s->pat_list[B1][x->counter];
@@ -334,21 +493,86 @@ void mx_3g_perform64(t_mx_3g *x, t_object *dsp64, double **ins, long numins, dou
         *a2_out++ = in1*(int)p_s->pat_list[A2][x->counter];
         *b2_out++ = in1*(int)p_s->pat_list[B2][x->counter];
         *c2_out++ = in1*(int)p_s->pat_list[C2][x->counter];
-        
+    
+        //an onset for every lane playing on the click, lanes counted like the pattern outlets
+        if(in1>0.){
+            mx_timing_click(&x->timing);
+            for(int i=R1;i<=C2;i++){
+                if(p_s->pat_list[i][x->counter]){
+                    mx_events_onset(&x->events, i, x->counter, sampleframes-n-1);
+                }
+            }
+        }
+    
         *cd_out++ = in1;
-        
+    
         //cp_out is 1 on one click, when x->counter is 0 and v is one
         *cp_out++ = (!x->counter) && in1;
+        mx_events_step(&x->events, x->counter, sampleframes-n-1);
         *stp_out++ = x->counter;
+        mx_timing_run(&x->timing, timing_outs, sampleframes-n-1, sampleframes-n, x->counter, p_s->pat_list, 8, p_s->steps);
     }
+    mx_events_block(&x->events, sampleframes);
+    mx_stats_perform(&x->stats, start, sampleframes);
     return;
 }
 
+void mx_3g_perform_clock(t_mx_3g *x, t_mx_clock_event *clicks, long events, double **outs, long sampleframes){
+    //clicks and resets from mx-clock~: the step is the clicks it counted modulo the steps, the
+    //outputs are 0 but on the clicks and the step number holds in between
+    t_schillinger *p_s = &x->t;
+    t_double *cd_out = outs[CD];
+    t_double *cp_out = outs[CP];
+    t_double *stp_out = outs[STP];
+    t_double **timing_outs = outs + STP + 1;
+    long from = 0;
+    
+    for(int i=R1;i<STP;i++){
+        set_zero64(outs[i], sampleframes);
+    }
+    
+    for(long i=0;i<events;i++){
+        t_mx_clock_event *e = clicks+i;
+        long o = e->offset;
+        for(long j=from;j<o;j++){
+            stp_out[j] = x->counter;
+        }
+        mx_timing_run(&x->timing, timing_outs, from, o, x->counter, p_s->pat_list, 8, p_s->steps);
+        from = o;
+        x->counter = e->count % p_s->steps;
+        mx_events_step(&x->events, x->counter, o);
+        if(e->click <= 0.){
+            continue;
+        }
+    
+        mx_timing_click(&x->timing);
+        for(int i=R1;i<=C2;i++){
+            outs[i][o] = e->click*(int)p_s->pat_list[i][x->counter];
+            if(p_s->pat_list[i][x->counter]){
+                mx_events_onset(&x->events, i, x->counter, o);
+            }
+        }
+        cd_out[o] = e->click;
+        cp_out[o] = !x->counter;
+    }
+    for(long j=from;j<sampleframes;j++){
+        stp_out[j] = x->counter;
+    }
+    mx_timing_run(&x->timing, timing_outs, from, sampleframes, x->counter, p_s->pat_list, 8, p_s->steps);
+}
+
 void mx_3g_dsp64(t_mx_3g *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags){
+    mx_3g_init(x);
+    mx_stats_dsp(&x->stats, samplerate);
+    mx_events_dsp(&x->events, samplerate);
     object_method(dsp64, gensym("dsp_add64"), x, mx_3g_perform64, 0, NULL);
 }
 
 void mx_outlet(t_mx_3g *x, char *pre, int a, int b, int c){
+    if(x->quiet){
+        return;
+    }
+    mx_stats_sent(&x->stats, 1);
     t_atom argv[3];
     atom_setlong(argv, a);
     atom_setlong(argv+1, b);
@@ -357,6 +581,10 @@ void mx_outlet(t_mx_3g *x, char *pre, int a, int b, int c){
 }
 
 void outlet_s(t_mx_3g *x, char *selector, int argc, char *msg, ...){
+    if(x->quiet){
+        return;
+    }
+    mx_stats_sent(&x->stats, 1);
     //the first symbol message counts as argc as well
     t_atom argv[argc];
     int i, temp;
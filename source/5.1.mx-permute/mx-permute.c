@@ -17,6 +17,55 @@
 
 #include "ext.h"
 #include "ext_obex.h"
+#include "ext_systhread.h"
+#include "ext_critical.h"
+#include "ext_atomic.h"
+#include "ext_dictobj.h"
+#include "../common/mxpl_max.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+#include "../common/mx_worker.h"
+
+//layout of the blob saved with @embed, bump when it changes
+#define MX_STATE_VERSION 1
+
+//nearest: permutations from which the scan is split across threads
+#define MX_NEAREST_THREADS 4
+#define MX_NEAREST_PARALLEL 65536
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//one pat request: input pattern and the permutations computed from it
+typedef struct _mx_permute_job {
+    t_mx_worker *worker;        //for @async, the job is cancelled when its id isn't the newest
+    int32_t id;
+    t_atom_long *pattern;
+    t_atom_long **permutations;
+    long unq_perm;
+    long pat_len;
+    t_uint64 start;             //when the pat message arrived, for @measure
+} t_mx_permute_job;
+
+//where the permutations of a job go while they are found
+typedef struct _mx_permute_fill {
+    t_mx_permute_job *job;
+    long r_index;
+} t_mx_permute_fill;
+
+//part of a nearest scan: permutations first to last-1 against the query, k closest kept
+typedef struct _mx_permute_scan {
+    const t_uint64 *bits;
+    const t_uint64 *query;
+    long words;
+    long first;
+    long last;
+    long k;
+    long found;
+    long *best;
+    long *dist;
+} t_mx_permute_scan;
 
 typedef struct _mx_permute {
     t_object p_ob;
@@ -29,6 +78,24 @@ typedef struct _mx_permute {
     long unq_perm;
     long pat_len;
     t_bool circ_mode;
+    char async;
+    t_critical lock;
+    t_mx_worker *worker;        //@async jobs, see mx_worker.h
+    char coalesce;
+    t_qelem *pending_q;
+    t_critical pending_lock;
+    t_symbol *pending_s;        //latest pat/patbin message, waiting for pending_q
+    long pending_argc;
+    long pending_size;
+    t_atom *pending_argv;
+    char embed;
+    t_symbol *library;
+    t_mxpl *lib;
+    t_uint64 *perm_bits;        //every permutation as a bitset of onsets, words 64 bit words each
+    long perm_words;
+    long perm_steps;
+    char perm_bits_dirty;       //permutations changed since perm_bits was built
+    t_mx_stats stats;
 } t_mx_permute;
 
 void *mx_permute_new(t_symbol *s,  long argc, t_atom *argv);
@@ -36,20 +103,41 @@ void mx_permute_free(t_mx_permute *x);
 void mx_permute_assist(t_mx_permute *x, void *b, long m, long a, char *s);
 void mx_permute_bang(t_mx_permute *x);
 void mx_permute_pat(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv);
+void mx_permute_coalesce(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv);
+void mx_permute_coalesced(t_mx_permute *x);
+void mx_permute_dispatch(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv);
 void mx_permute_patbin(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv);
 void mx_permute_recall(t_mx_permute *x, long a);
 void mx_permute_recallbin(t_mx_permute *x, long a);
 void mx_permute_circular(t_mx_permute *x, long shift);
 void mx_permute_anticircular(t_mx_permute *x, long shift);
 
+t_mx_permute_job *mx_permute_job_new(long argc, t_atom *argv);
+void mx_permute_job_free(t_mx_permute_job *job);
+void mx_permute_job_run(t_mx_permute_job *job);
+t_bool mx_permute_job_cancelled(t_mx_permute_job *job);
+void mx_permute_install(t_mx_permute *x, t_mx_permute_job *job);
+void mx_permute_async(t_mx_permute *x, t_mx_permute_job *job);
+void *mx_permute_worker(t_mx_permute_job *job);
+void mx_permute_publish(t_mx_permute *x);
+void mx_permute_appendtodictionary(t_mx_permute *x, t_dictionary *d);
+void mx_permute_restore(t_mx_permute *x, t_dictionary *d);
+t_bool mx_permute_lookup(t_mx_permute *x, long argc, t_atom *argv);
+t_max_err mx_permute_library_set(t_mx_permute *x, void *attr, long argc, t_atom *argv);
+void mx_permute_nearest(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv);
+void mx_permute_pack(t_mx_permute *x);
+void mx_permute_scan(t_mx_permute_scan *scan);
+void *mx_permute_scan_thread(t_mx_permute_scan *scan);
+void nearest_insert(t_mx_permute_scan *scan, long index, long dist);
+long popcount64(t_uint64 v);
+long pack_bits(t_atom *words, t_atom_long *vals, long n, long width);
+void unpack_bits(t_atom_long *vals, t_atom *words, long n, long width);
+void mx_permute_stats_info(t_mx_permute *x, long *bytes, long *length);
+
 void circ_clw(t_mx_permute *x, t_atom_long output[], long shift);
 void circ_aclw(t_mx_permute *x, t_atom_long array[], long shift);
 
-long factorial(long n);
-void swap(t_atom_long *dest, t_atom_long *src);
-int shouldSwap(t_atom_long *arr, t_atom_long start, t_atom_long curr);
-void findPermutations(t_atom_long *arr, t_atom_long index, t_atom_long n, t_atom_long **result, int *r_index);
-void augment_entry(t_hashtab *t, long key);
+int mx_permute_store(void *ctx, const mx_core_long *perm, long n);
 
 t_class *mx_permute_class;
 
@@ -59,17 +147,35 @@ void ext_main(void *r){
     c = class_new("mx-permute", (method)mx_permute_new, (method)mx_permute_free, sizeof(t_mx_permute), NULL, A_GIMME, 0);
     class_addmethod(c, (method)mx_permute_assist, "assist", A_CANT, 0);
     //class_addmethod(c, (method)mx_permute_bang, "bang", 0);
-    class_addmethod(c, (method)mx_permute_pat, "pat", A_GIMME, 0);
-    class_addmethod(c, (method)mx_permute_patbin, "patbin", A_GIMME, 0);
+    class_addmethod(c, (method)mx_permute_coalesce, "pat", A_GIMME, 0);
+    class_addmethod(c, (method)mx_permute_coalesce, "patbin", A_GIMME, 0);
     class_addmethod(c, (method)mx_permute_recall, "recall", A_LONG, 0);
     class_addmethod(c, (method)mx_permute_circular, "circular", A_LONG, 0);
     class_addmethod(c, (method)mx_permute_anticircular, "anticircular", A_LONG, 0);
+    class_addmethod(c, (method)mx_permute_appendtodictionary, "appendtodictionary", A_CANT, 0);
+    class_addmethod(c, (method)mx_permute_nearest, "nearest", A_GIMME, 0);
     
     CLASS_ATTR_LONG(c, "circ_mode", 0, t_mx_permute, circ_mode);
     CLASS_ATTR_ENUM(c, "circ_mode", 0, "forwards reverse");
     CLASS_ATTR_STYLE(c, "circ_mode", 0, "enumindex");
     CLASS_ATTR_FILTER_CLIP(c, "circ_mode", 0, 1);
-
+    
+    CLASS_ATTR_CHAR(c, "async", 0, t_mx_permute, async);
+    CLASS_ATTR_STYLE_LABEL(c, "async", 0, "onoff", "Compute permutations in the background");
+    
+    CLASS_ATTR_CHAR(c, "coalesce", 0, t_mx_permute, coalesce);
+    CLASS_ATTR_STYLE_LABEL(c, "coalesce", 0, "onoff", "Coalesce pat messages");
+    
+    CLASS_ATTR_CHAR(c, "embed", 0, t_mx_permute, embed);
+    CLASS_ATTR_STYLE_LABEL(c, "embed", 0, "onoff", "Save permutations with patcher");
+    CLASS_ATTR_SAVE(c, "embed", 0);
+    
+    CLASS_ATTR_SYM(c, "library", 0, t_mx_permute, library);
+    CLASS_ATTR_ACCESSORS(c, "library", NULL, mx_permute_library_set);
+    CLASS_ATTR_LABEL(c, "library", 0, "Pattern library");
+    
+    MX_STATS_CLASS(c, t_mx_permute, stats, mx_permute_stats_info);
+    
     class_register(CLASS_BOX, c);
     mx_permute_class = c;
 }
@@ -85,12 +191,45 @@ void *mx_permute_new(t_symbol *s, long argc, t_atom *argv){
     x->pattern = NULL;
     x->permutations = NULL;
     x->circ_mode = 0;
-
+    x->unq_perm = 0;
+    
+    x->async = 0;
+    x->worker = mx_worker_new((t_object *)x, (method)mx_permute_publish, (mx_worker_free_fn)mx_permute_job_free);
+    critical_new(&x->lock);
+    
+    x->coalesce = 0;
+    x->pending_q = qelem_new(x, (method)mx_permute_coalesced);
+    critical_new(&x->pending_lock);
+    x->pending_s = NULL;
+    x->pending_argc = 0;
+    x->pending_size = 16;
+    x->pending_argv = (t_atom *)sysmem_newptrclear(x->pending_size * sizeof(t_atom));
+    
+    x->embed = 0;
+    x->library = gensym("");
+    x->lib = NULL;
+    x->perm_bits = NULL;
+    x->perm_words = 0;
+    x->perm_steps = 0;
+    x->perm_bits_dirty = 1;
+    mx_stats_init(&x->stats, (t_object *)x);
+    
     attr_args_process(x, argc, argv);
+    //state saved with @embed, restored silently
+    mx_permute_restore(x, (t_dictionary *)gensym("#D")->s_thing);
     return (x);
 }
 
 void mx_permute_free(t_mx_permute *x){
+    qelem_free(x->pending_q);
+    critical_free(x->pending_lock);
+    sysmem_freeptr(x->pending_argv);
+    
+    mx_worker_close(x->worker);
+    mx_stats_free(&x->stats);
+    
+    critical_free(x->lock);
+    
     if(x->permutations){
         for(int i=0;i<x->unq_perm;i++){
             sysmem_freeptr(x->permutations[i]);
@@ -101,6 +240,11 @@ void mx_permute_free(t_mx_permute *x){
     if(x->pattern){
         sysmem_freeptr(x->pattern);
     }
+    mxpl_close(x->lib);
+    
+    if(x->perm_bits){
+        sysmem_freeptr(x->perm_bits);
+    }
 }
 
 void mx_permute_assist(t_mx_permute *x, void *b, long m, long a, char *s){
@@ -135,6 +279,48 @@ void mx_permute_bang(t_mx_permute *x){
     }
 }
 
+void mx_permute_coalesce(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv){
+    if(!x->coalesce){
+        mx_permute_dispatch(x, s, argc, argv);
+        return;
+    }
+    //overwrite the pending message, only the latest one of a burst gets computed
+    critical_enter(x->pending_lock);
+    if(argc > x->pending_size){
+        x->pending_argv = (t_atom *)sysmem_resizeptr(x->pending_argv, argc * sizeof(t_atom));
+        x->pending_size = argc;
+    }
+    sysmem_copyptr(argv, x->pending_argv, argc * sizeof(t_atom));
+    x->pending_s = s;
+    x->pending_argc = argc;
+    critical_exit(x->pending_lock);
+    
+    qelem_set(x->pending_q);
+}
+
+void mx_permute_coalesced(t_mx_permute *x){
+    //copy the message out, so a new one may arrive while this one is computed
+    critical_enter(x->pending_lock);
+    t_symbol *s = x->pending_s;
+    long argc = x->pending_argc;
+    t_atom argv[argc?argc:1];
+    sysmem_copyptr(x->pending_argv, argv, argc * sizeof(t_atom));
+    x->pending_s = NULL;
+    critical_exit(x->pending_lock);
+    
+    if(s){
+        mx_permute_dispatch(x, s, argc, argv);
+    }
+}
+
+void mx_permute_dispatch(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv){
+    if(s == gensym("patbin")){
+        mx_permute_patbin(x, s, argc, argv);
+    }else{
+        mx_permute_pat(x, s, argc, argv);
+    }
+}
+
 void mx_permute_pat(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv){
     /*
     if(atom_getlong(argv) == 0){
@@ -142,98 +328,541 @@ void mx_permute_pat(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv){
         return;
     }
     */
-     
-    t_hashtab *tab = (t_hashtab *)hashtab_new(0);
-    t_atom_long args[argc];
-    x->pat_len = argc;
-    long total_perm = factorial(argc);
+    if(!argc){
+        return;
+    }
     
-    if(x->pattern){
-        sysmem_freeptr(x->pattern);
+    if(mx_permute_lookup(x, argc, argv)){
+        return;
     }
-    x->pattern = (t_atom_long*)sysmem_newptr(x->pat_len * sizeof(t_atom_long));
     
-    for(int i=0;i<argc;i++){
-        long current = atom_getlong(argv+i);
-        args[i] = current;
-        x->pattern[i] = current;
-        hashtab_storelong(tab, (t_symbol *)args[i], 0);
+    t_mx_permute_job *job = mx_permute_job_new(argc, argv);
+    job->start = mx_stats_start(&x->stats);
+    
+    if(x->async){
+        mx_permute_async(x, job);
+    }else{
+        mx_permute_job_run(job);
+        mx_permute_install(x, job);
     }
+}
+
+t_mx_permute_job *mx_permute_job_new(long argc, t_atom *argv){
+    t_mx_permute_job *job = (t_mx_permute_job *)sysmem_newptrclear(sizeof(t_mx_permute_job));
+    job->worker = NULL;
+    job->id = 0;
+    job->pat_len = argc;
+    job->pattern = (t_atom_long *)sysmem_newptr(argc * sizeof(t_atom_long));
+    job->permutations = NULL;
+    job->unq_perm = 0;
+    job->start = 0;
     
     for(int i=0;i<argc;i++){
-        long current = args[i];
-        augment_entry(tab, current);
+        job->pattern[i] = atom_getlong(argv+i);
     }
+    return job;
+}
+
+void mx_permute_job_free(t_mx_permute_job *job){
+    if(job->permutations){
+        for(int i=0;i<job->unq_perm;i++){
+            if(job->permutations[i]){
+                sysmem_freeptr(job->permutations[i]);
+            }
+        }
+        sysmem_freeptr(job->permutations);
+    }
+    
+    if(job->pattern){
+        sysmem_freeptr(job->pattern);
+    }
+    sysmem_freeptr(job);
+}
+
+t_bool mx_permute_job_cancelled(t_mx_permute_job *job){
+    //synchronous jobs have no request counter and can't be superseded
+    return mx_worker_cancelled(job->worker, job->id);
+}
+
+void mx_permute_job_run(t_mx_permute_job *job){
+    //heavy part of pat, touches nothing but the job so it may run on any thread
+    long argc = job->pat_len;
+    t_atom_long args[argc];
     
-    long unq_perm_div = 1;
+    for(int i=0;i<argc;i++){
+        args[i] = job->pattern[i];
+    }
     
-    t_symbol    **keys = NULL;
-    long        numKeys = hashtab_getsize(tab);
-    t_atom_long vals[numKeys];
-    hashtab_getkeys(tab, &numKeys, &keys);
+    job->unq_perm = (long)mx_core_permutations_count(args, argc);
+    job->permutations = (t_atom_long **)sysmem_newptrclear(job->unq_perm*sizeof(t_atom_long *));
     
-    for(int i=0;i<numKeys;i++){
-        hashtab_lookuplong(tab, keys[i], vals+i);
-        unq_perm_div *= factorial(vals[i]);
+    for(int i=0;i<job->unq_perm;i++){
+        if(mx_permute_job_cancelled(job)){
+            return;
+        }
+        job->permutations[i] = (t_atom_long *)sysmem_newptrclear(argc*sizeof(t_atom_long));
     }
     
+    t_mx_permute_fill fill;
+    fill.job = job;
+    fill.r_index = 0;
+    mx_core_permutations(args, argc, mx_permute_store, &fill);
+}
+
+void mx_permute_install(t_mx_permute *x, t_mx_permute_job *job){
+    //swap the finished result in as a whole, then output it
+    critical_enter(x->lock);
+    
     if(x->permutations){
         for(int i=0;i<x->unq_perm;i++){
             sysmem_freeptr(x->permutations[i]);
         }
-        
         sysmem_freeptr(x->permutations);
     }
     
-    x->unq_perm = (long)total_perm/unq_perm_div;
+    if(x->pattern){
+        sysmem_freeptr(x->pattern);
+    }
+    
+    x->pattern = job->pattern;
+    x->permutations = job->permutations;
+    x->unq_perm = job->unq_perm;
+    x->pat_len = job->pat_len;
+    x->perm_bits_dirty = 1;
+    
+    critical_exit(x->lock);
+    //with @async the generation takes from the pat message to here
+    t_uint64 start = job->start;
+    sysmem_freeptr(job);
+    
+    mx_permute_recall(x, 0);
+    outlet_int(x->int_out, x->unq_perm);
+    mx_stats_sent(&x->stats, 1);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mx_permute_stats_info(t_mx_permute *x, long *bytes, long *length){
+    critical_enter(x->lock);
+    *bytes = sysmem_ptrsize(x->pattern) + sysmem_ptrsize(x->perm_bits) + x->pending_size*sizeof(t_atom);
+    if(x->permutations){
+        *bytes += x->unq_perm * (x->pat_len*sizeof(t_atom_long) + sizeof(t_atom_long *));
+    }
+    *length = x->pat_len;
+    critical_exit(x->lock);
+}
+
+void mx_permute_async(t_mx_permute *x, t_mx_permute_job *job){
+    //a new request supersedes the one in flight, which bails out at its next check
+    job->worker = x->worker;
+    job->id = mx_worker_request(x->worker);
+    mx_worker_start(x->worker, (method)mx_permute_worker, job);
+}
+
+void *mx_permute_worker(t_mx_permute_job *job){
+    t_uint64 start = mx_trace_start();
+    mx_permute_job_run(job);
+    mx_worker_done(job->worker, job, mx_permute_job_cancelled(job), start);
+    systhread_exit(0);
+    return NULL;
+}
+
+void mx_permute_publish(t_mx_permute *x){
+    //runs on the main thread
+    t_mx_permute_job *job = (t_mx_permute_job *)mx_worker_take(x->worker);
     
-    x->permutations = (t_atom_long **)sysmem_newptrclear(x->unq_perm*sizeof(t_atom_long *));
+    if(!job){
+        return;
+    }
+    
+    if(mx_permute_job_cancelled(job)){
+        mx_permute_job_free(job);
+        return;
+    }
+    mx_permute_install(x, job);
+}
+
+void mx_permute_appendtodictionary(t_mx_permute *x, t_dictionary *d){
+    //@embed: pattern and permutations are stored with the patcher, every
+    //element packed into as few bits as the largest one needs
+    if(!x->embed || !x->permutations){
+        return;
+    }
+    
+    critical_enter(x->lock);
+    t_atom_long max = 1;
+    for(int i=0;i<x->pat_len;i++){
+        if(x->pattern[i]<0 || x->pattern[i]>0xffffffff){
+            critical_exit(x->lock);
+            post("embed: pattern elements out of range, state not saved.");
+            return;
+        }
+        max = MAX(max, x->pattern[i]);
+    }
+    
+    long width = 1;
+    while(width<32 && (max >> width)){
+        width++;
+    }
+    
+    long pat_words = (x->pat_len * width + 31) / 32;
+    long perm_words = (x->unq_perm * x->pat_len * width + 31) / 32;
+    long argc = 4 + pat_words + perm_words;
+    t_atom *argv = (t_atom *)sysmem_newptr(argc * sizeof(t_atom));
+    t_atom_long *flat = (t_atom_long *)sysmem_newptr(MAX(x->unq_perm * x->pat_len, 1) * sizeof(t_atom_long));
     
     for(int i=0;i<x->unq_perm;i++){
-        x->permutations[i] = (t_atom_long *)sysmem_newptrclear(argc*sizeof(t_atom_long));
+        memcpy(flat + i*x->pat_len, x->permutations[i], x->pat_len * sizeof(t_atom_long));
     }
     
-    int r_index = 0;
-    findPermutations(args, 0, argc, x->permutations, &r_index);
+    atom_setlong(argv, MX_STATE_VERSION);
+    atom_setlong(argv+1, x->pat_len);
+    atom_setlong(argv+2, x->unq_perm);
+    atom_setlong(argv+3, width);
+    pack_bits(argv+4, x->pattern, x->pat_len, width);
+    pack_bits(argv+4+pat_words, flat, x->unq_perm * x->pat_len, width);
+    critical_exit(x->lock);
     
-    mx_permute_recall(x, 0);
-    outlet_int(x->int_out, x->unq_perm);
-    object_free((t_object *)tab);
+    dictionary_appendatoms(d, gensym("mx_state"), argc, argv);
+    sysmem_freeptr(flat);
+    sysmem_freeptr(argv);
 }
 
-void mx_permute_patbin(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv){
-    if(atom_getlong(argv) == 0){
-        post("(patbin) may not start with 0.");
+void mx_permute_restore(t_mx_permute *x, t_dictionary *d){
+    //counterpart of appendtodictionary. nothing is recomputed and nothing is
+    //output, the permutations are just there for the next recall
+    long argc = 0;
+    t_atom *argv = NULL;
+    
+    if(!d || dictionary_getatoms(d, gensym("mx_state"), &argc, &argv) || argc<4){
+        return;
+    }
+    if(atom_getlong(argv) != MX_STATE_VERSION){
         return;
     }
     
-    t_atom_long binpat[argc];
+    long pat_len = atom_getlong(argv+1);
+    long unq_perm = atom_getlong(argv+2);
+    long width = atom_getlong(argv+3);
     
-    for(int i=0;i<argc;i++){
-        binpat[i] = atom_getlong(argv+i);
+    if(pat_len<1 || unq_perm<1 || width<1 || width>32){
+        post("embed: saved state is corrupt, ignored.");
+        return;
+    }
+    
+    long pat_words = (pat_len * width + 31) / 32;
+    long perm_words = (unq_perm * pat_len * width + 31) / 32;
+    if(argc != 4 + pat_words + perm_words){
+        post("embed: saved state is corrupt, ignored.");
+        return;
     }
     
-    int beatcount = 0;
+    t_atom_long *flat = (t_atom_long *)sysmem_newptr(unq_perm * pat_len * sizeof(t_atom_long));
+    unpack_bits(flat, argv+4+pat_words, unq_perm * pat_len, width);
+    
+    x->pattern = (t_atom_long *)sysmem_newptr(pat_len * sizeof(t_atom_long));
+    unpack_bits(x->pattern, argv+4, pat_len, width);
+    
+    x->permutations = (t_atom_long **)sysmem_newptr(unq_perm * sizeof(t_atom_long *));
+    for(int i=0;i<unq_perm;i++){
+        x->permutations[i] = (t_atom_long *)sysmem_newptr(pat_len * sizeof(t_atom_long));
+        memcpy(x->permutations[i], flat + i*pat_len, pat_len * sizeof(t_atom_long));
+    }
+    x->pat_len = pat_len;
+    x->unq_perm = unq_perm;
+    x->perm_bits_dirty = 1;
+    
+    sysmem_freeptr(flat);
+}
 
-    for(int i=0;i<argc;i++){
-        beatcount += binpat[i];
+long pack_bits(t_atom *words, t_atom_long *vals, long n, long width){
+    //width bits per value, 32 bits per word, so the words survive as plain ints in the patcher
+    t_uint64 acc = 0;
+    long fill = 0;
+    long w = 0;
+    t_uint64 mask = ((t_uint64)1 << width) - 1;
+    
+    for(int i=0;i<n;i++){
+        acc |= ((t_uint64)vals[i] & mask) << fill;
+        fill += width;
+        while(fill>=32){
+            atom_setlong(words+w++, (t_atom_long)(acc & 0xffffffff));
+            acc >>= 32;
+            fill -= 32;
+        }
+    }
+    if(fill){
+        atom_setlong(words+w++, (t_atom_long)(acc & 0xffffffff));
     }
+    return w;
+}
+
+void unpack_bits(t_atom_long *vals, t_atom *words, long n, long width){
+    t_uint64 acc = 0;
+    long fill = 0;
+    long w = 0;
+    t_uint64 mask = ((t_uint64)1 << width) - 1;
     
-    t_atom_long lpat[beatcount+1];
-    t_atom_long result[beatcount];
-    int counter=0;
+    for(int i=0;i<n;i++){
+        while(fill<width){
+            acc |= ((t_uint64)atom_getlong(words+w++) & 0xffffffff) << fill;
+            fill += 32;
+        }
+        vals[i] = (t_atom_long)(acc & mask);
+        acc >>= width;
+        fill -= width;
+    }
+}
+
+t_bool mx_permute_lookup(t_mx_permute *x, long argc, t_atom *argv){
+    //permutations found in the @library map are copied instead of computed
+    if(!x->lib || argc>32){
+        return 0;
+    }
     
+    int32_t key[32];
     for(int i=0;i<argc;i++){
-        if(binpat[i]==1){
-            lpat[counter++] = i;
+        key[i] = (int32_t)atom_getlong(argv+i);
+    }
+    
+    const t_mxpl_slot *e = mxpl_find(x->lib, MXPL_PERMUTE, key, (uint32_t)argc);
+    if(!e || e->steps != argc || !e->lanes){
+        return 0;
+    }
+    
+    t_mx_permute_job *job = mx_permute_job_new(argc, argv);
+    job->start = mx_stats_start(&x->stats);
+    job->unq_perm = e->lanes;
+    job->permutations = (t_atom_long **)sysmem_newptr(job->unq_perm * sizeof(t_atom_long *));
+    for(int i=0;i<job->unq_perm;i++){
+        const int32_t *perm = mxpl_permutation(x->lib, e, i);
+        job->permutations[i] = (t_atom_long *)sysmem_newptr(argc * sizeof(t_atom_long));
+        for(int j=0;j<argc;j++){
+            job->permutations[i][j] = perm[j];
         }
     }
-    lpat[beatcount] = argc;
+    
+    //a computation still running for an older pattern must not overwrite this one
+    mx_worker_request(x->worker);
+    mx_permute_install(x, job);
+    return 1;
+}
+
+t_max_err mx_permute_library_set(t_mx_permute *x, void *attr, long argc, t_atom *argv){
+    t_symbol *name = (argc && argv)?atom_getsym(argv):gensym("");
+    t_mxpl *lib = NULL;
+    
+    //permutations are always copied out, the old map may go right away
+    if(name != gensym("")){
+        lib = mxpl_open_sym(name);
+    }
+    mxpl_close(x->lib);
+    x->lib = lib;
+    x->library = lib?name:gensym("");
+    return MAX_ERR_NONE;
+}
 
+void mx_permute_nearest(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv){
+    //nearest <k> pat|patbin <pattern>: the k permutations sharing the most onsets with
+    //the pattern, closest first. their indices go out as a nearest list, then the closest
+    //one is recalled. the pattern is compared over the length of the permutations.
+    if(!x->permutations){
+        post("No pattern received yet.");
+        return;
+    }
+    if(argc<3 || atom_gettype(argv) != A_LONG || atom_gettype(argv+1) != A_SYM){
+        post("nearest: expected k, pat or patbin and a pattern.");
+        return;
+    }
+    
+    long k = CLAMP(atom_getlong(argv), 1, x->unq_perm);
+    char bin = atom_getsym(argv+1) == gensym("patbin");
+    argc -= 2;
+    argv += 2;
+    
+    //the scan borrows perm_bits and runs outside the lock, a pat arriving meanwhile
+    //installs new permutations and perm_bits is packed again on the next nearest
+    critical_enter(x->lock);
+    if(x->perm_bits_dirty || !x->perm_bits){
+        mx_permute_pack(x);
+    }
+    t_uint64 *bits = x->perm_bits;
+    long words = x->perm_words;
+    long steps = x->perm_steps;
+    long unq_perm = x->unq_perm;
+    x->perm_bits = NULL;
+    critical_exit(x->lock);
+    
+    k = MIN(k, unq_perm);
+    t_uint64 *query = (t_uint64 *)sysmem_newptrclear(words * sizeof(t_uint64));
+    long step = 0;
+    for(int i=0;i<argc && step<steps;i++){
+        t_atom_long temp = atom_getlong(argv+i);
+        if(bin){
+            if(temp){
+                query[step>>6] |= (t_uint64)1 << (step&63);
+            }
+            step++;
+        }else{
+            query[step>>6] |= (t_uint64)1 << (step&63);
+            step += (temp<1)?1:temp;
+        }
+    }
+    
+    //one slice per thread for large sets, their k closest are merged afterwards
+    long threads = (unq_perm >= MX_NEAREST_PARALLEL)?MX_NEAREST_THREADS:1;
+    t_mx_permute_scan scans[MX_NEAREST_THREADS];
+    t_systhread workers[MX_NEAREST_THREADS] = {NULL};
+    
+    for(int i=0;i<threads;i++){
+        scans[i].bits = bits;
+        scans[i].query = query;
+        scans[i].words = words;
+        scans[i].first = unq_perm * i / threads;
+        scans[i].last = unq_perm * (i+1) / threads;
+        scans[i].k = k;
+        scans[i].found = 0;
+        scans[i].best = (long *)sysmem_newptr(k * sizeof(long));
+        scans[i].dist = (long *)sysmem_newptr(k * sizeof(long));
+    }
+    
+    for(int i=1;i<threads;i++){
+        //a slice whose thread can't be started is scanned here
+        if(systhread_create((method)mx_permute_scan_thread, scans+i, 0, 0, 0, workers+i)){
+            workers[i] = NULL;
+            mx_permute_scan(scans+i);
+        }
+    }
+    mx_permute_scan(scans);
+    for(int i=1;i<threads;i++){
+        unsigned int ret;
+        if(workers[i]){
+            systhread_join(workers[i], &ret);
+        }
+        for(int j=0;j<scans[i].found;j++){
+            nearest_insert(scans, scans[i].best[j], scans[i].dist[j]);
+        }
+    }
+    
+    //give perm_bits back unless the permutations changed or were packed again meanwhile
+    critical_enter(x->lock);
+    if(!x->perm_bits && !x->perm_bits_dirty){
+        x->perm_bits = bits;
+        bits = NULL;
+    }
+    critical_exit(x->lock);
+    if(bits){
+        sysmem_freeptr(bits);
+    }
+    
+    t_atom *out = (t_atom *)sysmem_newptr(scans[0].found * sizeof(t_atom));
+    for(int i=0;i<scans[0].found;i++){
+        atom_setlong(out+i, scans[0].best[i]+1);
+    }
+    outlet_anything(x->int_out, gensym("nearest"), (short)scans[0].found, out);
+    mx_stats_sent(&x->stats, 1);
+    mx_permute_recall(x, scans[0].best[0]+1);
+    
+    sysmem_freeptr(out);
+    sysmem_freeptr(query);
+    for(int i=0;i<threads;i++){
+        sysmem_freeptr(scans[i].best);
+        sysmem_freeptr(scans[i].dist);
+    }
+}
+
+void mx_permute_pack(t_mx_permute *x){
+    //onsets of every permutation in aligned 64 bit words, all permutations have the same length.
+    //durations below 1 count as 1, like in the query
+    long steps = 0;
+    for(int i=0;i<x->pat_len;i++){
+        t_atom_long temp = x->pattern[i];
+        steps += (temp<1)?1:temp;
+    }
+    
+    if(x->perm_bits){
+        sysmem_freeptr(x->perm_bits);
+    }
+    x->perm_steps = MAX(steps, 1);
+    x->perm_words = (x->perm_steps+63)/64;
+    x->perm_bits = (t_uint64 *)sysmem_newptrclear(x->unq_perm * x->perm_words * sizeof(t_uint64));
+    
+    for(long i=0;i<x->unq_perm;i++){
+        t_uint64 *bits = x->perm_bits + i*x->perm_words;
+        long other = 0;
+        for(int j=0;j<x->pat_len && other<x->perm_steps;j++){
+            t_atom_long temp = x->permutations[i][j];
+            bits[other>>6] |= (t_uint64)1 << (other&63);
+            other += (temp<1)?1:temp;
+        }
+    }
+    x->perm_bits_dirty = 0;
+}
+
+void mx_permute_scan(t_mx_permute_scan *scan){
+    //hamming distance: popcount of the xor, 64 steps at a time
+    for(long i=scan->first;i<scan->last;i++){
+        const t_uint64 *bits = scan->bits + i*scan->words;
+        long dist = 0;
+        for(long w=0;w<scan->words;w++){
+            dist += popcount64(bits[w] ^ scan->query[w]);
+        }
+        nearest_insert(scan, i, dist);
+    }
+}
+
+void *mx_permute_scan_thread(t_mx_permute_scan *scan){
+    mx_permute_scan(scan);
+    systhread_exit(0);
+    return NULL;
+}
+
+void nearest_insert(t_mx_permute_scan *scan, long index, long dist){
+    //keeps best sorted by distance, then index, at most k entries
+    long i = scan->found;
+    if(i == scan->k){
+        if(dist > scan->dist[i-1] || (dist == scan->dist[i-1] && index > scan->best[i-1])){
+            return;
+        }
+        i--;
+    }else{
+        scan->found++;
+    }
+    
+    while(i>0 && (scan->dist[i-1] > dist || (scan->dist[i-1] == dist && scan->best[i-1] > index))){
+        scan->best[i] = scan->best[i-1];
+        scan->dist[i] = scan->dist[i-1];
+        i--;
+    }
+    scan->best[i] = index;
+    scan->dist[i] = dist;
+}
+
+long popcount64(t_uint64 v){
+#ifdef _MSC_VER
+    return (long)__popcnt64(v);
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+void mx_permute_patbin(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv){
+    if(atom_getlong(argv) == 0){
+        post("(patbin) may not start with 0.");
+        return;
+    }
+    
+    t_atom_long binpat[argc];
+    
+    for(int i=0;i<argc;i++){
+        binpat[i] = atom_getlong(argv+i);
+    }
+    
+    long beatcount = mx_core_onsets(binpat, argc);
+    t_atom_long result[beatcount];
     t_atom pat[beatcount];
     
+    mx_core_bintopat(binpat, argc, result);
     for(int i=0;i<beatcount;i++){
-        result[i] = lpat[i+1]-lpat[i];
         atom_setlong(pat+i, result[i]);
     }
     
@@ -242,19 +871,19 @@ void mx_permute_patbin(t_mx_permute *x, t_symbol *s, long argc, t_atom *argv){
 
 void circ_clw(t_mx_permute *x, t_atom_long output[], long shift){
     t_atom argv[x->pat_len];
-
+    
     for(int j=0;j<shift;j++){
         t_atom_long temp = output[0];
         t_atom_long temparray[x->pat_len];
-        
+    
         for(int i=0;i<x->pat_len;i++){
             temparray[i] = output[i];
         }
-        
+    
         for(int i=0;i<x->pat_len-1;i++){
             output[i] = temparray[i+1];
         }
-        
+    
         output[x->pat_len-1] = temp;
     }
     
@@ -263,6 +892,7 @@ void circ_clw(t_mx_permute *x, t_atom_long output[], long shift){
     }
     
     outlet_anything(x->pat_out, gensym("pat"), x->pat_len, argv);
+    mx_stats_sent(&x->stats, 1);
 }
 
 void circ_aclw(t_mx_permute *x, t_atom_long output[], long shift){
@@ -271,15 +901,15 @@ void circ_aclw(t_mx_permute *x, t_atom_long output[], long shift){
     for(int j=0;j<shift;j++){
         t_atom_long temp = output[x->pat_len-1];
         long temparray[x->pat_len];
-        
+    
         for(int i=0;i<x->pat_len;i++){
             temparray[i] = output[i];
         }
-        
+    
         for(int i=0;i<x->pat_len-1;i++){
             output[i+1] = temparray[i];
         }
-        
+    
         output[0] = temp;
     }
     
@@ -288,6 +918,7 @@ void circ_aclw(t_mx_permute *x, t_atom_long output[], long shift){
     }
     
     outlet_anything(x->pat_out, gensym("pat"), x->pat_len, argv);
+    mx_stats_sent(&x->stats, 1);
 }
 
 
@@ -349,14 +980,18 @@ void mx_permute_recall(t_mx_permute *x, long a){
     a--;
     if(a==x->unq_perm-1){
         outlet_bang(x->bang_out);
+        mx_stats_sent(&x->stats, 1);
     }
     
     t_atom argv[x->pat_len];
+    critical_enter(x->lock);
     for(int i=0;i<x->pat_len;i++){
         atom_setlong(argv+i, x->permutations[a][i]);
     }
+    critical_exit(x->lock);
     outlet_anything(x->pat_out, gensym("pat"), x->pat_len, argv);
-
+    mx_stats_sent(&x->stats, 1);
+    
     mx_permute_recallbin(x, a);
 }
 
@@ -368,81 +1003,36 @@ void mx_permute_recallbin(t_mx_permute *x, long a){
     
     a = CLAMP(a, 0, x->unq_perm-1);
     
-    long pat_sum = 0;
-
-    for(int i=0;i<x->pat_len;i++){
-        pat_sum += x->permutations[a][i];
-    }
+    long pat_sum = mx_core_pat_length(x->permutations[a], x->pat_len);
     
     if(x->permutations[a][0] == 0 && x->pat_len==1){
         t_atom argv[1];
         atom_setlong(argv, 0);
         outlet_anything(x->patbin_out, gensym("patbin"), 1, argv);
+        mx_stats_sent(&x->stats, 1);
         return;
     }
     
-    t_ptr patbin = sysmem_newptrclear(pat_sum * sizeof(t_ptr));
-    
-    int other = 0;
-    
-    for(int i=0;i<x->pat_len;i++){
-        patbin[other] = 1;
-        other+=x->permutations[a][i];
-    }
-    
+    t_atom_long patbin[pat_sum];
     t_atom argv[pat_sum];
+    
+    memset(patbin, 0, pat_sum * sizeof(t_atom_long));
+    mx_core_pattobin(x->permutations[a], x->pat_len, patbin);
     for(int i=0;i<pat_sum;i++){
         atom_setlong(argv+i, patbin[i]);
     }
     
     outlet_anything(x->patbin_out, gensym("patbin"), pat_sum, argv);
-    sysmem_freeptr(patbin);
+    mx_stats_sent(&x->stats, 1);
 }
 
-long factorial(long n){
-    if(n==0){
-        return 1;
-    }else{
-        return (n*factorial(n-1));
-    }
-}
-
-void swap(t_atom_long *dest, t_atom_long *src){
-    t_atom_long tmp = *src;
-    *src = *dest;
-    *dest = tmp;
-}
-
-int shouldSwap(t_atom_long *arr, t_atom_long start, t_atom_long curr){
-    for(t_atom_long i=start;i<curr;i++){
-        if(arr[i] == arr[curr]){
-            return 0;
-        }
-    }
-    return 1;
-}
-
-void findPermutations(t_atom_long *arr, t_atom_long index, t_atom_long n, t_atom_long **result, int *r_index){
-    if(index>=n){
-        memcpy(result[*r_index], arr, (size_t)n*sizeof(t_atom_long *));
-        
-        (*r_index)++;
-        return;
-    }
+int mx_permute_store(void *ctx, const mx_core_long *perm, long n){
+    //called by mx_core_permutations for each permutation in turn, stops once the job is superseded
+    t_mx_permute_fill *fill = (t_mx_permute_fill *)ctx;
     
-    for(t_atom_long i=index;i<n;i++){
-        int check = shouldSwap(arr, index, i);
-        if(check){
-            swap(&(arr[index]), &(arr[i]));
-            findPermutations(arr, index+1, n, result, r_index);
-            swap(&(arr[index]), &(arr[i]));
-        }
+    if(mx_permute_job_cancelled(fill->job)){
+        return 1;
     }
-}
-
-void augment_entry(t_hashtab *t, long key){
-    t_atom_long val;
-    hashtab_lookuplong(t, (t_symbol *)key, &val);
-    val++;
-    hashtab_storelong(t, (t_symbol *)key, val);
+    memcpy(fill->job->permutations[fill->r_index++], perm, (size_t)n*sizeof(t_atom_long));
+    return 0;
 }
@@ -17,6 +17,30 @@
 
 #include "ext.h"
 #include "ext_obex.h"
+#include "ext_systhread.h"
+#include "ext_critical.h"
+#include "ext_atomic.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+#include "../common/mx_worker.h"
+
+//one group request: the parsed groups and the permutations computed from them
+typedef struct _mx_permute_groups_job {
+    t_mx_worker *worker;        //for @async, the job is cancelled when its id isn't the newest
+    int32_t id;
+    t_atom_long group_amt;
+    t_atom_long **groups;
+    t_symbol **sym_groups;
+    t_symbol ***permutations;
+    t_atom_long unq_perm;
+    t_uint64 start;             //when the group message arrived, for @measure
+} t_mx_permute_groups_job;
+
+//where the permutations of a job go while they are found
+typedef struct _mx_permute_groups_fill {
+    t_mx_permute_groups_job *job;
+    long r_index;
+} t_mx_permute_groups_fill;
 
 typedef struct _mx_permute_groups {
     t_object p_ob;
@@ -30,26 +54,45 @@ typedef struct _mx_permute_groups {
     t_symbol ***permutations;
     t_atom_long unq_perm;
     t_bool circ_mode;
+    char async;
+    t_critical lock;
+    t_mx_worker *worker;        //@async jobs, see mx_worker.h
+    char coalesce;
+    t_qelem *pending_q;
+    t_critical pending_lock;
+    t_symbol *pending_s;        //latest group message, waiting for pending_q
+    long pending_argc;
+    long pending_size;
+    t_atom *pending_argv;
+    t_mx_stats stats;
 } t_mx_permute_groups;
 
 void *mx_permute_groups_new(t_symbol *s, long argc, t_atom *argv);
 void mx_permute_groups_free(t_mx_permute_groups *x);
 void mx_permute_groups_assist(t_mx_permute_groups *x, void *b, long m, long a, char *s);
 void mx_permute_groups_group(t_mx_permute_groups *x, t_symbol *s, long argc, t_atom *argv);
+void mx_permute_groups_coalesce(t_mx_permute_groups *x, t_symbol *s, long argc, t_atom *argv);
+void mx_permute_groups_coalesced(t_mx_permute_groups *x);
 void mx_permute_groups_recall(t_mx_permute_groups *x, long a);
 void mx_permute_groups_circular(t_mx_permute_groups *x, long shift);
 void mx_permute_groups_anticircular(t_mx_permute_groups *x, long shift);
 
+t_mx_permute_groups_job *mx_permute_groups_job_new(long argc, t_atom *argv);
+void mx_permute_groups_job_free(t_mx_permute_groups_job *job);
+void mx_permute_groups_job_run(t_mx_permute_groups_job *job);
+t_bool mx_permute_groups_job_cancelled(t_mx_permute_groups_job *job);
+void mx_permute_groups_install(t_mx_permute_groups *x, t_mx_permute_groups_job *job);
+void mx_permute_groups_async(t_mx_permute_groups *x, t_mx_permute_groups_job *job);
+void *mx_permute_groups_worker(t_mx_permute_groups_job *job);
+void mx_permute_groups_publish(t_mx_permute_groups *x);
+
 void circ_clw(t_mx_permute_groups *x, t_symbol **output, long shift);
 void circ_aclw(t_mx_permute_groups *x, t_symbol **array, long shift);
 
-void findPermutations(t_symbol **arr, t_atom_long index, t_atom_long n, t_symbol ***result, int *r_index);
-int shouldSwap(t_symbol **arr, t_atom_long start, t_atom_long curr);
-void swap(t_symbol **dest, t_symbol **src);
-void augment_entry(t_hashtab *t, t_symbol *key);
-long factorial(long n);
+int mx_permute_groups_store(void *ctx, const mx_core_long *perm, long n);
 
 void print(t_mx_permute_groups *x, t_symbol **s);
+void mx_permute_groups_stats_info(t_mx_permute_groups *x, long *bytes, long *length);
 
 t_class *mx_permute_groups_class;
 
@@ -58,16 +101,24 @@ void ext_main(void *r){
     
     c = class_new("mx-permute-groups", (method)mx_permute_groups_new, (method)mx_permute_groups_free, sizeof(t_mx_permute_groups), NULL, A_GIMME, 0);
     class_addmethod(c, (method)mx_permute_groups_assist, "assist", A_CANT, 0);
-    class_addmethod(c, (method)mx_permute_groups_group, "group", A_GIMME, 0);
+    class_addmethod(c, (method)mx_permute_groups_coalesce, "group", A_GIMME, 0);
     class_addmethod(c, (method)mx_permute_groups_recall, "recall", A_LONG, 0);
     class_addmethod(c, (method)mx_permute_groups_circular, "circular", A_LONG, 0);
     class_addmethod(c, (method)mx_permute_groups_anticircular, "anticircular", A_LONG, 0);
-
+    
     CLASS_ATTR_LONG(c, "circ_mode", 0, t_mx_permute_groups, circ_mode);
     CLASS_ATTR_ENUM(c, "circ_mode", 0, "forwards reverse");
     CLASS_ATTR_STYLE(c, "circ_mode", 0, "enumindex");
     CLASS_ATTR_FILTER_CLIP(c, "circ_mode", 0, 1);
     
+    CLASS_ATTR_CHAR(c, "async", 0, t_mx_permute_groups, async);
+    CLASS_ATTR_STYLE_LABEL(c, "async", 0, "onoff", "Compute permutations in the background");
+    
+    CLASS_ATTR_CHAR(c, "coalesce", 0, t_mx_permute_groups, coalesce);
+    CLASS_ATTR_STYLE_LABEL(c, "coalesce", 0, "onoff", "Coalesce group messages");
+    
+    MX_STATS_CLASS(c, t_mx_permute_groups, stats, mx_permute_groups_stats_info);
+    
     class_register(CLASS_BOX, c);
     mx_permute_groups_class = c;
 }
@@ -79,16 +130,40 @@ void *mx_permute_groups_new(t_symbol *s, long argc, t_atom *argv){
     x->int_out = outlet_new((t_object *)x, NULL);
     x->patbin_out = outlet_new((t_object *)x, NULL);
     x->pat_out = outlet_new((t_object *)x, NULL);
-
+    
     x->groups = NULL;
     x->sym_groups = NULL;
+    x->permutations = NULL;
+    x->group_amt = 0;
+    x->unq_perm = 0;
+    
+    x->async = 0;
+    x->worker = mx_worker_new((t_object *)x, (method)mx_permute_groups_publish, (mx_worker_free_fn)mx_permute_groups_job_free);
+    critical_new(&x->lock);
     
     x->circ_mode = 0;
-    attr_args_process(x, argc, argv);
+    x->coalesce = 0;
+    x->pending_q = qelem_new(x, (method)mx_permute_groups_coalesced);
+    critical_new(&x->pending_lock);
+    x->pending_s = NULL;
+    x->pending_argc = 0;
+    x->pending_size = 16;
+    x->pending_argv = (t_atom *)sysmem_newptrclear(x->pending_size * sizeof(t_atom));
+    mx_stats_init(&x->stats, (t_object *)x);
     
+    attr_args_process(x, argc, argv);
     return (x);
 }
 void mx_permute_groups_free(t_mx_permute_groups *x){
+    qelem_free(x->pending_q);
+    critical_free(x->pending_lock);
+    sysmem_freeptr(x->pending_argv);
+    
+    mx_worker_close(x->worker);
+    mx_stats_free(&x->stats);
+    
+    critical_free(x->lock);
+    
     if(x->groups){
         for(int i=0;i<x->group_amt;i++){
             sysmem_freeptr(x->groups[i]);
@@ -164,15 +239,15 @@ void mx_permute_groups_anticircular(t_mx_permute_groups *x, long shift){
          post("No pattern received yet.\n");
          return;
      }
-     
+    
      shift = abs((int)shift);
      t_symbol *output[x->group_amt];
-     
+    
      for(int i=1;i<x->group_amt;i++){
          output[i] = x->sym_groups[x->group_amt-i];
      }
      output[0] = x->sym_groups[0];
-     
+    
      switch(x->circ_mode){
          case 0:
              circ_clw(x, output, shift);
@@ -187,15 +262,15 @@ void circ_clw(t_mx_permute_groups *x, t_symbol **output, long shift){
     for(int j=0;j<shift;j++){
         t_symbol *temp = output[0];
         t_symbol *temparray[x->group_amt];
-        
+    
         for(int i=0;i<x->group_amt;i++){
             temparray[i] = output[i];
         }
-        
+    
         for(int i=0;i<x->group_amt-1;i++){
             output[i] = temparray[i+1];
         }
-        
+    
         output[x->group_amt-1] = temp;
     }
     
@@ -206,21 +281,55 @@ void circ_aclw(t_mx_permute_groups *x, t_symbol **output, long shift){
     for(int j=0;j<shift;j++){
         t_symbol *temp = output[x->group_amt-1];
         t_symbol *temparray[x->group_amt];
-        
+    
         for(int i=0;i<x->group_amt;i++){
             temparray[i] = output[i];
         }
-        
+    
         for(int i=0;i<x->group_amt-1;i++){
             output[i+1] = temparray[i];
         }
-        
+    
         output[0] = temp;
     }
-
+    
     print(x, output);
 }
 
+void mx_permute_groups_coalesce(t_mx_permute_groups *x, t_symbol *s, long argc, t_atom *argv){
+    if(!x->coalesce){
+        mx_permute_groups_group(x, s, argc, argv);
+        return;
+    }
+    //overwrite the pending message, only the latest one of a burst gets computed
+    critical_enter(x->pending_lock);
+    if(argc > x->pending_size){
+        x->pending_argv = (t_atom *)sysmem_resizeptr(x->pending_argv, argc * sizeof(t_atom));
+        x->pending_size = argc;
+    }
+    sysmem_copyptr(argv, x->pending_argv, argc * sizeof(t_atom));
+    x->pending_s = s;
+    x->pending_argc = argc;
+    critical_exit(x->pending_lock);
+    
+    qelem_set(x->pending_q);
+}
+
+void mx_permute_groups_coalesced(t_mx_permute_groups *x){
+    //copy the message out, so a new one may arrive while this one is computed
+    critical_enter(x->pending_lock);
+    t_symbol *s = x->pending_s;
+    long argc = x->pending_argc;
+    t_atom argv[argc?argc:1];
+    sysmem_copyptr(x->pending_argv, argv, argc * sizeof(t_atom));
+    x->pending_s = NULL;
+    critical_exit(x->pending_lock);
+    
+    if(s){
+        mx_permute_groups_group(x, s, argc, argv);
+    }
+}
+
 void mx_permute_groups_group(t_mx_permute_groups *x, t_symbol *s, long argc, t_atom *argv){
     if(argc==1){
         post("Bad group pattern.");
@@ -228,12 +337,24 @@ void mx_permute_groups_group(t_mx_permute_groups *x, t_symbol *s, long argc, t_a
         return;
     }
     
-    if(x->groups){
-        for(int i=0;i<x->group_amt;i++){
-            sysmem_freeptr(x->groups[i]);
-        }
-        sysmem_freeptr(x->groups);
+    t_mx_permute_groups_job *job = mx_permute_groups_job_new(argc, argv);
+    job->start = mx_stats_start(&x->stats);
+    
+    if(x->async){
+        mx_permute_groups_async(x, job);
+    }else{
+        mx_permute_groups_job_run(job);
+        mx_permute_groups_install(x, job);
     }
+}
+
+t_mx_permute_groups_job *mx_permute_groups_job_new(long argc, t_atom *argv){
+    t_mx_permute_groups_job *job = (t_mx_permute_groups_job *)sysmem_newptrclear(sizeof(t_mx_permute_groups_job));
+    job->worker = NULL;
+    job->id = 0;
+    job->permutations = NULL;
+    job->unq_perm = 0;
+    job->start = 0;
     
     //longs are  type 1, symbols are type 3
     //split by symbols to get groups
@@ -245,18 +366,18 @@ void mx_permute_groups_group(t_mx_permute_groups *x, t_symbol *s, long argc, t_a
             g_c++;
         }
     }
-    x->group_amt = g_c;
+    job->group_amt = g_c;
     
-    x->groups = (t_atom_long **)sysmem_newptrclear(x->group_amt * sizeof(t_atom_long *));
-    int group_sizes[x->group_amt];
+    job->groups = (t_atom_long **)sysmem_newptrclear(job->group_amt * sizeof(t_atom_long *));
+    int group_sizes[job->group_amt];
     g_c = 0;
-
+    
     //get amt of elements per group and allocate memory accordingly
     int ing_c = 0;  //amt. of elements per group
-
+    
     for(int i=1;i<=argc;i++){
-        if(atom_gettype(argv+i)==3 || i==argc){
-            x->groups[g_c] = (t_atom_long *)sysmem_newptrclear(ing_c * sizeof(t_atom_long));
+        if(i==argc || atom_gettype(argv+i)==3){
+            job->groups[g_c] = (t_atom_long *)sysmem_newptrclear(ing_c * sizeof(t_atom_long));
             group_sizes[g_c] = ing_c;
             ing_c = 0;
             g_c++;
@@ -272,77 +393,174 @@ void mx_permute_groups_group(t_mx_permute_groups *x, t_symbol *s, long argc, t_a
             ing_c = 0;
             g_c++;
         }else{
-            x->groups[g_c][ing_c++] = atom_getlong(argv+i);
+            job->groups[g_c][ing_c++] = atom_getlong(argv+i);
         }
     }
     
     ////////////////////////
     //turn array of ints into array of symbols (turn into func?)
     
-    if(x->sym_groups){
-        sysmem_freeptr(x->sym_groups);
-    }
-    x->sym_groups = (t_symbol **)sysmem_newptr(x->group_amt * sizeof(t_symbol *));
+    job->sym_groups = (t_symbol **)sysmem_newptr(job->group_amt * sizeof(t_symbol *));
     
-    for(int i=0;i<x->group_amt;i++){
+    for(int i=0;i<job->group_amt;i++){
         char s[100];
-        
+    
         for(int j=0;j<group_sizes[i]*2-1;j++){
             if(j%2 == 0){
-                sprintf(&s[j], "%lld", x->groups[i][j/2]);
+                sprintf(&s[j], "%lld", (long long)job->groups[i][j/2]);
             }else{
                 sprintf(&s[j], " ");
             }
         }
-        x->sym_groups[i] = gensym(s);
+        job->sym_groups[i] = gensym(s);
     }
     
-    ////////////////////////
-    //hash the symbols
-    
-    t_hashtab *tab = (t_hashtab *)hashtab_new(0);
-    long total_perm = factorial(x->group_amt);
+    return job;
+}
+
+void mx_permute_groups_job_free(t_mx_permute_groups_job *job){
+    if(job->groups){
+        for(int i=0;i<job->group_amt;i++){
+            sysmem_freeptr(job->groups[i]);
+        }
+        sysmem_freeptr(job->groups);
+    }
     
-    for(int i=0;i<x->group_amt;i++){
-        hashtab_storelong(tab, x->sym_groups[i], 0);
+    if(job->sym_groups){
+        sysmem_freeptr(job->sym_groups);
     }
     
-    for(int i=0;i<x->group_amt;i++){
-        t_symbol *current = x->sym_groups[i];
-        augment_entry(tab, current);
+    if(job->permutations){
+        for(int i=0;i<job->unq_perm;i++){
+            if(job->permutations[i]){
+                sysmem_freeptr(job->permutations[i]);
+            }
+        }
+        sysmem_freeptr(job->permutations);
     }
+    sysmem_freeptr(job);
+}
+
+t_bool mx_permute_groups_job_cancelled(t_mx_permute_groups_job *job){
+    //synchronous jobs have no request counter and can't be superseded
+    return mx_worker_cancelled(job->worker, job->id);
+}
+
+void mx_permute_groups_job_run(t_mx_permute_groups_job *job){
+    //heavy part of group, touches nothing but the job so it may run on any thread
     
     ////////////////////////
-    //calculate permutation amount
+    //number the groups, equal groups share the index of the first one
     
-    long unq_perm_div = 1;
+    t_atom_long ids[job->group_amt];
     
-    t_symbol    **keys = NULL;
-    long        numKeys = hashtab_getsize(tab);
-    t_atom_long vals[numKeys];
-    hashtab_getkeys(tab, &numKeys, &keys);
+    for(int i=0;i<job->group_amt;i++){
+        ids[i] = i;
+        for(int j=0;j<i;j++){
+            if(job->sym_groups[j] == job->sym_groups[i]){
+                ids[i] = j;
+                break;
+            }
+        }
+    }
     
-    for(int i=0;i<numKeys;i++){
-        hashtab_lookuplong(tab, keys[i], vals+i);
-        unq_perm_div *= factorial(vals[i]);
-    }    
+    ////////////////////////
+    //calculate permutation amount
+    
+    job->unq_perm = (t_atom_long)mx_core_permutations_count(ids, job->group_amt);
     
-    x->unq_perm = (long)total_perm/unq_perm_div;
-
     //a pointer to (array of) arrays of t_symbol-pointers..
-    x->permutations = (t_symbol ***)sysmem_newptrclear(x->unq_perm*sizeof(t_symbol **));
+    job->permutations = (t_symbol ***)sysmem_newptrclear(job->unq_perm*sizeof(t_symbol **));
     
-    for(int i=0;i<x->unq_perm;i++){
-        //x->permutations[i] = (t_symbol **)sysmem_newptrclear(argc*sizeof(t_symbol *));
-        x->permutations[i] = (t_symbol **)sysmem_newptrclear(x->group_amt*sizeof(t_symbol *));
+    for(int i=0;i<job->unq_perm;i++){
+        if(mx_permute_groups_job_cancelled(job)){
+            return;
+        }
+        job->permutations[i] = (t_symbol **)sysmem_newptrclear(job->group_amt*sizeof(t_symbol *));
     }
-
-    int r_index = 0;
     
-    findPermutations(x->sym_groups, 0, x->group_amt, x->permutations, &r_index);
+    t_mx_permute_groups_fill fill;
+    fill.job = job;
+    fill.r_index = 0;
+    mx_core_permutations(ids, job->group_amt, mx_permute_groups_store, &fill);
+}
 
+void mx_permute_groups_install(t_mx_permute_groups *x, t_mx_permute_groups_job *job){
+    //swap the finished result in as a whole, then output it
+    critical_enter(x->lock);
+    
+    t_mx_permute_groups_job old;
+    old.groups = x->groups;
+    old.group_amt = x->group_amt;
+    old.sym_groups = x->sym_groups;
+    old.permutations = x->permutations;
+    old.unq_perm = x->unq_perm;
+    
+    x->groups = job->groups;
+    x->group_amt = job->group_amt;
+    x->sym_groups = job->sym_groups;
+    x->permutations = job->permutations;
+    x->unq_perm = job->unq_perm;
+    
+    critical_exit(x->lock);
+    
+    //hand the old result to the job shell so it is freed in one go
+    job->groups = old.groups;
+    job->group_amt = old.group_amt;
+    job->sym_groups = old.sym_groups;
+    job->permutations = old.permutations;
+    job->unq_perm = old.unq_perm;
+    //with @async the generation takes from the group message to here
+    t_uint64 start = job->start;
+    mx_permute_groups_job_free(job);
+    
     outlet_int(x->int_out, x->unq_perm);
+    mx_stats_sent(&x->stats, 1);
     mx_permute_groups_recall(x, 0);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mx_permute_groups_stats_info(t_mx_permute_groups *x, long *bytes, long *length){
+    critical_enter(x->lock);
+    *bytes = sysmem_ptrsize(x->groups) + sysmem_ptrsize(x->sym_groups) + x->pending_size*sizeof(t_atom);
+    for(int i=0;x->groups && i<x->group_amt;i++){
+        *bytes += sysmem_ptrsize(x->groups[i]);
+    }
+    if(x->permutations){
+        *bytes += x->unq_perm * (x->group_amt*sizeof(t_symbol *) + sizeof(t_symbol **));
+    }
+    *length = x->group_amt;
+    critical_exit(x->lock);
+}
+
+void mx_permute_groups_async(t_mx_permute_groups *x, t_mx_permute_groups_job *job){
+    //a new request supersedes the one in flight, which bails out at its next check
+    job->worker = x->worker;
+    job->id = mx_worker_request(x->worker);
+    mx_worker_start(x->worker, (method)mx_permute_groups_worker, job);
+}
+
+void *mx_permute_groups_worker(t_mx_permute_groups_job *job){
+    t_uint64 start = mx_trace_start();
+    mx_permute_groups_job_run(job);
+    mx_worker_done(job->worker, job, mx_permute_groups_job_cancelled(job), start);
+    systhread_exit(0);
+    return NULL;
+}
+
+void mx_permute_groups_publish(t_mx_permute_groups *x){
+    //runs on the main thread
+    t_mx_permute_groups_job *job = (t_mx_permute_groups_job *)mx_worker_take(x->worker);
+    
+    if(!job){
+        return;
+    }
+    
+    if(mx_permute_groups_job_cancelled(job)){
+        mx_permute_groups_job_free(job);
+        return;
+    }
+    mx_permute_groups_install(x, job);
 }
 
 void mx_permute_groups_recall(t_mx_permute_groups *x, long a){
@@ -354,9 +572,15 @@ void mx_permute_groups_recall(t_mx_permute_groups *x, long a){
     a--;
     if(a==x->unq_perm-1){
         outlet_bang(x->bang_out);
+        mx_stats_sent(&x->stats, 1);
     }
     
-    print(x, x->permutations[a]);
+    t_symbol *output[x->group_amt];
+    critical_enter(x->lock);
+    memcpy(output, x->permutations[a], x->group_amt * sizeof(t_symbol *));
+    critical_exit(x->lock);
+    
+    print(x, output);
 }
 
 void print(t_mx_permute_groups *x, t_symbol **s){
@@ -376,7 +600,7 @@ void print(t_mx_permute_groups *x, t_symbol **s){
     
     for(int i=0;i<x->group_amt;i++){
         char *buff = s[i]->s_name;
-
+    
         //count elements in each group
         int j=0;
         int c=0;
@@ -388,7 +612,7 @@ void print(t_mx_permute_groups *x, t_symbol **s){
             }
         }
         long_array[i] = (t_atom_long *)sysmem_newptrclear(c * sizeof(t_atom_long));
-        
+    
         int k=0;
         for(j=0;j<c;j++){
             //this feels wrong, but don't have any other clue tbh
@@ -401,9 +625,10 @@ void print(t_mx_permute_groups *x, t_symbol **s){
             g_c++;
         }
     }
-
+    
     outlet_anything(x->pat_out, gensym("pat"), g_c, args);
-
+    mx_stats_sent(&x->stats, 1);
+    
     t_atom_long *patbin = (t_atom_long *)sysmem_newptrclear(pat_sum * sizeof(t_atom_long));
     
     int other = 0;
@@ -418,6 +643,7 @@ void print(t_mx_permute_groups *x, t_symbol **s){
     }
     
     outlet_anything(x->patbin_out, gensym("patbin"), pat_sum, argv);
+    mx_stats_sent(&x->stats, 1);
     sysmem_freeptr(patbin);
     
     for(int i=0;i<x->group_amt;i++){
@@ -428,51 +654,17 @@ void print(t_mx_permute_groups *x, t_symbol **s){
 
 /************************************************/
 
-long factorial(long n){
-    if(n==0){
+int mx_permute_groups_store(void *ctx, const mx_core_long *perm, long n){
+    //called by mx_core_permutations for each permutation of the group indices, stops once the job is superseded
+    t_mx_permute_groups_fill *fill = (t_mx_permute_groups_fill *)ctx;
+    t_symbol **row;
+    
+    if(mx_permute_groups_job_cancelled(fill->job)){
         return 1;
-    }else{
-        return (n*factorial(n-1));
-    }
-}
-
-void swap(t_symbol **dest, t_symbol **src){
-    t_symbol *tmp = *src;
-    *src = *dest;
-    *dest = tmp;
-}
-
-int shouldSwap(t_symbol **arr, t_atom_long start, t_atom_long curr){
-    for(t_atom_long i=start;i<curr;i++){
-        if(arr[i] == arr[curr]){
-            return 0;
-        }
     }
-    return 1;
-}
-
-void findPermutations(t_symbol **arr, t_atom_long index, t_atom_long n, t_symbol ***result, int *r_index){
-    if(index>=n){
-        
-        memcpy(result[*r_index], arr, (size_t)n*sizeof(t_symbol **));
-        
-        (*r_index)++;
-        return;
-    }
-    
-    for(t_atom_long i=index;i<n;i++){
-        int check = shouldSwap(arr, index, i);
-        if(check){
-            swap(&arr[index], &arr[i]);
-            findPermutations(arr, index+1, n, result, r_index);
-            swap(&(arr[index]), &(arr[i]));
-        }
+    row = fill->job->permutations[fill->r_index++];
+    for(long i=0;i<n;i++){
+        row[i] = fill->job->sym_groups[perm[i]];
     }
-}
-
-void augment_entry(t_hashtab *t, t_symbol *key){
-    t_atom_long val;
-    hashtab_lookuplong(t, key, &val);
-    val++;
-    hashtab_storelong(t, key, val);
+    return 0;
 }
@@ -17,6 +17,7 @@
 
 #include "ext.h"
 #include "ext_obex.h"
+#include "../common/mx_stats.h"
 
 typedef struct _mx_autogroup {
     t_object p_ob;
@@ -28,6 +29,7 @@ typedef struct _mx_autogroup {
     t_atom *output;
     t_atom_long group_size;
     t_atom_long grouper;
+    t_mx_stats stats;
 } t_mx_autogroup;
 
 void *mx_autogroup_new(t_symbol *s,  long argc, t_atom *argv);
@@ -37,6 +39,7 @@ void mx_autogroup_bang(t_mx_autogroup *x);
 void mx_autogroup_pat(t_mx_autogroup *x, t_symbol *s, long argc, t_atom *argv);
 void mx_autogroup_patbin(t_mx_autogroup *x, t_symbol *s, long argc, t_atom *argv);
 void mx_autogroup_groupby(t_mx_autogroup *x, long grouper);
+void mx_autogroup_stats_info(t_mx_autogroup *x, long *bytes, long *length);
 
 t_class *mx_autogroup_class;
 
@@ -50,13 +53,15 @@ void ext_main(void *r){
     class_addmethod(c, (method)mx_autogroup_patbin, "patbin", A_GIMME, 0);
     class_addmethod(c, (method)mx_autogroup_groupby, "groupby", A_LONG, 0);
     
+    MX_STATS_CLASS(c, t_mx_autogroup, stats, mx_autogroup_stats_info);
+    
     class_register(CLASS_BOX, c);
     mx_autogroup_class = c;
 }
 
 void *mx_autogroup_new(t_symbol *s, long argc, t_atom *argv){
     t_mx_autogroup *x = (t_mx_autogroup *)object_alloc(mx_autogroup_class);
-
+    
     x->umenu_out = outlet_new((t_object *)x, NULL);
     x->list_out = outlet_new((t_object *)x, NULL);
     x->group_out = outlet_new((t_object *)x, NULL);
@@ -66,17 +71,20 @@ void *mx_autogroup_new(t_symbol *s, long argc, t_atom *argv){
     x->pat_len = 1;
     x->pattern = NULL;
     x->output = NULL;
+    mx_stats_init(&x->stats, (t_object *)x);
     
+    attr_args_process(x, argc, argv);
     return (x);
 }
 
 void mx_autogroup_free(t_mx_autogroup *x){
+    mx_stats_free(&x->stats);
     if(x->pattern)
         sysmem_freeptr(x->pattern);
     
     if(x->output){
         sysmem_freeptr(x->output);
-        
+    
     }
 }
 
@@ -103,6 +111,7 @@ void mx_autogroup_assist(t_mx_autogroup *x, void *b, long m, long a, char *s){
 }
 
 void mx_autogroup_pat(t_mx_autogroup *x, t_symbol *s, long argc, t_atom *argv){
+    t_uint64 start = mx_stats_start(&x->stats);
     int sum = 0;
     x->pat_len = argc;
     
@@ -123,6 +132,7 @@ void mx_autogroup_pat(t_mx_autogroup *x, t_symbol *s, long argc, t_atom *argv){
     t_atom listout[sum];
     int loc = 0;
     outlet_anything(x->umenu_out, gensym("clear"), 0, NIL);
+    mx_stats_sent(&x->stats, 1);
     
     for(int i=2;i<sum;i++){
         if(sum % i == 0 && i >= max){
@@ -131,10 +141,13 @@ void mx_autogroup_pat(t_mx_autogroup *x, t_symbol *s, long argc, t_atom *argv){
             t_atom out[1];
             atom_setlong(out, i);
             outlet_anything(x->umenu_out, gensym("append"), 1, out);
+            mx_stats_sent(&x->stats, 1);
         }
     }
     
     outlet_list(x->list_out, NULL, loc, listout);
+    mx_stats_sent(&x->stats, 1);
+    mx_stats_gen(&x->stats, start);
 }
 
 void mx_autogroup_groupby(t_mx_autogroup *x, long grouper){
@@ -144,6 +157,7 @@ void mx_autogroup_groupby(t_mx_autogroup *x, long grouper){
         return;
     }
     
+    t_uint64 start = mx_stats_start(&x->stats);
     t_atom_long sum = 0, group_size = 0, group_amt = 0;
     if(x->output){
         sysmem_freeptr(x->output);
@@ -169,6 +183,13 @@ void mx_autogroup_groupby(t_mx_autogroup *x, long grouper){
     }
     x->group_size = group_size;
     outlet_anything(x->group_out, gensym("group"), group_size, x->output);
+    mx_stats_sent(&x->stats, 1);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mx_autogroup_stats_info(t_mx_autogroup *x, long *bytes, long *length){
+    *bytes = sysmem_ptrsize(x->pattern) + sysmem_ptrsize(x->output);
+    *length = x->pattern ? x->pat_len : 0;
 }
 
 void mx_autogroup_bang(t_mx_autogroup *x){
@@ -180,6 +201,7 @@ void mx_autogroup_bang(t_mx_autogroup *x){
         return;
     }else{
         outlet_anything(x->group_out, gensym("group"), x->group_size, x->output);
+        mx_stats_sent(&x->stats, 1);
     }
 }
 
@@ -190,7 +212,6 @@ void mx_autogroup_patbin(t_mx_autogroup *x, t_symbol *s, long argc, t_atom *argv
     }
     
     t_atom_long patbin[argc];
-    t_atom_long patbin_length = argc;
     
     for(int i=0;i<argc;i++){
         patbin[i] = atom_getlong(argv+i);
@@ -234,9 +255,9 @@ void mx_autogroup_patbin(t_mx_autogroup *x, t_symbol *s, long argc, t_atom *argv
         //rest functionality is disabled for now, because no other objects supports it, and there is no time
         //to implement proper functionality. maybe for later release..
         /*
-         char buffer[4];
+         char buffer[16];
          t_atom pat[beatcount+1];
-         snprintf(buffer, 4, "r%d", rest);
+         snprintf(buffer, sizeof(buffer), "r%d", rest);
          atom_setsym(pat, gensym(buffer));
          for(int i=1;i<beatcount+1;i++){
          atom_setlong(pat+i, result[i-1]);
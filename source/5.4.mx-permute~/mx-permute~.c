@@ -0,0 +1,567 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ext.h"
+#include "z_dsp.h"
+#include "ext_obex.h"
+#include "ext_atomic.h"
+#include <stdarg.h>
+#include "../common/mx_stats.h"
+#include "../common/mx_events.h"
+#include "../common/mx_clock.h"
+
+//signal outlets (pat, cd, cp, stepnr, permutation index)
+#define PAT_OUT 0
+#define CD_OUT 1
+#define CP_OUT 2
+#define STP_OUT 3
+#define IDX_OUT 4
+
+//longest pattern, the number of arrangements still fits in 64 bits
+#define MX_PERMUTE_MAX 20
+
+//states of the pending pattern handed from pat to perform
+#define PENDING_EMPTY 0
+#define PENDING_WRITING 1
+#define PENDING_READY 2
+#define PENDING_READING 3
+
+typedef struct _schillinger{
+    t_atom_long pattern[MX_PERMUTE_MAX];    //arrangement currently playing
+    long pat_len;
+    long steps;         //sum of the pattern, the same for every arrangement
+    long elem;          //element of the pattern the counter is in
+    long elem_start;    //step that element starts on
+    t_uint64 index;     //lexicographic rank of the arrangement
+} t_schillinger;
+
+typedef struct _mx_permute_tilde {
+    t_pxobject p_ob;
+    int counter;
+    int step_prev;
+    t_schillinger t;
+    t_atom_long pending[MX_PERMUTE_MAX];
+    long pending_len;
+    t_uint64 pending_index;
+    t_int32_atomic pending_state;
+    void *msg_out;
+    void *onset_out;
+    char *out_names[2];
+    t_mx_stats stats;
+    t_mx_events events;
+    t_mx_clock_reader clock;
+} t_mx_permute_tilde;
+
+void *mx_permute_tilde_new(t_symbol *s,  long argc, t_atom *argv);
+void mx_permute_tilde_free(t_mx_permute_tilde *x);
+void mx_permute_tilde_assist(t_mx_permute_tilde *x, void *b, long m, long a, char *s);
+void mx_permute_tilde_bang(t_mx_permute_tilde *x);
+void mx_permute_tilde_pat(t_mx_permute_tilde *x, t_symbol *s, long argc, t_atom *argv);
+void mx_permute_tilde_print(t_mx_permute_tilde *x);
+void mx_permute_tilde_perform64(t_mx_permute_tilde *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam);
+void mx_permute_tilde_dsp64(t_mx_permute_tilde *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags);
+void mx_permute_tilde_perform_clock(t_mx_permute_tilde *x, t_mx_clock_event *clicks, long events, double **outs, long sampleframes);
+t_bool mx_permute_tilde_take_pending(t_mx_permute_tilde *x);
+void mx_permute_tilde_click(t_mx_permute_tilde *x);
+void mx_permute_tilde_reset(t_mx_permute_tilde *x);
+void mx_permute_tilde_seek(t_schillinger *p_s, long step);
+
+t_bool next_permutation(t_atom_long *a, long n);
+t_uint64 permutation_rank(t_atom_long *a, long n);
+void outlet_s(t_mx_permute_tilde *x, char *selector, int argc, char *msg, ...);
+void mx_outlet(t_mx_permute_tilde *x, char *pre, int a, int b, int c);
+void mx_permute_tilde_stats_info(t_mx_permute_tilde *x, long *bytes, long *length);
+
+t_class *mx_permute_tilde_class;
+
+void ext_main(void *r){
+    t_class *c;
+    
+    c = class_new("mx-permute~", (method)mx_permute_tilde_new, (method)mx_permute_tilde_free, sizeof(t_mx_permute_tilde), NULL, A_GIMME, 0);
+    class_addmethod(c, (method)mx_permute_tilde_dsp64, "dsp64", A_CANT, 0);
+    class_addmethod(c, (method)mx_permute_tilde_assist, "assist", A_CANT, 0);
+    class_addmethod(c, (method)mx_permute_tilde_bang, "bang", 0);
+    class_addmethod(c, (method)mx_permute_tilde_pat, "pat", A_GIMME, 0);
+    
+    class_dspinit(c);
+    
+    MX_STATS_CLASS(c, t_mx_permute_tilde, stats, mx_permute_tilde_stats_info);
+    MX_CLOCK_CLASS(c, t_mx_permute_tilde, clock);
+    
+    class_register(CLASS_BOX, c);
+    mx_permute_tilde_class = c;
+}
+
+void *mx_permute_tilde_new(t_symbol *s, long argc, t_atom *argv){
+    //allocate class
+    t_mx_permute_tilde *x = (t_mx_permute_tilde *)object_alloc(mx_permute_tilde_class);
+    
+    //onset outlet, the rightmost
+    x->onset_out = outlet_new((t_object *)x, NULL);
+    
+    //create one message outlet
+    x->msg_out = outlet_new((t_object *)x, NULL);
+    
+    //set up DSP, create signal inlets (3)
+    dsp_setup((t_pxobject *)x, 3);
+    //signal outlets (pat, cd, cp, stepnr, permutation index)
+    for(int i=0;i<5;i++){
+        outlet_new((t_object *)x, "signal");
+    }
+    
+    x->counter = 0;
+    x->step_prev = 0;
+    
+    x->out_names[0] = "r";
+    x->out_names[1] = "stp";
+    
+    t_schillinger *p_s = &x->t;
+    p_s->pat_len = 0;
+    p_s->steps = 0;
+    p_s->elem = 0;
+    p_s->elem_start = 0;
+    p_s->index = 0;
+    
+    x->pending_len = 0;
+    x->pending_index = 0;
+    x->pending_state = PENDING_EMPTY;
+    mx_stats_init(&x->stats, (t_object *)x);
+    mx_events_init(&x->events, x->msg_out, x->onset_out);
+    mx_clock_init(&x->clock);
+    
+    long ac = attr_args_offset(argc, argv);
+    attr_args_process(x, argc, argv);
+    
+    if(ac){
+        mx_permute_tilde_pat(x, NULL, ac, argv);
+    }
+    
+    return (x);
+}
+
+void mx_permute_tilde_free(t_mx_permute_tilde *x){
+    mx_stats_free(&x->stats);
+    mx_events_free(&x->events);
+    dsp_free((t_pxobject *)x);
+}
+
+void mx_permute_tilde_assist(t_mx_permute_tilde *x, void *b, long m, long a, char *s){
+    if(m == ASSIST_INLET){
+        switch(a){
+            case 0:
+                sprintf(s, "(signal) Click to advance one step | (pat) Pattern to permute");
+                break;
+            case 1:
+                sprintf(s, "(signal) Click to reset sequencer");
+                break;
+            case 2:
+                sprintf(s, "(signal) Step number to jump to");
+                break;
+        }
+    }else{
+        switch(a){
+            case 0:
+                sprintf(s, "Pattern");
+                break;
+            case 1:
+                sprintf(s, "Common denominator");
+                break;
+            case 2:
+                sprintf(s, "Common product");
+                break;
+            case 3:
+                sprintf(s, "Step number");
+                break;
+            case 4:
+                sprintf(s, "Permutation index");
+                break;
+            case 5:
+                sprintf(s, "To sequencer");
+                break;
+            case 6:
+                sprintf(s, "Onsets (onset <lane> <step>), on the scheduler");
+                break;
+        }
+    }
+}
+
+void mx_permute_tilde_bang(t_mx_permute_tilde *x){
+    if(x->pending_len){
+        mx_permute_tilde_print(x);
+    }else{
+        post("No pattern received yet!");
+    }
+}
+
+void mx_permute_tilde_pat(t_mx_permute_tilde *x, t_symbol *s, long argc, t_atom *argv){
+    if(!argc)
+        return;
+    
+    t_uint64 start = mx_stats_start(&x->stats);
+    if(argc > MX_PERMUTE_MAX){
+        post("Pattern too long, only the first %d elements are permuted.", MX_PERMUTE_MAX);
+        argc = MX_PERMUTE_MAX;
+    }
+    
+    t_atom_long pattern[MX_PERMUTE_MAX];
+    for(int i=0;i<argc;i++){
+        t_atom_long temp = atom_getlong(argv+i);
+        pattern[i] = (temp<1)?1:temp;
+    }
+    t_uint64 index = permutation_rank(pattern, argc);
+    
+    //claim the pending slot. perform only holds it for the few
+    //samples it takes to copy the pattern out, so this never spins long.
+    while(!ATOMIC_COMPARE_SWAP32(PENDING_EMPTY, PENDING_WRITING, &x->pending_state)
+          && !ATOMIC_COMPARE_SWAP32(PENDING_READY, PENDING_WRITING, &x->pending_state)){
+        ;
+    }
+    
+    for(int i=0;i<argc;i++){
+        x->pending[i] = pattern[i];
+    }
+    x->pending_len = argc;
+    x->pending_index = index;
+    x->pending_state = PENDING_READY;
+    
+    mx_permute_tilde_print(x);
+    mx_stats_gen(&x->stats, start);
+}
+
+void mx_permute_tilde_stats_info(t_mx_permute_tilde *x, long *bytes, long *length){
+    //the patterns live in the object itself
+    *bytes = sizeof(x->t.pattern) + sizeof(x->pending);
+    *length = x->t.steps;
+}
+
+void mx_permute_tilde_print(t_mx_permute_tilde *x){
+    //shows the pattern last received, perform switches to it on the next cycle
+    long steps = 0;
+    for(int i=0;i<x->pending_len;i++){
+        steps += x->pending[i];
+    }
+    
+    for(int i=0;i<2;i++){
+        outlet_s(x, x->out_names[i], 1, "clear");
+        outlet_s(x, x->out_names[i], 2, "rows", 1);
+        outlet_s(x, x->out_names[i], 2, "columns", (int)steps);
+    }
+    mx_events_refresh(&x->events);
+    
+    outlet_int(x->msg_out, 1);
+    outlet_int(x->msg_out, steps);
+    mx_stats_sent(&x->stats, 2);
+    
+    long onset = 0;
+    for(int i=0;i<x->pending_len;i++){
+        mx_outlet(x, "r", (int)onset, 0, 1);
+        onset += x->pending[i];
+    }
+}
+
+t_bool mx_permute_tilde_take_pending(t_mx_permute_tilde *x){
+    //audio thread: take over a new pattern if one is waiting, never blocks
+    if(!ATOMIC_COMPARE_SWAP32(PENDING_READY, PENDING_READING, &x->pending_state)){
+        return 0;
+    }
+    
+    t_schillinger *p_s = &x->t;
+    p_s->pat_len = x->pending_len;
+    p_s->steps = 0;
+    for(int i=0;i<p_s->pat_len;i++){
+        p_s->pattern[i] = x->pending[i];
+        p_s->steps += p_s->pattern[i];
+    }
+    p_s->index = x->pending_index;
+    p_s->elem = 0;
+    p_s->elem_start = 0;
+    
+    x->pending_state = PENDING_EMPTY;
+    return 1;
+}
+
+void mx_permute_tilde_click(t_mx_permute_tilde *x){
+    //one step on, at the end of a cycle to the next arrangement or to a new pattern
+    t_schillinger *p_s = &x->t;
+    x->counter++;
+    
+    if(x->counter >= p_s->steps){
+        x->counter = 0;
+        if(!mx_permute_tilde_take_pending(x)){
+            p_s->index = next_permutation(p_s->pattern, p_s->pat_len)?p_s->index+1:0;
+            p_s->elem = 0;
+            p_s->elem_start = 0;
+        }
+    }else if(x->counter >= p_s->elem_start + p_s->pattern[p_s->elem]){
+        p_s->elem_start += p_s->pattern[p_s->elem];
+        p_s->elem++;
+    }
+}
+
+void mx_permute_tilde_reset(t_mx_permute_tilde *x){
+    x->counter = 0;
+    x->t.elem = 0;
+    x->t.elem_start = 0;
+}
+
+void mx_permute_tilde_seek(t_schillinger *p_s, long step){
+    //find the element the step lies in
+    p_s->elem = 0;
+    p_s->elem_start = 0;
+    while(p_s->elem < p_s->pat_len-1 && p_s->elem_start + p_s->pattern[p_s->elem] <= step){
+        p_s->elem_start += p_s->pattern[p_s->elem];
+        p_s->elem++;
+    }
+}
+
+t_bool next_permutation(t_atom_long *a, long n){
+    //rearranges a into the lexicographically next permutation, in place.
+    //equal elements are never swapped, so every distinct arrangement comes up once.
+    //returns false and wraps around to ascending order after the last one.
+    long i = n-2;
+    while(i>=0 && a[i] >= a[i+1]){
+        i--;
+    }
+    
+    if(i>=0){
+        long j = n-1;
+        while(a[j] <= a[i]){
+            j--;
+        }
+        t_atom_long temp = a[i];
+        a[i] = a[j];
+        a[j] = temp;
+    }
+    
+    for(long l=i+1, r=n-1;l<r;l++, r--){
+        t_atom_long temp = a[l];
+        a[l] = a[r];
+        a[r] = temp;
+    }
+    
+    return i>=0;
+}
+
+t_uint64 permutation_rank(t_atom_long *a, long n){
+    //position of a among the distinct arrangements of its elements in lexicographic order
+    t_atom_long values[MX_PERMUTE_MAX];
+    long counts[MX_PERMUTE_MAX];
+    long distinct = 0;
+    
+    for(int i=0;i<n;i++){
+        int k = 0;
+        while(k<distinct && values[k] != a[i]){
+            k++;
+        }
+        if(k == distinct){
+            values[distinct] = a[i];
+            counts[distinct++] = 0;
+        }
+        counts[k]++;
+    }
+    
+    t_uint64 rank = 0;
+    for(int i=0;i<n;i++){
+        for(int k=0;k<distinct;k++){
+            if(values[k] >= a[i] || !counts[k]){
+                continue;
+            }
+            //arrangements of the remaining elements with values[k] in position i
+            counts[k]--;
+            t_uint64 perms = 1;
+            long placed = 0;
+            for(int m=0;m<distinct;m++){
+                for(int c=1;c<=counts[m];c++){
+                    perms = perms * ++placed / c;
+                }
+            }
+            rank += perms;
+            counts[k]++;
+        }
+    
+        for(int k=0;k<distinct;k++){
+            if(values[k] == a[i]){
+                counts[k]--;
+                break;
+            }
+        }
+    }
+    
+    return rank;
+}
+
+void mx_permute_tilde_perform64(t_mx_permute_tilde *x, t_object *dsp64, double **ins, long numins, double **outs, long numouts, long sampleframes, long flags, void *userparam){
+    t_double        *in1_p = ins[0];
+    t_double        *in2_p = ins[1];
+    t_double        *in3_p = ins[2];
+    t_double        *r_out = outs[PAT_OUT];
+    t_double        *cd_out = outs[CD_OUT];
+    t_double        *cp_out = outs[CP_OUT];
+    t_double        *stp_out = outs[STP_OUT];
+    t_double        *idx_out = outs[IDX_OUT];
+    long            n = sampleframes;
+    t_double        in1, in2, in3;
+    t_uint64        start = mx_stats_start(&x->stats);
+    
+    t_schillinger *p_s = &x->t;
+    
+    //nothing played yet, start right away with the first pattern
+    if(!p_s->steps && mx_permute_tilde_take_pending(x)){
+        x->counter = 0;
+    }
+    
+    if(!p_s->steps){
+        set_zero64(r_out, sampleframes);
+        set_zero64(cd_out, sampleframes);
+        set_zero64(cp_out, sampleframes);
+        set_zero64(stp_out, sampleframes);
+        set_zero64(idx_out, sampleframes);
+        mx_events_block(&x->events, sampleframes);
+        mx_stats_perform(&x->stats, start, sampleframes);
+        return;
+    }
+    
+    //clicks and resets from mx-clock~ instead of the inlets
+    t_mx_clock_event *clicks = NULL;
+    long events = mx_clock_read(&x->clock, sampleframes, &clicks);
+    if(events >= 0){
+        mx_permute_tilde_perform_clock(x, clicks, events, outs, sampleframes);
+        mx_events_block(&x->events, sampleframes);
+        mx_stats_perform(&x->stats, start, sampleframes);
+        return;
+    }
+    
+    while(n--){
+        in1 = *in1_p++;
+        in2 = *in2_p++;
+        in3 = *in3_p++;
+    
+        //detect click, increase on click
+        if(in1>0.){
+            mx_permute_tilde_click(x);
+        }
+    
+        //detect click, reset counter on click
+        if(in2>0.){
+            mx_permute_tilde_reset(x);
+        }
+    
+        //if new in3 is different than previous step, reset the counter to in3 (only on ONE frame!)
+        if(x->step_prev != in3 && in3 != 0){
+            x->counter = ((int)(in3-1)) % p_s->steps;
+            mx_permute_tilde_seek(p_s, x->counter);
+        }
+    
+        x->step_prev = in3;
+        *r_out++ = (x->counter == p_s->elem_start)?CLAMP(in1, -1, 1):0.;
+        if(in1>0. && x->counter == p_s->elem_start){
+            mx_events_onset(&x->events, 0, x->counter, sampleframes-n-1);
+        }
+        *cd_out++ = in1;
+    
+        //cp_out is 1 on one click, when x->counter is 0 and v is one
+        *cp_out++ = (!x->counter) && in1;
+        mx_events_step(&x->events, x->counter, sampleframes-n-1);
+        *stp_out++ = x->counter;
+        *idx_out++ = (t_double)p_s->index;
+    }
+    mx_events_block(&x->events, sampleframes);
+    mx_stats_perform(&x->stats, start, sampleframes);
+}
+
+void mx_permute_tilde_perform_clock(t_mx_permute_tilde *x, t_mx_clock_event *clicks, long events, double **outs, long sampleframes){
+    //clicks and resets from mx-clock~, stepped through one by one like those of the inlets:
+    //which arrangement plays depends on every cycle before, not just on the count. the
+    //outputs are 0 but on the clicks, step number and index hold in between
+    t_schillinger *p_s = &x->t;
+    t_double *r_out = outs[PAT_OUT];
+    t_double *cd_out = outs[CD_OUT];
+    t_double *cp_out = outs[CP_OUT];
+    t_double *stp_out = outs[STP_OUT];
+    t_double *idx_out = outs[IDX_OUT];
+    long from = 0;
+    
+    set_zero64(r_out, sampleframes);
+    set_zero64(cd_out, sampleframes);
+    set_zero64(cp_out, sampleframes);
+    
+    for(long i=0;i<events;i++){
+        t_mx_clock_event *e = clicks+i;
+        long o = e->offset;
+        for(long j=from;j<o;j++){
+            stp_out[j] = x->counter;
+            idx_out[j] = (t_double)p_s->index;
+        }
+        from = o;
+    
+        //a click, then a reset: the count is 0 after one
+        if(e->click > 0.){
+            mx_permute_tilde_click(x);
+        }
+        if(!e->count){
+            mx_permute_tilde_reset(x);
+        }
+        mx_events_step(&x->events, x->counter, o);
+        if(e->click <= 0.){
+            continue;
+        }
+    
+        if(x->counter == p_s->elem_start){
+            r_out[o] = CLAMP(e->click, -1, 1);
+            mx_events_onset(&x->events, 0, x->counter, o);
+        }
+        cd_out[o] = e->click;
+        cp_out[o] = !x->counter;
+    }
+    for(long j=from;j<sampleframes;j++){
+        stp_out[j] = x->counter;
+        idx_out[j] = (t_double)p_s->index;
+    }
+}
+
+void mx_permute_tilde_dsp64(t_mx_permute_tilde *x, t_object *dsp64, short *count, double samplerate, long maxvectorsize, long flags){
+    mx_stats_dsp(&x->stats, samplerate);
+    mx_events_dsp(&x->events, samplerate);
+    object_method(dsp64, gensym("dsp_add64"), x, mx_permute_tilde_perform64, 0, NULL);
+}
+
+void mx_outlet(t_mx_permute_tilde *x, char *pre, int a, int b, int c){
+    mx_stats_sent(&x->stats, 1);
+    t_atom argv[3];
+    atom_setlong(argv, a);
+    atom_setlong(argv+1, b);
+    atom_setlong(argv+2, c);
+    outlet_anything(x->msg_out, gensym(pre), 3, argv);
+}
+
+void outlet_s(t_mx_permute_tilde *x, char *selector, int argc, char *msg, ...){
+    mx_stats_sent(&x->stats, 1);
+    //the first symbol message counts as argc as well
+    t_atom argv[argc];
+    int temp;
+    va_list ap;
+    va_start(ap, msg);
+    atom_setsym(argv, gensym(msg));
+    
+    for(int i=1;i<argc;i++){
+        temp = va_arg(ap, int);
+        atom_setlong(argv+i, temp);
+    }
+    
+    outlet_anything(x->msg_out, gensym(selector), argc, argv);
+    va_end(ap);
+}
@@ -17,6 +17,13 @@
 
 #include "ext.h"
 #include "ext_obex.h"
+#include "ext_systhread.h"
+#include "ext_critical.h"
+#include "ext_atomic.h"
+#include "../common/mx_arena.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+#include "../common/mx_worker.h"
 
 typedef struct _schillinger{
     long p_len;
@@ -29,8 +36,17 @@ typedef struct _schillinger{
     t_atom_long *cube;
     t_atom_long *sync;
     t_atom_long *sync2;
+    t_mx_arena arena;   //holds all of the above
 } t_schillinger;
 
+//one pat request: input pattern and the products computed from it
+typedef struct _mx_cube_job {
+    t_mx_worker *worker;        //for @async, the job is cancelled when its id isn't the newest
+    int32_t id;
+    t_schillinger t;
+    t_uint64 start;             //when the pat message arrived, for @measure
+} t_mx_cube_job;
+
 typedef struct _mx_cube {
     t_object p_ob;
     t_schillinger t;
@@ -38,6 +54,12 @@ typedef struct _mx_cube {
     void *cube_out;
     void *sync_out;
     void *sync2_out;
+    char async;
+    t_critical lock;
+    t_mx_worker *worker;        //@async jobs, see mx_worker.h
+    t_mx_cube_job *spare;       //buffers of the result replaced last, reused by the next pat
+    t_mx_stats stats;
+    t_mx_arena out;             //atoms of the printed lists, main thread only
 } t_mx_cube;
 
 void *mx_cube_new(t_symbol *s,  long argc, t_atom *argv);
@@ -46,7 +68,17 @@ void mx_cube_pat(t_mx_cube *x,t_symbol *s, long argc, t_atom *argv);
 void mx_cube_assist(t_mx_cube *x, void *b, long m, long a, char *s);
 void mx_cube_bang(t_mx_cube *x);
 
+t_mx_cube_job *mx_cube_job_new(t_mx_cube *x, long argc, t_atom *argv);
+void mx_cube_job_free(t_mx_cube_job *job);
+void mx_cube_job_run(t_mx_cube_job *job);
+t_bool mx_cube_job_cancelled(t_mx_cube_job *job);
+void mx_cube_install(t_mx_cube *x, t_mx_cube_job *job);
+void mx_cube_async(t_mx_cube *x, t_mx_cube_job *job);
+void *mx_cube_worker(t_mx_cube_job *job);
+void mx_cube_publish(t_mx_cube *x);
+
 void print(t_mx_cube *x);
+void mx_cube_stats_info(t_mx_cube *x, long *bytes, long *length);
 
 t_class *mx_cube_class;
 
@@ -58,6 +90,11 @@ void ext_main(void *r){
     class_addmethod(c, (method)mx_cube_bang, "bang", 0);
     class_addmethod(c, (method)mx_cube_pat, "pat", A_GIMME, 0);
     
+    CLASS_ATTR_CHAR(c, "async", 0, t_mx_cube, async);
+    CLASS_ATTR_STYLE_LABEL(c, "async", 0, "onoff", "Compute patterns in the background");
+    
+    MX_STATS_CLASS(c, t_mx_cube, stats, mx_cube_stats_info);
+    
     class_register(CLASS_BOX, c);
     mx_cube_class = c;
 }
@@ -71,27 +108,38 @@ void *mx_cube_new(t_symbol *s, long argc, t_atom *argv){
     x->cube_out = outlet_new((t_object *)x, NULL);
     
     t_schillinger *p_s = &x->t;
-
+    
     p_s->polynom = NULL;
     p_s->square = NULL;
     p_s->cube = NULL;
     p_s->sync = NULL;
     p_s->sync2 = NULL;
+    mx_arena_init(&p_s->arena);
+    
+    x->async = 0;
+    x->spare = NULL;
+    x->worker = mx_worker_new((t_object *)x, (method)mx_cube_publish, (mx_worker_free_fn)mx_cube_job_free);
+    critical_new(&x->lock);
+    mx_arena_init(&x->out);
+    mx_stats_init(&x->stats, (t_object *)x);
+    
+    attr_args_process(x, argc, argv);
     return (x);
 }
 
 void mx_cube_free(t_mx_cube *x){
     t_schillinger *p_s = &x->t;
-    if(p_s->polynom)
-        sysmem_freeptr(p_s->polynom);
-    if(p_s->square)
-        sysmem_freeptr(p_s->square);
-    if(p_s->cube)
-        sysmem_freeptr(p_s->cube);
-    if(p_s->sync)
-        sysmem_freeptr(p_s->sync);
-    if(p_s->sync2)
-        sysmem_freeptr(p_s->sync2);
+    
+    mx_worker_close(x->worker);
+    mx_stats_free(&x->stats);
+    
+    if(x->spare){
+        mx_cube_job_free(x->spare);
+    }
+    critical_free(x->lock);
+    
+    mx_arena_free(&p_s->arena);
+    mx_arena_free(&x->out);
 }
 
 void mx_cube_assist(t_mx_cube *x, void *b, long m, long a, char *s){
@@ -131,7 +179,27 @@ void mx_cube_pat(t_mx_cube *x,t_symbol *s, long argc, t_atom *argv){
     if(!argc)   //no arguments, do nothing and exit
         return;
     
-    t_schillinger *p_s = &x->t;
+    t_mx_cube_job *job = mx_cube_job_new(x, argc, argv);
+    job->start = mx_stats_start(&x->stats);
+    
+    if(x->async){
+        mx_cube_async(x, job);
+    }else{
+        mx_cube_job_run(job);
+        mx_cube_install(x, job);
+    }
+}
+
+t_mx_cube_job *mx_cube_job_new(t_mx_cube *x, long argc, t_atom *argv){
+    //main thread only: takes over the buffers of the previous result if there is one
+    t_mx_cube_job *job = x->spare;
+    x->spare = NULL;
+    if(!job){
+        job = (t_mx_cube_job *)sysmem_newptrclear(sizeof(t_mx_cube_job));
+    }
+    t_schillinger *p_s = &job->t;
+    job->worker = NULL;
+    job->id = 0;
     
     p_s->p_len = argc;
     p_s->sq_len = pow(argc, 2);
@@ -139,79 +207,134 @@ void mx_cube_pat(t_mx_cube *x,t_symbol *s, long argc, t_atom *argv){
     p_s->s_len = pow(argc, 2);
     p_s->s2_len = argc;
     
-    if(p_s->cube)
-        sysmem_freeptr(p_s->cube);
-    p_s->cube = (t_atom_long *)sysmem_newptrclear(p_s->c_len * sizeof(t_atom_long));
-    
-    if(p_s->polynom)
-        sysmem_freeptr(p_s->polynom);
-    p_s->polynom = (t_atom_long *)sysmem_newptrclear(p_s->p_len * sizeof(t_atom_long));
+    //every array of the job in one cleared block, allocated only when it has to grow
+    mx_arena_reset(&p_s->arena, MX_ARENA_ALIGN(p_s->p_len * sizeof(t_atom_long))
+                   + MX_ARENA_ALIGN(p_s->sq_len * sizeof(t_atom_long))
+                   + MX_ARENA_ALIGN(p_s->c_len * sizeof(t_atom_long))
+                   + MX_ARENA_ALIGN(p_s->s_len * sizeof(t_atom_long))
+                   + MX_ARENA_ALIGN(p_s->s2_len * sizeof(t_atom_long)));
+    p_s->polynom = (t_atom_long *)mx_arena_take(&p_s->arena, p_s->p_len * sizeof(t_atom_long));
+    p_s->square = (t_atom_long *)mx_arena_take(&p_s->arena, p_s->sq_len * sizeof(t_atom_long));
+    p_s->cube = (t_atom_long *)mx_arena_take(&p_s->arena, p_s->c_len * sizeof(t_atom_long));
+    p_s->sync = (t_atom_long *)mx_arena_take(&p_s->arena, p_s->s_len * sizeof(t_atom_long));
+    p_s->sync2 = (t_atom_long *)mx_arena_take(&p_s->arena, p_s->s2_len * sizeof(t_atom_long));
     
-    if(p_s->square)
-        sysmem_freeptr(p_s->square);
-    p_s->square = (t_atom_long *)sysmem_newptrclear(p_s->sq_len * sizeof(t_atom_long));
-    
-    if(p_s->sync)
-        sysmem_freeptr(p_s->sync);
-    p_s->sync = (t_atom_long *)sysmem_newptrclear(p_s->s_len * sizeof(t_atom_long));
-    
-    if(p_s->sync2)
-        sysmem_freeptr(p_s->sync2);
-    p_s->sync2 = (t_atom_long *)sysmem_newptrclear(p_s->s2_len * sizeof(t_atom_long));
-   
-    long arg_sum = 0;
     for(int i=0;i<p_s->p_len;i++){
         p_s->polynom[i] = atom_getlong(argv+i);
-        arg_sum += p_s->polynom[i];
     }
-    
-    int resultcount=0;
-    long arg_square = arg_sum * arg_sum;
+    return job;
+}
 
-    for(int i=0;i<p_s->p_len;i++){
-        for(int j=0;j<p_s->p_len;j++){
-            p_s->square[resultcount++] = p_s->polynom[i] * p_s->polynom[j];
-        }
-        p_s->sync2[i] = arg_square * p_s->polynom[i];
-    }
+void mx_cube_job_free(t_mx_cube_job *job){
+    mx_arena_free(&job->t.arena);
+    sysmem_freeptr(job);
+}
 
-    for(int i=0;i<p_s->sq_len;i++){
-        p_s->sync[i] = arg_sum * p_s->square[i];
-    }
+t_bool mx_cube_job_cancelled(t_mx_cube_job *job){
+    //synchronous jobs have no request counter and can't be superseded
+    return mx_worker_cancelled(job->worker, job->id);
+}
+
+void mx_cube_job_run(t_mx_cube_job *job){
+    //heavy part of pat, touches nothing but the job so it may run on any thread
+    t_schillinger *p_s = &job->t;
     
-    resultcount = 0;
+    long arg_sum = mx_core_pat_length(p_s->polynom, p_s->p_len);
     
-    for(int i=0;i<p_s->p_len;i++){
-        for(int j=0;j<p_s->sq_len;j++){
-            p_s->cube[resultcount++] = p_s->polynom[i] * p_s->square[j];
+    mx_core_square(p_s->polynom, p_s->p_len, p_s->square);
+    mx_core_scale(p_s->polynom, p_s->p_len, arg_sum * arg_sum, p_s->sync2);
+    mx_core_scale(p_s->square, p_s->sq_len, arg_sum, p_s->sync);
+    
+    //a row at a time, so a newer pat can cut it short
+    for(long i=0;i<p_s->p_len;i++){
+        if(mx_cube_job_cancelled(job)){
+            return;
         }
+        mx_core_cube_rows(p_s->polynom, p_s->p_len, p_s->square, i, i+1, p_s->cube);
     }
+}
+
+void mx_cube_install(t_mx_cube *x, t_mx_cube_job *job){
+    //swap the finished result in as a whole, then output it
+    critical_enter(x->lock);
+    t_schillinger old = x->t;
+    x->t = job->t;
+    job->t = old;
+    critical_exit(x->lock);
     
+    //the replaced result becomes the buffers of the next pat
+    if(x->spare){
+        mx_cube_job_free(x->spare);
+    }
+    x->spare = job;
     print(x);
+    //with @async the generation takes from the pat message to here
+    mx_stats_gen(&x->stats, job->start);
+}
+
+void mx_cube_stats_info(t_mx_cube *x, long *bytes, long *length){
+    critical_enter(x->lock);
+    *bytes = x->t.arena.capacity + (x->spare ? x->spare->t.arena.capacity : 0);
+    *length = x->t.cube ? x->t.c_len : 0;
+    critical_exit(x->lock);
+}
+
+void mx_cube_async(t_mx_cube *x, t_mx_cube_job *job){
+    //a new request supersedes the one in flight, which bails out at its next check
+    job->worker = x->worker;
+    job->id = mx_worker_request(x->worker);
+    mx_worker_start(x->worker, (method)mx_cube_worker, job);
+}
+
+void *mx_cube_worker(t_mx_cube_job *job){
+    t_uint64 start = mx_trace_start();
+    mx_cube_job_run(job);
+    mx_worker_done(job->worker, job, mx_cube_job_cancelled(job), start);
+    systhread_exit(0);
+    return NULL;
+}
+
+void mx_cube_publish(t_mx_cube *x){
+    //runs on the main thread
+    t_mx_cube_job *job = (t_mx_cube_job *)mx_worker_take(x->worker);
+    
+    if(!job){
+        return;
+    }
+    
+    if(mx_cube_job_cancelled(job)){
+        mx_cube_job_free(job);
+        return;
+    }
+    mx_cube_install(x, job);
 }
 
 void print(t_mx_cube *x){
     t_schillinger *p_s = &x->t;
     
-    t_atom square[p_s->sq_len];
-    t_atom cube[p_s->c_len];
-    t_atom sync[p_s->sq_len];
-    t_atom sync2[p_s->p_len];
+    critical_enter(x->lock);
+    mx_arena_reset(&x->out, MX_ARENA_ALIGN(p_s->c_len * sizeof(t_atom))
+                   + MX_ARENA_ALIGN(p_s->s_len * sizeof(t_atom))
+                   + MX_ARENA_ALIGN(p_s->s2_len * sizeof(t_atom)));
+    t_atom *cube = (t_atom *)mx_arena_take(&x->out, p_s->c_len * sizeof(t_atom));
+    t_atom *sync = (t_atom *)mx_arena_take(&x->out, p_s->s_len * sizeof(t_atom));
+    t_atom *sync2 = (t_atom *)mx_arena_take(&x->out, p_s->s2_len * sizeof(t_atom));
     
     for(int i=0;i<p_s->c_len;i++){
         atom_setlong(cube+i, p_s->cube[i]);
     }
-
-    for(int i=0;i<p_s->sq_len;i++){
-        atom_setlong(square+i, p_s->square[i]);
+    
+    for(int i=0;i<p_s->s_len;i++){
         atom_setlong(sync+i, p_s->sync[i]);
     }
     
     for(int i=0;i<p_s->s2_len;i++){
         atom_setlong(sync2+i, p_s->sync2[i]);
     }
+    critical_exit(x->lock);
     
     outlet_anything(x->cube_out, gensym("pat"), p_s->c_len, cube);
     outlet_anything(x->sync_out, gensym("pat"), p_s->s_len, sync);
     outlet_anything(x->sync2_out, gensym("pat"), p_s->s2_len, sync2);
+    mx_stats_sent(&x->stats, 3);
 }
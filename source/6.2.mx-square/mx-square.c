@@ -17,6 +17,9 @@
 
 #include "ext.h"
 #include "ext_obex.h"
+#include "../common/mx_arena.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
 
 typedef struct _schillinger{
     long steps;
@@ -25,6 +28,7 @@ typedef struct _schillinger{
     t_atom_long *sync;
     long p_len;
     long arg_sum;
+    t_mx_arena arena;   //polynom, result and sync, kept across pat messages
 } t_schillinger;
 
 typedef struct _mx_square {
@@ -32,6 +36,8 @@ typedef struct _mx_square {
     t_schillinger t;
     void *pat_out;
     void *sync_out;
+    t_mx_stats stats;
+    t_mx_arena out;     //atoms of the two lists, kept across pat messages
 } t_mx_square;
 
 void *mx_square_new(t_symbol *s,  long argc, t_atom *argv);
@@ -41,6 +47,7 @@ void mx_square_assist(t_mx_square *x, void *b, long m, long a, char *s);
 void mx_square_bang(t_mx_square *x);
 
 void print(t_mx_square *x);
+void mx_square_stats_info(t_mx_square *x, long *bytes, long *length);
 
 t_class *mx_square_class;
 
@@ -52,6 +59,8 @@ void ext_main(void *r){
     class_addmethod(c, (method)mx_square_bang, "bang", 0);
     class_addmethod(c, (method)mx_square_pat, "pat", A_GIMME, 0);
     
+    MX_STATS_CLASS(c, t_mx_square, stats, mx_square_stats_info);
+    
     class_register(CLASS_BOX, c);
     mx_square_class = c;
 }
@@ -69,18 +78,19 @@ void *mx_square_new(t_symbol *s, long argc, t_atom *argv){
     p_s->polynom = NULL;
     p_s->sync = NULL;
     p_s->result = NULL;
+    mx_arena_init(&p_s->arena);
+    mx_arena_init(&x->out);
+    mx_stats_init(&x->stats, (t_object *)x);
+    
+    attr_args_process(x, argc, argv);
     return (x);
 }
 
 void mx_square_free(t_mx_square *x){
     t_schillinger *p_s = &x->t;
-    if(p_s->polynom)
-        sysmem_freeptr(p_s->polynom);
-    
-    if(p_s->sync)
-        sysmem_freeptr(p_s->sync);
-    if(p_s->result)
-        sysmem_freeptr(p_s->result);
+    mx_stats_free(&x->stats);
+    mx_arena_free(&p_s->arena);
+    mx_arena_free(&x->out);
 }
 
 void mx_square_assist(t_mx_square *x, void *b, long m, long a, char *s){
@@ -117,49 +127,44 @@ void mx_square_pat(t_mx_square *x,t_symbol *s, long argc, t_atom *argv){
     if(!argc)   //no arguments, do nothing and exit
         return;
     
+    t_uint64 start = mx_stats_start(&x->stats);
     t_schillinger *p_s = &x->t;
+    long power = 2;
+    long a_pow = pow(argc, power);
     
-    if(p_s->polynom)
-        sysmem_freeptr(p_s->polynom);
-    p_s->polynom = (t_atom_long *)sysmem_newptrclear(argc * sizeof(t_atom_long));
+    //polynom, result and sync in one cleared block, allocated only when it has to grow
+    mx_arena_reset(&p_s->arena, 2*MX_ARENA_ALIGN(argc * sizeof(t_atom_long)) + MX_ARENA_ALIGN(a_pow * sizeof(t_atom_long)));
+    p_s->polynom = (t_atom_long *)mx_arena_take(&p_s->arena, argc * sizeof(t_atom_long));
+    p_s->result = (t_atom_long *)mx_arena_take(&p_s->arena, a_pow * sizeof(t_atom_long));
+    p_s->sync = (t_atom_long *)mx_arena_take(&p_s->arena, argc * sizeof(t_atom_long));
     
-    p_s->arg_sum = 0;
     for(int i=0;i<argc;i++){
         p_s->polynom[i] = atom_getlong(argv+i);
-        p_s->arg_sum += p_s->polynom[i];
     }
-
-    long power = 2;
-    long a_pow = pow(argc, power);
+    p_s->arg_sum = mx_core_pat_length(p_s->polynom, argc);
+    
     p_s->steps = a_pow;
     p_s->p_len = argc;
     
-    if(p_s->result)
-        sysmem_freeptr(p_s->result);
-    p_s->result = (t_atom_long *)sysmem_newptrclear(p_s->steps * sizeof(t_atom_long));
-    
-    if(p_s->sync)
-        sysmem_freeptr(p_s->sync);
-    p_s->sync = (t_atom_long *)sysmem_newptrclear(argc * sizeof(t_atom_long));
-    
-    int resultcount=0;
-    for(int i=0;i<argc;i++){
-        for(int j=0;j<argc;j++){
-            p_s->result[resultcount++] = p_s->polynom[i] * p_s->polynom[j];
-        }
-        p_s->sync[i] = p_s->arg_sum * p_s->polynom[i];
-    }
+    mx_core_square(p_s->polynom, argc, p_s->result);
+    mx_core_scale(p_s->polynom, argc, p_s->arg_sum, p_s->sync);
     
     //PRINTING
     print(x);
+    mx_stats_gen(&x->stats, start);
+}
 
+void mx_square_stats_info(t_mx_square *x, long *bytes, long *length){
+    *bytes = x->t.arena.capacity;
+    *length = x->t.result ? x->t.steps : 0;
 }
 
 void print(t_mx_square *x){
     t_schillinger *p_s = &x->t;
     
-    t_atom result[p_s->steps];
-    t_atom sync[p_s->p_len];
+    mx_arena_reset(&x->out, MX_ARENA_ALIGN(p_s->steps * sizeof(t_atom)) + MX_ARENA_ALIGN(p_s->p_len * sizeof(t_atom)));
+    t_atom *result = (t_atom *)mx_arena_take(&x->out, p_s->steps * sizeof(t_atom));
+    t_atom *sync = (t_atom *)mx_arena_take(&x->out, p_s->p_len * sizeof(t_atom));
     
     for(int i=0;i<p_s->steps;i++){
         atom_setlong(result+i, p_s->result[i]);
@@ -170,4 +175,5 @@ void print(t_mx_square *x){
     
     outlet_anything(x->pat_out, gensym("pat"), p_s->steps, result);
     outlet_anything(x->sync_out, gensym("pat"), p_s->p_len, sync);
+    mx_stats_sent(&x->stats, 2);
 }
@@ -0,0 +1,616 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ext.h"
+#include "ext_obex.h"
+#include "../common/mxpl_max.h"
+#include "../common/mx_core.h"
+#include "../common/mx_stats.h"
+
+//range features, each with its own sorted index
+#define F_STEPS     0
+#define F_ONSETS    1
+#define F_GAP       2
+#define F_DENSITY   3
+#define MX_QUERY_FEATURES 4
+
+//intervals of 64 steps and more share the last posting list
+#define MX_QUERY_IOI 64
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//one entry of a sorted feature index
+typedef struct _mx_query_key{
+    double val;
+    long id;
+} t_mx_query_key;
+
+typedef struct _mx_query {
+    t_object p_ob;
+    void *pat_out;
+    void *patbin_out;
+    void *int_out;
+    char *bits;             //all patterns of the corpus back to back
+    long bits_len;
+    long bits_size;
+    long *start;            //first step of each pattern, count+1 entries
+    long count;
+    long size;
+    double *feat[MX_QUERY_FEATURES];
+    t_uint64 *ioi;          //interval set of each pattern, bit v-1 for an interval of v steps
+    long *table;            //id+1 of every pattern by hash, 0 for a free slot, to drop duplicates
+    long table_size;
+    t_mx_query_key *order[MX_QUERY_FEATURES];
+    t_uint64 *postings;     //MX_QUERY_IOI bitsets, one bit per pattern: has an interval of v steps
+    long words;             //length of one bitset
+    char dirty;             //corpus changed since the index was built
+    long *matches;          //result of the last query
+    long match_count;
+    t_mx_stats stats;
+} t_mx_query;
+
+void *mx_query_new(t_symbol *s,  long argc, t_atom *argv);
+void mx_query_free(t_mx_query *x);
+void mx_query_assist(t_mx_query *x, void *b, long m, long a, char *s);
+void mx_query_pat(t_mx_query *x, t_symbol *s, long argc, t_atom *argv);
+void mx_query_patbin(t_mx_query *x, t_symbol *s, long argc, t_atom *argv);
+void mx_query_read(t_mx_query *x, t_symbol *s);
+void mx_query_clear(t_mx_query *x);
+void mx_query_release(t_mx_query *x);
+void mx_query_query(t_mx_query *x, t_symbol *s, long argc, t_atom *argv);
+void mx_query_recall(t_mx_query *x, long n);
+void mx_query_bang(t_mx_query *x);
+
+void mx_query_add(t_mx_query *x, const char *bits, long steps);
+long mx_query_find(t_mx_query *x, const char *bits, long steps, t_uint64 hash);
+void mx_query_rehash(t_mx_query *x, long table_size);
+void mx_query_build(t_mx_query *x);
+void mx_query_range(t_mx_query *x, long feature, double lo, double hi, t_uint64 *cand);
+int key_compare(const void *a, const void *b);
+t_uint64 pattern_hash(const char *bits, long steps);
+long lowest_bit(t_uint64 bits);
+void mx_query_stats_info(t_mx_query *x, long *bytes, long *length);
+
+t_class *mx_query_class;
+
+void ext_main(void *r){
+    t_class *c;
+    
+    c = class_new("mx-query", (method)mx_query_new, (method)mx_query_free, sizeof(t_mx_query), NULL, A_GIMME, 0);
+    class_addmethod(c, (method)mx_query_assist, "assist", A_CANT, 0);
+    class_addmethod(c, (method)mx_query_bang, "bang", 0);
+    class_addmethod(c, (method)mx_query_pat, "pat", A_GIMME, 0);
+    class_addmethod(c, (method)mx_query_patbin, "patbin", A_GIMME, 0);
+    class_addmethod(c, (method)mx_query_read, "read", A_SYM, 0);
+    class_addmethod(c, (method)mx_query_clear, "clear", 0);
+    class_addmethod(c, (method)mx_query_query, "query", A_GIMME, 0);
+    class_addmethod(c, (method)mx_query_recall, "recall", A_LONG, 0);
+    
+    MX_STATS_CLASS(c, t_mx_query, stats, mx_query_stats_info);
+    
+    class_register(CLASS_BOX, c);
+    mx_query_class = c;
+}
+
+void *mx_query_new(t_symbol *s, long argc, t_atom *argv){
+    //allocate class
+    t_mx_query *x = (t_mx_query *)object_alloc(mx_query_class);
+    x->int_out = outlet_new((t_object *)x, NULL);
+    x->patbin_out = outlet_new((t_object *)x, NULL);
+    x->pat_out = outlet_new((t_object *)x, NULL);
+    
+    x->bits = NULL;
+    x->bits_len = 0;
+    x->bits_size = 0;
+    x->start = NULL;
+    x->count = 0;
+    x->size = 0;
+    x->ioi = NULL;
+    x->table = NULL;
+    x->table_size = 0;
+    x->postings = NULL;
+    x->words = 0;
+    x->dirty = 0;
+    x->matches = NULL;
+    x->match_count = 0;
+    
+    for(int i=0;i<MX_QUERY_FEATURES;i++){
+        x->feat[i] = NULL;
+        x->order[i] = NULL;
+    }
+    
+    mx_query_clear(x);
+    mx_stats_init(&x->stats, (t_object *)x);
+    
+    attr_args_process(x, argc, argv);
+    return (x);
+}
+
+void mx_query_free(t_mx_query *x){
+    mx_stats_free(&x->stats);
+    mx_query_release(x);
+}
+
+void mx_query_assist(t_mx_query *x, void *b, long m, long a, char *s){
+    if(m == ASSIST_INLET){
+        switch(a){
+            case 0:
+                sprintf(s, "(pat|patbin) Add to corpus | (read) Library | (query) Search");
+                break;
+        }
+    }else{
+        switch(a){
+            case 0:
+                sprintf(s, "(pat) Matching pattern");
+                break;
+            case 1:
+                sprintf(s, "(patbin) Matching pattern");
+                break;
+            case 2:
+                sprintf(s, "(int) Amount of matches");
+                break;
+        }
+    }
+}
+
+void mx_query_clear(t_mx_query *x){
+    //drops the corpus and sets up an empty one
+    mx_query_release(x);
+    
+    x->size = 64;
+    x->bits_size = 1024;
+    x->bits = (char *)sysmem_newptr(x->bits_size);
+    x->start = (long *)sysmem_newptrclear((x->size+1) * sizeof(long));
+    x->ioi = (t_uint64 *)sysmem_newptr(x->size * sizeof(t_uint64));
+    for(int i=0;i<MX_QUERY_FEATURES;i++){
+        x->feat[i] = (double *)sysmem_newptr(x->size * sizeof(double));
+    }
+    mx_query_rehash(x, 128);
+}
+
+void mx_query_release(t_mx_query *x){
+    sysmem_freeptr(x->bits);
+    sysmem_freeptr(x->start);
+    sysmem_freeptr(x->ioi);
+    sysmem_freeptr(x->table);
+    sysmem_freeptr(x->postings);
+    sysmem_freeptr(x->matches);
+    for(int i=0;i<MX_QUERY_FEATURES;i++){
+        sysmem_freeptr(x->feat[i]);
+        sysmem_freeptr(x->order[i]);
+        x->feat[i] = NULL;
+        x->order[i] = NULL;
+    }
+    x->bits = NULL;
+    x->start = NULL;
+    x->ioi = NULL;
+    x->table = NULL;
+    x->postings = NULL;
+    x->matches = NULL;
+    x->bits_len = 0;
+    x->bits_size = 0;
+    x->count = 0;
+    x->match_count = 0;
+    x->table_size = 0;
+    x->size = 0;
+    x->words = 0;
+    x->dirty = 1;
+}
+
+void mx_query_bang(t_mx_query *x){
+    post("mx-query: %ld patterns in corpus, %ld matches.", x->count, x->match_count);
+}
+
+void mx_query_pat(t_mx_query *x, t_symbol *s, long argc, t_atom *argv){
+    long steps = 0;
+    for(int i=0;i<argc;i++){
+        t_atom_long temp = atom_getlong(argv+i);
+        steps += (temp<1)?1:temp;
+    }
+    if(!steps){
+        return;
+    }
+    
+    char *bits = (char *)sysmem_newptrclear(steps);
+    long other = 0;
+    for(int i=0;i<argc;i++){
+        t_atom_long temp = atom_getlong(argv+i);
+        bits[other] = 1;
+        other += (temp<1)?1:temp;
+    }
+    mx_query_add(x, bits, steps);
+    sysmem_freeptr(bits);
+}
+
+void mx_query_patbin(t_mx_query *x, t_symbol *s, long argc, t_atom *argv){
+    if(!argc){
+        return;
+    }
+    
+    char *bits = (char *)sysmem_newptr(argc);
+    for(int i=0;i<argc;i++){
+        bits[i] = atom_getlong(argv+i) != 0;
+    }
+    mx_query_add(x, bits, argc);
+    sysmem_freeptr(bits);
+}
+
+void mx_query_read(t_mx_query *x, t_symbol *s){
+    //takes every lane and every permutation of a pattern library (mxpl-build) into the corpus
+    t_mxpl *lib = mxpl_open_sym(s);
+    if(!lib){
+        return;
+    }
+    
+    const t_mxpl_header *h = (const t_mxpl_header *)lib->base;
+    const t_mxpl_slot *slots = (const t_mxpl_slot *)(lib->base + sizeof(t_mxpl_header));
+    long before = x->count;
+    char *bits = NULL;
+    long bits_size = 0;
+    
+    for(uint32_t i=0;i<h->slots;i++){
+        const t_mxpl_slot *e = slots + i;
+        if(!e->kind || e->data + (uint64_t)e->lanes * e->steps * (e->kind==MXPL_PERMUTE?4:1) > lib->size){
+            continue;
+        }
+    
+        if(e->kind != MXPL_PERMUTE){
+            for(uint32_t j=0;j<e->lanes;j++){
+                mx_query_add(x, mxpl_lane(lib, e, j), e->steps);
+            }
+            continue;
+        }
+    
+        for(uint32_t j=0;j<e->lanes;j++){
+            const int32_t *perm = mxpl_permutation(lib, e, j);
+            long steps = 0;
+            for(uint32_t k=0;k<e->steps;k++){
+                steps += (perm[k]<1)?1:perm[k];
+            }
+            if(steps > bits_size){
+                sysmem_freeptr(bits);
+                bits_size = steps;
+                bits = (char *)sysmem_newptr(bits_size);
+            }
+            memset(bits, 0, steps);
+            long other = 0;
+            for(uint32_t k=0;k<e->steps;k++){
+                bits[other] = 1;
+                other += (perm[k]<1)?1:perm[k];
+            }
+            mx_query_add(x, bits, steps);
+        }
+    }
+    
+    sysmem_freeptr(bits);
+    mxpl_close(lib);
+    post("mx-query: %ld patterns read from %s, %ld in corpus.", x->count-before, s->s_name, x->count);
+}
+
+void mx_query_add(t_mx_query *x, const char *bits, long steps){
+    t_uint64 hash = pattern_hash(bits, steps);
+    if(mx_query_find(x, bits, steps, hash) >= 0){
+        return;
+    }
+    
+    //grow by doubling, a whole library goes in with few reallocations
+    if(x->count == x->size){
+        x->size *= 2;
+        x->start = (long *)sysmem_resizeptr(x->start, (x->size+1) * sizeof(long));
+        x->ioi = (t_uint64 *)sysmem_resizeptr(x->ioi, x->size * sizeof(t_uint64));
+        for(int i=0;i<MX_QUERY_FEATURES;i++){
+            x->feat[i] = (double *)sysmem_resizeptr(x->feat[i], x->size * sizeof(double));
+        }
+    }
+    if(x->bits_len + steps > x->bits_size){
+        while(x->bits_len + steps > x->bits_size){
+            x->bits_size *= 2;
+        }
+        x->bits = (char *)sysmem_resizeptr(x->bits, x->bits_size);
+    }
+    
+    long id = x->count++;
+    memcpy(x->bits + x->bits_len, bits, steps);
+    x->start[id] = x->bits_len;
+    x->bits_len += steps;
+    x->start[id+1] = x->bits_len;
+    
+    //features. intervals wrap around, the pattern is played as a cycle
+    long onsets = 0;
+    long first = -1;
+    long last = -1;
+    long gap = 0;
+    t_uint64 ioi = 0;
+    
+    for(int i=0;i<steps;i++){
+        if(!bits[i]){
+            continue;
+        }
+        if(last>=0){
+            long interval = i-last;
+            gap = MAX(gap, interval);
+            ioi |= (t_uint64)1 << (MIN(interval, MX_QUERY_IOI)-1);
+        }else{
+            first = i;
+        }
+        last = i;
+        onsets++;
+    }
+    if(onsets){
+        long interval = steps-last+first;
+        gap = MAX(gap, interval);
+        ioi |= (t_uint64)1 << (MIN(interval, MX_QUERY_IOI)-1);
+    }
+    
+    x->feat[F_STEPS][id] = steps;
+    x->feat[F_ONSETS][id] = onsets;
+    x->feat[F_GAP][id] = gap;
+    x->feat[F_DENSITY][id] = (double)onsets/steps;
+    x->ioi[id] = ioi;
+    x->dirty = 1;
+    
+    if(x->count*2 > x->table_size){
+        mx_query_rehash(x, x->table_size*2);
+    }else{
+        long slot = hash & (x->table_size-1);
+        while(x->table[slot]){
+            slot = (slot+1) & (x->table_size-1);
+        }
+        x->table[slot] = id+1;
+    }
+}
+
+long mx_query_find(t_mx_query *x, const char *bits, long steps, t_uint64 hash){
+    long slot = hash & (x->table_size-1);
+    while(x->table[slot]){
+        long id = x->table[slot]-1;
+        if(x->start[id+1]-x->start[id] == steps && !memcmp(x->bits + x->start[id], bits, steps)){
+            return id;
+        }
+        slot = (slot+1) & (x->table_size-1);
+    }
+    return -1;
+}
+
+void mx_query_rehash(t_mx_query *x, long table_size){
+    sysmem_freeptr(x->table);
+    x->table_size = table_size;
+    x->table = (long *)sysmem_newptrclear(table_size * sizeof(long));
+    
+    for(long id=0;id<x->count;id++){
+        long steps = x->start[id+1]-x->start[id];
+        long slot = pattern_hash(x->bits + x->start[id], steps) & (table_size-1);
+        while(x->table[slot]){
+            slot = (slot+1) & (table_size-1);
+        }
+        x->table[slot] = id+1;
+    }
+}
+
+void mx_query_build(t_mx_query *x){
+    //sorted keys for the range features, one bitset per interval for the set queries
+    for(int f=0;f<MX_QUERY_FEATURES;f++){
+        sysmem_freeptr(x->order[f]);
+        x->order[f] = (t_mx_query_key *)sysmem_newptr(MAX(x->count, 1) * sizeof(t_mx_query_key));
+        for(long id=0;id<x->count;id++){
+            x->order[f][id].val = x->feat[f][id];
+            x->order[f][id].id = id;
+        }
+        qsort(x->order[f], x->count, sizeof(t_mx_query_key), key_compare);
+    }
+    
+    x->words = (x->count+63)/64;
+    sysmem_freeptr(x->postings);
+    x->postings = (t_uint64 *)sysmem_newptrclear(MAX(MX_QUERY_IOI * x->words, 1) * sizeof(t_uint64));
+    for(long id=0;id<x->count;id++){
+        for(int v=0;v<MX_QUERY_IOI;v++){
+            if((x->ioi[id] >> v) & 1){
+                x->postings[v*x->words + (id>>6)] |= (t_uint64)1 << (id&63);
+            }
+        }
+    }
+    
+    sysmem_freeptr(x->matches);
+    x->matches = (long *)sysmem_newptr(MAX(x->count, 1) * sizeof(long));
+    x->match_count = 0;
+    x->dirty = 0;
+}
+
+void mx_query_range(t_mx_query *x, long feature, double lo, double hi, t_uint64 *cand){
+    //binary search for the first key >= lo, then keep the candidates up to hi
+    t_mx_query_key *keys = x->order[feature];
+    t_uint64 *in = (t_uint64 *)sysmem_newptrclear(MAX(x->words, 1) * sizeof(t_uint64));
+    long l = 0;
+    long h = x->count;
+    
+    while(l<h){
+        long mid = (l+h)/2;
+        if(keys[mid].val < lo){
+            l = mid+1;
+        }else{
+            h = mid;
+        }
+    }
+    for(long i=l;i<x->count && keys[i].val<=hi;i++){
+        in[keys[i].id>>6] |= (t_uint64)1 << (keys[i].id&63);
+    }
+    
+    for(long w=0;w<x->words;w++){
+        cand[w] &= in[w];
+    }
+    sysmem_freeptr(in);
+}
+
+void mx_query_query(t_mx_query *x, t_symbol *s, long argc, t_atom *argv){
+    //query [steps|onsets|gap|density <min> <max>] [has <interval>...] [only <interval>...]
+    //every clause narrows the result down further
+    if(!x->count){
+        post("query: corpus is empty.");
+        return;
+    }
+    t_uint64 start = mx_stats_start(&x->stats);
+    if(x->dirty){
+        mx_query_build(x);
+    }
+    
+    t_uint64 *cand = (t_uint64 *)sysmem_newptr(x->words * sizeof(t_uint64));
+    for(long w=0;w<x->words;w++){
+        cand[w] = ~(t_uint64)0;
+    }
+    if(x->count&63){
+        cand[x->words-1] = ((t_uint64)1 << (x->count&63)) - 1;
+    }
+    
+    t_symbol *features[MX_QUERY_FEATURES] = {gensym("steps"), gensym("onsets"), gensym("gap"), gensym("density")};
+    long i = 0;
+    while(i<argc){
+        t_symbol *clause = atom_getsym(argv+i++);
+        long f = 0;
+        while(f<MX_QUERY_FEATURES && features[f]!=clause){
+            f++;
+        }
+    
+        if(f<MX_QUERY_FEATURES){
+            if(i+2>argc || atom_gettype(argv+i)==A_SYM || atom_gettype(argv+i+1)==A_SYM){
+                post("query: %s expects a minimum and a maximum.", clause->s_name);
+                sysmem_freeptr(cand);
+                return;
+            }
+            mx_query_range(x, f, atom_getfloat(argv+i), atom_getfloat(argv+i+1), cand);
+            i += 2;
+        }else if(clause == gensym("has") || clause == gensym("only")){
+            t_uint64 set = 0;
+            while(i<argc && atom_gettype(argv+i)!=A_SYM){
+                long v = CLAMP(atom_getlong(argv+i), 1, MX_QUERY_IOI);
+                set |= (t_uint64)1 << (v-1);
+                i++;
+            }
+    
+            if(clause == gensym("has")){
+                for(int v=0;v<MX_QUERY_IOI;v++){
+                    if(!((set >> v) & 1)){
+                        continue;
+                    }
+                    t_uint64 *posting = x->postings + v*x->words;
+                    for(long w=0;w<x->words;w++){
+                        cand[w] &= posting[w];
+                    }
+                }
+            }else{
+                for(long w=0;w<x->words;w++){
+                    for(t_uint64 bits=cand[w];bits;bits&=bits-1){
+                        long id = w*64 + lowest_bit(bits);
+                        if(x->ioi[id] & ~set){
+                            cand[w] &= ~((t_uint64)1 << (id&63));
+                        }
+                    }
+                }
+            }
+        }else{
+            post("query: unknown clause %s.", clause->s_name);
+            sysmem_freeptr(cand);
+            return;
+        }
+    }
+    
+    x->match_count = 0;
+    for(long w=0;w<x->words;w++){
+        for(t_uint64 bits=cand[w];bits;bits&=bits-1){
+            x->matches[x->match_count++] = w*64 + lowest_bit(bits);
+        }
+    }
+    sysmem_freeptr(cand);
+    
+    outlet_int(x->int_out, x->match_count);
+    mx_stats_sent(&x->stats, 1);
+    if(x->match_count){
+        mx_query_recall(x, 1);
+    }
+    mx_stats_gen(&x->stats, start);
+}
+
+void mx_query_recall(t_mx_query *x, long n){
+    //outputs the nth match of the last query, counted from 1
+    if(!x->match_count){
+        post("No matches.");
+        return;
+    }
+    
+    long id = x->matches[CLAMP(n, 1, x->match_count)-1];
+    const char *bits = x->bits + x->start[id];
+    long steps = x->start[id+1]-x->start[id];
+    t_atom *argv = (t_atom *)sysmem_newptr(steps * sizeof(t_atom));
+    mx_core_long *pat = (mx_core_long *)sysmem_newptr(steps * sizeof(mx_core_long));
+    
+    //pat: the pattern as a cycle like in mx_query_add, a leading rest wraps around into the last interval
+    long onsets = mx_core_cycletopat(bits, steps, pat);
+    if(onsets){
+        for(long i=0;i<onsets;i++){
+            atom_setlong(argv+i, pat[i]);
+        }
+        outlet_anything(x->pat_out, gensym("pat"), onsets, argv);
+        mx_stats_sent(&x->stats, 1);
+    }
+    
+    for(int i=0;i<steps;i++){
+        atom_setlong(argv+i, bits[i]);
+    }
+    outlet_anything(x->patbin_out, gensym("patbin"), steps, argv);
+    mx_stats_sent(&x->stats, 1);
+    sysmem_freeptr(pat);
+    sysmem_freeptr(argv);
+}
+
+void mx_query_stats_info(t_mx_query *x, long *bytes, long *length){
+    *bytes = sysmem_ptrsize(x->bits) + sysmem_ptrsize(x->start) + sysmem_ptrsize(x->ioi) + sysmem_ptrsize(x->table)
+             + sysmem_ptrsize(x->postings) + sysmem_ptrsize(x->matches);
+    for(int i=0;i<MX_QUERY_FEATURES;i++){
+        *bytes += sysmem_ptrsize(x->feat[i]) + sysmem_ptrsize(x->order[i]);
+    }
+    //the steps of the whole corpus
+    *length = x->bits_len;
+}
+
+int key_compare(const void *a, const void *b){
+    const t_mx_query_key *ka = (const t_mx_query_key *)a;
+    const t_mx_query_key *kb = (const t_mx_query_key *)b;
+    if(ka->val != kb->val){
+        return (ka->val < kb->val)?-1:1;
+    }
+    return (ka->id < kb->id)?-1:(ka->id > kb->id);
+}
+
+t_uint64 pattern_hash(const char *bits, long steps){
+    //fnv-1a
+    t_uint64 h = 14695981039346656037ULL;
+    for(int i=0;i<steps;i++){
+        h = (h ^ (unsigned char)bits[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+long lowest_bit(t_uint64 bits){
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, bits);
+    return (long)i;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
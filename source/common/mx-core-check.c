@@ -0,0 +1,150 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//checks the algorithms of mx_core.h against patterns worked out by hand: the pattern
+//conversions, the generators and the permutations. prints one line per case and exits
+//with 1 if any of them failed. run by ctest, or on its own:
+//  cc -O2 -o mx-core-check mx-core-check.c && ./mx-core-check
+
+#include <stdio.h>
+#include "mx_core.h"
+
+#define MX_CHECK_MAX 32
+
+static long failed = 0;
+
+static void check(long ok, const char *what){
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+    failed += !ok;
+}
+
+static long same(const mx_core_long *a, const mx_core_long *b, long n){
+    for(long i=0;i<n;i++){
+        if(a[i] != b[i]){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static long lane_is(const char *lane, const char *bits){
+    //bits as "100110", one char per step
+    for(long i=0;bits[i];i++){
+        if(lane[i] != (bits[i]=='1')){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//PATTERNS
+
+typedef struct _pat_case{
+    const char *name;
+    long n;
+    mx_core_long pat[MX_CHECK_MAX];
+    long length;
+    mx_core_long bin[MX_CHECK_MAX];
+} t_pat_case;
+
+static const t_pat_case pat_cases[] = {
+    {"3 1 2",           3,  {3, 1, 2},          6,  {1, 0, 0, 1, 1, 0}},
+    {"1 1 1",           3,  {1, 1, 1},          3,  {1, 1, 1}},
+    {"2",               1,  {2},                2,  {1, 0}},
+    {"4 4 2 1 1",       5,  {4, 4, 2, 1, 1},    12, {1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 1}},
+    {"1 3 1 3",         4,  {1, 3, 1, 3},       8,  {1, 1, 0, 0, 1, 1, 0, 0}},
+    {"(empty)",         0,  {0},                0,  {0}},
+};
+
+static void check_patterns(void){
+    char what[128];
+    for(size_t c=0;c<sizeof(pat_cases)/sizeof(pat_cases[0]);c++){
+        const t_pat_case *pc = pat_cases + c;
+        long length = mx_core_pat_length(pc->pat, pc->n);
+        snprintf(what, sizeof(what), "mx_core_pat_length %s = %ld", pc->name, pc->length);
+        check(length == pc->length, what);
+    
+        mx_core_long bin[MX_CHECK_MAX] = {0};
+        mx_core_pattobin(pc->pat, pc->n, bin);
+        snprintf(what, sizeof(what), "mx_core_pattobin %s", pc->name);
+        check(same(bin, pc->bin, MX_CHECK_MAX), what);
+    
+        snprintf(what, sizeof(what), "mx_core_onsets of %s = %ld", pc->name, pc->n);
+        check(mx_core_onsets(bin, length) == pc->n, what);
+    
+        mx_core_long pat[MX_CHECK_MAX] = {0};
+        mx_core_bintopat(bin, length, pat);
+        snprintf(what, sizeof(what), "mx_core_bintopat of mx_core_pattobin %s", pc->name);
+        check(same(pat, pc->pat, pc->n), what);
+    }
+    
+    //a leading rest wraps around into the last interval
+    mx_core_long cycle[MX_CHECK_MAX] = {0};
+    const mx_core_long rest[2] = {2, 2}, rests[2] = {3, 2};
+    check(mx_core_cycletopat("\0\1\0\1", 4, cycle) == 2 && same(cycle, rest, 2), "mx_core_cycletopat 0 1 0 1 = 2 2");
+    check(mx_core_cycletopat("\0\1\0\0\1", 5, cycle) == 2 && same(cycle, rests, 2), "mx_core_cycletopat 0 1 0 0 1 = 3 2");
+    check(mx_core_cycletopat("\0\0\0", 3, cycle) == 0, "mx_core_cycletopat 0 0 0 = (empty)");
+}
+
+//GENERATORS
+
+static void check_generators(void){
+    char r[MX_CHECK_MAX] = {0}, a[MX_CHECK_MAX] = {0}, b[MX_CHECK_MAX] = {0};
+    check(mx_core_p1_steps(3, 2) == 6, "mx_core_p1_steps 3 2 = 6");
+    mx_core_p1(3, 2, r, a, b);
+    check(lane_is(r, "101110") && lane_is(a, "100100") && lane_is(b, "101010"), "mx_core_p1 3 2");
+    
+    char r2[MX_CHECK_MAX] = {0}, a2[MX_CHECK_MAX] = {0}, b0[MX_CHECK_MAX] = {0}, b1[MX_CHECK_MAX] = {0};
+    char *bs[2] = {b0, b1};
+    check(mx_core_b_amt(3, 2) == 2, "mx_core_b_amt 3 2 = 2");
+    check(mx_core_p2_steps(3, 2) == 9, "mx_core_p2_steps 3 2 = 9");
+    mx_core_p2(3, 2, r2, a2, bs);
+    check(lane_is(a2, "100100100") && lane_is(b0, "101010000") && lane_is(b1, "000101010")
+          && lane_is(r2, "101111110"), "mx_core_p2 3 2");
+    
+    check(mx_core_3g_steps(2, 3, 5) == 30, "mx_core_3g_steps 2 3 5 = 30");
+}
+
+//PERMUTATIONS
+
+static int count_perm(void *ctx, const mx_core_long *perm, long n){
+    (void)perm;
+    (void)n;
+    (*(long *)ctx)++;
+    return 0;
+}
+
+static void check_permutations(void){
+    mx_core_long distinct[4] = {1, 2, 3, 4};
+    mx_core_long repeated[4] = {1, 1, 2, 2};
+    mx_core_long before[4] = {1, 1, 2, 2};
+    long count = 0;
+    
+    check(mx_core_permutations_count(distinct, 4) == 24, "mx_core_permutations_count 1 2 3 4 = 24");
+    check(mx_core_permutations_count(repeated, 4) == 6, "mx_core_permutations_count 1 1 2 2 = 6");
+    
+    mx_core_permutations(repeated, 4, count_perm, &count);
+    check(count == 6, "mx_core_permutations 1 1 2 2 visits 6");
+    check(same(repeated, before, 4), "mx_core_permutations leaves the pattern as it was");
+}
+
+int main(void){
+    check_patterns();
+    check_generators();
+    check_permutations();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//reusable buffer for everything one result needs (all lanes of a gen, say).
+//mx_arena_reset makes room for the whole result and clears it in one go, the
+//parts are then handed out by mx_arena_take. the buffer only ever grows, by
+//doubling, so regenerating results of a similar size doesn't touch the heap.
+//mx_buffer_reserve does the same for a single array kept next to its capacity.
+
+#ifndef MX_ARENA_H
+#define MX_ARENA_H
+
+#include "ext.h"
+#include <string.h>
+
+//size of a part rounded up, so every part handed out stays aligned for any element type
+#define MX_ARENA_ALIGN(n) (((n)+7) & ~(long)7)
+
+typedef struct _mx_arena{
+    char *data;
+    long capacity;
+    long used;
+} t_mx_arena;
+
+static inline void mx_arena_init(t_mx_arena *arena){
+    arena->data = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
+
+static inline void mx_arena_reset(t_mx_arena *arena, long size){
+    //size is the sum of the MX_ARENA_ALIGNed parts about to be taken
+    size = MAX(size, 0);
+    if(size > arena->capacity){
+        long capacity = MAX(arena->capacity*2, MX_ARENA_ALIGN(size));
+        //old contents are about to be cleared anyway, no need to copy them over
+        if(arena->data){
+            sysmem_freeptr(arena->data);
+        }
+        arena->data = (char *)sysmem_newptr(capacity);
+        arena->capacity = capacity;
+    }
+    if(size){
+        memset(arena->data, 0, size);
+    }
+    arena->used = 0;
+}
+
+static inline void *mx_arena_take(t_mx_arena *arena, long size){
+    void *part = arena->data + arena->used;
+    arena->used += MX_ARENA_ALIGN(size);
+    return part;
+}
+
+static inline void *mx_buffer_reserve(void *buffer, long *capacity, long size){
+    //returns buffer, or a larger one if size bytes don't fit, with the first size bytes cleared
+    size = MAX(size, 0);
+    if(!buffer || size > *capacity){
+        long grown = MAX(*capacity*2, MX_ARENA_ALIGN(MAX(size, 1)));
+        if(buffer){
+            sysmem_freeptr(buffer);
+        }
+        buffer = sysmem_newptr(grown);
+        *capacity = grown;
+    }
+    if(size){
+        memset(buffer, 0, size);
+    }
+    return buffer;
+}
+
+static inline void mx_arena_free(t_mx_arena *arena){
+    if(arena->data){
+        sysmem_freeptr(arena->data);
+    }
+    mx_arena_init(arena);
+}
+
+#endif
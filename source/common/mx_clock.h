@@ -0,0 +1,188 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//shared clocks: mx-clock~ scans its click and reset signals once per vector and publishes
+//what happened in it, the clicks and resets with their sample and the clicks counted since
+//the last reset, under a name. sequencers with @clock set to that name read the vector from
+//there instead of their own click, reset and jump inlets: per click a modulo of the count,
+//nothing per sample but filling their outputs.
+//
+//a timeline is made the first time a name is used and kept for as long as max runs, it
+//hangs off a symbol like the trace rings so every external of the package finds the same.
+//it holds the last MX_CLOCK_BLOCKS vectors. a sequencer after mx-clock~ in the dsp chain
+//reads the vector it was just published, one before it the vector before, so it follows a
+//vector late. connecting mx-clock~'s outlet to the sequencers' click inlets puts them after.
+//while no mx-clock~ publishes under the name, the sequencers go by their inlets.
+//
+//for sequencers: MX_CLOCK_CLASS in ext_main for the clock attribute, mx_clock_init in new,
+//mx_clock_read at the start of the perform routine.
+
+#ifndef MX_CLOCK_H
+#define MX_CLOCK_H
+
+#include <stdio.h>
+#include "ext.h"
+#include "ext_obex.h"
+#include "ext_atomic.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MX_CLOCK_BARRIER() MemoryBarrier()
+#else
+#define MX_CLOCK_BARRIER() __sync_synchronize()
+#endif
+
+//raised whenever t_mx_clock changes, externals built against another layout don't share
+#define MX_CLOCK_VERSION 1
+#define MX_CLOCK_BLOCKS 4       //a power of two
+#define MX_CLOCK_EVENTS 4096    //per vector, the largest vector size
+
+typedef struct _mx_clock_event{
+    t_uint32 offset;            //in the vector
+    t_uint32 count;             //clicks since the last reset, with this one
+    double click;               //the click's value, 0 for a reset without one
+} t_mx_clock_event;
+
+typedef struct _mx_clock_block{
+    long frames;
+    long events;
+    t_mx_clock_event event[MX_CLOCK_EVENTS];
+} t_mx_clock_block;
+
+typedef struct _mx_clock{
+    long version;
+    t_symbol *name;
+    t_object *hub;              //the mx-clock~ publishing, NULL while there's none
+    t_int32_atomic serial;      //vectors published, moved on by the hub only
+    t_mx_clock_block blocks[MX_CLOCK_BLOCKS];
+} t_mx_clock;
+
+//what a sequencer keeps of the clock it reads
+typedef struct _mx_clock_reader{
+    t_symbol *name;
+    t_mx_clock *clock;
+    t_uint32 serial;            //the next vector to read
+} t_mx_clock_reader;
+
+static long mx_clock_offset = 0;
+
+static inline t_mx_clock *mx_clock_find(t_symbol *name){
+    //the timeline of a name, made on first use. main thread only
+    char shared[256];
+    snprintf(shared, sizeof(shared), "__mx_clock_%s", name->s_name);
+    t_symbol *s = gensym(shared);
+    if(!s->s_thing){
+        t_mx_clock *c = (t_mx_clock *)sysmem_newptrclear(sizeof(t_mx_clock));
+        c->version = MX_CLOCK_VERSION;
+        c->name = name;
+        s->s_thing = (t_object *)c;
+    }
+    t_mx_clock *c = (t_mx_clock *)s->s_thing;
+    return c->version == MX_CLOCK_VERSION ? c : NULL;
+}
+
+//HUB
+
+static inline long mx_clock_claim(t_mx_clock *c, t_object *hub){
+    //one hub per name, returns 0 if another one has it. main thread only
+    if(c->hub && c->hub != hub){
+        return 0;
+    }
+    c->hub = hub;
+    return 1;
+}
+
+static inline void mx_clock_release(t_mx_clock *c, t_object *hub){
+    if(c && c->hub == hub){
+        c->hub = NULL;
+    }
+}
+
+static inline t_mx_clock_block *mx_clock_block(t_mx_clock *c){
+    //the vector the hub writes next, read by none of the sequencers keeping up
+    return c->blocks + ((t_uint32)c->serial & (MX_CLOCK_BLOCKS-1));
+}
+
+static inline void mx_clock_publish(t_mx_clock *c){
+    //the vector is complete before the serial moves past it
+    MX_CLOCK_BARRIER();
+    c->serial = (t_int32)((t_uint32)c->serial + 1);
+}
+
+//SEQUENCERS
+
+static inline long mx_clock_read(t_mx_clock_reader *r, long frames, t_mx_clock_event **events){
+    //the events of this vector, -1 to go by the inlets instead
+    t_mx_clock *c = r->clock;
+    if(!c || !c->hub){
+        return -1;
+    }
+    t_uint32 serial = (t_uint32)c->serial;
+    if(serial - r->serial > MX_CLOCK_BLOCKS-1){
+        //attached just now or left behind: from the next vector the hub publishes on
+        r->serial = serial;
+    }
+    if(r->serial == serial){
+        //the hub hasn't run in this vector yet, or the sequencer is catching up with it
+        return 0;
+    }
+    MX_CLOCK_BARRIER();
+    t_mx_clock_block *b = c->blocks + (r->serial & (MX_CLOCK_BLOCKS-1));
+    if(b->frames != frames){
+        //another vector size, in a poly~ or a resampling patcher
+        return -1;
+    }
+    r->serial++;
+    *events = b->event;
+    return b->events;
+}
+
+static inline t_max_err mx_clock_set(t_object *x, void *attr, long argc, t_atom *argv){
+    t_mx_clock_reader *r = (t_mx_clock_reader *)((char *)x + mx_clock_offset);
+    t_symbol *name = argc && atom_gettype(argv) == A_SYM ? atom_getsym(argv) : gensym("");
+    t_mx_clock *c = NULL;
+    if(name != gensym("")){
+        c = mx_clock_find(name);
+        if(!c){
+            object_error(x, "clock: not available, the package's externals are of different versions");
+        }
+    }
+    //the perform routine sees no clock until the new one is set up
+    r->clock = NULL;
+    MX_CLOCK_BARRIER();
+    r->name = name;
+    r->serial = c ? (t_uint32)c->serial : 0;
+    MX_CLOCK_BARRIER();
+    r->clock = c;
+    return MAX_ERR_NONE;
+}
+
+static inline void mx_clock_class(t_class *c, long offset){
+    mx_clock_offset = offset;
+    class_addattr(c, attr_offset_new("clock", gensym("symbol"), 0, (method)0L, (method)mx_clock_set, offset + calcoffset(t_mx_clock_reader, name)));
+    CLASS_ATTR_LABEL(c, "clock", 0, "Follow the mx-clock~ of this name");
+}
+
+#define MX_CLOCK_CLASS(c, structname, member) mx_clock_class((c), calcoffset(structname, member))
+
+static inline void mx_clock_init(t_mx_clock_reader *r){
+    r->name = gensym("");
+    r->clock = NULL;
+    r->serial = 0;
+}
+
+#endif
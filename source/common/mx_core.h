@@ -0,0 +1,372 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//MX core: the algorithms of the package, free of the max api. the objects only
+//clamp their arguments, hand in their buffers and turn the results into messages,
+//so everything here builds and runs anywhere (see CMakeLists.txt in the package root).
+//
+//nothing in here allocates: lanes are `steps` bytes each and arrays are sized by
+//the caller with the *_steps/*_length helpers, lanes cleared beforehand.
+
+#ifndef MX_CORE_H
+#define MX_CORE_H
+
+#include <stdint.h>
+#include <string.h>
+
+//same width as t_atom_long, so arrays of either can be handed over as they are
+typedef intptr_t mx_core_long;
+
+//GENERATORS
+//lanes of the two generator objects: r, a and b_amt b lanes, b <= a
+
+static inline long mx_core_b_amt(long a, long b){
+    return a - b + 1;
+}
+
+static inline long mx_core_p1_steps(long a, long b){
+    return a*b;
+}
+
+static inline void mx_core_p1(long a, long b, char *r, char *ap, char *bp){
+    //a single b lane, b may be larger than a
+    long steps = a*b;
+    
+    for(long i=0;i<steps;i+=a){
+        ap[i] = 1;
+        r[i] = 1;
+    }
+    for(long i=0;i<steps;i+=b){
+        bp[i] = 1;
+        r[i] = 1;
+    }
+}
+
+static inline long mx_core_p2_steps(long a, long b){
+    (void)b;    //same arguments as the other *_steps
+    return a*a;
+}
+
+static inline void mx_core_p2(long a, long b, char *r, char *ap, char **bp){
+    long steps = a*a;
+    long steps_b = a*b;
+    long b_amt = mx_core_b_amt(a, b);
+    
+    for(long i=0;i<steps;i+=a){
+        ap[i] = 1;
+        r[i] = 1;
+    }
+    for(long i=0;i<steps_b;i+=b){
+        for(long j=0;j<b_amt;j++){
+            bp[j][i+j*a] = 1;
+            r[i+j*a] = 1;
+        }
+    }
+}
+
+static inline long mx_core_b_steps(long a, long b){
+    //squared group, a/b normal groups and one added note
+    long steps_aa = a*a;
+    long steps_abm = a*b*(a/b);
+    return (steps_aa + steps_abm) + (steps_aa - steps_abm);
+}
+
+static inline void mx_core_b(long a, long b, char *r, char *ap, char **bp){
+    long steps_aa = a*a;
+    long steps_ab = a*b;
+    long steps_groups = steps_aa + steps_ab*(a/b);
+    long steps = mx_core_b_steps(a, b);
+    long b_amt = mx_core_b_amt(a, b);
+    
+    //squared group
+    for(long i=0;i<steps_aa;i+=a){
+        ap[i] = 1;
+        r[i] = 1;
+    }
+    for(long i=0;i<steps_ab;i+=b){
+        for(long j=0;j<b_amt;j++){
+            bp[j][i+j*a] = 1;
+            r[i+j*a] = 1;
+        }
+    }
+    
+    //normal groups
+    for(long i=steps_aa;i<steps_groups;i+=a){
+        ap[i] = 1;
+        r[i] = 1;
+    }
+    for(long i=steps_aa;i<steps_groups;i+=b){
+        for(long j=0;j<b_amt;j++){
+            bp[j][i] = 1;
+        }
+        r[i] = 1;
+    }
+    
+    //last note, there is none when the groups fill the pattern (b divides a)
+    if(steps_groups < steps){
+        ap[steps_groups] = 1;
+        r[steps_groups] = 1;
+        for(long j=0;j<b_amt;j++){
+            bp[j][steps_groups] = 1;
+        }
+    }
+}
+
+static inline long mx_core_c_steps(long a, long b){
+    return a*a + a*b;
+}
+
+static inline void mx_core_c(long a, long b, char *r, char *ap, char **bp){
+    long steps_aa = a*a;
+    long steps_ab = a*b;
+    long steps = steps_aa + steps_ab;
+    long b_amt = mx_core_b_amt(a, b);
+    
+    //squared group
+    for(long i=0;i<steps;i+=a){
+        ap[i] = 1;
+        r[i] = 1;
+    }
+    for(long i=0;i<steps_ab;i+=b){
+        for(long j=0;j<b_amt;j++){
+            bp[j][i+j*a] = 1;
+            r[i+j*a] = 1;
+        }
+    }
+    
+    //normal groups
+    for(long i=steps_aa;i<steps;i+=b){
+        for(long j=0;j<b_amt;j++){
+            bp[j][i] = 1;
+        }
+        r[i] = 1;
+    }
+}
+
+static inline long mx_core_e_steps(long a, long b){
+    return a*a + a*b;
+}
+
+static inline void mx_core_e(long a, long b, char *r, char *ap, char **bp){
+    long steps_ab = a*b;
+    long steps = a*a + steps_ab;
+    long b_amt = mx_core_b_amt(a, b);
+    
+    //a runs through the normal group and the squared groups
+    for(long i=0;i<steps;i+=a){
+        ap[i] = 1;
+        r[i] = 1;
+    }
+    for(long i=0;i<steps_ab;i+=b){
+        //normal group
+        for(long j=0;j<b_amt;j++){
+            bp[j][i] = 1;
+        }
+        r[i] = 1;
+    
+        //squared groups
+        for(long j=0;j<b_amt;j++){
+            bp[j][i+j*a+steps_ab] = 1;
+            r[i+j*a+steps_ab] = 1;
+        }
+    }
+}
+
+//lanes of mx-3g: R1 A1 B1 C1 R2 A2 B2 C2
+
+static inline long mx_core_3g_steps(long a, long b, long c){
+    return a*b*c;
+}
+
+static inline void mx_core_3g(long a, long b, long c, char **lanes){
+    long steps = a*b*c;
+    long theme[3] = {a, b, c};
+    long counter[3] = {b*c, a*c, a*b};
+    
+    for(int k=0;k<3;k++){
+        //theme
+        for(long i=0;i<steps;i+=theme[k]){
+            lanes[1+k][i] = 1;
+            lanes[0][i] = 1;
+        }
+        //countertheme
+        for(long i=0;i<steps;i+=counter[k]){
+            lanes[5+k][i] = 1;
+            lanes[4][i] = 1;
+        }
+    }
+}
+
+//PERMUTATIONS
+//every distinct ordering of a pattern, in the order of the swap recursion below
+
+//called with each permutation, returns nonzero to stop
+typedef int (*mx_core_perm_fn)(void *ctx, const mx_core_long *perm, long n);
+
+static inline double mx_core_permutations_count(const mx_core_long *pat, long n){
+    //n! over the factorials of the repeated elements, as a double since it overflows early
+    double total = 1;
+    for(long i=1;i<=n;i++){
+        total *= i;
+    }
+    for(long i=0;i<n;i++){
+        long first = 1;
+        long count = 0;
+        for(long j=0;j<n;j++){
+            if(pat[j] == pat[i]){
+                first &= j>=i;
+                count++;
+            }
+        }
+        for(long k=2;first && k<=count;k++){
+            total /= k;
+        }
+    }
+    return total;
+}
+
+static inline int mx_core_should_swap(const mx_core_long *arr, long start, long curr){
+    for(long i=start;i<curr;i++){
+        if(arr[i] == arr[curr]){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static inline int mx_core_permute_from(mx_core_long *arr, long index, long n, mx_core_perm_fn fn, void *ctx){
+    if(index>=n){
+        return fn(ctx, arr, n);
+    }
+    
+    for(long i=index;i<n;i++){
+        if(mx_core_should_swap(arr, index, i)){
+            mx_core_long tmp = arr[index];
+            arr[index] = arr[i];
+            arr[i] = tmp;
+            int stop = mx_core_permute_from(arr, index+1, n, fn, ctx);
+            arr[i] = arr[index];
+            arr[index] = tmp;
+            if(stop){
+                return stop;
+            }
+        }
+    }
+    return 0;
+}
+
+static inline int mx_core_permutations(mx_core_long *arr, long n, mx_core_perm_fn fn, void *ctx){
+    //arr is permuted in place and back, returns what fn returned if it stopped early
+    return mx_core_permute_from(arr, 0, n, fn, ctx);
+}
+
+//PATTERNS
+//pat: durations between onsets, bin: one step per entry with 1 on every onset
+
+static inline long mx_core_pat_length(const mx_core_long *pat, long n){
+    long sum = 0;
+    for(long i=0;i<n;i++){
+        sum += (long)pat[i];
+    }
+    return sum;
+}
+
+static inline void mx_core_pattobin(const mx_core_long *pat, long n, mx_core_long *bin){
+    //bin has mx_core_pat_length steps, cleared
+    long step = 0;
+    for(long i=0;i<n;i++){
+        bin[step] = 1;
+        step += (long)pat[i];
+    }
+}
+
+static inline long mx_core_onsets(const mx_core_long *bin, long n){
+    long count = 0;
+    for(long i=0;i<n;i++){
+        count += (bin[i]==1);
+    }
+    return count;
+}
+
+static inline void mx_core_bintopat(const mx_core_long *bin, long n, mx_core_long *pat){
+    //interval from each onset to the next one, the last one runs to the end of bin
+    long counter = 0;
+    long last = 0;
+    for(long i=0;i<n;i++){
+        if(bin[i]==1){
+            if(counter){
+                pat[counter-1] = i-last;
+            }
+            last = i;
+            counter++;
+        }
+    }
+    if(counter){
+        pat[counter-1] = n-last;
+    }
+}
+
+static inline long mx_core_cycletopat(const char *lane, long n, mx_core_long *pat){
+    //lane read as a cycle: intervals start at the first onset and the last one wraps around to it,
+    //so they add up to n with a leading rest too. returns the number of intervals
+    long counter = 0;
+    long first = -1;
+    long last = -1;
+    for(long i=0;i<n;i++){
+        if(lane[i]){
+            if(last>=0){
+                pat[counter++] = i-last;
+            }else{
+                first = i;
+            }
+            last = i;
+        }
+    }
+    if(last>=0){
+        pat[counter++] = n-last+first;
+    }
+    return counter;
+}
+
+//PRODUCTS
+//square and cube of a pattern read as a polynomial, n*n and n*n*n elements
+
+static inline void mx_core_scale(const mx_core_long *src, long n, mx_core_long factor, mx_core_long *dst){
+    for(long i=0;i<n;i++){
+        dst[i] = factor * src[i];
+    }
+}
+
+static inline void mx_core_square(const mx_core_long *poly, long n, mx_core_long *square){
+    for(long i=0;i<n;i++){
+        for(long j=0;j<n;j++){
+            square[i*n+j] = poly[i] * poly[j];
+        }
+    }
+}
+
+static inline void mx_core_cube_rows(const mx_core_long *poly, long n, const mx_core_long *square, long first, long last, mx_core_long *cube){
+    //rows first to last-1 of the cube, one row per element of poly
+    long sq_len = n*n;
+    for(long i=first;i<last;i++){
+        for(long j=0;j<sq_len;j++){
+            cube[i*sq_len+j] = poly[i] * square[j];
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,237 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//events from a perform routine to the other threads: rings with one producer, the perform
+//routine, and one consumer that neither waits for the other. the producer only moves a
+//ring's head on, the consumer only its tail. a full ring drops the newest events.
+//
+//the sequencers push every step they move to, mx_events_block after each vector wakes a
+//qelem once, which then outputs the latest step as step <n>. the step visualiser no longer
+//has to poll the step signal, and steps shorter than its redraw aren't missed.
+//
+//they also push an onset for every lane that plays on a click. the clock mx_events_block
+//sets goes off at the onset's time, counted in samples from the start of the vector, where
+//the scheduler's time stands while the perform routine runs. it outputs onset <lane> <step>
+//on the scheduler, and sets itself for the next onset. with overdrive and the scheduler in
+//audio interrupt that's within the vector after the onset, with the onset's own time.
+//
+//mx_events_init in new once the outlets exist, mx_events_dsp in dsp64, mx_events_step and
+//mx_events_onset in the perform loop, mx_events_block on every way out of the perform
+//routine, mx_events_free in free and mx_events_refresh where the step visualiser is cleared.
+
+#ifndef MX_EVENTS_H
+#define MX_EVENTS_H
+
+#include "ext.h"
+#include "ext_atomic.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MX_EVENTS_BARRIER() MemoryBarrier()
+#else
+#define MX_EVENTS_BARRIER() __sync_synchronize()
+#endif
+
+#define MX_EVENTS_SIZE 512      //per ring, a power of two
+
+enum e_mx_event_kinds {
+    MX_EVENT_STEP = 0,
+    MX_EVENT_ONSET
+};
+
+typedef struct _mx_event{
+    long kind;
+    long lane;
+    long step;
+    t_uint64 sample;            //samples run by the perform routine before it
+} t_mx_event;
+
+typedef struct _mx_events_ring{
+    t_mx_event events[MX_EVENTS_SIZE];
+    t_int32_atomic head;        //events pushed, moved on by the producer only
+    t_int32_atomic tail;        //events taken, moved on by the consumer only
+} t_mx_events_ring;
+
+typedef struct _mx_events{
+    t_mx_events_ring steps;     //to the qelem
+    t_mx_events_ring onsets;    //to the clock
+    t_int32_atomic waking;      //the qelem is set and hasn't drained yet
+    t_int32_atomic timing;      //the clock is set and hasn't run out of onsets
+    t_int32_atomic dropped;
+    //the producer's
+    long step;                  //the last step pushed
+    t_uint64 sample;            //first sample of the vector running
+    double samplerate;
+    //the consumers'
+    t_qelem *q;
+    void *clock;
+    t_uint64 clock_sample;      //the sample the clock is set for, by whoever set it
+    void *outlet;
+    void *onset_outlet;
+} t_mx_events;
+
+//RINGS
+
+static inline void mx_events_push(t_mx_events *ev, t_mx_events_ring *r, long kind, long lane, long step, long offset){
+    t_uint32 head = (t_uint32)r->head;
+    if(head - (t_uint32)r->tail >= MX_EVENTS_SIZE){
+        ATOMIC_INCREMENT(&ev->dropped);
+        return;
+    }
+    t_mx_event *e = r->events + (head & (MX_EVENTS_SIZE-1));
+    e->kind = kind;
+    e->lane = lane;
+    e->step = step;
+    e->sample = ev->sample + offset;
+    //the event is complete before the head moves past it
+    MX_EVENTS_BARRIER();
+    r->head = (t_int32)(head + 1);
+}
+
+static inline t_mx_event *mx_events_peek(t_mx_events_ring *r){
+    //the oldest event, left in the ring until mx_events_take
+    t_uint32 tail = (t_uint32)r->tail;
+    if(tail == (t_uint32)r->head){
+        return NULL;
+    }
+    MX_EVENTS_BARRIER();
+    return r->events + (tail & (MX_EVENTS_SIZE-1));
+}
+
+static inline void mx_events_take(t_mx_events_ring *r){
+    //the event was read before the producer may write over it
+    MX_EVENTS_BARRIER();
+    r->tail = (t_int32)((t_uint32)r->tail + 1);
+}
+
+//PRODUCER
+
+static inline void mx_events_step(t_mx_events *ev, long step, long offset){
+    //a compare per sample, an event only when the step changed
+    if(step != ev->step){
+        ev->step = step;
+        mx_events_push(ev, &ev->steps, MX_EVENT_STEP, 0, step, offset);
+    }
+}
+
+static inline void mx_events_onset(t_mx_events *ev, long lane, long step, long offset){
+    //only called on clicks, a lane that doesn't play costs nothing
+    mx_events_push(ev, &ev->onsets, MX_EVENT_ONSET, lane, step, offset);
+}
+
+static inline void mx_events_schedule(t_mx_events *ev, t_uint64 now){
+    //the clock for the oldest onset, now is the sample the scheduler's time stands at. only
+    //called by whoever swapped timing from 0 to 1, or by the clock itself
+    t_mx_event *e = mx_events_peek(&ev->onsets);
+    double ms = e->sample > now && ev->samplerate > 0 ? (e->sample - now) * 1000. / ev->samplerate : 0;
+    ev->clock_sample = e->sample;
+    clock_fdelay(ev->clock, ms);
+}
+
+static inline void mx_events_block(t_mx_events *ev, long sampleframes){
+    //at most one qelem_set until the qelem ran
+    if(ev->steps.head != ev->steps.tail && ATOMIC_COMPARE_SWAP32(0, 1, &ev->waking)){
+        qelem_set(ev->q);
+    }
+    //and one clock_fdelay until the clock ran out of onsets
+    if(ev->onsets.head != ev->onsets.tail && ATOMIC_COMPARE_SWAP32(0, 1, &ev->timing)){
+        mx_events_schedule(ev, ev->sample);
+    }
+    ev->sample += sampleframes;
+}
+
+static inline void mx_events_refresh(t_mx_events *ev){
+    //after the visualiser was cleared the next vector pushes the step it's on again. not
+    //from the perform routine: at worst a step is pushed twice
+    ev->step = -1;
+}
+
+static inline void mx_events_dsp(t_mx_events *ev, double samplerate){
+    ev->samplerate = samplerate;
+}
+
+//CONSUMERS
+
+static inline void mx_events_drain(t_mx_events *ev){
+    //low priority: only the latest step goes out, the visualiser can't show more anyway
+    t_mx_event *e;
+    long step = -1;
+    //events pushed from here on set the qelem again
+    ATOMIC_COMPARE_SWAP32(1, 0, &ev->waking);
+    while((e = mx_events_peek(&ev->steps))){
+        step = e->step;
+        mx_events_take(&ev->steps);
+    }
+    if(step >= 0){
+        t_atom a;
+        atom_setlong(&a, step);
+        outlet_anything(ev->outlet, gensym("step"), 1, &a);
+    }
+}
+
+static inline void mx_events_tick(t_mx_events *ev){
+    //on the scheduler: the onsets due at the sample the clock was set for, then the clock
+    //for the next one
+    t_uint64 now = ev->clock_sample;
+    t_symbol *onset = gensym("onset");
+    for(;;){
+        t_mx_event *e;
+        while((e = mx_events_peek(&ev->onsets)) && e->sample <= now){
+            t_atom a[2];
+            atom_setlong(a, e->lane);
+            atom_setlong(a+1, e->step);
+            mx_events_take(&ev->onsets);
+            outlet_anything(ev->onset_outlet, onset, 2, a);
+        }
+        if(e){
+            mx_events_schedule(ev, now);
+            return;
+        }
+        //out of onsets, the perform routine sets the clock for the next. one pushed after
+        //the ring was found empty and before timing was 0 again is left to the clock
+        ATOMIC_COMPARE_SWAP32(1, 0, &ev->timing);
+        if(ev->onsets.head == ev->onsets.tail || !ATOMIC_COMPARE_SWAP32(0, 1, &ev->timing)){
+            return;
+        }
+    }
+}
+
+static inline void mx_events_init(t_mx_events *ev, void *outlet, void *onset_outlet){
+    ev->steps.head = 0;
+    ev->steps.tail = 0;
+    ev->onsets.head = 0;
+    ev->onsets.tail = 0;
+    ev->waking = 0;
+    ev->timing = 0;
+    ev->dropped = 0;
+    ev->step = -1;
+    ev->sample = 0;
+    ev->samplerate = 0;
+    ev->q = qelem_new(ev, (method)mx_events_drain);
+    ev->clock = clock_new(ev, (method)mx_events_tick);
+    ev->clock_sample = 0;
+    ev->outlet = outlet;
+    ev->onset_outlet = onset_outlet;
+}
+
+static inline void mx_events_free(t_mx_events *ev){
+    qelem_free(ev->q);
+    clock_unset(ev->clock);
+    object_free(ev->clock);
+}
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//patch cords per outlet. objects keep a count for each outlet, update it from their
+//patchlineupdate method and don't build any output for outlets without a cord.
+
+#ifndef MX_LINKS_H
+#define MX_LINKS_H
+
+#include "ext.h"
+#include "jpatcher_api.h"
+
+static inline void mx_links_update(long *links, long outlets, void *x, long updatetype, t_object *src, long srcout){
+    //patchlineupdate is sent for both ends of a cord, only the ones leaving x count
+    if(src != (t_object *)x || srcout<0 || srcout>=outlets){
+        return;
+    }
+    if(updatetype == JPATCHLINE_CONNECT){
+        links[srcout]++;
+    }else if(updatetype == JPATCHLINE_DISCONNECT && links[srcout]>0){
+        links[srcout]--;
+    }
+}
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//runtime statistics, kept by every object while @measure is on: the time its perform routine
+//takes per block, the time the last and the longest generation (gen, pat, ...) took and the
+//messages sent for the last one. the stats message posts them to the max window next to the
+//bytes and the pattern length the object reports itself, @statsinterval every so many ms.
+//
+//times are read from the cycle counter and converted to microseconds when posted, against
+//systimer_gettime over the same span. perform times are kept in a histogram with 4 buckets
+//per octave, so the percentiles are within 20%. the perform routine only writes, the
+//stats message only reads, neither waits for the other.
+//
+//every external has one class, so the struct's offset and the class' info function are
+//kept in statics here: MX_STATS_CLASS in ext_main, mx_stats_init in new (before
+//attr_args_process), mx_stats_free in free.
+//
+//the generations and perform routines timed here are also spans for the trace message
+//(mx_trace.h), which MX_STATS_CLASS adds as well. they are named after the function.
+
+#ifndef MX_STATS_H
+#define MX_STATS_H
+
+#include "ext.h"
+#include "ext_obex.h"
+#include "ext_systime.h"
+#include "mx_trace.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define MX_STATS_BUCKETS 160
+
+//bytes held by the patterns and the current pattern length, whatever the object counts as such
+typedef void (*mx_stats_info_fn)(t_object *x, long *bytes, long *length);
+
+typedef struct _mx_stats{
+    char on;
+    double interval;                //ms between posts, 0 for none
+    t_object *owner;
+    void *clock;
+    //perform, written on the audio thread
+    t_uint32 hist[MX_STATS_BUCKETS];
+    t_uint64 blocks;
+    t_uint64 perform_ticks;
+    t_uint64 perform_max;
+    long frames;                    //of the last block
+    double samplerate;
+    //generation, written where the object generates
+    t_uint64 gens;
+    t_uint64 gen_last;
+    t_uint64 gen_max;
+    long messages;                  //sent since the last generation ended
+    long gen_messages;              //sent for the last generation
+    //the span the ticks are converted over
+    t_uint64 since_ticks;
+    double since_ms;
+} t_mx_stats;
+
+static long mx_stats_offset = 0;
+static mx_stats_info_fn mx_stats_info = NULL;
+
+static inline long mx_stats_top_bit(t_uint64 ticks){
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse64(&i, ticks);
+    return (long)i;
+#else
+    return 63 - __builtin_clzll(ticks);
+#endif
+}
+
+static inline long mx_stats_bucket(t_uint64 ticks){
+    //4 buckets per octave: the octave and the two bits below its top bit
+    if(ticks < 4){
+        return (long)ticks;
+    }
+    long e = mx_stats_top_bit(ticks);
+    return MIN((e-1)*4 + (long)((ticks >> (e-2)) & 3), MX_STATS_BUCKETS-1);
+}
+
+static inline t_uint64 mx_stats_bucket_floor(long i){
+    return i < 4 ? (t_uint64)i : (t_uint64)(4 + i%4) << (i/4 - 1);
+}
+
+static inline t_mx_stats *mx_stats_of(t_object *x){
+    return (t_mx_stats *)((char *)x + mx_stats_offset);
+}
+
+static inline void mx_stats_reset(t_mx_stats *st){
+    memset(st->hist, 0, sizeof(st->hist));
+    st->blocks = 0;
+    st->perform_ticks = 0;
+    st->perform_max = 0;
+    st->gens = 0;
+    st->gen_last = 0;
+    st->gen_max = 0;
+    st->messages = 0;
+    st->gen_messages = 0;
+    st->since_ticks = mx_trace_ticks();
+    st->since_ms = systimer_gettime();
+}
+
+//TIMING
+//start returns 0 while neither @measure nor tracing is on, the matching call then records nothing
+
+static inline t_uint64 mx_stats_start(t_mx_stats *st){
+    return st->on || mx_trace_on() ? mx_trace_ticks() : 0;
+}
+
+static inline void mx_stats_perform_(t_mx_stats *st, t_uint64 start, long frames, const char *name){
+    if(!start){
+        return;
+    }
+    mx_trace_record(st->owner, name, "audio", start);
+    if(!st->on){
+        return;
+    }
+    t_uint64 ticks = mx_trace_ticks() - start;
+    st->hist[mx_stats_bucket(ticks)]++;
+    st->blocks++;
+    st->perform_ticks += ticks;
+    st->perform_max = MAX(st->perform_max, ticks);
+    st->frames = frames;
+}
+
+static inline void mx_stats_gen_(t_mx_stats *st, t_uint64 start, const char *name){
+    if(!start){
+        return;
+    }
+    mx_trace_record(st->owner, name, "thread", start);
+    if(!st->on){
+        return;
+    }
+    st->gen_last = mx_trace_ticks() - start;
+    st->gen_max = MAX(st->gen_max, st->gen_last);
+    st->gens++;
+    st->gen_messages = st->messages;
+    st->messages = 0;
+}
+
+#define mx_stats_perform(st, start, frames) mx_stats_perform_((st), (start), (frames), __func__)
+#define mx_stats_gen(st, start) mx_stats_gen_((st), (start), __func__)
+
+static inline void mx_stats_sent(t_mx_stats *st, long messages){
+    if(st->on){
+        st->messages += messages;
+    }
+}
+
+static inline void mx_stats_dsp(t_mx_stats *st, double samplerate){
+    st->samplerate = samplerate;
+}
+
+//REPORT
+
+static inline double mx_stats_percentile(t_mx_stats *st, double p){
+    //the middle of the bucket the percentile falls into, in ticks
+    t_uint64 rank = (t_uint64)(p * st->blocks);
+    t_uint64 seen = 0;
+    for(long i=0;i<MX_STATS_BUCKETS;i++){
+        seen += st->hist[i];
+        if(seen > rank){
+            return (mx_stats_bucket_floor(i) + mx_stats_bucket_floor(i+1)) * 0.5;
+        }
+    }
+    return (double)st->perform_max;
+}
+
+static inline void mx_stats_post(t_object *x){
+    t_mx_stats *st = mx_stats_of(x);
+    long bytes = 0;
+    long length = 0;
+    if(mx_stats_info){
+        mx_stats_info(x, &bytes, &length);
+    }
+    if(!st->on){
+        object_post(x, "stats: not measuring (@measure 1), pattern length %ld, %ld bytes", length, bytes);
+        return;
+    }
+    
+    t_uint64 ticks = mx_trace_ticks() - st->since_ticks;
+    double us = ticks ? (systimer_gettime() - st->since_ms) * 1e3 / ticks : 0;
+    if(st->blocks){
+        double mean = (double)st->perform_ticks / st->blocks * us;
+        double block = st->samplerate > 0 ? st->frames * 1e6 / st->samplerate : 0;
+        object_post(x, "stats: perform %llu blocks, p50 %.2f p90 %.2f p99 %.2f max %.2f us, load %.2f%%",
+                    (unsigned long long)st->blocks, mx_stats_percentile(st, 0.5)*us, mx_stats_percentile(st, 0.9)*us,
+                    mx_stats_percentile(st, 0.99)*us, st->perform_max*us, block > 0 ? mean / block * 100 : 0);
+    }
+    object_post(x, "stats: %llu generations, last %.2f max %.2f us, %ld messages for the last",
+                (unsigned long long)st->gens, st->gen_last*us, st->gen_max*us, st->gen_messages);
+    object_post(x, "stats: pattern length %ld, %ld bytes", length, bytes);
+}
+
+static inline void mx_stats_tick(t_object *x){
+    t_mx_stats *st = mx_stats_of(x);
+    mx_stats_post(x);
+    if(st->interval > 0){
+        clock_fdelay(st->clock, st->interval);
+    }
+}
+
+//MESSAGES AND ATTRIBUTES
+
+static inline void mx_stats_msg(t_object *x, t_symbol *s, long argc, t_atom *argv){
+    //stats posts, stats reset starts over
+    if(argc && atom_gettype(argv) == A_SYM && atom_getsym(argv) == gensym("reset")){
+        mx_stats_reset(mx_stats_of(x));
+    }else{
+        mx_stats_post(x);
+    }
+}
+
+static inline t_max_err mx_stats_on_set(t_object *x, void *attr, long argc, t_atom *argv){
+    t_mx_stats *st = mx_stats_of(x);
+    char on = argc ? atom_getlong(argv) != 0 : 0;
+    if(on && !st->on){
+        //measured from here on
+        mx_stats_reset(st);
+    }
+    st->on = on;
+    return MAX_ERR_NONE;
+}
+
+static inline t_max_err mx_stats_interval_set(t_object *x, void *attr, long argc, t_atom *argv){
+    t_mx_stats *st = mx_stats_of(x);
+    st->interval = argc ? MAX(atom_getfloat(argv), 0) : 0;
+    if(st->interval > 0){
+        clock_fdelay(st->clock, st->interval);
+    }else{
+        clock_unset(st->clock);
+    }
+    return MAX_ERR_NONE;
+}
+
+static inline void mx_stats_class(t_class *c, long offset, mx_stats_info_fn info){
+    mx_stats_offset = offset;
+    mx_stats_info = info;
+    class_addmethod(c, (method)mx_stats_msg, "stats", A_GIMME, 0);
+    mx_trace_class(c);
+    
+    class_addattr(c, attr_offset_new("measure", gensym("char"), 0, (method)0L, (method)mx_stats_on_set, offset + calcoffset(t_mx_stats, on)));
+    CLASS_ATTR_STYLE_LABEL(c, "measure", 0, "onoff", "Measure performance statistics");
+    class_addattr(c, attr_offset_new("statsinterval", gensym("float64"), 0, (method)0L, (method)mx_stats_interval_set, offset + calcoffset(t_mx_stats, interval)));
+    CLASS_ATTR_FILTER_MIN(c, "statsinterval", 0);
+    CLASS_ATTR_LABEL(c, "statsinterval", 0, "Post statistics every (ms)");
+}
+
+#define MX_STATS_CLASS(c, structname, member, info) mx_stats_class((c), calcoffset(structname, member), (mx_stats_info_fn)(info))
+
+static inline void mx_stats_init(t_mx_stats *st, t_object *owner){
+    st->on = 0;
+    st->interval = 0;
+    st->owner = owner;
+    st->clock = clock_new(owner, (method)mx_stats_tick);
+    st->frames = 0;
+    st->samplerate = 0;
+    mx_stats_reset(st);
+}
+
+static inline void mx_stats_free(t_mx_stats *st){
+    clock_unset(st->clock);
+    object_free(st->clock);
+}
+
+#endif
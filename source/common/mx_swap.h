@@ -0,0 +1,98 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//data the perform routine plays from, replaced by the main thread without either of them
+//waiting. three slots: the front one perform reads, the back one the main thread builds
+//the next version in, and the one in the middle that is handed over. the two swap their
+//slot with the middle one in a compare and swap on the state, so perform never allocates,
+//frees or waits, and the main thread only ever writes to the back slot. neither reads the
+//state: the middle slot is one of the two that aren't their own, so they try those.
+//
+//a slot perform let go of comes back to the main thread as its back slot with a later
+//publish, that's where it is resized or freed. the version published last stays readable
+//by the main thread with mx_swap_latest, nobody writes to it any more.
+//
+//mx_swap_init with the three slots in new, in the main thread mx_swap_back to build into
+//and mx_swap_publish once it's complete, in perform mx_swap_front at the start of a vector.
+
+#ifndef MX_SWAP_H
+#define MX_SWAP_H
+
+#include "ext.h"
+#include "ext_atomic.h"
+
+#define MX_SWAP_FRESH 4         //the middle slot holds a version perform hasn't taken yet
+
+typedef struct _mx_swap{
+    void *slots[3];
+    t_int32_atomic state;       //index of the middle slot, | MX_SWAP_FRESH
+    long front;                 //perform's slot, perform only
+    long back;                  //main thread only
+    long latest;                //slot published last, main thread only
+} t_mx_swap;
+
+static inline void mx_swap_init(t_mx_swap *s, void *front, void *middle, void *back){
+    //three slots holding the same empty version, perform starts with the first
+    s->slots[0] = front;
+    s->slots[1] = middle;
+    s->slots[2] = back;
+    s->state = 1;
+    s->front = 0;
+    s->back = 2;
+    s->latest = 0;
+}
+
+//MAIN THREAD
+
+static inline void *mx_swap_back(t_mx_swap *s){
+    //the slot to build the next version in, perform never sees it until it's published
+    return s->slots[s->back];
+}
+
+static inline void *mx_swap_latest(t_mx_swap *s){
+    //the version published last, read only
+    return s->slots[s->latest];
+}
+
+static inline void mx_swap_publish(t_mx_swap *s){
+    //the back slot goes to the middle, a version perform didn't take yet is replaced.
+    //one of the four states tried matches, unless perform took a version in between
+    for(long i=0;;i=(i+1)&3){
+        int32_t state = (int32_t)((s->back + 1 + (i&1)) % 3) | ((i&2) ? MX_SWAP_FRESH : 0);
+        if(ATOMIC_COMPARE_SWAP32(state, (int32_t)s->back | MX_SWAP_FRESH, &s->state)){
+            s->latest = s->back;
+            s->back = state & 3;
+            return;
+        }
+    }
+}
+
+//PERFORM
+
+static inline void *mx_swap_front(t_mx_swap *s){
+    //at the start of a vector: takes a new version if one was published
+    for(long i=1;i<3;i++){
+        int32_t middle = (int32_t)((s->front + i) % 3);
+        if(ATOMIC_COMPARE_SWAP32(middle | MX_SWAP_FRESH, (int32_t)s->front, &s->state)){
+            s->front = middle;
+            break;
+        }
+    }
+    return s->slots[s->front];
+}
+
+#endif
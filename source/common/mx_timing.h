@@ -0,0 +1,172 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//timing signals for envelopes, with @timing 1 in the object box: two more outlets right of
+//the step number. the first is the phase within the step, a ramp from 0 on a click to 1 where
+//the next click is expected, the second an mc outlet with a channel per lane, counted like
+//the onsets, with the samples until the lane's next onset.
+//
+//both expect the next click as far from the last one as that was from the one before. the
+//steps to each lane's next onset are looked up in its pattern when the step changes, so
+//between clicks it's a multiply and a subtraction per lane and sample. -1 while a lane doesn't
+//play in the pattern or less than two clicks came.
+//
+//outlets can't be added once the object exists, so @timing is only read in new: mx_timing_init
+//before the signal outlets are made and mx_timing_outlets where the two go, MX_TIMING_CLASS in
+//ext_main so the attribute is known. in the perform routine mx_timing_click on every click and
+//mx_timing_run for the samples, mx_timing_refresh once a generation filled the patterns. an
+//object whose steps aren't a char per step fills gap and step itself and calls mx_timing_output.
+
+#ifndef MX_TIMING_H
+#define MX_TIMING_H
+
+#include <stdio.h>
+#include "ext.h"
+#include "ext_obex.h"
+
+#define MX_TIMING_LANES 12      //the widest: r, a and the b lanes of mxp2~, mx-b~, mx-c~, mx-e~
+
+typedef struct _mx_timing{
+    char on;                    //the outlets exist
+    long lanes;                 //channels of the countdown outlet
+    long index;                 //its signal outlet, counted from the left
+    double period;              //samples between the last two clicks, 0 until two came
+    double since;               //samples since the last click
+    char clicked;               //a click came
+    long step;                  //the step the gaps were looked up for, -1 to look them up again
+    long gap[MX_TIMING_LANES];  //steps from there to each lane's next onset, 0 if it doesn't play
+} t_mx_timing;
+
+static long mx_timing_offset = 0;
+
+//OBJECT
+
+static inline void mx_timing_init(t_mx_timing *t, long lanes, long index, long argc, t_atom *argv){
+    //lanes: channels of the countdown, index: the signal outlets left of the phase
+    t->on = 0;
+    for(long i=0;i+1<argc;i++){
+        if(atom_gettype(argv+i) == A_SYM && atom_getsym(argv+i) == gensym("@timing")){
+            t->on = atom_getlong(argv+i+1) != 0;
+        }
+    }
+    t->lanes = MIN(lanes, MX_TIMING_LANES);
+    t->index = index + 1;
+    t->period = 0;
+    t->since = 0;
+    t->clicked = 0;
+    t->step = -1;
+}
+
+static inline void mx_timing_outlets(t_mx_timing *t, t_object *x){
+    //right to left: countdown, phase
+    if(t->on){
+        outlet_new(x, "multichannelsignal");
+        outlet_new(x, "signal");
+    }
+}
+
+static inline long mx_timing_assist(t_mx_timing *t, long first, long *a, char *s){
+    //1 if the outlet is one of the two at first, the outlets right of them move on by 2
+    if(!t->on || *a < first){
+        return 0;
+    }
+    if(*a == first){
+        sprintf(s, "Phase within the step");
+        return 1;
+    }
+    if(*a == first + 1){
+        sprintf(s, "Samples until the next onset, one channel per lane");
+        return 1;
+    }
+    *a -= 2;
+    return 0;
+}
+
+static inline void mx_timing_refresh(t_mx_timing *t){
+    //new patterns, the gaps are looked up again in the next vector. not from the perform routine
+    t->step = -1;
+}
+
+//PERFORM
+
+static inline void mx_timing_click(t_mx_timing *t){
+    if(t->clicked){
+        t->period = t->since;
+    }
+    t->clicked = 1;
+    t->since = 0;
+}
+
+static inline void mx_timing_find(t_mx_timing *t, t_ptr *pats, long lanes, long step, long steps){
+    //only when the step changed: the first onset after it, in steps, per lane
+    for(long l=0;l<t->lanes;l++){
+        long gap = 0;
+        for(long k=1;l<lanes && k<=steps;k++){
+            if(pats[l][(step+k) % steps]){
+                gap = k;
+                break;
+            }
+        }
+        t->gap[l] = gap;
+    }
+    t->step = step;
+}
+
+static inline void mx_timing_output(t_mx_timing *t, t_double **outs, long from, long to){
+    //outs: the phase, then the countdown's channels. samples from to to, with the gaps found last
+    double period = t->period;
+    for(long j=from;j<to;j++){
+        double since = t->since;
+        outs[0][j] = period > 0 ? MIN(since / period, 1.) : 0;
+        for(long l=0;l<t->lanes;l++){
+            outs[1+l][j] = t->gap[l] && period > 0 ? MAX(t->gap[l]*period - since, 0) : -1;
+        }
+        t->since = since + 1;
+    }
+}
+
+static inline void mx_timing_run(t_mx_timing *t, t_double **outs, long from, long to, long step, t_ptr *pats, long lanes, long steps){
+    //samples from to to, all on step
+    if(!t->on){
+        return;
+    }
+    if(step != t->step){
+        mx_timing_find(t, pats, lanes, step, steps);
+    }
+    mx_timing_output(t, outs, from, to);
+}
+
+//ATTRIBUTE
+
+static inline t_max_err mx_timing_set(t_object *x, void *attr, long argc, t_atom *argv){
+    t_mx_timing *t = (t_mx_timing *)((char *)x + mx_timing_offset);
+    char on = argc ? atom_getlong(argv) != 0 : 0;
+    if(on != t->on){
+        object_error(x, "timing: only in the object box, e.g. @timing 1, it adds outlets");
+    }
+    return MAX_ERR_NONE;
+}
+
+static inline void mx_timing_class(t_class *c, long offset){
+    mx_timing_offset = offset;
+    class_addattr(c, attr_offset_new("timing", gensym("char"), 0, (method)0L, (method)mx_timing_set, offset + calcoffset(t_mx_timing, on)));
+    CLASS_ATTR_STYLE_LABEL(c, "timing", 0, "onoff", "Phase and onset countdown outlets");
+}
+
+#define MX_TIMING_CLASS(c, structname, member) mx_timing_class((c), calcoffset(structname, member))
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//span tracing across all objects of the package: trace 1 to any of them starts recording,
+//trace 0 stops it, trace write <file> writes what was recorded as chrome trace json, to be
+//opened in perfetto or chrome://tracing. the spans show which thread generated or performed
+//what and when, so a dropout can be laid next to the pattern change it coincided with.
+//
+//every thread gets a ring of its own on its first span. only that thread writes to it, so a
+//span costs neither a lock nor an allocation, on the audio thread neither. the newest
+//MX_TRACE_EVENTS spans per thread are kept. the rings are made once and kept for as long as
+//max runs, they hang off a symbol so every external of the package records into the same.
+//
+//a span is mx_trace_start before and mx_trace_span with its start after, named after the
+//function it's in. the generations and perform routines timed for @measure are traced as
+//well (see mx_stats.h), mx_trace_span is for what happens inside or outside of them.
+
+#ifndef MX_TRACE_H
+#define MX_TRACE_H
+
+#include <stdio.h>
+#include "ext.h"
+#include "ext_obex.h"
+#include "ext_path.h"
+#include "ext_atomic.h"
+#include "ext_systhread.h"
+#include "ext_systime.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef _MSC_VER
+#define MX_TRACE_TLS __declspec(thread)
+#else
+#define MX_TRACE_TLS __thread
+#endif
+
+//raised whenever t_mx_trace changes, externals built against another layout don't trace
+#define MX_TRACE_VERSION 1
+#define MX_TRACE_THREADS 16
+#define MX_TRACE_EVENTS 16384   //per thread, a power of two
+
+typedef struct _mx_trace_event{
+    t_uint64 start;
+    t_uint64 end;
+    const char *name;           //the function
+    t_symbol *cls;
+    t_object *x;
+} t_mx_trace_event;
+
+typedef struct _mx_trace_ring{
+    t_int32_atomic claimed;
+    t_systhread owner;
+    const char *kind;           //main, scheduler, audio or thread
+    t_int32_atomic head;        //spans written, moved on by the owner only
+    t_mx_trace_event *events;
+} t_mx_trace_ring;
+
+typedef struct _mx_trace{
+    long version;
+    volatile long on;
+    //spans before since aren't written, the ticks are converted over since to now
+    t_uint64 since_ticks;
+    double since_ms;
+    t_int32_atomic dropped;     //spans of threads that found all rings taken
+    t_mx_trace_ring rings[MX_TRACE_THREADS];
+} t_mx_trace;
+
+static t_mx_trace *mx_trace = NULL;
+static MX_TRACE_TLS t_mx_trace_ring *mx_trace_mine = NULL;
+
+static inline t_uint64 mx_trace_ticks(void){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    t_uint64 t;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+#else
+    return (t_uint64)(systimer_gettime()*1e6);
+#endif
+}
+
+static inline long mx_trace_on(void){
+    return mx_trace && mx_trace->on;
+}
+
+//RECORDING
+
+static inline t_uint64 mx_trace_start(void){
+    return mx_trace_on() ? mx_trace_ticks() : 0;
+}
+
+static inline t_mx_trace_ring *mx_trace_ring(const char *kind){
+    //the calling thread's ring: cached, claimed by this thread through another external or free
+    if(mx_trace_mine){
+        return mx_trace_mine;
+    }
+    t_systhread self = systhread_self();
+    for(int i=0;i<MX_TRACE_THREADS;i++){
+        t_mx_trace_ring *r = mx_trace->rings+i;
+        if(r->claimed && r->owner == self){
+            mx_trace_mine = r;
+            return r;
+        }
+    }
+    for(int i=0;i<MX_TRACE_THREADS;i++){
+        t_mx_trace_ring *r = mx_trace->rings+i;
+        if(ATOMIC_COMPARE_SWAP32(0, 1, &r->claimed)){
+            r->owner = self;
+            r->kind = systhread_ismainthread() ? "main" : systhread_istimerthread() ? "scheduler" : kind;
+            mx_trace_mine = r;
+            return r;
+        }
+    }
+    return NULL;
+}
+
+static inline void mx_trace_record(t_object *x, const char *name, const char *kind, t_uint64 start){
+    if(!start || !mx_trace_on()){
+        return;
+    }
+    t_mx_trace_ring *r = mx_trace_ring(kind);
+    if(!r){
+        ATOMIC_INCREMENT(&mx_trace->dropped);
+        return;
+    }
+    t_mx_trace_event *e = r->events + ((t_uint32)r->head & (MX_TRACE_EVENTS-1));
+    e->start = start;
+    e->end = mx_trace_ticks();
+    e->name = name;
+    e->cls = object_classname(x);
+    e->x = x;
+    //the event is complete before the head moves past it
+    ATOMIC_INCREMENT_BARRIER(&r->head);
+}
+
+#define mx_trace_span(x, start) mx_trace_record((t_object *)(x), __func__, "thread", (start))
+//for a part of a function
+#define mx_trace_span_as(x, name, start) mx_trace_record((t_object *)(x), (name), "thread", (start))
+
+static inline void mx_trace_release(void){
+    //for threads that end: their ring goes to the next thread that needs one, spans and all
+    t_mx_trace_ring *r = mx_trace_mine;
+    if(!r){
+        return;
+    }
+    mx_trace_mine = NULL;
+    r->owner = NULL;
+    ATOMIC_COMPARE_SWAP32(1, 0, &r->claimed);
+}
+
+//WRITING
+
+static inline void mx_trace_write(t_object *x, t_symbol *file){
+    char path[MAX_PATH_CHARS];
+    if(!mx_trace->since_ticks){
+        object_error(x, "trace: nothing recorded yet (trace 1)");
+        return;
+    }
+    path_nameconform(file->s_name, path, PATH_STYLE_NATIVE, PATH_TYPE_BOOT);
+    FILE *f = fopen(path, "w");
+    if(!f){
+        object_error(x, "trace: can't write %s", path);
+        return;
+    }
+    
+    //recording pauses while the rings are read. a span that began before may still end,
+    //it goes to the slot after the head, where a full ring keeps its oldest span: not written
+    long on = mx_trace->on;
+    mx_trace->on = 0;
+    t_uint64 ticks = mx_trace_ticks() - mx_trace->since_ticks;
+    double us = ticks ? (systimer_gettime() - mx_trace->since_ms) * 1e3 / ticks : 0;
+    long written = 0;
+    
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"max\"}}");
+    for(int i=0;i<MX_TRACE_THREADS;i++){
+        t_mx_trace_ring *r = mx_trace->rings+i;
+        t_uint32 head = (t_uint32)r->head;
+        if(!head){
+            continue;
+        }
+        fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+                i, r->kind, i);
+        t_uint32 first = head > MX_TRACE_EVENTS-1 ? head - (MX_TRACE_EVENTS-1) : 0;
+        for(t_uint32 j=first;j!=head;j++){
+            t_mx_trace_event *e = r->events + (j & (MX_TRACE_EVENTS-1));
+            if(e->start < mx_trace->since_ticks){
+                continue;
+            }
+            fprintf(f, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"object\": \"%p\"}}",
+                    e->name, e->cls->s_name, i, (e->start - mx_trace->since_ticks)*us, (e->end - e->start)*us, (void *)e->x);
+            written++;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    mx_trace->on = on;
+    
+    object_post(x, "trace: %ld spans written to %s", written, path);
+    if(mx_trace->dropped){
+        object_warn(x, "trace: %ld spans dropped, more than %d threads recorded", (long)mx_trace->dropped, MX_TRACE_THREADS);
+    }
+}
+
+//MESSAGE
+
+static inline void mx_trace_enable(t_object *x, long on){
+    if(on && !mx_trace->rings[0].events){
+        //once, kept for good: a thread may still hold on to a ring after tracing stopped
+        for(int i=0;i<MX_TRACE_THREADS;i++){
+            mx_trace->rings[i].events = (t_mx_trace_event *)sysmem_newptrclear(MX_TRACE_EVENTS * sizeof(t_mx_trace_event));
+        }
+    }
+    if(on && !mx_trace->on){
+        //a new recording, the spans of the last one are left out
+        mx_trace->dropped = 0;
+        mx_trace->since_ticks = mx_trace_ticks();
+        mx_trace->since_ms = systimer_gettime();
+    }
+    mx_trace->on = on;
+}
+
+static inline void mx_trace_msg(t_object *x, t_symbol *s, long argc, t_atom *argv){
+    //trace 1 | trace 0 | trace write <file>, for all objects of the package at once
+    if(!mx_trace){
+        object_error(x, "trace: not available, the package's externals are of different versions");
+        return;
+    }
+    if(argc && atom_gettype(argv) == A_SYM && atom_getsym(argv) == gensym("write")){
+        if(argc < 2 || atom_gettype(argv+1) != A_SYM){
+            object_error(x, "trace write: file name missing");
+            return;
+        }
+        mx_trace_write(x, atom_getsym(argv+1));
+    }else if(argc && (atom_gettype(argv) == A_LONG || atom_gettype(argv) == A_FLOAT)){
+        mx_trace_enable(x, atom_getlong(argv) != 0);
+    }else{
+        object_error(x, "trace: expects 1, 0 or write <file>");
+    }
+}
+
+static inline void mx_trace_class(t_class *c){
+    //the first external loaded makes the shared state, the others find it
+    t_symbol *shared = gensym("__mx_trace");
+    if(!shared->s_thing){
+        t_mx_trace *t = (t_mx_trace *)sysmem_newptrclear(sizeof(t_mx_trace));
+        t->version = MX_TRACE_VERSION;
+        shared->s_thing = (t_object *)t;
+    }
+    mx_trace = (t_mx_trace *)shared->s_thing;
+    if(mx_trace->version != MX_TRACE_VERSION){
+        mx_trace = NULL;
+    }
+    class_addmethod(c, (method)mx_trace_msg, "trace", A_GIMME, 0);
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//background jobs for @async that the main thread never waits for. a new request or freeing
+//the object only moves the request id on, a running worker notices at its next check, frees
+//its own job and ends. what the workers share with the object is a t_mx_worker of its own,
+//held by the object and by every running worker, so a worker outliving its object still
+//finds the request id and the lock and is the one to free them.
+//
+//mx_worker_new in new and mx_worker_close in free. for a job, mx_worker_request for its id,
+//then mx_worker_start runs it on a detached thread that checks mx_worker_cancelled as it
+//goes and ends with mx_worker_done. that hands a job which wasn't cancelled to the object's
+//publish qelem, where mx_worker_take gets it.
+
+#ifndef MX_WORKER_H
+#define MX_WORKER_H
+
+#include "ext.h"
+#include "ext_systhread.h"
+#include "ext_critical.h"
+#include "ext_atomic.h"
+#include "mx_trace.h"
+
+typedef void (*mx_worker_free_fn)(void *job);
+
+typedef struct _mx_worker{
+    t_int32_atomic refs;        //the object and every running worker
+    t_int32_atomic job_id;      //id of the newest request, jobs with another id are cancelled
+    t_critical lock;            //guards owner and ready
+    t_object *owner;            //NULL once the object is freed
+    t_qelem *publish_q;         //the owner's, set when a job is ready
+    void *ready;                //finished job waiting for publish_q
+    mx_worker_free_fn job_free;
+} t_mx_worker;
+
+static inline t_mx_worker *mx_worker_new(t_object *owner, method publish, mx_worker_free_fn job_free){
+    t_mx_worker *w = (t_mx_worker *)sysmem_newptrclear(sizeof(t_mx_worker));
+    w->refs = 1;
+    w->job_id = 0;
+    critical_new(&w->lock);
+    w->owner = owner;
+    w->publish_q = qelem_new(owner, publish);
+    w->ready = NULL;
+    w->job_free = job_free;
+    return w;
+}
+
+static inline void mx_worker_release(t_mx_worker *w){
+    //the last one to let go frees it, the object or a worker
+    if(ATOMIC_DECREMENT_BARRIER(&w->refs) == 0){
+        critical_free(w->lock);
+        sysmem_freeptr(w);
+    }
+}
+
+static inline int32_t mx_worker_request(t_mx_worker *w){
+    //id for a new job, every job before it is cancelled
+    return ATOMIC_INCREMENT(&w->job_id);
+}
+
+static inline t_bool mx_worker_cancelled(t_mx_worker *w, int32_t id){
+    //from any thread, a swap of the id with itself reads it atomically
+    return w && !ATOMIC_COMPARE_SWAP32(id, id, &w->job_id);
+}
+
+static inline void mx_worker_start(t_mx_worker *w, method run, void *job){
+    //run(job) on a thread of its own that nobody joins
+    t_systhread thread = NULL;
+    ATOMIC_INCREMENT_BARRIER(&w->refs);
+    if(systhread_create(run, job, 0, 0, 0, &thread)){
+        ATOMIC_DECREMENT_BARRIER(&w->refs);
+        w->job_free(job);
+        return;
+    }
+    systhread_detach(thread);
+}
+
+static inline void mx_worker_finish(t_mx_worker *w, void *job, t_bool cancelled, const char *name, t_uint64 start){
+    //last thing a worker does: the job goes to the publish qelem or is freed here
+    void *stale = job;
+    critical_enter(w->lock);
+    if(w->owner){
+        mx_trace_record(w->owner, name, "thread", start);
+        if(!cancelled){
+            stale = w->ready;
+            w->ready = job;
+            qelem_set(w->publish_q);
+        }
+    }
+    critical_exit(w->lock);
+    
+    if(stale){
+        w->job_free(stale);
+    }
+    mx_trace_release();
+    mx_worker_release(w);
+}
+
+#define mx_worker_done(w, job, cancelled, start) mx_worker_finish((w), (job), (cancelled), __func__, (start))
+
+static inline void *mx_worker_take(t_mx_worker *w){
+    //main thread: the job waiting for publish_q, or NULL
+    critical_enter(w->lock);
+    void *job = w->ready;
+    w->ready = NULL;
+    critical_exit(w->lock);
+    return job;
+}
+
+static inline void mx_worker_close(t_mx_worker *w){
+    //the object is freed: running workers are cancelled and clean up after themselves
+    critical_enter(w->lock);
+    w->owner = NULL;
+    void *ready = w->ready;
+    w->ready = NULL;
+    critical_exit(w->lock);
+    
+    ATOMIC_INCREMENT(&w->job_id);
+    qelem_free(w->publish_q);
+    if(ready){
+        w->job_free(ready);
+    }
+    mx_worker_release(w);
+}
+
+#endif
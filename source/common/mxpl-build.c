@@ -0,0 +1,277 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//writes the pattern library the generators map with @library:
+//every mxp2/mx-b/mx-c/mx-e result for 1 <= b <= a <= 9, every mx-3g triple up to
+//a bound and the permutations of every resultant with few enough of them.
+//
+//build and run, no max sdk needed:
+//  cc -O2 -o mxpl-build mxpl-build.c
+//  ./mxpl-build [-3g bound] [-perms max] [schillinger.mxpl]
+//or with the cmake build in the package root.
+//
+//the patterns come from mx_core.h like the ones of the objects,
+//bump MXPL_VERSION when the results change.
+
+#include <stdio.h>
+#include "mxpl.h"
+#include "mx_core.h"
+
+typedef struct _entry{
+    uint32_t kind;
+    int32_t key[32];
+    uint32_t key_len;
+    uint32_t steps;
+    uint32_t lanes;
+    char *data;             //lanes*steps bytes, or lanes*steps int32 for permutations
+    size_t data_len;
+} t_entry;
+
+static t_entry *entries = NULL;
+static long entry_count = 0;
+static long entry_size = 0;
+
+static char **lanes_new(long lanes, long steps){
+    char **lane = (char **)calloc(lanes, sizeof(char *));
+    for(int i=0;i<lanes;i++){
+        lane[i] = (char *)calloc(steps?steps:1, 1);
+    }
+    return lane;
+}
+
+static void add_lanes(uint32_t kind, int32_t *key, uint32_t key_len, char **lane, long lanes, long steps){
+    if(entry_count == entry_size){
+        entry_size = entry_size?entry_size*2:256;
+        entries = (t_entry *)realloc(entries, entry_size * sizeof(t_entry));
+    }
+    t_entry *e = entries + entry_count++;
+    e->kind = kind;
+    memcpy(e->key, key, key_len*4);
+    e->key_len = key_len;
+    e->steps = (uint32_t)steps;
+    e->lanes = (uint32_t)lanes;
+    e->data_len = lanes*steps;
+    e->data = (char *)malloc(e->data_len?e->data_len:1);
+    for(int i=0;i<lanes;i++){
+        memcpy(e->data + i*steps, lane[i], steps);
+        free(lane[i]);
+    }
+    free(lane);
+}
+
+//lanes of the two generator objects: r, a, b0..bn
+
+typedef void (*t_gen_fn)(long a, long b, char *r, char *ap, char **bp);
+
+static void gen_pair(uint32_t kind, long a, long b, long steps, t_gen_fn fn){
+    long b_amt = mx_core_b_amt(a, b);
+    char **lane = lanes_new(2+b_amt, steps);
+    
+    fn(a, b, lane[0], lane[1], lane+2);
+    
+    int32_t key[2] = {(int32_t)a, (int32_t)b};
+    add_lanes(kind, key, 2, lane, 2+b_amt, steps);
+}
+
+static void gen_mx_3g(long a, long b, long c){
+    //lanes R1 A1 B1 C1 R2 A2 B2 C2, as pat_list of mx-3g
+    long steps = mx_core_3g_steps(a, b, c);
+    char **lane = lanes_new(8, steps);
+    
+    mx_core_3g(a, b, c, lane);
+    
+    int32_t key[3] = {(int32_t)a, (int32_t)b, (int32_t)c};
+    add_lanes(MXPL_MX_3G, key, 3, lane, 8, steps);
+}
+
+//permutations, in the order of mx-permute's
+
+typedef struct _perm_out{
+    int32_t *result;
+    long r_index;
+} t_perm_out;
+
+static int perm_store(void *ctx, const mx_core_long *perm, long n){
+    t_perm_out *out = (t_perm_out *)ctx;
+    int32_t *row = out->result + out->r_index*n;
+    for(long i=0;i<n;i++){
+        row[i] = (int32_t)perm[i];
+    }
+    out->r_index++;
+    return 0;
+}
+
+static void add_permutations(t_entry *gen, long max){
+    //the resultant r as mx-permute gets it from patbin
+    int32_t pat[32];
+    long n = 0;
+    long last = -1;
+    
+    for(uint32_t i=0;i<gen->steps;i++){
+        if(gen->data[i]){
+            if(last>=0){
+                if(n==32)
+                    return;
+                pat[n++] = (int32_t)(i-last);
+            }
+            last = i;
+        }
+    }
+    if(last<0 || n==32)
+        return;
+    pat[n++] = (int32_t)(gen->steps-last);
+    
+    for(long i=0;i<entry_count;i++){
+        if(entries[i].kind == MXPL_PERMUTE && entries[i].key_len == n && !memcmp(entries[i].key, pat, n*4)){
+            return;
+        }
+    }
+    
+    mx_core_long arr[32];
+    for(long i=0;i<n;i++){
+        arr[i] = pat[i];
+    }
+    
+    double total = mx_core_permutations_count(arr, n);
+    if(total>max)
+        return;
+    long unq_perm = (long)(total+0.5);
+    
+    t_perm_out out;
+    out.result = (int32_t *)malloc(unq_perm*n*4);
+    out.r_index = 0;
+    mx_core_permutations(arr, n, perm_store, &out);
+    
+    if(entry_count == entry_size){
+        entry_size *= 2;
+        entries = (t_entry *)realloc(entries, entry_size * sizeof(t_entry));
+    }
+    t_entry *e = entries + entry_count++;
+    e->kind = MXPL_PERMUTE;
+    memcpy(e->key, pat, n*4);
+    e->key_len = (uint32_t)n;
+    e->steps = (uint32_t)n;
+    e->lanes = (uint32_t)unq_perm;
+    e->data = (char *)out.result;
+    e->data_len = unq_perm*n*4;
+}
+
+static int write_library(const char *path){
+    uint32_t slots = 1;
+    while(slots < entry_count*2){
+        slots *= 2;
+    }
+    
+    t_mxpl_slot *table = (t_mxpl_slot *)calloc(slots, sizeof(t_mxpl_slot));
+    uint64_t offset = sizeof(t_mxpl_header) + (uint64_t)slots * sizeof(t_mxpl_slot);
+    
+    for(long i=0;i<entry_count;i++){
+        t_entry *e = entries + i;
+        uint64_t hash = mxpl_hash(e->kind, e->key, e->key_len);
+        uint32_t s = (uint32_t)hash & (slots-1);
+        while(table[s].kind){
+            s = (s+1) & (slots-1);
+        }
+        table[s].kind = e->kind;
+        table[s].key_len = e->key_len;
+        table[s].hash = hash;
+        table[s].key = offset;
+        offset += e->key_len*4;
+        table[s].data = offset;
+        offset += (e->data_len+3) & ~(uint64_t)3;   //keep every key int32 aligned
+        table[s].steps = e->steps;
+        table[s].lanes = e->lanes;
+    }
+    
+    t_mxpl_header h;
+    memcpy(h.magic, MXPL_MAGIC, 4);
+    h.version = MXPL_VERSION;
+    h.slots = slots;
+    h.entries = (uint32_t)entry_count;
+    h.size = offset;
+    
+    FILE *f = fopen(path, "wb");
+    if(!f){
+        free(table);
+        return 1;
+    }
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(table, sizeof(t_mxpl_slot), slots, f);
+    
+    //same order as the offsets above
+    static const char pad[4] = {0, 0, 0, 0};
+    for(long i=0;i<entry_count;i++){
+        t_entry *e = entries + i;
+        fwrite(e->key, 4, e->key_len, f);
+        fwrite(e->data, 1, e->data_len, f);
+        fwrite(pad, 1, ((e->data_len+3) & ~(size_t)3) - e->data_len, f);
+    }
+    
+    free(table);
+    return fclose(f)?1:0;
+}
+
+int main(int argc, char **argv){
+    long bound_3g = 9;
+    long max_perms = 5040;
+    const char *path = "schillinger.mxpl";
+    
+    for(int i=1;i<argc;i++){
+        if(!strcmp(argv[i], "-3g") && i+1<argc){
+            bound_3g = atol(argv[++i]);
+        }else if(!strcmp(argv[i], "-perms") && i+1<argc){
+            max_perms = atol(argv[++i]);
+        }else if(argv[i][0] == '-'){
+            fprintf(stderr, "usage: mxpl-build [-3g bound] [-perms max] [file]\n");
+            return 1;
+        }else{
+            path = argv[i];
+        }
+    }
+    
+    for(long a=1;a<=9;a++){
+        for(long b=1;b<=a;b++){
+            gen_pair(MXPL_MXP2, a, b, mx_core_p2_steps(a, b), mx_core_p2);
+            gen_pair(MXPL_MX_B, a, b, mx_core_b_steps(a, b), mx_core_b);
+            gen_pair(MXPL_MX_C, a, b, mx_core_c_steps(a, b), mx_core_c);
+            gen_pair(MXPL_MX_E, a, b, mx_core_e_steps(a, b), mx_core_e);
+        }
+    }
+    
+    for(long a=1;a<=bound_3g;a++){
+        for(long b=1;b<=bound_3g;b++){
+            for(long c=1;c<=bound_3g;c++){
+                gen_mx_3g(a, b, c);
+            }
+        }
+    }
+    
+    //permutation sets of the two generator resultants
+    long generators = entry_count;
+    for(long i=0;i<generators;i++){
+        if(entries[i].kind != MXPL_MX_3G){
+            add_permutations(entries+i, max_perms);
+        }
+    }
+    
+    if(write_library(path)){
+        fprintf(stderr, "mxpl-build: can't write %s\n", path);
+        return 1;
+    }
+    printf("%s: %ld entries\n", path, entry_count);
+    return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//MXPL: library of precomputed patterns, written by mxpl-build and memory-mapped
+//read-only by the objects (@library). header only and free of the max api, so
+//mxpl-build can use it as well.
+//
+//file layout, all integers little endian:
+//  header  | slots (open addressing hash table, power of two) | keys and data
+//a generator entry holds `lanes` lanes of `steps` bytes (0 or 1) one after another,
+//in the order the object keeps them. a permutation entry holds `lanes` permutations
+//of `steps` int32 elements, in the order findPermutations produces them.
+
+#ifndef MXPL_H
+#define MXPL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define MXPL_MAGIC "MXPL"
+#define MXPL_VERSION 1
+
+//what an entry was generated by, part of the key
+#define MXPL_MXP2 1
+#define MXPL_MX_B 2
+#define MXPL_MX_C 3
+#define MXPL_MX_E 4
+#define MXPL_MX_3G 5
+#define MXPL_PERMUTE 6
+
+//errors of mxpl_open
+#define MXPL_ERR_NONE 0
+#define MXPL_ERR_OPEN 1
+#define MXPL_ERR_FORMAT 2
+#define MXPL_ERR_VERSION 3
+
+typedef struct _mxpl_header{
+    char magic[4];
+    uint32_t version;
+    uint32_t slots;         //size of the hash table, a power of two
+    uint32_t entries;
+    uint64_t size;          //whole file, to catch truncated copies
+} t_mxpl_header;
+
+typedef struct _mxpl_slot{
+    uint32_t kind;          //0 for an empty slot
+    uint32_t key_len;       //int32 values in the key
+    uint64_t hash;
+    uint64_t key;           //file offset of the key
+    uint64_t data;          //file offset of the lanes
+    uint32_t steps;
+    uint32_t lanes;
+} t_mxpl_slot;
+
+//one mapped file, shared by every instance that opened the same path
+typedef struct _mxpl{
+    char *path;
+    const char *base;
+    size_t size;
+    long refs;
+    struct _mxpl *next;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE map;
+#endif
+} t_mxpl;
+
+static t_mxpl *mxpl_libs = NULL;
+
+static inline uint64_t mxpl_hash(uint32_t kind, const int32_t *key, uint32_t key_len){
+    //fnv-1a over the kind and the key
+    uint64_t h = 14695981039346656037ULL;
+    const unsigned char *p = (const unsigned char *)&kind;
+    
+    for(int i=0;i<4;i++){
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    p = (const unsigned char *)key;
+    for(uint32_t i=0;i<key_len*4;i++){
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static inline void mxpl_unmap(t_mxpl *lib){
+#ifdef _WIN32
+    if(lib->base)
+        UnmapViewOfFile(lib->base);
+    if(lib->map)
+        CloseHandle(lib->map);
+    if(lib->file != INVALID_HANDLE_VALUE)
+        CloseHandle(lib->file);
+#else
+    if(lib->base)
+        munmap((void *)lib->base, lib->size);
+#endif
+    free(lib->path);
+    free(lib);
+}
+
+static inline t_mxpl *mxpl_open(const char *path, int *err){
+    //maps the file once per process, further opens of the same path share it
+    for(t_mxpl *lib=mxpl_libs;lib;lib=lib->next){
+        if(!strcmp(lib->path, path)){
+            lib->refs++;
+            *err = MXPL_ERR_NONE;
+            return lib;
+        }
+    }
+    
+    t_mxpl *lib = (t_mxpl *)calloc(1, sizeof(t_mxpl));
+    lib->path = strdup(path);
+    *err = MXPL_ERR_OPEN;
+    
+#ifdef _WIN32
+    lib->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER size;
+    if(lib->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(lib->file, &size)){
+        mxpl_unmap(lib);
+        return NULL;
+    }
+    lib->size = (size_t)size.QuadPart;
+    lib->map = CreateFileMappingA(lib->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(lib->map){
+        lib->base = (const char *)MapViewOfFile(lib->map, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd<0 || fstat(fd, &st)){
+        if(fd>=0)
+            close(fd);
+        mxpl_unmap(lib);
+        return NULL;
+    }
+    lib->size = (size_t)st.st_size;
+    if(lib->size){
+        void *base = mmap(NULL, lib->size, PROT_READ, MAP_SHARED, fd, 0);
+        lib->base = (base == MAP_FAILED)?NULL:(const char *)base;
+    }
+    close(fd);
+#endif
+    
+    if(!lib->base){
+        mxpl_unmap(lib);
+        return NULL;
+    }
+    
+    const t_mxpl_header *h = (const t_mxpl_header *)lib->base;
+    if(lib->size < sizeof(t_mxpl_header) || memcmp(h->magic, MXPL_MAGIC, 4)){
+        *err = MXPL_ERR_FORMAT;
+        mxpl_unmap(lib);
+        return NULL;
+    }
+    if(h->version != MXPL_VERSION){
+        *err = MXPL_ERR_VERSION;
+        mxpl_unmap(lib);
+        return NULL;
+    }
+    if(h->size != lib->size || !h->slots || (h->slots & (h->slots-1))
+       || sizeof(t_mxpl_header) + (uint64_t)h->slots * sizeof(t_mxpl_slot) > lib->size){
+        *err = MXPL_ERR_FORMAT;
+        mxpl_unmap(lib);
+        return NULL;
+    }
+    
+    lib->refs = 1;
+    lib->next = mxpl_libs;
+    mxpl_libs = lib;
+    *err = MXPL_ERR_NONE;
+    return lib;
+}
+
+static inline void mxpl_close(t_mxpl *lib){
+    if(!lib || --lib->refs){
+        return;
+    }
+    
+    t_mxpl **p = &mxpl_libs;
+    while(*p && *p!=lib){
+        p = &(*p)->next;
+    }
+    if(*p){
+        *p = lib->next;
+    }
+    mxpl_unmap(lib);
+}
+
+static inline const t_mxpl_slot *mxpl_find(const t_mxpl *lib, uint32_t kind, const int32_t *key, uint32_t key_len){
+    //linear probing, the table is at most half full so a miss ends quickly
+    const t_mxpl_header *h = (const t_mxpl_header *)lib->base;
+    const t_mxpl_slot *slots = (const t_mxpl_slot *)(lib->base + sizeof(t_mxpl_header));
+    uint64_t hash = mxpl_hash(kind, key, key_len);
+    uint32_t mask = h->slots - 1;
+    
+    for(uint32_t i=(uint32_t)hash&mask, n=0;n<h->slots;i=(i+1)&mask, n++){
+        const t_mxpl_slot *s = slots + i;
+        if(!s->kind){
+            return NULL;
+        }
+        if(s->hash == hash && s->kind == kind && s->key_len == key_len
+           && s->key + key_len*4 <= lib->size
+           && s->data + (uint64_t)s->lanes * s->steps * (kind==MXPL_PERMUTE?4:1) <= lib->size
+           && !memcmp(lib->base + s->key, key, key_len*4)){
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static inline const char *mxpl_lane(const t_mxpl *lib, const t_mxpl_slot *s, uint32_t lane){
+    return lib->base + s->data + (uint64_t)lane * s->steps;
+}
+
+static inline const int32_t *mxpl_permutation(const t_mxpl *lib, const t_mxpl_slot *s, uint32_t i){
+    return (const int32_t *)(lib->base + s->data) + (uint64_t)i * s->steps;
+}
+
+static inline const char *mxpl_strerror(int err){
+    switch(err){
+        case MXPL_ERR_OPEN:
+            return "can't open file";
+        case MXPL_ERR_FORMAT:
+            return "not a pattern library or truncated";
+        case MXPL_ERR_VERSION:
+            return "library was built for another version, rebuild it with mxpl-build";
+    }
+    return "no error";
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//max side of the pattern library: finds the file given to @library in the search path
+
+#ifndef MXPL_MAX_H
+#define MXPL_MAX_H
+
+#include "ext.h"
+#include "ext_path.h"
+#include "mxpl.h"
+
+static inline t_mxpl *mxpl_open_sym(t_symbol *name){
+    //a bare file name is looked up in the max search path, anything else is taken as is
+    char filename[MAX_PATH_CHARS];
+    char fullpath[MAX_PATH_CHARS];
+    short path = 0;
+    t_fourcc type = 0;
+    int err = MXPL_ERR_NONE;
+    
+    strncpy(filename, name->s_name, MAX_PATH_CHARS-1);
+    filename[MAX_PATH_CHARS-1] = 0;
+    
+    if(!locatefile_extended(filename, &path, &type, NULL, 0)
+       && !path_toabsolutesystempath(path, filename, fullpath)){
+        t_mxpl *lib = mxpl_open(fullpath, &err);
+        if(lib){
+            return lib;
+        }
+    }else{
+        t_mxpl *lib = mxpl_open(name->s_name, &err);
+        if(lib){
+            return lib;
+        }
+    }
+    
+    post("library: %s: %s.", name->s_name, mxpl_strerror(err));
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//stand-in for the max sdk headers, for building the externals against the headless
+//host (mx_host.c) instead of max. only the part of the api the package uses is here,
+//with the types and constants of the sdk so the sources compile unchanged.
+//the other ext_*.h headers of this folder all come down to this one.
+
+#ifndef MX_HOST_EXT_H
+#define MX_HOST_EXT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+//TYPES
+
+typedef intptr_t t_ptr_int;
+typedef t_ptr_int t_atom_long;
+typedef uintptr_t t_ptr_uint;
+typedef t_ptr_uint t_atom_ulong;
+typedef double t_atom_float;
+typedef double t_double;
+typedef float t_float;
+typedef t_atom_long t_max_err;
+typedef char *t_ptr;
+typedef t_ptr_uint t_ptr_size;
+typedef long t_bool;
+typedef int8_t t_int8;
+typedef uint8_t t_uint8;
+typedef int32_t t_int32;
+typedef uint32_t t_uint32;
+typedef int64_t t_int64;
+typedef uint64_t t_uint64;
+typedef volatile int32_t t_int32_atomic;
+typedef uint32_t t_fourcc;
+typedef short t_filepath;
+typedef void *(*method)(void *, ...);
+
+typedef struct _class t_class;
+typedef struct _mx_host_box t_mx_host_box;
+
+//every object starts with one, o_box holds the host's bookkeeping (outlets, signals)
+typedef struct _object {
+    t_class *o_class;
+    t_mx_host_box *o_box;
+} t_object;
+
+typedef struct _symbol {
+    char *s_name;
+    t_object *s_thing;
+} t_symbol;
+
+union word {
+    t_atom_long w_long;
+    t_atom_float w_float;
+    t_symbol *w_sym;
+    t_object *w_obj;
+};
+
+typedef struct _atom {
+    short a_type;
+    union word a_w;
+} t_atom;
+
+typedef struct _qelem t_qelem;
+typedef struct _clock t_clock;
+typedef struct _dictionary t_dictionary;
+
+//CONSTANTS
+
+enum e_max_atomtypes {
+    A_NOTHING = 0,
+    A_LONG,
+    A_FLOAT,
+    A_SYM,
+    A_OBJ,
+    A_DEFLONG,
+    A_DEFFLOAT,
+    A_DEFSYM,
+    A_GIMME,
+    A_CANT,
+    A_SEMI,
+    A_COMMA,
+    A_DOLLAR,
+    A_DOLLSYM,
+    A_GIMMEBACK
+};
+
+enum e_max_errorcodes {
+    MAX_ERR_NONE = 0,
+    MAX_ERR_GENERIC = -1,
+    MAX_ERR_INVALID_PTR = -2,
+    MAX_ERR_DUPLICATE = -3,
+    MAX_ERR_OUT_OF_MEM = -4
+};
+
+#define ASSIST_INLET 1
+#define ASSIST_OUTLET 2
+
+#define MAX_PATH_CHARS 2048
+#define MAX_FILENAME_CHARS 512
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+#define NIL ((void *)0)
+
+#define C74_EXPORT
+#define C74_CONST const
+
+#ifndef MIN
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b) ((a)>(b)?(a):(b))
+#endif
+#define CLAMP(a, lo, hi) ((a)<(lo)?(lo):((a)>(hi)?(hi):(a)))
+
+#define CLASS_BOX gensym("box")
+#define CLASS_NOBOX gensym("nobox")
+
+#define calcoffset(x,y) ((t_ptr_int)(&(((x *)0L)->y)))
+
+//POSTING, SYMBOLS, ATOMS
+
+void post(C74_CONST char *fmt, ...);
+void object_post(t_object *x, C74_CONST char *fmt, ...);
+void object_error(t_object *x, C74_CONST char *fmt, ...);
+void object_warn(t_object *x, C74_CONST char *fmt, ...);
+void error(C74_CONST char *fmt, ...);
+
+t_symbol *gensym(C74_CONST char *s);
+
+t_max_err atom_setlong(t_atom *a, t_atom_long b);
+t_max_err atom_setfloat(t_atom *a, double b);
+t_max_err atom_setsym(t_atom *a, t_symbol *b);
+t_max_err atom_setobj(t_atom *a, void *b);
+t_atom_long atom_getlong(C74_CONST t_atom *a);
+t_atom_float atom_getfloat(C74_CONST t_atom *a);
+t_symbol *atom_getsym(C74_CONST t_atom *a);
+long atom_gettype(C74_CONST t_atom *a);
+
+//CLASSES AND OBJECTS
+
+t_class *class_new(C74_CONST char *name, C74_CONST method mnew, C74_CONST method mfree, long size, C74_CONST method mmenu, short type, ...);
+t_max_err class_addmethod(t_class *c, C74_CONST method m, C74_CONST char *name, ...);
+t_max_err class_register(t_symbol *name_space, t_class *c);
+
+void *object_alloc(t_class *c);
+t_max_err object_free(void *x);
+t_symbol *object_classname(void *x);
+void *object_method(void *x, t_symbol *s, ...);
+t_max_err object_method_typed(void *x, t_symbol *s, long ac, t_atom *av, t_atom *rv);
+
+void *outlet_new(void *x, C74_CONST char *s);
+void *bangout(void *x);
+void *intout(void *x);
+void *outlet_bang(void *o);
+void *outlet_int(void *o, t_atom_long n);
+void *outlet_float(void *o, double f);
+void *outlet_list(void *o, t_symbol *s, short ac, t_atom *av);
+void *outlet_anything(void *o, t_symbol *s, short ac, t_atom *av);
+
+//MEMORY
+
+t_ptr sysmem_newptr(long size);
+t_ptr sysmem_newptrclear(long size);
+t_ptr sysmem_resizeptr(void *ptr, long newsize);
+t_ptr sysmem_resizeptrclear(void *ptr, long newsize);
+long sysmem_ptrsize(void *ptr);
+void sysmem_freeptr(void *ptr);
+void sysmem_copyptr(C74_CONST void *src, void *dst, long bytes);
+
+//SCHEDULING
+//qelems run when the host idles (mx_host_idle), clocks when its time moves on (mx_host_advance).
+//clocks are freed with object_free
+
+t_qelem *qelem_new(void *obj, method fn);
+void qelem_set(t_qelem *q);
+void qelem_unset(t_qelem *q);
+void qelem_front(t_qelem *q);
+void qelem_free(t_qelem *q);
+
+void *clock_new(void *obj, method fn);
+void clock_delay(void *x, long n);
+void clock_fdelay(void *x, double time);
+void clock_unset(void *x);
+void clock_getftime(double *time);
+long gettime(void);
+
+void freeobject(t_object *op);
+
+#include "ext_atomic.h"
+#include "ext_critical.h"
+#include "ext_systhread.h"
+#include "ext_path.h"
+#include "ext_systime.h"
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//stand-in for the sdk header, see ext.h
+
+#ifndef MX_HOST_EXT_ATOMIC_H
+#define MX_HOST_EXT_ATOMIC_H
+
+#include "ext.h"
+
+#define ATOMIC_INCREMENT(p) __sync_add_and_fetch((p), 1)
+#define ATOMIC_DECREMENT(p) __sync_sub_and_fetch((p), 1)
+#define ATOMIC_INCREMENT_BARRIER(p) __sync_add_and_fetch((p), 1)
+#define ATOMIC_DECREMENT_BARRIER(p) __sync_sub_and_fetch((p), 1)
+#define ATOMIC_COMPARE_SWAP32(oldvalue, newvalue, atomicvalue) __sync_bool_compare_and_swap((atomicvalue), (oldvalue), (newvalue))
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//stand-in for the sdk header, see ext.h
+//buffers are made by the harness with mx_host_buffer_new, there is no buffer~ object
+
+#ifndef MX_HOST_EXT_BUFFER_H
+#define MX_HOST_EXT_BUFFER_H
+
+#include "ext.h"
+
+typedef struct _buffer_ref t_buffer_ref;
+typedef t_object t_buffer_obj;
+
+t_buffer_ref *buffer_ref_new(t_object *self, t_symbol *name);
+void buffer_ref_set(t_buffer_ref *x, t_symbol *name);
+t_buffer_obj *buffer_ref_getobject(t_buffer_ref *x);
+t_max_err buffer_ref_notify(t_buffer_ref *x, t_symbol *s, t_symbol *msg, void *sender, void *data);
+float *buffer_locksamples(t_buffer_obj *b);
+void buffer_unlocksamples(t_buffer_obj *b);
+t_atom_long buffer_getchannelcount(t_buffer_obj *b);
+t_atom_long buffer_getframecount(t_buffer_obj *b);
+t_max_err buffer_setdirty(t_buffer_obj *b);
+
+#endif
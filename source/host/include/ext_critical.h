@@ -0,0 +1,34 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//stand-in for the sdk header, see ext.h
+
+#ifndef MX_HOST_EXT_CRITICAL_H
+#define MX_HOST_EXT_CRITICAL_H
+
+#include "ext.h"
+
+typedef struct _mx_host_critical *t_critical;
+
+void critical_new(t_critical *x);
+void critical_enter(t_critical x);
+void critical_exit(t_critical x);
+void critical_free(t_critical x);
+//0 when entered, like the sdk
+short critical_tryenter(t_critical x);
+
+#endif
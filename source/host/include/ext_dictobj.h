@@ -0,0 +1,38 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//stand-in for the sdk header, see ext.h
+
+#ifndef MX_HOST_EXT_DICTOBJ_H
+#define MX_HOST_EXT_DICTOBJ_H
+
+#include "ext.h"
+
+t_dictionary *dictionary_new(void);
+t_max_err dictionary_appendlong(t_dictionary *d, t_symbol *key, t_atom_long value);
+t_max_err dictionary_appendfloat(t_dictionary *d, t_symbol *key, double value);
+t_max_err dictionary_appendsym(t_dictionary *d, t_symbol *key, t_symbol *value);
+t_max_err dictionary_appendatoms(t_dictionary *d, t_symbol *key, long argc, t_atom *argv);
+t_max_err dictionary_appenddictionary(t_dictionary *d, t_symbol *key, t_object *value);
+t_max_err dictionary_getlong(C74_CONST t_dictionary *d, t_symbol *key, t_atom_long *value);
+t_max_err dictionary_getatoms(C74_CONST t_dictionary *d, t_symbol *key, long *argc, t_atom **argv);
+t_max_err dictionary_clear(t_dictionary *d);
+long dictionary_hasentry(C74_CONST t_dictionary *d, t_symbol *key);
+t_dictionary *dictobj_register(t_dictionary *d, t_symbol **name);
+t_max_err dictobj_release(t_dictionary *d);
+
+#endif
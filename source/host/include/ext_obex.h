@@ -0,0 +1,57 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//stand-in for the sdk header, see ext.h
+
+#ifndef MX_HOST_EXT_OBEX_H
+#define MX_HOST_EXT_OBEX_H
+
+#include "ext.h"
+
+#define ATTR_FLAGS_NONE 0
+
+t_max_err class_attr_addattr_parse(t_class *c, C74_CONST char *attrname, C74_CONST char *attrname2, t_symbol *type, long flags, C74_CONST char *parsestr);
+t_max_err class_attr_addattr_format(t_class *c, C74_CONST char *attrname, C74_CONST char *attrname2, C74_CONST t_symbol *type, long flags, C74_CONST char *fmt, ...);
+t_object *attr_offset_new(C74_CONST char *name, C74_CONST t_symbol *type, long flags, C74_CONST method mget, C74_CONST method mset, long offset);
+t_max_err class_addattr(t_class *c, t_object *attr);
+t_max_err attr_args_process(void *x, short ac, t_atom *av);
+long attr_args_offset(short ac, t_atom *av);
+
+//the host keeps min, max and setter itself, the rest is only there for the inspector in max
+t_max_err mx_host_attr_filter(t_class *c, C74_CONST char *attrname, int which, double value);
+t_max_err mx_host_attr_accessors(t_class *c, C74_CONST char *attrname, method getter, method setter);
+
+#define CLASS_ATTR_LONG(c,attrname,flags,structname,structmember) class_addattr((c),attr_offset_new(attrname,gensym("long"),(flags),(method)0L,(method)0L,calcoffset(structname,structmember)))
+#define CLASS_ATTR_CHAR(c,attrname,flags,structname,structmember) class_addattr((c),attr_offset_new(attrname,gensym("char"),(flags),(method)0L,(method)0L,calcoffset(structname,structmember)))
+#define CLASS_ATTR_SYM(c,attrname,flags,structname,structmember) class_addattr((c),attr_offset_new(attrname,gensym("symbol"),(flags),(method)0L,(method)0L,calcoffset(structname,structmember)))
+#define CLASS_ATTR_DOUBLE(c,attrname,flags,structname,structmember) class_addattr((c),attr_offset_new(attrname,gensym("float64"),(flags),(method)0L,(method)0L,calcoffset(structname,structmember)))
+#define CLASS_ATTR_ENUM(c,attrname,flags,parsestr) class_attr_addattr_parse(c,attrname,"enumvals",gensym("symbol"),flags,parsestr)
+#define CLASS_ATTR_ENUMINDEX(c,attrname,flags,parsestr) class_attr_addattr_parse(c,attrname,"enumvals",gensym("symbol"),flags,parsestr)
+#define CLASS_ATTR_STYLE(c,attrname,flags,parsestr) class_attr_addattr_parse(c,attrname,"style",gensym("symbol"),flags,parsestr)
+#define CLASS_ATTR_LABEL(c,attrname,flags,labelstr) class_attr_addattr_parse(c,attrname,"label",gensym("symbol"),flags,labelstr)
+#define CLASS_ATTR_STYLE_LABEL(c,attrname,flags,stylestr,labelstr) { CLASS_ATTR_STYLE(c,attrname,flags,stylestr); CLASS_ATTR_LABEL(c,attrname,flags,labelstr); }
+#define CLASS_ATTR_SAVE(c,attrname,flags) class_attr_addattr_parse(c,attrname,"save",gensym("long"),flags,"1")
+#define CLASS_ATTR_DEFAULT(c,attrname,flags,parsestr) class_attr_addattr_parse(c,attrname,"default",gensym("long"),flags,parsestr)
+#define CLASS_ATTR_DEFAULT_SAVE(c,attrname,flags,parsestr) { CLASS_ATTR_DEFAULT(c,attrname,flags,parsestr); CLASS_ATTR_SAVE(c,attrname,flags); }
+#define CLASS_ATTR_CATEGORY(c,attrname,flags,parsestr) class_attr_addattr_parse(c,attrname,"category",gensym("symbol"),flags,parsestr)
+#define CLASS_ATTR_BASIC(c,attrname,flags) class_attr_addattr_parse(c,attrname,"basic",gensym("long"),flags,"1")
+#define CLASS_ATTR_FILTER_MIN(c,attrname,minval) mx_host_attr_filter(c,attrname,0,(double)(minval))
+#define CLASS_ATTR_FILTER_MAX(c,attrname,maxval) mx_host_attr_filter(c,attrname,1,(double)(maxval))
+#define CLASS_ATTR_FILTER_CLIP(c,attrname,minval,maxval) { CLASS_ATTR_FILTER_MIN(c,attrname,minval); CLASS_ATTR_FILTER_MAX(c,attrname,maxval); }
+#define CLASS_ATTR_ACCESSORS(c,attrname,getter,setter) mx_host_attr_accessors(c,attrname,(method)(getter),(method)(setter))
+
+#endif
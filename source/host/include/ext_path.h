@@ -0,0 +1,51 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//stand-in for the sdk header, see ext.h
+//the host has no search path, files are only found by absolute name
+
+#ifndef MX_HOST_EXT_PATH_H
+#define MX_HOST_EXT_PATH_H
+
+#include "ext.h"
+
+short locatefile_extended(char *name, short *outvol, t_fourcc *outtype, C74_CONST t_fourcc *filetypelist, short numtypes);
+short path_toabsolutesystempath(C74_CONST short in_path, C74_CONST char *in_filename, char *out_filename);
+
+enum e_max_path_styles {
+    PATH_STYLE_MAX = 0,
+    PATH_STYLE_NATIVE,
+    PATH_STYLE_COLON,
+    PATH_STYLE_SLASH,
+    PATH_STYLE_NATIVE_WIN
+};
+
+enum e_max_path_types {
+    PATH_TYPE_IGNORE = 0,
+    PATH_TYPE_ABSOLUTE,
+    PATH_TYPE_RELATIVE,
+    PATH_TYPE_BOOT,
+    PATH_TYPE_C74,
+    PATH_TYPE_PATH,
+    PATH_TYPE_DESKTOP,
+    PATH_TYPE_TILDE,
+    PATH_TYPE_TEMPFOLDER
+};
+
+short path_nameconform(C74_CONST char *src, char *dst, long style, long type);
+
+#endif
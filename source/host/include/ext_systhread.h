@@ -0,0 +1,41 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//stand-in for the sdk header, see ext.h
+
+#ifndef MX_HOST_EXT_SYSTHREAD_H
+#define MX_HOST_EXT_SYSTHREAD_H
+
+#include "ext.h"
+
+typedef struct _mx_host_thread *t_systhread;
+typedef struct _mx_host_mutex *t_systhread_mutex;
+
+long systhread_create(method entryproc, void *arg, long stacksize, long priority, long flags, t_systhread *thread);
+long systhread_join(t_systhread thread, unsigned int *retval);
+long systhread_detach(t_systhread thread);
+void systhread_exit(long status);
+void systhread_sleep(int milliseconds);
+long systhread_ismainthread(void);
+long systhread_istimerthread(void);
+t_systhread systhread_self(void);
+long systhread_mutex_new(t_systhread_mutex *pmutex, long flags);
+long systhread_mutex_free(t_systhread_mutex pmutex);
+long systhread_mutex_lock(t_systhread_mutex pmutex);
+long systhread_mutex_unlock(t_systhread_mutex pmutex);
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//stand-in for the sdk header, see ext.h
+
+#ifndef MX_HOST_Z_DSP_H
+#define MX_HOST_Z_DSP_H
+
+#include "ext.h"
+
+typedef struct _pxobject {
+    t_object z_ob;
+    long z_misc;
+} t_pxobject;
+
+#define Z_NO_INPLACE 1
+
+void dsp_setup(t_pxobject *x, long nsignals);
+void dsp_free(t_pxobject *x);
+void class_dspinit(t_class *c);
+void set_zero64(double *dst, long n);
+double sys_getsr(void);
+long sys_getmaxblksize(void);
+
+#endif
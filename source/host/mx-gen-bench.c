@@ -0,0 +1,240 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//message domain benchmark: times gen of the generators for every (a, b), mx-3g for
+//every a<b<c, genrange of the generators for growing batches, mx-permute's pat for 1 to
+//11 elements, mx-permute-groups' group and mx-cube's pat for growing patterns. next to
+//the time per message it counts what the objects asked of the host: sysmem calls and
+//bytes, and messages and atoms sent.
+//
+//the first message to a new object is counted apart (cold), the others are averaged.
+//
+//  mx-gen-bench [--format csv|json] [--min-ms 20] [--permute-max 9] [--filter mx-b]
+//               [--externals dir]
+
+#include "mx_host.h"
+#include "mx_bench.h"
+
+#ifndef MX_EXTERNALS_DIR
+#define MX_EXTERNALS_DIR "externals"
+#endif
+
+#define MX_BENCH_TEXT 512
+
+typedef struct _mx_bench_result{
+    const char *object;
+    char msg[MX_BENCH_TEXT];
+    long calls;
+    double us_per_call;
+    double cycles_per_call;
+    t_mx_host_counters cold;    //first message
+    t_mx_host_counters warm;    //sum over the timed ones
+} t_mx_bench_result;
+
+typedef struct _mx_bench{
+    double min_ms;
+    const char *filter;
+    int json;
+    int first;
+    int failed;
+} t_mx_bench;
+
+static void mx_bench_print(t_mx_bench *b, const t_mx_bench_result *r){
+    double n = r->calls;
+    char cycles[32] = "";
+    if(MX_BENCH_CYCLES){
+        snprintf(cycles, sizeof(cycles), "%.0f", r->cycles_per_call);
+    }
+    if(b->json){
+        printf("%s\n  {\"object\": \"%s\", \"message\": \"%s\", \"calls\": %ld, \"us_per_call\": %.3f, "
+               "\"cycles_per_call\": %s, \"cold_allocs\": %lld, \"cold_bytes\": %lld, "
+               "\"allocs_per_call\": %.2f, \"resizes_per_call\": %.2f, \"frees_per_call\": %.2f, "
+               "\"bytes_per_call\": %.1f, \"peak_bytes\": %lld, \"messages_per_call\": %.2f, \"atoms_per_call\": %.1f}",
+               b->first ? "" : ",", r->object, r->msg, r->calls, r->us_per_call, cycles[0] ? cycles : "null",
+               r->cold.allocs + r->cold.resizes, r->cold.alloc_bytes,
+               r->warm.allocs/n, r->warm.resizes/n, r->warm.frees/n, r->warm.alloc_bytes/n,
+               MAX(r->cold.peak_bytes, r->warm.peak_bytes), r->warm.messages/n, r->warm.atoms/n);
+    }else{
+        printf("%s,%s,%ld,%.3f,%s,%lld,%lld,%.2f,%.2f,%.2f,%.1f,%lld,%.2f,%.1f\n",
+               r->object, r->msg, r->calls, r->us_per_call, cycles,
+               r->cold.allocs + r->cold.resizes, r->cold.alloc_bytes,
+               r->warm.allocs/n, r->warm.resizes/n, r->warm.frees/n, r->warm.alloc_bytes/n,
+               MAX(r->cold.peak_bytes, r->warm.peak_bytes), r->warm.messages/n, r->warm.atoms/n);
+    }
+    b->first = 0;
+    fflush(stdout);
+}
+
+static void mx_bench_run(t_mx_bench *b, const char *object, const char *msg){
+    if(b->filter && strcmp(b->filter, object)){
+        return;
+    }
+    t_mx_bench_result res;
+    memset(&res, 0, sizeof(res));
+    res.object = object;
+    snprintf(res.msg, sizeof(res.msg), "%s", msg);
+    
+    t_object *x = mx_host_new(object, "");
+    if(!x){
+        b->failed = 1;
+        return;
+    }
+    //every outlet has a cord, so the objects build all of their output
+    mx_host_connect_all(x);
+    mx_host_idle();
+    
+    mx_host_counters_reset();
+    mx_host_send(x, msg);
+    mx_host_idle();
+    mx_host_counters(&res.cold);
+    
+    //the messages are sent at least once, then until min_ms are up
+    mx_host_counters_reset();
+    double start = mx_bench_now();
+    unsigned long long cstart = mx_bench_cycles();
+    double elapsed = 0;
+    while(!res.calls || elapsed < b->min_ms*1e6){
+        mx_host_send(x, msg);
+        mx_host_idle();
+        res.calls++;
+        elapsed = mx_bench_now() - start;
+    }
+    res.cycles_per_call = (double)(mx_bench_cycles() - cstart) / res.calls;
+    res.us_per_call = elapsed / res.calls / 1e3;
+    mx_host_counters(&res.warm);
+    
+    mx_host_free(x);
+    mx_bench_print(b, &res);
+}
+
+static void mx_bench_usage(void){
+    fprintf(stderr, "usage: mx-gen-bench [--format csv|json] [--min-ms 20] [--permute-max 9]\n"
+                    "                    [--filter object] [--externals dir]\n");
+}
+
+int main(int argc, char **argv){
+    const char *externals = MX_EXTERNALS_DIR;
+    long permute_max = 9;
+    t_mx_bench b;
+    b.min_ms = 20;
+    b.filter = NULL;
+    b.json = 0;
+    b.first = 1;
+    b.failed = 0;
+    
+    for(int i=1;i<argc;i++){
+        if(!strcmp(argv[i], "--format") && i+1<argc){
+            b.json = !strcmp(argv[++i], "json");
+        }else if(!strcmp(argv[i], "--min-ms") && i+1<argc){
+            b.min_ms = atof(argv[++i]);
+        }else if(!strcmp(argv[i], "--permute-max") && i+1<argc){
+            long n = atol(argv[++i]);
+            permute_max = CLAMP(n, 1, 11);
+        }else if(!strcmp(argv[i], "--filter") && i+1<argc){
+            b.filter = argv[++i];
+        }else if(!strcmp(argv[i], "--externals") && i+1<argc){
+            externals = argv[++i];
+        }else{
+            mx_bench_usage();
+            return 1;
+        }
+    }
+    
+    if(!mx_host_load_dir(externals)){
+        fprintf(stderr, "mx-gen-bench: no externals in %s\n", externals);
+        return 1;
+    }
+    
+    if(b.json){
+        printf("[");
+    }else{
+        printf("object,message,calls,us_per_call,cycles_per_call,cold_allocs,cold_bytes,allocs_per_call,"
+               "resizes_per_call,frees_per_call,bytes_per_call,peak_bytes,messages_per_call,atoms_per_call\n");
+    }
+    
+    char msg[MX_BENCH_TEXT];
+    
+    //generators, every pair they accept
+    const char *generators[] = {"mxp2", "mx-b", "mx-c", "mx-e"};
+    for(int g=0;g<4;g++){
+        for(int a=1;a<=9;a++){
+            for(int c=1;c<=a;c++){
+                snprintf(msg, sizeof(msg), "gen %d %d", a, c);
+                mx_bench_run(&b, generators[g], msg);
+            }
+        }
+    }
+    
+    for(int a=1;a<=9;a++){
+        for(int c=a+1;c<=9;c++){
+            for(int d=c+1;d<=9;d++){
+                snprintf(msg, sizeof(msg), "gen %d %d %d", a, c, d);
+                mx_bench_run(&b, "mx-3g", msg);
+            }
+        }
+    }
+    
+    //batches of growing size, up to every pair at once
+    const char *batchers[] = {"mxp1", "mxp2", "mx-b", "mx-c", "mx-e"};
+    const int batch_max[] = {2, 3, 4, 6, 9};
+    for(int g=0;g<5;g++){
+        for(int s=0;s<5;s++){
+            snprintf(msg, sizeof(msg), "genrange 1 %d 1 %d", batch_max[s], batch_max[s]);
+            mx_bench_run(&b, batchers[g], msg);
+        }
+    }
+    
+    //distinct elements have n! permutations, so these stop at permute_max. with three
+    //values repeating the count stays small enough to go up to 11 elements
+    for(int n=1;n<=permute_max;n++){
+        strcpy(msg, "pat");
+        for(int i=0;i<n;i++){
+            snprintf(msg+strlen(msg), sizeof(msg)-strlen(msg), " %d", i+1);
+        }
+        mx_bench_run(&b, "mx-permute", msg);
+    }
+    for(int n=1;n<=11;n++){
+        strcpy(msg, "pat");
+        for(int i=0;i<n;i++){
+            snprintf(msg+strlen(msg), sizeof(msg)-strlen(msg), " %d", i%3 + 1);
+        }
+        mx_bench_run(&b, "mx-permute", msg);
+    }
+    
+    for(int n=1;n<=MIN(permute_max, 8);n++){
+        strcpy(msg, "group");
+        for(int i=0;i<n;i++){
+            snprintf(msg+strlen(msg), sizeof(msg)-strlen(msg), " G %d %d", i+1, i%3 + 1);
+        }
+        mx_bench_run(&b, "mx-permute-groups", msg);
+    }
+    
+    //the cube goes out as one message, its n*n*n atoms have to fit a short
+    const int cube_sizes[] = {2, 4, 8, 16, 24, 31};
+    for(int s=0;s<6;s++){
+        strcpy(msg, "pat");
+        for(int i=0;i<cube_sizes[s];i++){
+            snprintf(msg+strlen(msg), sizeof(msg)-strlen(msg), " %d", i%4 + 1);
+        }
+        mx_bench_run(&b, "mx-cube", msg);
+    }
+    
+    if(b.json){
+        printf("\n]\n");
+    }
+    return b.failed;
+}
@@ -0,0 +1,261 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//perform loop benchmark: loads the ~ externals into the headless host, gives each one a
+//pattern and runs its perform routine over synthetic click, reset and jump signals at
+//every vector size. prints one row per object, pattern and vector size, as csv or json.
+//
+//  mx-perform-bench [--format csv|json] [--vs 1,64,512] [--min-ms 50] [--filter mxp2~]
+//                   [--externals dir]
+
+#include "mx_host.h"
+#include "mx_bench.h"
+
+#ifndef MX_EXTERNALS_DIR
+#define MX_EXTERNALS_DIR "externals"
+#endif
+
+//input signals repeat after this many samples, the largest vector is read past it
+#define MX_BENCH_PERIOD 65536
+#define MX_BENCH_MAXVS 4096
+
+typedef struct _mx_bench_case{
+    const char *object;
+    const char *size;
+    const char *msg;
+} t_mx_bench_case;
+
+//small, medium and large pattern for each object, the generators' b lanes grow with a-b
+static const t_mx_bench_case mx_bench_cases[] = {
+    {"mx-player~",  "small",    "pat 3 1 2"},
+    {"mx-player~",  "medium",   "pat 3 1 2 2 1 3 1 1 2 3 2 1 3 1 2 2 1 3 1 1 2 3 2 1 3 1 2 2 1 3 1 1"},
+    {"mx-player~",  "large",    NULL},
+    {"mxp1~",       "small",    "gen 3 2"},
+    {"mxp1~",       "medium",   "gen 8 5"},
+    {"mxp1~",       "large",    "gen 16 9"},
+    {"mxp2~",       "small",    "gen 3 2"},
+    {"mxp2~",       "medium",   "gen 6 3"},
+    {"mxp2~",       "large",    "gen 9 2"},
+    {"mx-b~",       "small",    "gen 3 2"},
+    {"mx-b~",       "medium",   "gen 6 3"},
+    {"mx-b~",       "large",    "gen 9 2"},
+    {"mx-c~",       "small",    "gen 3 2"},
+    {"mx-c~",       "medium",   "gen 6 3"},
+    {"mx-c~",       "large",    "gen 9 2"},
+    {"mx-e~",       "small",    "gen 3 2"},
+    {"mx-e~",       "medium",   "gen 6 3"},
+    {"mx-e~",       "large",    "gen 9 2"},
+    {"mx-3g~",      "small",    "gen 3 4 5"},
+    {"mx-3g~",      "medium",   "gen 5 7 8"},
+    {"mx-3g~",      "large",    "gen 7 11 13"},
+    {"mx-permute~", "small",    "pat 1 2 3"},
+    {"mx-permute~", "medium",   "pat 3 1 2 1 2 4"},
+    {"mx-permute~", "large",    "pat 3 1 2 1 2 4 1 1 2 3 5 2"},
+};
+
+typedef struct _mx_bench_result{
+    const char *object;
+    const char *size;
+    const char *msg;
+    long vs;
+    long numins;
+    long numouts;
+    long samples;
+    double ns_per_sample;
+    double msamples_per_s;
+    double cycles_per_sample;
+} t_mx_bench_result;
+
+//click, reset, jump and a silent signal for any further inlet
+static double *mx_bench_signals[4];
+
+static void mx_bench_make_signals(void){
+    long len = MX_BENCH_PERIOD + MX_BENCH_MAXVS;
+    for(int i=0;i<4;i++){
+        mx_bench_signals[i] = (double *)calloc(len, sizeof(double));
+    }
+    for(long i=0;i<len;i++){
+        for(int j=0;j<4;j++){
+            mx_bench_signals[j][i] = mx_bench_signal(j, i % MX_BENCH_PERIOD);
+        }
+    }
+}
+
+static void mx_bench_point(t_object *x, long offset){
+    //inputs read straight from the signal tables, nothing is copied between vectors
+    double **ins = mx_host_dsp_ins(x);
+    long numins = mx_host_dsp_numins(x);
+    for(long i=0;i<numins;i++){
+        ins[i] = mx_bench_signals[MIN(i, 3)] + offset;
+    }
+}
+
+static int mx_bench_run(const t_mx_bench_case *bc, const char *msg, long vs, double min_ms, t_mx_bench_result *res){
+    t_object *x = mx_host_new(bc->object, "");
+    if(!x){
+        return 1;
+    }
+    mx_host_connect_all(x);
+    mx_host_idle();
+    mx_host_send(x, msg);
+    mx_host_idle();
+    
+    if(mx_host_dsp_start(x, 44100, vs)){
+        mx_host_free(x);
+        return 1;
+    }
+    
+    //warm up the caches and the branch predictors
+    long offset = 0;
+    for(long i=0;i<MAX(MX_BENCH_MAXVS/vs, 16);i++){
+        mx_bench_point(x, offset);
+        mx_host_dsp_tick(x);
+        offset = (offset + vs) % MX_BENCH_PERIOD;
+    }
+    
+    //timed in batches of about 4096 samples, so reading the clock doesn't count at small vectors
+    long batch = MAX(MX_BENCH_MAXVS/vs, 1);
+    long samples = 0;
+    double start = mx_bench_now();
+    unsigned long long cstart = mx_bench_cycles();
+    double elapsed = 0;
+    while(elapsed < min_ms*1e6){
+        for(long i=0;i<batch;i++){
+            mx_bench_point(x, offset);
+            mx_host_dsp_tick(x);
+            offset = (offset + vs) % MX_BENCH_PERIOD;
+        }
+        samples += batch*vs;
+        elapsed = mx_bench_now() - start;
+    }
+    unsigned long long cycles = mx_bench_cycles() - cstart;
+    
+    res->object = bc->object;
+    res->size = bc->size;
+    res->msg = bc->msg ? bc->msg : "pat (256 values)";
+    res->vs = vs;
+    res->numins = mx_host_dsp_numins(x);
+    res->numouts = mx_host_dsp_numouts(x);
+    res->samples = samples;
+    res->ns_per_sample = elapsed / samples;
+    res->msamples_per_s = samples / elapsed * 1e3;
+    res->cycles_per_sample = MX_BENCH_CYCLES ? (double)cycles / samples : -1;
+    
+    mx_host_dsp_stop(x);
+    mx_host_free(x);
+    return 0;
+}
+
+static void mx_bench_print(const t_mx_bench_result *r, int json, int first){
+    char cycles[32] = "";
+    if(r->cycles_per_sample >= 0){
+        snprintf(cycles, sizeof(cycles), "%.3f", r->cycles_per_sample);
+    }
+    if(json){
+        printf("%s\n  {\"object\": \"%s\", \"size\": \"%s\", \"message\": \"%s\", \"vector\": %ld, "
+               "\"numins\": %ld, \"numouts\": %ld, \"samples\": %ld, \"ns_per_sample\": %.4f, "
+               "\"msamples_per_s\": %.3f, \"cycles_per_sample\": %s}",
+               first ? "" : ",", r->object, r->size, r->msg, r->vs, r->numins, r->numouts,
+               r->samples, r->ns_per_sample, r->msamples_per_s, cycles[0] ? cycles : "null");
+    }else{
+        printf("%s,%s,%s,%ld,%ld,%ld,%ld,%.4f,%.3f,%s\n", r->object, r->size, r->msg, r->vs,
+               r->numins, r->numouts, r->samples, r->ns_per_sample, r->msamples_per_s, cycles);
+    }
+    fflush(stdout);
+}
+
+static void mx_bench_usage(void){
+    fprintf(stderr, "usage: mx-perform-bench [--format csv|json] [--vs 1,64,512] [--min-ms 50]\n"
+                    "                        [--filter object] [--externals dir]\n");
+}
+
+int main(int argc, char **argv){
+    const char *externals = MX_EXTERNALS_DIR;
+    const char *filter = NULL;
+    int json = 0;
+    double min_ms = 50;
+    long vs[32];
+    long nvs = 0;
+    
+    for(int i=1;i<argc;i++){
+        if(!strcmp(argv[i], "--format") && i+1<argc){
+            json = !strcmp(argv[++i], "json");
+        }else if(!strcmp(argv[i], "--vs") && i+1<argc){
+            for(char *s=argv[++i];*s && nvs<32;){
+                long v = strtol(s, &s, 10);
+                vs[nvs++] = CLAMP(v, 1, MX_BENCH_MAXVS);
+                s += (*s == ',');
+            }
+        }else if(!strcmp(argv[i], "--min-ms") && i+1<argc){
+            min_ms = atof(argv[++i]);
+        }else if(!strcmp(argv[i], "--filter") && i+1<argc){
+            filter = argv[++i];
+        }else if(!strcmp(argv[i], "--externals") && i+1<argc){
+            externals = argv[++i];
+        }else{
+            mx_bench_usage();
+            return 1;
+        }
+    }
+    if(!nvs){
+        for(long v=1;v<=MX_BENCH_MAXVS;v*=2){
+            vs[nvs++] = v;
+        }
+    }
+    
+    if(!mx_host_load_dir(externals)){
+        fprintf(stderr, "mx-perform-bench: no externals in %s\n", externals);
+        return 1;
+    }
+    mx_bench_make_signals();
+    
+    //the large player pattern is too long to spell out
+    char large[4096] = "pat";
+    for(int i=0;i<256;i++){
+        snprintf(large+strlen(large), sizeof(large)-strlen(large), " %d", 1 + (i*7)%4);
+    }
+    
+    if(json){
+        printf("[");
+    }else{
+        printf("object,size,message,vector,numins,numouts,samples,ns_per_sample,msamples_per_s,cycles_per_sample\n");
+    }
+    
+    int first = 1;
+    int failed = 0;
+    for(size_t i=0;i<sizeof(mx_bench_cases)/sizeof(mx_bench_cases[0]);i++){
+        const t_mx_bench_case *bc = mx_bench_cases+i;
+        if(filter && strcmp(filter, bc->object)){
+            continue;
+        }
+        for(long j=0;j<nvs;j++){
+            t_mx_bench_result res;
+            if(mx_bench_run(bc, bc->msg ? bc->msg : large, vs[j], min_ms, &res)){
+                fprintf(stderr, "mx-perform-bench: can't run %s\n", bc->object);
+                failed = 1;
+                break;
+            }
+            mx_bench_print(&res, json, first);
+            first = 0;
+        }
+    }
+    
+    if(json){
+        printf("\n]\n");
+    }
+    return failed;
+}
@@ -0,0 +1,181 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//perform check: runs every ~ object in the headless host with the perform check on (see
+//mx_host.h) and fails if a perform routine allocates, frees or takes a lock. the messages of
+//each case arrive while dsp is running, between vectors, like they do in max.
+//prints one line per case and exits with 1 if any of them failed.
+//
+//  mx-perform-check [--abort] [--vs 1,64,512] [--filter mxp2~] [--externals dir]
+
+#include "mx_host.h"
+#include "mx_bench.h"
+
+#ifndef MX_EXTERNALS_DIR
+#define MX_EXTERNALS_DIR "externals"
+#endif
+
+#define MX_CHECK_MESSAGES 6
+//samples run after each message
+#define MX_CHECK_SAMPLES 32768
+
+typedef struct _mx_check_case{
+    const char *object;
+    const char *args;
+    const char *msgs[MX_CHECK_MESSAGES];
+} t_mx_check_case;
+
+//every ~ object, with the messages that change what its perform routine reads
+static const t_mx_check_case mx_check_cases[] = {
+    {"mx-player~",  "",                         {"pat 3 1 2 2 1 3", "patbin 1 0 0 1 0 1 1 0", "pat 4 4 2 1 1"}},
+    {"mx-player~",  "@coalesce 1",              {"pat 3 1 2", "pat 2 2 1 3 1 1 2", "bang"}},
+    {"mx-player~",  "@banks 4 @banksize 16",    {"bank 1 pat 3 1 2", "bank 2 patbin 1 0 1 1", "bank 3 pat 4 4 2 1", "banks 2", "banksize 8"}},
+    {"mx-player~",  "",                         {"arrange x2 3 2 4 x4 1 1 2", "seek 3", "arrange x2abc 3 2", "arrange x9999999 4 4", "arrange", "pat 2 1"}},
+    {"mx-player~",  "@timing 1 @banks 2",       {"pat 3 1 2", "bank 1 4 1", "arrange x2 3 2 4", "arrange", "banks 0"}},
+    {"mxp1~",       "",                         {"gen 3 2", "gen 8 5", "gen 16 9", "gen 2 1", "bang"}},
+    {"mxp1~",       "@coalesce 1",              {"gen 3 2", "gen 16 9", "gen 5 4", "gen -30 2"}},
+    {"mxp1~",       "@timing 1",                {"gen 3 2", "gen 16 9", "gen 1 1"}},
+    {"mxp2~",       "",                         {"gen 3 2", "gen 9 2", "gen 6 3", "gen 1 1", "bang"}},
+    {"mxp2~",       "@coalesce 1",              {"gen 3 2", "gen 9 2", "gen 4 3"}},
+    {"mx-b~",       "",                         {"gen 3 2", "gen 9 2", "gen 6 3", "gen 1 1", "bang"}},
+    {"mx-b~",       "@coalesce 1",              {"gen 3 2", "gen 9 2", "gen 4 3"}},
+    {"mx-b~",       "@timing 1",                {"gen 3 2", "gen 9 2", "gen 1 1"}},
+    {"mx-c~",       "",                         {"gen 3 2", "gen 9 2", "gen 6 3", "gen 1 1", "bang"}},
+    {"mx-c~",       "@coalesce 1",              {"gen 3 2", "gen 9 2", "gen 4 3"}},
+    {"mx-e~",       "",                         {"gen 3 2", "gen 9 2", "gen 6 3", "gen 1 1", "bang"}},
+    {"mx-e~",       "@coalesce 1",              {"gen 3 2", "gen 9 2", "gen 4 3"}},
+    {"mx-3g~",      "",                         {"gen 3 4 5", "gen 7 11 13", "gen 2 3 5", "bang"}},
+    {"mx-3g~",      "@coalesce 1",              {"gen 3 4 5", "gen 7 11 13", "gen 5 7 8", "gen -30 2 3"}},
+    {"mx-3g~",      "@timing 1",                {"gen 3 4 5", "gen 7 11 13", "gen 2 3 5"}},
+    {"mx-permute~", "",                         {"pat 1 2 3", "pat 3 1 2 1 2 4", "pat 2", "bang"}},
+    {"mx-clock~",   "main",                     {"name other", "name main", "name"}},
+    {"mxp1~",       "@clock main",              {"gen 3 2", "clock other", "gen 8 5", "clock"}},
+    {"mx-player~",  "@clock main",              {"pat 3 1 2", "arrange x2 3 2 4", "seek 3", "clock other", "pat 2 1", "clock"}},
+    {"mx-permute~", "@clock main",              {"pat 1 2 3", "pat 3 1 2 1 2 4", "clock other", "clock"}},
+};
+
+static void mx_check_tick(t_object *x, long vs, long *t){
+    double **ins = mx_host_dsp_ins(x);
+    long numins = mx_host_dsp_numins(x);
+    for(long i=0;i<numins;i++){
+        for(long j=0;j<vs;j++){
+            ins[i][j] = mx_bench_signal(i, *t + j);
+        }
+    }
+    mx_host_dsp_tick(x);
+    *t += vs;
+    //the qelems the objects set run between vectors
+    mx_host_idle();
+}
+
+//returns the calls flagged while running the case, -1 if it couldn't run
+static long mx_check_run(const t_mx_check_case *cc, long vs){
+    t_object *x = mx_host_new(cc->object, cc->args);
+    if(!x){
+        return -1;
+    }
+    mx_host_connect_all(x);
+    mx_host_idle();
+    if(mx_host_dsp_start(x, 44100, vs)){
+        mx_host_free(x);
+        return -1;
+    }
+    
+    long before = mx_host_perform_violations();
+    long t = 0;
+    //without a pattern first, then after each message
+    for(int m=-1;m<MX_CHECK_MESSAGES;m++){
+        if(m >= 0){
+            if(!cc->msgs[m]){
+                break;
+            }
+            mx_host_send(x, cc->msgs[m]);
+        }
+        for(long s=0;s<MX_CHECK_SAMPLES;s+=vs){
+            mx_check_tick(x, vs, &t);
+        }
+    }
+    long flagged = mx_host_perform_violations() - before;
+    
+    mx_host_dsp_stop(x);
+    mx_host_free(x);
+    return flagged;
+}
+
+static void mx_check_usage(void){
+    fprintf(stderr, "usage: mx-perform-check [--abort] [--vs 1,64,512] [--filter object] [--externals dir]\n");
+}
+
+int main(int argc, char **argv){
+    const char *externals = MX_EXTERNALS_DIR;
+    const char *filter = NULL;
+    int mode = MX_HOST_CHECK_LOG;
+    long vs[32];
+    long nvs = 0;
+    
+    for(int i=1;i<argc;i++){
+        if(!strcmp(argv[i], "--abort")){
+            mode = MX_HOST_CHECK_ABORT;
+        }else if(!strcmp(argv[i], "--vs") && i+1<argc){
+            for(char *s=argv[++i];*s && nvs<32;){
+                long v = strtol(s, &s, 10);
+                vs[nvs++] = CLAMP(v, 1, 4096);
+                s += (*s == ',');
+            }
+        }else if(!strcmp(argv[i], "--filter") && i+1<argc){
+            filter = argv[++i];
+        }else if(!strcmp(argv[i], "--externals") && i+1<argc){
+            externals = argv[++i];
+        }else{
+            mx_check_usage();
+            return 1;
+        }
+    }
+    if(!nvs){
+        vs[nvs++] = 1;
+        vs[nvs++] = 64;
+        vs[nvs++] = 512;
+    }
+    
+    if(!mx_host_load_dir(externals)){
+        fprintf(stderr, "mx-perform-check: no externals in %s\n", externals);
+        return 1;
+    }
+    mx_host_perform_check(mode);
+    
+    int failed = 0;
+    for(size_t i=0;i<sizeof(mx_check_cases)/sizeof(mx_check_cases[0]);i++){
+        const t_mx_check_case *cc = mx_check_cases+i;
+        if(filter && strcmp(filter, cc->object)){
+            continue;
+        }
+        for(long j=0;j<nvs;j++){
+            long flagged = mx_check_run(cc, vs[j]);
+            if(flagged < 0){
+                printf("FAIL %s %s (vector %ld): can't run\n", cc->object, cc->args, vs[j]);
+                failed = 1;
+            }else if(flagged){
+                printf("FAIL %s %s (vector %ld): %ld calls from the perform routine\n", cc->object, cc->args, vs[j], flagged);
+                failed = 1;
+            }else{
+                printf("ok   %s %s (vector %ld)\n", cc->object, cc->args, vs[j]);
+            }
+            fflush(stdout);
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,59 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//clocks and input signals shared by the benchmarks and the perform check in this folder
+
+#ifndef MX_BENCH_H
+#define MX_BENCH_H
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MX_BENCH_CYCLES 1
+#else
+#define MX_BENCH_CYCLES 0
+#endif
+
+static inline double mx_bench_now(void){
+    //nanoseconds
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+static inline unsigned long long mx_bench_cycles(void){
+    //time stamp counter, 0 where there is none
+#if MX_BENCH_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+//the signal at an inlet of a ~ object: a click every 7 samples, a reset every 997, a new jump
+//target every 331 and silence for any further inlet
+static inline double mx_bench_signal(long inlet, long t){
+    switch(inlet){
+        case 0: return (t % 7) == 0;
+        case 1: return (t % 997) == 0;
+        case 2: return (t / 331) % 5 ? 0 : 1 + (t / 331) % 13;
+        default: return 0;
+    }
+}
+
+#endif
@@ -0,0 +1,1653 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mx_host.h"
+#include "ext_obex.h"
+#include "ext_dictobj.h"
+#include "ext_buffer.h"
+#include "z_dsp.h"
+#include "jpatcher_api.h"
+#include <stdarg.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <dirent.h>
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define MX_HOST_BACKTRACE 1
+#endif
+
+#define MX_HOST_METHODS 64
+#define MX_HOST_ATTRS 32
+#define MX_HOST_TYPES 8
+#define MX_HOST_OUTLETS 64
+#define MX_HOST_ARGS 64
+#define MX_HOST_SYMBOLS 4096
+#define MX_HOST_CHECK_REPORTS 16
+
+typedef struct _mx_host_method{
+    t_symbol *name;
+    method fn;
+    short types[MX_HOST_TYPES];
+    long ntypes;
+} t_mx_host_method;
+
+typedef struct _mx_host_attr{
+    t_symbol *name;
+    t_symbol *type;
+    long offset;
+    method set;
+    double min;
+    double max;
+    char has_min;
+    char has_max;
+} t_mx_host_attr;
+
+struct _class{
+    char *name;
+    t_symbol *sym;      //the name, for object_classname
+    method mnew;
+    method mfree;
+    long size;
+    t_mx_host_method methods[MX_HOST_METHODS];
+    long nmethods;
+    t_mx_host_attr attrs[MX_HOST_ATTRS];
+    long nattrs;
+    char dsp;
+    struct _class *next;
+};
+
+typedef struct _mx_host_outlet{
+    t_object *owner;
+    t_symbol *type;             //NULL for message outlets
+    long created;               //creation order, the first one is the rightmost
+} t_mx_host_outlet;
+
+typedef struct _mx_host_chain{
+    t_object ob;
+    t_object *x;
+    method perform;
+    long flags;
+    void *userparam;
+    double samplerate;
+    long vectorsize;
+    long numins;
+    long numouts;
+    double **ins;
+    double **outs;
+    double *samples;
+} t_mx_host_chain;
+
+struct _mx_host_box{
+    t_mx_host_outlet *outlets[MX_HOST_OUTLETS];
+    long noutlets;
+    long nsigins;
+    t_mx_host_chain *chain;
+};
+
+struct _qelem{
+    void *obj;
+    method fn;
+    char set;
+    struct _qelem *next;
+};
+
+struct _clock{
+    t_object ob;
+    void *owner;
+    method fn;
+    double due;
+    char set;
+    struct _clock *next;
+};
+
+struct _mx_host_critical{
+    pthread_mutex_t mutex;
+};
+
+struct _mx_host_thread{
+    pthread_t thread;
+    method fn;
+    void *arg;
+    int refs;       //the thread's own and the handle's, given up by systhread_join or _detach
+};
+
+struct _mx_host_mutex{
+    pthread_mutex_t mutex;
+};
+
+typedef struct _mx_host_entry{
+    t_symbol *key;
+    long argc;
+    t_atom *argv;
+    struct _mx_host_entry *next;
+} t_mx_host_entry;
+
+struct _dictionary{
+    t_object ob;
+    t_mx_host_entry *entries;
+};
+
+typedef struct _mx_host_buffer{
+    t_object ob;
+    t_symbol *name;
+    float *samples;
+    long frames;
+    long chans;
+    struct _mx_host_buffer *next;
+} t_mx_host_buffer;
+
+struct _buffer_ref{
+    t_object ob;
+    t_symbol *name;
+};
+
+typedef struct _mx_host_symbol{
+    t_symbol s;
+    struct _mx_host_symbol *next;
+} t_mx_host_symbol;
+
+static t_class *mx_host_classes = NULL;
+static t_class *mx_host_chain_class = NULL;
+static t_class *mx_host_dict_class = NULL;
+static t_class *mx_host_buffer_class = NULL;
+static t_class *mx_host_ref_class = NULL;
+static t_class *mx_host_clock_class = NULL;
+
+static t_mx_host_symbol *mx_host_symbols[MX_HOST_SYMBOLS];
+static pthread_mutex_t mx_host_symbol_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static t_qelem *mx_host_pending = NULL;
+static pthread_mutex_t mx_host_qelem_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static t_clock *mx_host_clocks = NULL;
+static double mx_host_now = 0;
+static pthread_mutex_t mx_host_clock_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static t_mx_host_buffer *mx_host_buffers = NULL;
+
+static mx_host_outlet_fn mx_host_hook = NULL;
+static void *mx_host_hook_ctx = NULL;
+
+static t_mx_host_counters mx_host_counted;
+
+static pthread_t mx_host_main;
+static char mx_host_started = 0;
+
+#ifndef MX_HOST_PERFORM_CHECK
+#define MX_HOST_PERFORM_CHECK MX_HOST_CHECK_OFF
+#endif
+static int mx_host_check = MX_HOST_PERFORM_CHECK;
+static long mx_host_violations = 0;
+//the object whose perform routine runs on this thread, NULL outside of mx_host_dsp_tick
+static __thread t_object *mx_host_performing = NULL;
+//systhread_self: the thread as started by systhread_create, or a stand-in for any other thread
+static __thread struct _mx_host_thread *mx_host_self = NULL;
+static __thread struct _mx_host_thread mx_host_self_other;
+
+static double mx_host_sr = 44100;
+static long mx_host_vs = 64;
+
+static void mx_host_init(void);
+static void mx_host_dict_free(t_dictionary *d);
+static void mx_host_buffer_size(t_mx_host_buffer *b, t_symbol *s, long argc, t_atom *argv);
+static void mx_host_buffer_release(t_mx_host_buffer *b);
+static void mx_host_clock_release(t_clock *c);
+static void mx_host_dsp_add64(t_mx_host_chain *chain, t_object *x, method perform, long flags, void *userparam);
+
+//POSTING
+
+static void mx_host_vpost(const char *prefix, const char *fmt, va_list ap){
+    fputs(prefix, stderr);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+}
+
+void post(C74_CONST char *fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    mx_host_vpost("", fmt, ap);
+    va_end(ap);
+}
+
+void object_post(t_object *x, C74_CONST char *fmt, ...){
+    va_list ap;
+    (void)x;
+    va_start(ap, fmt);
+    mx_host_vpost("", fmt, ap);
+    va_end(ap);
+}
+
+void object_error(t_object *x, C74_CONST char *fmt, ...){
+    va_list ap;
+    (void)x;
+    va_start(ap, fmt);
+    mx_host_vpost("error: ", fmt, ap);
+    va_end(ap);
+}
+
+void object_warn(t_object *x, C74_CONST char *fmt, ...){
+    va_list ap;
+    (void)x;
+    va_start(ap, fmt);
+    mx_host_vpost("warning: ", fmt, ap);
+    va_end(ap);
+}
+
+void error(C74_CONST char *fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    mx_host_vpost("error: ", fmt, ap);
+    va_end(ap);
+}
+
+//SYMBOLS AND ATOMS
+
+t_symbol *gensym(C74_CONST char *s){
+    unsigned long hash = 5381;
+    for(const char *c=s;*c;c++){
+        hash = hash*33 + (unsigned char)*c;
+    }
+    hash %= MX_HOST_SYMBOLS;
+    
+    pthread_mutex_lock(&mx_host_symbol_lock);
+    t_mx_host_symbol *sym = mx_host_symbols[hash];
+    while(sym && strcmp(sym->s.s_name, s)){
+        sym = sym->next;
+    }
+    if(!sym){
+        //symbols live as long as the host, like in max
+        sym = (t_mx_host_symbol *)calloc(1, sizeof(t_mx_host_symbol));
+        sym->s.s_name = strdup(s);
+        sym->next = mx_host_symbols[hash];
+        mx_host_symbols[hash] = sym;
+    }
+    pthread_mutex_unlock(&mx_host_symbol_lock);
+    return &sym->s;
+}
+
+t_max_err atom_setlong(t_atom *a, t_atom_long b){
+    a->a_type = A_LONG;
+    a->a_w.w_long = b;
+    return MAX_ERR_NONE;
+}
+
+t_max_err atom_setfloat(t_atom *a, double b){
+    a->a_type = A_FLOAT;
+    a->a_w.w_float = b;
+    return MAX_ERR_NONE;
+}
+
+t_max_err atom_setsym(t_atom *a, t_symbol *b){
+    a->a_type = A_SYM;
+    a->a_w.w_sym = b;
+    return MAX_ERR_NONE;
+}
+
+t_max_err atom_setobj(t_atom *a, void *b){
+    a->a_type = A_OBJ;
+    a->a_w.w_obj = (t_object *)b;
+    return MAX_ERR_NONE;
+}
+
+t_atom_long atom_getlong(C74_CONST t_atom *a){
+    switch(a->a_type){
+        case A_LONG: return a->a_w.w_long;
+        case A_FLOAT: return (t_atom_long)a->a_w.w_float;
+        default: return 0;
+    }
+}
+
+t_atom_float atom_getfloat(C74_CONST t_atom *a){
+    switch(a->a_type){
+        case A_LONG: return (t_atom_float)a->a_w.w_long;
+        case A_FLOAT: return a->a_w.w_float;
+        default: return 0;
+    }
+}
+
+t_symbol *atom_getsym(C74_CONST t_atom *a){
+    return a->a_type == A_SYM ? a->a_w.w_sym : gensym("");
+}
+
+long atom_gettype(C74_CONST t_atom *a){
+    return a->a_type;
+}
+
+static long mx_host_parse(const char *text, t_atom *argv, long max){
+    //whitespace separated words into atoms, numbers become longs or floats
+    long argc = 0;
+    char word[512];
+    const char *c = text ? text : "";
+    
+    while(argc<max){
+        while(*c==' ' || *c=='\t' || *c=='\n'){
+            c++;
+        }
+        if(!*c){
+            break;
+        }
+        long len = 0;
+        while(*c && *c!=' ' && *c!='\t' && *c!='\n'){
+            if(len < (long)sizeof(word)-1){
+                word[len++] = *c;
+            }
+            c++;
+        }
+        word[len] = 0;
+    
+        char *end;
+        long l = strtol(word, &end, 10);
+        if(!*end){
+            atom_setlong(argv+argc++, l);
+            continue;
+        }
+        double f = strtod(word, &end);
+        if(!*end){
+            atom_setfloat(argv+argc++, f);
+            continue;
+        }
+        atom_setsym(argv+argc++, gensym(word));
+    }
+    return argc;
+}
+
+//PERFORM CHECK
+//the perform routines run on the audio thread in max, which mustn't wait for the allocator
+//or for a lock held by another thread. the calls that could are checked here
+
+static void mx_host_perform_violation(const char *call){
+    t_object *x = mx_host_performing;
+    if(!x || mx_host_check == MX_HOST_CHECK_OFF){
+        return;
+    }
+    long n = __atomic_add_fetch(&mx_host_violations, 1, __ATOMIC_RELAXED);
+    if(n > MX_HOST_CHECK_REPORTS && mx_host_check != MX_HOST_CHECK_ABORT){
+        //a perform routine calls the same thing every vector, the first reports tell where
+        if(n == MX_HOST_CHECK_REPORTS+1){
+            fprintf(stderr, "mx_host: further calls from perform routines are only counted\n");
+        }
+        return;
+    }
+    fprintf(stderr, "mx_host: %s called from the perform routine of %s\n", call, x->o_class->name);
+#ifdef MX_HOST_BACKTRACE
+    void *frames[32];
+    int depth = backtrace(frames, 32);
+    //without this function
+    backtrace_symbols_fd(frames+1, depth-1, 2);
+#endif
+    if(mx_host_check == MX_HOST_CHECK_ABORT){
+        abort();
+    }
+}
+
+void mx_host_perform_check(int mode){
+    mx_host_check = CLAMP(mode, MX_HOST_CHECK_OFF, MX_HOST_CHECK_ABORT);
+}
+
+long mx_host_perform_violations(void){
+    return __atomic_load_n(&mx_host_violations, __ATOMIC_RELAXED);
+}
+
+//MEMORY
+//a header in front of every block keeps its size for sysmem_ptrsize and resizing.
+//the counters are updated atomically, objects allocate from their own threads too
+
+#define MX_HOST_HEADER 16
+
+static void mx_host_count_live(long long bytes){
+    long long live = __atomic_add_fetch(&mx_host_counted.live_bytes, bytes, __ATOMIC_RELAXED);
+    long long peak = __atomic_load_n(&mx_host_counted.peak_bytes, __ATOMIC_RELAXED);
+    while(live > peak && !__atomic_compare_exchange_n(&mx_host_counted.peak_bytes, &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+    }
+}
+
+t_ptr sysmem_newptr(long size){
+    mx_host_perform_violation("sysmem_newptr");
+    char *p = (char *)malloc(MX_HOST_HEADER + MAX(size, 0));
+    if(!p){
+        return NULL;
+    }
+    *(long *)p = size;
+    __atomic_add_fetch(&mx_host_counted.allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mx_host_counted.alloc_bytes, MAX(size, 0), __ATOMIC_RELAXED);
+    mx_host_count_live(MAX(size, 0));
+    return p + MX_HOST_HEADER;
+}
+
+t_ptr sysmem_newptrclear(long size){
+    t_ptr p = sysmem_newptr(size);
+    if(p && size>0){
+        memset(p, 0, size);
+    }
+    return p;
+}
+
+long sysmem_ptrsize(void *ptr){
+    return ptr ? *(long *)((char *)ptr - MX_HOST_HEADER) : 0;
+}
+
+t_ptr sysmem_resizeptr(void *ptr, long newsize){
+    if(!ptr){
+        return sysmem_newptr(newsize);
+    }
+    mx_host_perform_violation("sysmem_resizeptr");
+    long oldsize = sysmem_ptrsize(ptr);
+    char *p = (char *)realloc((char *)ptr - MX_HOST_HEADER, MX_HOST_HEADER + MAX(newsize, 0));
+    if(!p){
+        return NULL;
+    }
+    *(long *)p = newsize;
+    __atomic_add_fetch(&mx_host_counted.resizes, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mx_host_counted.alloc_bytes, MAX(newsize-oldsize, 0), __ATOMIC_RELAXED);
+    mx_host_count_live(MAX(newsize, 0) - oldsize);
+    return p + MX_HOST_HEADER;
+}
+
+t_ptr sysmem_resizeptrclear(void *ptr, long newsize){
+    long oldsize = sysmem_ptrsize(ptr);
+    t_ptr p = sysmem_resizeptr(ptr, newsize);
+    if(p && newsize>oldsize){
+        memset(p+oldsize, 0, newsize-oldsize);
+    }
+    return p;
+}
+
+void sysmem_freeptr(void *ptr){
+    if(ptr){
+        mx_host_perform_violation("sysmem_freeptr");
+        __atomic_add_fetch(&mx_host_counted.frees, 1, __ATOMIC_RELAXED);
+        mx_host_count_live(-sysmem_ptrsize(ptr));
+        free((char *)ptr - MX_HOST_HEADER);
+    }
+}
+
+void sysmem_copyptr(C74_CONST void *src, void *dst, long bytes){
+    memmove(dst, src, bytes);
+}
+
+//CLASSES
+
+t_class *class_new(C74_CONST char *name, C74_CONST method mnew, C74_CONST method mfree, long size, C74_CONST method mmenu, short type, ...){
+    (void)mmenu;
+    (void)type;
+    t_class *c = (t_class *)calloc(1, sizeof(t_class));
+    c->name = strdup(name);
+    c->sym = gensym(name);
+    c->mnew = mnew;
+    c->mfree = mfree;
+    c->size = size;
+    return c;
+}
+
+t_max_err class_addmethod(t_class *c, C74_CONST method m, C74_CONST char *name, ...){
+    if(c->nmethods >= MX_HOST_METHODS){
+        return MAX_ERR_GENERIC;
+    }
+    t_mx_host_method *meth = c->methods + c->nmethods++;
+    meth->name = gensym(name);
+    meth->fn = m;
+    meth->ntypes = 0;
+    
+    va_list ap;
+    va_start(ap, name);
+    int type;
+    while((type = va_arg(ap, int)) != A_NOTHING && meth->ntypes<MX_HOST_TYPES){
+        meth->types[meth->ntypes++] = (short)type;
+    }
+    va_end(ap);
+    return MAX_ERR_NONE;
+}
+
+t_max_err class_register(t_symbol *name_space, t_class *c){
+    (void)name_space;
+    c->next = mx_host_classes;
+    mx_host_classes = c;
+    return MAX_ERR_NONE;
+}
+
+static t_class *mx_host_class(const char *name){
+    for(t_class *c=mx_host_classes;c;c=c->next){
+        if(!strcmp(c->name, name)){
+            return c;
+        }
+    }
+    return NULL;
+}
+
+static t_mx_host_method *mx_host_method(t_object *x, t_symbol *s){
+    t_class *c = x ? x->o_class : NULL;
+    if(!c){
+        return NULL;
+    }
+    for(long i=0;i<c->nmethods;i++){
+        if(c->methods[i].name == s){
+            return c->methods+i;
+        }
+    }
+    return NULL;
+}
+
+static t_mx_host_attr *mx_host_attr(t_class *c, t_symbol *s){
+    for(long i=0;i<c->nattrs;i++){
+        if(c->attrs[i].name == s){
+            return c->attrs+i;
+        }
+    }
+    return NULL;
+}
+
+//ATTRIBUTES
+
+t_object *attr_offset_new(C74_CONST char *name, C74_CONST t_symbol *type, long flags, C74_CONST method mget, C74_CONST method mset, long offset){
+    (void)flags;
+    (void)mget;
+    t_mx_host_attr *attr = (t_mx_host_attr *)calloc(1, sizeof(t_mx_host_attr));
+    attr->name = gensym(name);
+    attr->type = (t_symbol *)type;
+    attr->offset = offset;
+    attr->set = mset;
+    return (t_object *)attr;
+}
+
+t_max_err class_addattr(t_class *c, t_object *attr){
+    t_mx_host_attr *a = (t_mx_host_attr *)attr;
+    if(c->nattrs >= MX_HOST_ATTRS){
+        free(a);
+        return MAX_ERR_GENERIC;
+    }
+    c->attrs[c->nattrs++] = *a;
+    free(a);
+    return MAX_ERR_NONE;
+}
+
+t_max_err class_attr_addattr_parse(t_class *c, C74_CONST char *attrname, C74_CONST char *attrname2, t_symbol *type, long flags, C74_CONST char *parsestr){
+    //labels, styles, enums and the like only matter to the inspector
+    (void)c; (void)attrname; (void)attrname2; (void)type; (void)flags; (void)parsestr;
+    return MAX_ERR_NONE;
+}
+
+t_max_err class_attr_addattr_format(t_class *c, C74_CONST char *attrname, C74_CONST char *attrname2, C74_CONST t_symbol *type, long flags, C74_CONST char *fmt, ...){
+    (void)c; (void)attrname; (void)attrname2; (void)type; (void)flags; (void)fmt;
+    return MAX_ERR_NONE;
+}
+
+t_max_err mx_host_attr_filter(t_class *c, C74_CONST char *attrname, int which, double value){
+    t_mx_host_attr *attr = mx_host_attr(c, gensym(attrname));
+    if(!attr){
+        return MAX_ERR_GENERIC;
+    }
+    if(which){
+        attr->max = value;
+        attr->has_max = 1;
+    }else{
+        attr->min = value;
+        attr->has_min = 1;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err mx_host_attr_accessors(t_class *c, C74_CONST char *attrname, method getter, method setter){
+    (void)getter;
+    t_mx_host_attr *attr = mx_host_attr(c, gensym(attrname));
+    if(!attr){
+        return MAX_ERR_GENERIC;
+    }
+    attr->set = setter;
+    return MAX_ERR_NONE;
+}
+
+static t_max_err mx_host_attr_set(t_object *x, t_mx_host_attr *attr, long argc, t_atom *argv){
+    t_atom clipped[MX_HOST_ARGS];
+    argc = MIN(argc, MX_HOST_ARGS);
+    for(long i=0;i<argc;i++){
+        clipped[i] = argv[i];
+        if(argv[i].a_type == A_LONG){
+            t_atom_long v = argv[i].a_w.w_long;
+            if(attr->has_min && v < attr->min){
+                v = (t_atom_long)attr->min;
+            }
+            if(attr->has_max && v > attr->max){
+                v = (t_atom_long)attr->max;
+            }
+            clipped[i].a_w.w_long = v;
+        }else if(argv[i].a_type == A_FLOAT){
+            clipped[i].a_w.w_float = CLAMP(argv[i].a_w.w_float,
+                                           attr->has_min ? attr->min : -INFINITY,
+                                           attr->has_max ? attr->max : INFINITY);
+        }
+    }
+    
+    if(attr->set){
+        return ((t_max_err (*)(t_object *, void *, long, t_atom *))attr->set)(x, attr, argc, clipped);
+    }
+    if(!argc){
+        return MAX_ERR_GENERIC;
+    }
+    
+    char *field = (char *)x + attr->offset;
+    if(attr->type == gensym("char")){
+        *(char *)field = (char)atom_getlong(clipped);
+    }else if(attr->type == gensym("long")){
+        *(t_atom_long *)field = atom_getlong(clipped);
+    }else if(attr->type == gensym("symbol")){
+        *(t_symbol **)field = atom_getsym(clipped);
+    }else if(attr->type == gensym("float64")){
+        *(double *)field = atom_getfloat(clipped);
+    }
+    return MAX_ERR_NONE;
+}
+
+long attr_args_offset(short ac, t_atom *av){
+    for(long i=0;i<ac;i++){
+        if(av[i].a_type == A_SYM && av[i].a_w.w_sym->s_name[0] == '@'){
+            return i;
+        }
+    }
+    return ac;
+}
+
+t_max_err attr_args_process(void *x, short ac, t_atom *av){
+    long i = attr_args_offset(ac, av);
+    while(i<ac){
+        t_symbol *name = gensym(av[i].a_w.w_sym->s_name+1);
+        long first = ++i;
+        while(i<ac && !(av[i].a_type == A_SYM && av[i].a_w.w_sym->s_name[0] == '@')){
+            i++;
+        }
+        t_mx_host_attr *attr = mx_host_attr(((t_object *)x)->o_class, name);
+        if(attr){
+            mx_host_attr_set((t_object *)x, attr, i-first, av+first);
+        }else{
+            post("%s: no attribute %s", ((t_object *)x)->o_class->name, name->s_name);
+        }
+    }
+    return MAX_ERR_NONE;
+}
+
+//OBJECTS
+
+void *object_alloc(t_class *c){
+    mx_host_init();
+    t_object *x = (t_object *)calloc(1, c->size);
+    x->o_class = c;
+    x->o_box = (t_mx_host_box *)calloc(1, sizeof(t_mx_host_box));
+    return x;
+}
+
+t_symbol *object_classname(void *x){
+    return ((t_object *)x)->o_class->sym;
+}
+
+t_max_err object_free(void *v){
+    t_object *x = (t_object *)v;
+    if(!x){
+        return MAX_ERR_INVALID_PTR;
+    }
+    if(x->o_box && x->o_box->chain){
+        mx_host_dsp_stop(x);
+    }
+    if(x->o_class->mfree){
+        x->o_class->mfree(x);
+    }
+    if(x->o_box){
+        for(long i=0;i<x->o_box->noutlets;i++){
+            free(x->o_box->outlets[i]);
+        }
+        free(x->o_box);
+    }
+    free(x);
+    return MAX_ERR_NONE;
+}
+
+void freeobject(t_object *op){
+    object_free(op);
+}
+
+void *object_method(void *x, t_symbol *s, ...){
+    //A_CANT methods take their arguments as they were passed, like max does
+    t_mx_host_method *m = mx_host_method((t_object *)x, s);
+    if(!m){
+        return NULL;
+    }
+    void *a[6];
+    va_list ap;
+    va_start(ap, s);
+    for(int i=0;i<6;i++){
+        a[i] = va_arg(ap, void *);
+    }
+    va_end(ap);
+    return m->fn(x, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+t_max_err object_method_typed(void *x, t_symbol *s, long ac, t_atom *av, t_atom *rv){
+    (void)rv;
+    return mx_host_send_atoms((t_object *)x, s, ac, av) ? MAX_ERR_GENERIC : MAX_ERR_NONE;
+}
+
+int mx_host_send_atoms(t_object *x, t_symbol *s, long argc, t_atom *argv){
+    t_mx_host_method *m = mx_host_method(x, s);
+    
+    if(!m){
+        t_mx_host_attr *attr = mx_host_attr(x->o_class, s);
+        if(attr){
+            return mx_host_attr_set(x, attr, argc, argv) ? 1 : 0;
+        }
+        post("%s: doesn't understand \"%s\"", x->o_class->name, s->s_name);
+        return 1;
+    }
+    
+    if(m->ntypes && m->types[0] == A_GIMME){
+        ((void (*)(t_object *, t_symbol *, long, t_atom *))m->fn)(x, s, argc, argv);
+        return 0;
+    }
+    
+    t_atom_long l[4] = {0, 0, 0, 0};
+    long nlongs = 0;
+    for(long i=0;i<m->ntypes;i++){
+        switch(m->types[i]){
+            case A_LONG:
+            case A_DEFLONG:
+                if(nlongs<4){
+                    l[nlongs] = i<argc ? atom_getlong(argv+i) : 0;
+                    nlongs++;
+                }
+                break;
+            case A_SYM:
+            case A_DEFSYM:
+                ((void (*)(t_object *, t_symbol *))m->fn)(x, argc ? atom_getsym(argv) : gensym(""));
+                return 0;
+            case A_FLOAT:
+            case A_DEFFLOAT:
+                ((void (*)(t_object *, double))m->fn)(x, argc ? atom_getfloat(argv) : 0);
+                return 0;
+            default:
+                post("%s: \"%s\" can't be sent as a message", x->o_class->name, s->s_name);
+                return 1;
+        }
+    }
+    ((void (*)(t_object *, t_atom_long, t_atom_long, t_atom_long, t_atom_long))m->fn)(x, l[0], l[1], l[2], l[3]);
+    return 0;
+}
+
+int mx_host_send(t_object *x, const char *text){
+    t_atom argv[MX_HOST_ARGS];
+    long argc = mx_host_parse(text, argv, MX_HOST_ARGS);
+    if(!argc){
+        return 1;
+    }
+    if(argv[0].a_type == A_SYM){
+        return mx_host_send_atoms(x, argv[0].a_w.w_sym, argc-1, argv+1);
+    }
+    if(argc>1){
+        return mx_host_send_atoms(x, gensym("list"), argc, argv);
+    }
+    return mx_host_send_atoms(x, gensym(argv[0].a_type == A_LONG ? "int" : "float"), 1, argv);
+}
+
+t_object *mx_host_new(const char *classname, const char *args){
+    mx_host_init();
+    t_class *c = mx_host_class(classname);
+    if(!c){
+        post("mx_host: no class %s", classname);
+        return NULL;
+    }
+    t_atom argv[MX_HOST_ARGS];
+    long argc = mx_host_parse(args, argv, MX_HOST_ARGS);
+    return (t_object *)((void *(*)(t_symbol *, long, t_atom *))c->mnew)(gensym(classname), argc, argv);
+}
+
+void mx_host_free(t_object *x){
+    object_free(x);
+}
+
+//LOADING
+
+static void mx_host_init(void){
+    if(mx_host_started){
+        return;
+    }
+    mx_host_started = 1;
+    mx_host_main = pthread_self();
+    
+    const char *check = getenv("MX_PERFORM_CHECK");
+    if(check){
+        mx_host_check = !strcmp(check, "abort") ? MX_HOST_CHECK_ABORT : !strcmp(check, "log") ? MX_HOST_CHECK_LOG : MX_HOST_CHECK_OFF;
+    }
+    
+    //the host's own objects, never registered so they can't be made from text
+    mx_host_chain_class = class_new("dspchain", NULL, NULL, sizeof(t_mx_host_chain), NULL, 0, 0);
+    class_addmethod(mx_host_chain_class, (method)mx_host_dsp_add64, "dsp_add64", A_CANT, 0);
+    mx_host_dict_class = class_new("dictionary", NULL, (method)mx_host_dict_free, sizeof(t_dictionary), NULL, 0, 0);
+    mx_host_buffer_class = class_new("buffer~", NULL, (method)mx_host_buffer_release, sizeof(t_mx_host_buffer), NULL, 0, 0);
+    class_addmethod(mx_host_buffer_class, (method)mx_host_buffer_size, "sizeinsamps", A_GIMME, 0);
+    mx_host_ref_class = class_new("buffer_ref", NULL, NULL, sizeof(t_buffer_ref), NULL, 0, 0);
+    mx_host_clock_class = class_new("clock", NULL, (method)mx_host_clock_release, sizeof(t_clock), NULL, 0, 0);
+}
+
+int mx_host_load(const char *path){
+    mx_host_init();
+    //local, so the statics of one external never stand in for those of another
+    void *lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if(!lib){
+        post("mx_host: %s", dlerror());
+        return 1;
+    }
+    void (*ext_main)(void *) = (void (*)(void *))dlsym(lib, "ext_main");
+    if(!ext_main){
+        post("mx_host: no ext_main in %s", path);
+        dlclose(lib);
+        return 1;
+    }
+    ext_main(NULL);
+    return 0;
+}
+
+long mx_host_load_dir(const char *dir){
+    DIR *d = opendir(dir);
+    if(!d){
+        post("mx_host: can't open %s", dir);
+        return 0;
+    }
+    long loaded = 0;
+    struct dirent *e;
+    while((e = readdir(d))){
+        const char *dot = strrchr(e->d_name, '.');
+        if(!dot || (strcmp(dot, ".so") && strcmp(dot, ".dylib"))){
+            continue;
+        }
+        char path[MAX_PATH_CHARS];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        loaded += !mx_host_load(path);
+    }
+    closedir(d);
+    return loaded;
+}
+
+//OUTLETS
+
+void *outlet_new(void *x, C74_CONST char *s){
+    t_mx_host_box *box = ((t_object *)x)->o_box;
+    if(box->noutlets >= MX_HOST_OUTLETS){
+        return NULL;
+    }
+    t_mx_host_outlet *o = (t_mx_host_outlet *)calloc(1, sizeof(t_mx_host_outlet));
+    o->owner = (t_object *)x;
+    o->type = s ? gensym(s) : NULL;
+    o->created = box->noutlets;
+    box->outlets[box->noutlets++] = o;
+    return o;
+}
+
+void *bangout(void *x){
+    return outlet_new(x, "bang");
+}
+
+void *intout(void *x){
+    return outlet_new(x, "int");
+}
+
+void *outlet_anything(void *o, t_symbol *s, short ac, t_atom *av){
+    t_mx_host_outlet *out = (t_mx_host_outlet *)o;
+    __atomic_add_fetch(&mx_host_counted.messages, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mx_host_counted.atoms, ac, __ATOMIC_RELAXED);
+    if(out && mx_host_hook){
+        long outlets = out->owner->o_box->noutlets;
+        mx_host_hook(mx_host_hook_ctx, out->owner, outlets-1-out->created, s, ac, av);
+    }
+    return NULL;
+}
+
+void *outlet_list(void *o, t_symbol *s, short ac, t_atom *av){
+    (void)s;
+    return outlet_anything(o, gensym("list"), ac, av);
+}
+
+void *outlet_bang(void *o){
+    return outlet_anything(o, gensym("bang"), 0, NULL);
+}
+
+void *outlet_int(void *o, t_atom_long n){
+    t_atom a;
+    atom_setlong(&a, n);
+    return outlet_anything(o, gensym("int"), 1, &a);
+}
+
+void *outlet_float(void *o, double f){
+    t_atom a;
+    atom_setfloat(&a, f);
+    return outlet_anything(o, gensym("float"), 1, &a);
+}
+
+long mx_host_outlets(t_object *x){
+    return x->o_box->noutlets;
+}
+
+void mx_host_connect(t_object *x, long outlet){
+    t_mx_host_method *m = mx_host_method(x, gensym("patchlineupdate"));
+    if(m){
+        ((t_max_err (*)(t_object *, t_object *, long, t_object *, long, t_object *, long))m->fn)(x, NULL, JPATCHLINE_CONNECT, x, outlet, NULL, 0);
+    }
+}
+
+void mx_host_connect_all(t_object *x){
+    for(long i=0;i<x->o_box->noutlets;i++){
+        mx_host_connect(x, i);
+    }
+}
+
+void mx_host_outlet_hook(mx_host_outlet_fn fn, void *ctx){
+    mx_host_hook = fn;
+    mx_host_hook_ctx = ctx;
+}
+
+//COUNTERS
+
+void mx_host_counters(t_mx_host_counters *c){
+    c->allocs = __atomic_load_n(&mx_host_counted.allocs, __ATOMIC_RELAXED);
+    c->resizes = __atomic_load_n(&mx_host_counted.resizes, __ATOMIC_RELAXED);
+    c->frees = __atomic_load_n(&mx_host_counted.frees, __ATOMIC_RELAXED);
+    c->alloc_bytes = __atomic_load_n(&mx_host_counted.alloc_bytes, __ATOMIC_RELAXED);
+    c->live_bytes = __atomic_load_n(&mx_host_counted.live_bytes, __ATOMIC_RELAXED);
+    c->peak_bytes = __atomic_load_n(&mx_host_counted.peak_bytes, __ATOMIC_RELAXED);
+    c->messages = __atomic_load_n(&mx_host_counted.messages, __ATOMIC_RELAXED);
+    c->atoms = __atomic_load_n(&mx_host_counted.atoms, __ATOMIC_RELAXED);
+}
+
+void mx_host_counters_reset(void){
+    //live bytes stay, they belong to blocks that are still around
+    __atomic_store_n(&mx_host_counted.allocs, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&mx_host_counted.resizes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&mx_host_counted.frees, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&mx_host_counted.alloc_bytes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&mx_host_counted.peak_bytes, __atomic_load_n(&mx_host_counted.live_bytes, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    __atomic_store_n(&mx_host_counted.messages, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&mx_host_counted.atoms, 0, __ATOMIC_RELAXED);
+}
+
+//QELEMS
+
+t_qelem *qelem_new(void *obj, method fn){
+    t_qelem *q = (t_qelem *)calloc(1, sizeof(t_qelem));
+    q->obj = obj;
+    q->fn = fn;
+    return q;
+}
+
+void qelem_set(t_qelem *q){
+    pthread_mutex_lock(&mx_host_qelem_lock);
+    if(!q->set){
+        q->set = 1;
+        q->next = NULL;
+        t_qelem **tail = &mx_host_pending;
+        while(*tail){
+            tail = &(*tail)->next;
+        }
+        *tail = q;
+    }
+    pthread_mutex_unlock(&mx_host_qelem_lock);
+}
+
+void qelem_front(t_qelem *q){
+    pthread_mutex_lock(&mx_host_qelem_lock);
+    if(!q->set){
+        q->set = 1;
+        q->next = mx_host_pending;
+        mx_host_pending = q;
+    }
+    pthread_mutex_unlock(&mx_host_qelem_lock);
+}
+
+void qelem_unset(t_qelem *q){
+    pthread_mutex_lock(&mx_host_qelem_lock);
+    if(q->set){
+        t_qelem **p = &mx_host_pending;
+        while(*p && *p!=q){
+            p = &(*p)->next;
+        }
+        if(*p){
+            *p = q->next;
+        }
+        q->set = 0;
+    }
+    pthread_mutex_unlock(&mx_host_qelem_lock);
+}
+
+void qelem_free(t_qelem *q){
+    if(q){
+        qelem_unset(q);
+        free(q);
+    }
+}
+
+void mx_host_idle(void){
+    //a qelem set again while running goes to the end of the queue and runs in this pass too
+    for(;;){
+        pthread_mutex_lock(&mx_host_qelem_lock);
+        t_qelem *q = mx_host_pending;
+        if(q){
+            mx_host_pending = q->next;
+            q->set = 0;
+        }
+        pthread_mutex_unlock(&mx_host_qelem_lock);
+        if(!q){
+            break;
+        }
+        q->fn(q->obj);
+    }
+}
+
+//CLOCKS
+//every clock is in one list, the ones set carry the time they're due
+
+void *clock_new(void *obj, method fn){
+    mx_host_init();
+    t_clock *c = (t_clock *)object_alloc(mx_host_clock_class);
+    c->owner = obj;
+    c->fn = fn;
+    pthread_mutex_lock(&mx_host_clock_lock);
+    c->next = mx_host_clocks;
+    mx_host_clocks = c;
+    pthread_mutex_unlock(&mx_host_clock_lock);
+    return c;
+}
+
+static void mx_host_clock_release(t_clock *c){
+    pthread_mutex_lock(&mx_host_clock_lock);
+    for(t_clock **p=&mx_host_clocks;*p;p=&(*p)->next){
+        if(*p == c){
+            *p = c->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mx_host_clock_lock);
+}
+
+void clock_fdelay(void *x, double time){
+    t_clock *c = (t_clock *)x;
+    pthread_mutex_lock(&mx_host_clock_lock);
+    c->due = mx_host_now + MAX(time, 0);
+    c->set = 1;
+    pthread_mutex_unlock(&mx_host_clock_lock);
+}
+
+void clock_delay(void *x, long n){
+    clock_fdelay(x, n);
+}
+
+void clock_unset(void *x){
+    t_clock *c = (t_clock *)x;
+    pthread_mutex_lock(&mx_host_clock_lock);
+    c->set = 0;
+    pthread_mutex_unlock(&mx_host_clock_lock);
+}
+
+void clock_getftime(double *time){
+    *time = mx_host_time();
+}
+
+long gettime(void){
+    return (long)mx_host_time();
+}
+
+double systimer_gettime(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e3 + ts.tv_nsec/1e6;
+}
+
+double mx_host_time(void){
+    pthread_mutex_lock(&mx_host_clock_lock);
+    double now = mx_host_now;
+    pthread_mutex_unlock(&mx_host_clock_lock);
+    return now;
+}
+
+void mx_host_advance(double ms){
+    pthread_mutex_lock(&mx_host_clock_lock);
+    double until = mx_host_now + MAX(ms, 0);
+    for(;;){
+        //the earliest clock due, a clock set again while running can come due in this pass too
+        t_clock *next = NULL;
+        for(t_clock *c=mx_host_clocks;c;c=c->next){
+            if(c->set && c->due <= until && (!next || c->due < next->due)){
+                next = c;
+            }
+        }
+        if(!next){
+            break;
+        }
+        next->set = 0;
+        mx_host_now = MAX(mx_host_now, next->due);
+        pthread_mutex_unlock(&mx_host_clock_lock);
+        next->fn(next->owner);
+        pthread_mutex_lock(&mx_host_clock_lock);
+    }
+    mx_host_now = until;
+    pthread_mutex_unlock(&mx_host_clock_lock);
+}
+
+//THREADS AND LOCKS
+
+static void mx_host_thread_release(struct _mx_host_thread *t){
+    if(!__sync_sub_and_fetch(&t->refs, 1)){
+        free(t);
+    }
+}
+
+static void mx_host_thread_end(void){
+    //the thread's reference, when it returns or calls systhread_exit
+    if(mx_host_self){
+        mx_host_thread_release(mx_host_self);
+        mx_host_self = NULL;
+    }
+}
+
+static void *mx_host_thread_main(void *arg){
+    struct _mx_host_thread *t = (struct _mx_host_thread *)arg;
+    mx_host_self = t;
+    void *ret = t->fn(t->arg);
+    mx_host_thread_end();
+    return ret;
+}
+
+long systhread_create(method entryproc, void *arg, long stacksize, long priority, long flags, t_systhread *thread){
+    (void)stacksize; (void)priority; (void)flags;
+    struct _mx_host_thread *t = (struct _mx_host_thread *)calloc(1, sizeof(struct _mx_host_thread));
+    t->fn = entryproc;
+    t->arg = arg;
+    t->refs = 2;
+    if(pthread_create(&t->thread, NULL, mx_host_thread_main, t)){
+        free(t);
+        *thread = NULL;
+        return 1;
+    }
+    *thread = t;
+    return 0;
+}
+
+long systhread_join(t_systhread thread, unsigned int *retval){
+    void *ret = NULL;
+    if(!thread){
+        return 1;
+    }
+    long err = pthread_join(thread->thread, &ret);
+    if(retval){
+        *retval = (unsigned int)(uintptr_t)ret;
+    }
+    mx_host_thread_release(thread);
+    return err;
+}
+
+long systhread_detach(t_systhread thread){
+    if(!thread){
+        return 1;
+    }
+    long err = pthread_detach(thread->thread);
+    mx_host_thread_release(thread);
+    return err;
+}
+
+void systhread_exit(long status){
+    mx_host_thread_end();
+    pthread_exit((void *)(intptr_t)status);
+}
+
+void systhread_sleep(int milliseconds){
+    usleep(milliseconds*1000);
+}
+
+long systhread_ismainthread(void){
+    return mx_host_started && pthread_equal(pthread_self(), mx_host_main);
+}
+
+long systhread_istimerthread(void){
+    //clocks run on the thread that moves the time on, there is no scheduler thread
+    return 0;
+}
+
+t_systhread systhread_self(void){
+    //threads the host didn't start are told apart by a thread local of their own
+    return mx_host_self ? mx_host_self : &mx_host_self_other;
+}
+
+long systhread_mutex_new(t_systhread_mutex *pmutex, long flags){
+    (void)flags;
+    *pmutex = (t_systhread_mutex)calloc(1, sizeof(struct _mx_host_mutex));
+    return pthread_mutex_init(&(*pmutex)->mutex, NULL);
+}
+
+long systhread_mutex_free(t_systhread_mutex pmutex){
+    pthread_mutex_destroy(&pmutex->mutex);
+    free(pmutex);
+    return 0;
+}
+
+long systhread_mutex_lock(t_systhread_mutex pmutex){
+    mx_host_perform_violation("systhread_mutex_lock");
+    return pthread_mutex_lock(&pmutex->mutex);
+}
+
+long systhread_mutex_unlock(t_systhread_mutex pmutex){
+    return pthread_mutex_unlock(&pmutex->mutex);
+}
+
+void critical_new(t_critical *x){
+    //critical regions nest in max
+    pthread_mutexattr_t attr;
+    *x = (t_critical)calloc(1, sizeof(struct _mx_host_critical));
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&(*x)->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void critical_enter(t_critical x){
+    mx_host_perform_violation("critical_enter");
+    pthread_mutex_lock(&x->mutex);
+}
+
+void critical_exit(t_critical x){
+    pthread_mutex_unlock(&x->mutex);
+}
+
+//never waits, so it's fine in a perform routine
+short critical_tryenter(t_critical x){
+    return pthread_mutex_trylock(&x->mutex) ? 1 : 0;
+}
+
+void critical_free(t_critical x){
+    if(x){
+        pthread_mutex_destroy(&x->mutex);
+        free(x);
+    }
+}
+
+//DICTIONARIES
+//a list of entries, nested dictionaries are freed with the one they were appended to
+
+static void mx_host_entry_free(t_mx_host_entry *e){
+    for(long i=0;i<e->argc;i++){
+        if(e->argv[i].a_type == A_OBJ){
+            object_free(e->argv[i].a_w.w_obj);
+        }
+    }
+    free(e->argv);
+    free(e);
+}
+
+static void mx_host_dict_free(t_dictionary *d){
+    dictionary_clear(d);
+}
+
+t_dictionary *dictionary_new(void){
+    mx_host_init();
+    return (t_dictionary *)object_alloc(mx_host_dict_class);
+}
+
+static t_mx_host_entry *mx_host_dict_entry(C74_CONST t_dictionary *d, t_symbol *key){
+    for(t_mx_host_entry *e=d->entries;e;e=e->next){
+        if(e->key == key){
+            return e;
+        }
+    }
+    return NULL;
+}
+
+t_max_err dictionary_appendatoms(t_dictionary *d, t_symbol *key, long argc, t_atom *argv){
+    t_mx_host_entry *e = (t_mx_host_entry *)calloc(1, sizeof(t_mx_host_entry));
+    e->key = key;
+    e->argc = argc;
+    e->argv = (t_atom *)malloc(MAX(argc, 1) * sizeof(t_atom));
+    memcpy(e->argv, argv, argc * sizeof(t_atom));
+    
+    //an entry of the same name is replaced
+    t_mx_host_entry **p = &d->entries;
+    while(*p && (*p)->key != key){
+        p = &(*p)->next;
+    }
+    if(*p){
+        e->next = (*p)->next;
+        mx_host_entry_free(*p);
+    }
+    *p = e;
+    return MAX_ERR_NONE;
+}
+
+t_max_err dictionary_appendlong(t_dictionary *d, t_symbol *key, t_atom_long value){
+    t_atom a;
+    atom_setlong(&a, value);
+    return dictionary_appendatoms(d, key, 1, &a);
+}
+
+t_max_err dictionary_appendfloat(t_dictionary *d, t_symbol *key, double value){
+    t_atom a;
+    atom_setfloat(&a, value);
+    return dictionary_appendatoms(d, key, 1, &a);
+}
+
+t_max_err dictionary_appendsym(t_dictionary *d, t_symbol *key, t_symbol *value){
+    t_atom a;
+    atom_setsym(&a, value);
+    return dictionary_appendatoms(d, key, 1, &a);
+}
+
+t_max_err dictionary_appenddictionary(t_dictionary *d, t_symbol *key, t_object *value){
+    t_atom a;
+    atom_setobj(&a, value);
+    return dictionary_appendatoms(d, key, 1, &a);
+}
+
+t_max_err dictionary_getlong(C74_CONST t_dictionary *d, t_symbol *key, t_atom_long *value){
+    t_mx_host_entry *e = mx_host_dict_entry(d, key);
+    if(!e || !e->argc){
+        return MAX_ERR_GENERIC;
+    }
+    *value = atom_getlong(e->argv);
+    return MAX_ERR_NONE;
+}
+
+t_max_err dictionary_getatoms(C74_CONST t_dictionary *d, t_symbol *key, long *argc, t_atom **argv){
+    t_mx_host_entry *e = mx_host_dict_entry(d, key);
+    if(!e){
+        *argc = 0;
+        *argv = NULL;
+        return MAX_ERR_GENERIC;
+    }
+    *argc = e->argc;
+    *argv = e->argv;
+    return MAX_ERR_NONE;
+}
+
+long dictionary_hasentry(C74_CONST t_dictionary *d, t_symbol *key){
+    return mx_host_dict_entry(d, key) != NULL;
+}
+
+t_max_err dictionary_clear(t_dictionary *d){
+    while(d->entries){
+        t_mx_host_entry *e = d->entries;
+        d->entries = e->next;
+        mx_host_entry_free(e);
+    }
+    return MAX_ERR_NONE;
+}
+
+t_dictionary *dictobj_register(t_dictionary *d, t_symbol **name){
+    static long unique = 0;
+    if(!*name || !(*name)->s_name[0]){
+        char s[32];
+        snprintf(s, sizeof(s), "u%09ld", ++unique);
+        *name = gensym(s);
+    }
+    return d;
+}
+
+t_max_err dictobj_release(t_dictionary *d){
+    (void)d;
+    return MAX_ERR_NONE;
+}
+
+//FILES
+//there is no search path, a file is found when its name works as it is
+
+short locatefile_extended(char *name, short *outvol, t_fourcc *outtype, C74_CONST t_fourcc *filetypelist, short numtypes){
+    (void)filetypelist; (void)numtypes;
+    *outvol = 0;
+    if(outtype){
+        *outtype = 0;
+    }
+    return access(name, R_OK) ? 1 : 0;
+}
+
+short path_toabsolutesystempath(C74_CONST short in_path, C74_CONST char *in_filename, char *out_filename){
+    (void)in_path;
+    strncpy(out_filename, in_filename, MAX_PATH_CHARS-1);
+    out_filename[MAX_PATH_CHARS-1] = 0;
+    return 0;
+}
+
+short path_nameconform(C74_CONST char *src, char *dst, long style, long type){
+    //names are native already
+    (void)style; (void)type;
+    strncpy(dst, src, MAX_PATH_CHARS-1);
+    dst[MAX_PATH_CHARS-1] = 0;
+    return 0;
+}
+
+//BUFFERS
+
+static void mx_host_buffer_size(t_mx_host_buffer *b, t_symbol *s, long argc, t_atom *argv){
+    (void)s;
+    long frames = argc>0 ? (long)atom_getlong(argv) : b->frames;
+    long chans = argc>1 ? (long)atom_getlong(argv+1) : b->chans;
+    frames = MAX(frames, 0);
+    chans = MAX(chans, 1);
+    free(b->samples);
+    b->samples = (float *)calloc(MAX(frames*chans, 1), sizeof(float));
+    b->frames = frames;
+    b->chans = chans;
+}
+
+t_buffer_obj *mx_host_buffer_new(const char *name, long frames, long channels){
+    mx_host_init();
+    t_mx_host_buffer *b = (t_mx_host_buffer *)object_alloc(mx_host_buffer_class);
+    t_atom size[2];
+    b->name = gensym(name);
+    atom_setlong(size, frames);
+    atom_setlong(size+1, channels);
+    mx_host_buffer_size(b, NULL, 2, size);
+    b->next = mx_host_buffers;
+    mx_host_buffers = b;
+    return (t_buffer_obj *)b;
+}
+
+static void mx_host_buffer_release(t_mx_host_buffer *b){
+    t_mx_host_buffer **p = &mx_host_buffers;
+    while(*p && *p != b){
+        p = &(*p)->next;
+    }
+    if(*p){
+        *p = b->next;
+    }
+    free(b->samples);
+}
+
+void mx_host_buffer_free(t_buffer_obj *b){
+    object_free(b);
+}
+
+t_buffer_ref *buffer_ref_new(t_object *self, t_symbol *name){
+    (void)self;
+    mx_host_init();
+    t_buffer_ref *ref = (t_buffer_ref *)object_alloc(mx_host_ref_class);
+    ref->name = name;
+    return ref;
+}
+
+void buffer_ref_set(t_buffer_ref *x, t_symbol *name){
+    x->name = name;
+}
+
+t_buffer_obj *buffer_ref_getobject(t_buffer_ref *x){
+    for(t_mx_host_buffer *b=mx_host_buffers;b;b=b->next){
+        if(b->name == x->name){
+            return (t_buffer_obj *)b;
+        }
+    }
+    return NULL;
+}
+
+t_max_err buffer_ref_notify(t_buffer_ref *x, t_symbol *s, t_symbol *msg, void *sender, void *data){
+    (void)x; (void)s; (void)msg; (void)sender; (void)data;
+    return MAX_ERR_NONE;
+}
+
+float *buffer_locksamples(t_buffer_obj *b){
+    return ((t_mx_host_buffer *)b)->samples;
+}
+
+void buffer_unlocksamples(t_buffer_obj *b){
+    (void)b;
+}
+
+t_atom_long buffer_getchannelcount(t_buffer_obj *b){
+    return ((t_mx_host_buffer *)b)->chans;
+}
+
+t_atom_long buffer_getframecount(t_buffer_obj *b){
+    return ((t_mx_host_buffer *)b)->frames;
+}
+
+t_max_err buffer_setdirty(t_buffer_obj *b){
+    (void)b;
+    return MAX_ERR_NONE;
+}
+
+//DSP
+
+void dsp_setup(t_pxobject *x, long nsignals){
+    x->z_ob.o_box->nsigins = nsignals;
+}
+
+void dsp_free(t_pxobject *x){
+    if(x->z_ob.o_box->chain){
+        mx_host_dsp_stop((t_object *)x);
+    }
+}
+
+void class_dspinit(t_class *c){
+    c->dsp = 1;
+}
+
+void set_zero64(double *dst, long n){
+    memset(dst, 0, n*sizeof(double));
+}
+
+double sys_getsr(void){
+    return mx_host_sr;
+}
+
+long sys_getmaxblksize(void){
+    return mx_host_vs;
+}
+
+static void mx_host_dsp_add64(t_mx_host_chain *chain, t_object *x, method perform, long flags, void *userparam){
+    chain->x = x;
+    chain->perform = perform;
+    chain->flags = flags;
+    chain->userparam = userparam;
+}
+
+int mx_host_dsp_start(t_object *x, double samplerate, long vectorsize){
+    t_mx_host_box *box = x->o_box;
+    t_mx_host_method *dsp64 = mx_host_method(x, gensym("dsp64"));
+    t_mx_host_method *mc = mx_host_method(x, gensym("multichanneloutputs"));
+    
+    if(!x->o_class->dsp || !dsp64){
+        post("%s: no dsp", x->o_class->name);
+        return 1;
+    }
+    if(box->chain){
+        mx_host_dsp_stop(x);
+    }
+    
+    //signal outlets from the left, mc ones as wide as the object asks for
+    long widths[MX_HOST_OUTLETS];
+    long nsigouts = 0;
+    long numouts = 0;
+    for(long i=box->noutlets-1;i>=0;i--){
+        t_symbol *type = box->outlets[i]->type;
+        if(type == gensym("signal")){
+            widths[nsigouts] = 1;
+        }else if(type == gensym("multichannelsignal")){
+            widths[nsigouts] = mc ? ((long (*)(t_object *, long))mc->fn)(x, nsigouts) : 1;
+        }else{
+            continue;
+        }
+        numouts += widths[nsigouts++];
+    }
+    
+    t_mx_host_chain *chain = (t_mx_host_chain *)object_alloc(mx_host_chain_class);
+    chain->samplerate = samplerate;
+    chain->vectorsize = vectorsize;
+    chain->numins = box->nsigins;
+    chain->numouts = numouts;
+    chain->ins = (double **)calloc(MAX(chain->numins, 1), sizeof(double *));
+    chain->outs = (double **)calloc(MAX(numouts, 1), sizeof(double *));
+    chain->samples = (double *)calloc((chain->numins + numouts) * vectorsize + 1, sizeof(double));
+    for(long i=0;i<chain->numins;i++){
+        chain->ins[i] = chain->samples + i*vectorsize;
+    }
+    for(long i=0;i<numouts;i++){
+        chain->outs[i] = chain->samples + (chain->numins + i)*vectorsize;
+    }
+    box->chain = chain;
+    
+    mx_host_sr = samplerate;
+    mx_host_vs = vectorsize;
+    
+    //every inlet and outlet counts as connected
+    short count[MX_HOST_OUTLETS*2];
+    for(long i=0;i<MX_HOST_OUTLETS*2;i++){
+        count[i] = 1;
+    }
+    ((void (*)(t_object *, t_object *, short *, double, long, long))dsp64->fn)(x, (t_object *)chain, count, samplerate, vectorsize, 0);
+    
+    if(!chain->perform){
+        post("%s: dsp64 added no perform routine", x->o_class->name);
+        mx_host_dsp_stop(x);
+        return 1;
+    }
+    return 0;
+}
+
+long mx_host_dsp_numins(t_object *x){
+    return x->o_box->chain ? x->o_box->chain->numins : 0;
+}
+
+long mx_host_dsp_numouts(t_object *x){
+    return x->o_box->chain ? x->o_box->chain->numouts : 0;
+}
+
+double **mx_host_dsp_ins(t_object *x){
+    return x->o_box->chain ? x->o_box->chain->ins : NULL;
+}
+
+double **mx_host_dsp_outs(t_object *x){
+    return x->o_box->chain ? x->o_box->chain->outs : NULL;
+}
+
+void mx_host_dsp_tick(t_object *x){
+    t_mx_host_chain *chain = x->o_box->chain;
+    mx_host_performing = x;
+    ((void (*)(t_object *, t_object *, double **, long, double **, long, long, long, void *))chain->perform)(x, (t_object *)chain, chain->ins, chain->numins, chain->outs, chain->numouts, chain->vectorsize, chain->flags, chain->userparam);
+    mx_host_performing = NULL;
+    mx_host_advance(chain->vectorsize * 1000. / chain->samplerate);
+}
+
+void mx_host_dsp_stop(t_object *x){
+    t_mx_host_chain *chain = x->o_box->chain;
+    if(!chain){
+        return;
+    }
+    x->o_box->chain = NULL;
+    free(chain->ins);
+    free(chain->outs);
+    free(chain->samples);
+    object_free(chain);
+}
@@ -0,0 +1,117 @@
+/*
+ * This file is part of the Schillinger Max Package, found at https://github.com/rybenmensch/schillinger.
+ * Copyright (c) 2020 Manolo Müller.
+ *
+ * The Schillinger Max Package is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//headless host: implements the part of the max api the package uses (see include/ext.h),
+//loads the externals built against it the way max does and drives them without a patcher.
+//messages are typed in as text, outlets can be watched through a hook and ~ objects get
+//a dsp chain of their own that the harness ticks one signal vector at a time.
+//
+//everything runs on the calling thread, except for the threads the objects start themselves.
+
+#ifndef MX_HOST_H
+#define MX_HOST_H
+
+#include "ext.h"
+#include "ext_buffer.h"
+
+//called for everything leaving an outlet, outlet counted from the left like in max
+typedef void (*mx_host_outlet_fn)(void *ctx, t_object *x, long outlet, t_symbol *s, long argc, t_atom *argv);
+
+//what the objects asked of the host since the last reset, summed over all objects and threads
+typedef struct _mx_host_counters{
+    long long allocs;           //sysmem_newptr(clear), and resizes of NULL
+    long long resizes;
+    long long frees;
+    long long alloc_bytes;      //bytes of new blocks and by which resizes grew blocks
+    long long live_bytes;       //sysmem blocks not freed yet
+    long long peak_bytes;       //most live bytes at any time since the reset
+    long long messages;         //messages sent from any outlet
+    long long atoms;            //atoms in those messages
+} t_mx_host_counters;
+
+//what happens when a perform routine allocates, frees or locks
+#define MX_HOST_CHECK_OFF 0
+#define MX_HOST_CHECK_LOG 1     //counted and reported with a backtrace on stderr
+#define MX_HOST_CHECK_ABORT 2   //reported, then abort()
+
+//LOADING AND OBJECTS
+
+//dlopens an external and runs its ext_main, returns 0 on success
+int mx_host_load(const char *path);
+//loads every external (*.so, *.dylib) in dir, returns the amount loaded
+long mx_host_load_dir(const char *dir);
+
+//creates an object of a loaded class from its box text without the class name ("3 2 @coalesce 1")
+t_object *mx_host_new(const char *classname, const char *args);
+void mx_host_free(t_object *x);
+//sends a message typed as text ("gen 3 2", "pat 3 1 2"), returns 0 if the object understood it
+int mx_host_send(t_object *x, const char *text);
+int mx_host_send_atoms(t_object *x, t_symbol *s, long argc, t_atom *argv);
+
+//runs the qelems that were set, like max does when it gets to its low priority queue
+void mx_host_idle(void);
+
+//the scheduler's time in ms. mx_host_dsp_tick moves it on by one vector, mx_host_advance by any
+//amount, the clocks coming due on the way run in time order with the time set to theirs
+double mx_host_time(void);
+void mx_host_advance(double ms);
+
+//OUTLETS
+
+long mx_host_outlets(t_object *x);
+//sends patchlineupdate for a cord leaving outlet (from the left), so the object builds its output
+void mx_host_connect(t_object *x, long outlet);
+void mx_host_connect_all(t_object *x);
+void mx_host_outlet_hook(mx_host_outlet_fn fn, void *ctx);
+
+//COUNTERS
+
+void mx_host_counters(t_mx_host_counters *c);
+void mx_host_counters_reset(void);
+
+//DSP
+//one chain per object: the signal inlets and the (mc expanded) signal outlets get buffers of
+//their own, so the perform routine never works in place
+
+int mx_host_dsp_start(t_object *x, double samplerate, long vectorsize);
+//inputs to fill (or point elsewhere) before a tick, outputs to read after one,
+//left to right, outs channel by channel
+long mx_host_dsp_numins(t_object *x);
+long mx_host_dsp_numouts(t_object *x);
+double **mx_host_dsp_ins(t_object *x);
+double **mx_host_dsp_outs(t_object *x);
+//runs the perform routine over one vector of vectorsize samples, then moves the time on by as much
+void mx_host_dsp_tick(t_object *x);
+void mx_host_dsp_stop(t_object *x);
+
+//PERFORM CHECK
+//sysmem_newptr, sysmem_resizeptr, sysmem_freeptr, systhread_mutex_lock and critical_enter
+//are flagged while mx_host_dsp_tick runs a perform routine. off unless the host was built
+//with MX_HOST_PERFORM_CHECK set to a mode, the environment variable MX_PERFORM_CHECK
+//(off, log, abort) or this call change it
+
+void mx_host_perform_check(int mode);
+//flagged calls since the start, over all objects
+long mx_host_perform_violations(void);
+
+//BUFFERS
+//named buffer~ stand-ins, found by buffer_ref_new and object_method_typed "sizeinsamps"
+
+t_buffer_obj *mx_host_buffer_new(const char *name, long frames, long channels);
+void mx_host_buffer_free(t_buffer_obj *b);
+
+#endif